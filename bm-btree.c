@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cu.h"
+#include "cu-avl-tree.h"
+#include "cu-btree.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+static void *bm_avl_tree_new(void) { return cu_avl_tree_new(NULL, NULL, NULL, NULL); }
+static void *bm_btree_new(void) { return cu_btree_new(NULL, NULL, NULL, NULL); }
+
+static BMMap maps[] = {
+    BM_MAP("avl-tree", cu_avl_tree, bm_avl_tree_new, 0),
+    BM_MAP("btree", cu_btree, bm_btree_new, 0),
+};
+
+static
+bool count_element(void *key, void *value, uint64_t *count)
+{
+    ++*count;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000000ULL;
+    uint64_t count, j, found;
+    uint32_t m;
+    uint64_t starttime;
+    void *map;
+
+    fprintf(stdout, "%-10s %12s %14s %14s %14s\n", "map", "keys", "insert ns/op", "find ns/op", "scan ns/elem");
+    for (count = 1000; count <= max_count; count *= 10) {
+        for (m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m) {
+            map = maps[m].create();
+
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j)
+                maps[m].insert(map, BM_KEY(j), BM_KEY(j));
+            double insert_ns = bm_elapsed_ns(starttime, count);
+
+            /* Look up in a different order than inserted. */
+            found = 0;
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j)
+                found += maps[m].find(map, BM_KEY((j * 7919) % count), NULL);
+            double find_ns = bm_elapsed_ns(starttime, count);
+
+            uint64_t visited = 0;
+            starttime = bm_now_ns();
+            maps[m].foreach(map, (CUTraverseFunc)count_element, &visited);
+            double scan_ns = bm_elapsed_ns(starttime, count);
+
+            if (found != count || visited != count)
+                fprintf(stderr, "%s: found %" PRIu64 ", visited %" PRIu64 " of %" PRIu64 "\n",
+                        maps[m].name, found, visited, count);
+
+            fprintf(stdout, "%-10s %12" PRIu64 " %14.1f %14.1f %14.1f\n",
+                    maps[m].name, count, insert_ns, find_ns, scan_ns);
+            fflush(stdout);
+
+            maps[m].destroy(map);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/** @file bm-common.h
+ *  Helpers shared by the benchmarks. Not part of the library and not installed.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "cu-types.h"
+#include "cu-memory.h"
+
+/* Spread consecutive indices over the whole key space (bijective on 64 bit). */
+#define BM_KEY(j) ((void *)(uintptr_t)((uint64_t)(j) * 0x9e3779b97f4a7c15ULL))
+
+/* Seed of the random numbers of the t-th thread, counting from 0. */
+#define BM_SEED(t) (0x2545f4914f6cdd1dULL * ((uint64_t)(t) + 1))
+
+/* A map as seen by the benchmarks. Operations a benchmark does not use may be NULL. */
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *);
+    void (*insert)(void *, void *, void *);
+    bool (*remove)(void *, void *);
+    bool (*find)(void *, void *, void **);
+    void (*foreach)(void *, CUTraverseFunc, void *);
+    uint64_t max_count; /* Skip larger key counts if not 0. */
+} BMMap;
+
+/* Describe a map whose functions are all named prefix_<operation>. */
+#define BM_MAP(name, prefix, create, max_count) \
+    { name, create, (void (*)(void *))prefix##_destroy, \
+      (void (*)(void *, void *, void *))prefix##_insert, \
+      (bool (*)(void *, void *))prefix##_remove, \
+      (bool (*)(void *, void *, void **))prefix##_find, \
+      (void (*)(void *, CUTraverseFunc, void *))prefix##_foreach, max_count }
+
+/* Loop over 1, 2, 4, ... threads, the last step being max_threads (at least 1). */
+#define BM_FOREACH_THREAD_COUNT(nthreads, max_threads) \
+    for ((nthreads) = 1; (nthreads); \
+         (nthreads) = (nthreads) == (max_threads) ? 0 : \
+                      (2 * (nthreads) < (max_threads) ? 2 * (nthreads) : (max_threads)))
+
+static inline
+uint64_t bm_random(uint64_t *state)
+{
+    /* xorshift64 */
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static inline
+uint64_t bm_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Nanoseconds per operation since start, for count operations. */
+static inline
+double bm_elapsed_ns(uint64_t start, uint64_t count)
+{
+    return (double)(bm_now_ns() - start) / count;
+}
+
+/* The thread count given as command line argument, or one per online processor. */
+static inline
+uint32_t bm_max_threads(const char *arg)
+{
+    uint32_t max_threads = arg ? strtoul(arg, NULL, 10) : (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    return max_threads ? max_threads : 1;
+}
+
+/* Run func on nthreads threads, the t-th getting the t-th element of size bytes of args.
+ * Return the wall time in seconds until all threads finished. */
+static inline
+double bm_run_threads(void *(*func)(void *), void *args, size_t size, uint32_t nthreads)
+{
+    pthread_t *thread_ids = cu_alloc(nthreads * sizeof(pthread_t));
+    uint64_t start = bm_now_ns();
+    uint32_t t;
+
+    for (t = 0; t < nthreads; ++t)
+        pthread_create(&thread_ids[t], NULL, func, (char *)args + t * size);
+    for (t = 0; t < nthreads; ++t)
+        pthread_join(thread_ids[t], NULL);
+    double seconds = (bm_now_ns() - start) * 1e-9;
+
+    cu_free(thread_ids);
+    return seconds;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "cu.h"
+#include "cu-hash-table.h"
+#include "cu-concurrent-hash-map.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Operations per thread. */
+#define BM_OPERATIONS 1000000
+
+typedef struct {
+    CUHashTable *table;
+    pthread_mutex_t lock;
+} BMLockedTable;
+
+typedef struct {
+    const char *name;
+    uint32_t update_percent; /* Half inserts, half removes. */
+} BMWorkload;
+
+static void *bm_locked_table_new(void)
+{
+    BMLockedTable *map = cu_alloc(sizeof(BMLockedTable));
+    map->table = cu_hash_table_new(NULL, NULL, NULL, NULL);
+    pthread_mutex_init(&map->lock, NULL);
+    return map;
+}
+
+static void bm_locked_table_destroy(BMLockedTable *map)
+{
+    cu_hash_table_destroy(map->table);
+    pthread_mutex_destroy(&map->lock);
+    cu_free(map);
+}
+
+static void bm_locked_table_insert(BMLockedTable *map, void *key, void *value)
+{
+    pthread_mutex_lock(&map->lock);
+    cu_hash_table_insert(map->table, key, value);
+    pthread_mutex_unlock(&map->lock);
+}
+
+static bool bm_locked_table_remove(BMLockedTable *map, void *key)
+{
+    pthread_mutex_lock(&map->lock);
+    bool rc = cu_hash_table_remove(map->table, key);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+static bool bm_locked_table_find(BMLockedTable *map, void *key, void **data)
+{
+    pthread_mutex_lock(&map->lock);
+    bool rc = cu_hash_table_find(map->table, key, data);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+static void *bm_concurrent_hash_map_new(void) { return cu_concurrent_hash_map_new(NULL, NULL, NULL, NULL); }
+
+static BMMap maps[] = {
+    { .name = "hash-table+mutex", .create = bm_locked_table_new, .destroy = (void (*)(void *))bm_locked_table_destroy,
+      .insert = (void (*)(void *, void *, void *))bm_locked_table_insert,
+      .remove = (bool (*)(void *, void *))bm_locked_table_remove,
+      .find = (bool (*)(void *, void *, void **))bm_locked_table_find },
+    BM_MAP("concurrent-map", cu_concurrent_hash_map, bm_concurrent_hash_map_new, 0),
+};
+
+static BMWorkload workloads[] = {
+    { "read-heavy", 5 },
+    { "mixed", 50 },
+};
+
+typedef struct {
+    BMMap *map;
+    void *data;
+    uint64_t key_count;
+    uint32_t update_percent;
+    uint64_t seed;
+} BMThread;
+
+static
+void *bm_thread(BMThread *thread)
+{
+    uint64_t x = thread->seed;
+    uint64_t j, key;
+    uint32_t op;
+
+    for (j = 0; j < BM_OPERATIONS; ++j) {
+        bm_random(&x);
+        key = (x >> 8) % thread->key_count;
+        op = (x >> 40) % 100;
+        if (op < thread->update_percent / 2)
+            thread->map->insert(thread->data, BM_KEY(key), BM_KEY(key));
+        else if (op < thread->update_percent)
+            thread->map->remove(thread->data, BM_KEY(key));
+        else
+            thread->map->find(thread->data, BM_KEY(key), NULL);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t key_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000ULL;
+    uint32_t max_threads = bm_max_threads(argc > 2 ? argv[2] : NULL);
+    uint32_t nthreads, m, t, w;
+    uint64_t j;
+
+    BMThread *threads = cu_alloc(max_threads * sizeof(BMThread));
+
+    fprintf(stdout, "%-12s %-18s %8s %14s\n", "workload", "map", "threads", "Mops/s");
+    for (w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w) {
+        BM_FOREACH_THREAD_COUNT(nthreads, max_threads) {
+            for (m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m) {
+                void *data = maps[m].create();
+
+                /* Fill half of the keys, the updates keep it about there. */
+                for (j = 0; j < key_count; j += 2)
+                    maps[m].insert(data, BM_KEY(j), BM_KEY(j));
+
+                for (t = 0; t < nthreads; ++t)
+                    threads[t] = (BMThread){ &maps[m], data, key_count, workloads[w].update_percent, BM_SEED(t) };
+                double seconds = bm_run_threads((void *(*)(void *))bm_thread, threads, sizeof(BMThread), nthreads);
+
+                fprintf(stdout, "%-12s %-18s %8" PRIu32 " %14.2f\n", workloads[w].name, maps[m].name, nthreads,
+                        (double)nthreads * BM_OPERATIONS / seconds * 1e-6);
+                fflush(stdout);
+
+                maps[m].destroy(data);
+            }
+        }
+    }
+
+    cu_free(threads);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cu.h"
+#include "cu-avl-tree.h"
+#include "cu-hash-table.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+static void *bm_avl_tree_new(void) { return cu_avl_tree_new(NULL, NULL, NULL, NULL); }
+static void *bm_hash_table_new(void) { return cu_hash_table_new(NULL, NULL, NULL, NULL); }
+
+static BMMap maps[] = {
+    BM_MAP("avl-tree", cu_avl_tree, bm_avl_tree_new, 0),
+    BM_MAP("hash-table", cu_hash_table, bm_hash_table_new, 0),
+};
+
+int main(int argc, char **argv)
+{
+    uint64_t max_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000ULL;
+    uint64_t count, j, found, missed;
+    uint32_t m;
+    uint64_t starttime;
+    void *map;
+
+    fprintf(stdout, "%-10s %12s %14s %14s %14s\n", "map", "keys", "insert ns/op", "find ns/op", "miss ns/op");
+    for (count = 1000; count <= max_count; count *= 10) {
+        for (m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m) {
+            map = maps[m].create();
+
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j)
+                maps[m].insert(map, BM_KEY(j), BM_KEY(j));
+            double insert_ns = bm_elapsed_ns(starttime, count);
+
+            /* Look up in a different order than inserted. */
+            found = 0;
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j)
+                found += maps[m].find(map, BM_KEY((j * 7919) % count), NULL);
+            double find_ns = bm_elapsed_ns(starttime, count);
+
+            missed = 0;
+            starttime = bm_now_ns();
+            for (j = count; j < 2 * count; ++j)
+                missed += !maps[m].find(map, BM_KEY(j), NULL);
+            double miss_ns = bm_elapsed_ns(starttime, count);
+
+            if (found != count || missed != count)
+                fprintf(stderr, "%s: found %" PRIu64 ", missed %" PRIu64 " of %" PRIu64 "\n",
+                        maps[m].name, found, missed, count);
+
+            fprintf(stdout, "%-10s %12" PRIu64 " %14.1f %14.1f %14.1f\n",
+                    maps[m].name, count, insert_ns, find_ns, miss_ns);
+            fflush(stdout);
+
+            maps[m].destroy(map);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <malloc.h>
+#include "cu.h"
+#include "cu-memory.h"
+#include "cu-ar-tree.h"
+#include "cu-avl-tree.h"
+#include "cu-btree.h"
+#include "cu-concurrent-hash-map.h"
+#include "cu-hash-table.h"
+#include "cu-skip-list.h"
+#include "cu-sorted-vector.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Operations timed together for one sample. A single operation is too short for the clock. */
+#define BM_BATCH 64
+
+/* Number of traversals to time for foreach. */
+#define BM_FOREACH_RUNS 8
+
+/* Skew of the Zipfian distribution, as in YCSB. */
+#define BM_ZIPF_THETA 0.99
+
+typedef enum {
+    BM_SEQUENTIAL = 0,
+    BM_RANDOM,
+    BM_ZIPFIAN,
+    BM_WORKLOADS
+} BMWorkload;
+
+static const char *workload_names[BM_WORKLOADS] = { "sequential", "random", "zipfian" };
+
+static void *bm_avl_tree_new(void) { return cu_avl_tree_new(NULL, NULL, NULL, NULL); }
+static void *bm_avl_tree_malloc_new(void) { return cu_avl_tree_new_full(NULL, NULL, NULL, NULL, false); }
+static void *bm_btree_new(void) { return cu_btree_new(NULL, NULL, NULL, NULL); }
+static void *bm_skip_list_new(void) { return cu_skip_list_new(NULL, NULL, NULL, NULL); }
+static void *bm_hash_table_new(void) { return cu_hash_table_new(NULL, NULL, NULL, NULL); }
+static void *bm_concurrent_hash_map_new(void) { return cu_concurrent_hash_map_new(NULL, NULL, NULL, NULL); }
+static void *bm_ar_tree_new(void) { return cu_ar_tree_new(NULL, NULL); }
+static void *bm_sorted_vector_new(void) { return cu_sorted_vector_new(NULL, NULL, NULL, NULL); }
+
+static BMMap maps[] = {
+    BM_MAP("avl-tree", cu_avl_tree, bm_avl_tree_new, 0),
+    BM_MAP("avl-tree-malloc", cu_avl_tree, bm_avl_tree_malloc_new, 0),
+    BM_MAP("btree", cu_btree, bm_btree_new, 0),
+    BM_MAP("skip-list", cu_skip_list, bm_skip_list_new, 0),
+    BM_MAP("hash-table", cu_hash_table, bm_hash_table_new, 0),
+    BM_MAP("concurrent-hash-map", cu_concurrent_hash_map, bm_concurrent_hash_map_new, 0),
+    BM_MAP("ar-tree", cu_ar_tree, bm_ar_tree_new, 0),
+    /* Every single insert moves the elements behind it. */
+    BM_MAP("sorted-vector", cu_sorted_vector, bm_sorted_vector_new, 100000),
+};
+
+/* Bytes currently allocated through cu_alloc(), including the overhead of malloc. */
+static size_t allocated;
+
+static void *bm_alloc(size_t size)
+{
+    void *ptr = malloc(size);
+    allocated += malloc_usable_size(ptr);
+    return ptr;
+}
+
+static void *bm_realloc(void *ptr, size_t size)
+{
+    allocated -= malloc_usable_size(ptr);
+    ptr = realloc(ptr, size);
+    allocated += malloc_usable_size(ptr);
+    return ptr;
+}
+
+static void bm_free(void *ptr)
+{
+    allocated -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+static uint64_t bm_random_state = BM_SEED(0);
+
+typedef struct {
+    uint64_t count;
+    double alpha;
+    double zeta;
+    double eta;
+    double half_pow_theta;
+} BMZipf;
+
+/* Gray et al., "Quickly generating billion-record synthetic databases". Rank 0 is the most popular. */
+static
+void bm_zipf_init(BMZipf *zipf, uint64_t count)
+{
+    double zeta2 = 1.0 + pow(0.5, BM_ZIPF_THETA);
+    uint64_t j;
+
+    zipf->count = count;
+    zipf->zeta = 0.0;
+    for (j = 1; j <= count; ++j)
+        zipf->zeta += 1.0 / pow((double)j, BM_ZIPF_THETA);
+    zipf->alpha = 1.0 / (1.0 - BM_ZIPF_THETA);
+    zipf->eta = (1.0 - pow(2.0 / count, 1.0 - BM_ZIPF_THETA)) / (1.0 - zeta2 / zipf->zeta);
+    zipf->half_pow_theta = pow(0.5, BM_ZIPF_THETA);
+}
+
+static
+uint64_t bm_zipf_next(BMZipf *zipf)
+{
+    double u = (double)(bm_random(&bm_random_state) >> 11) / (double)(1ULL << 53);
+    double uz = u * zipf->zeta;
+    uint64_t rank;
+
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + zipf->half_pow_theta)
+        return 1;
+    rank = (uint64_t)(zipf->count * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->count ? rank : zipf->count - 1;
+}
+
+static
+int bm_compare_samples(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Print one line of results. Sorts the samples (ns per operation). */
+static
+void bm_report(BMMap *map, BMWorkload workload, uint64_t count, const char *operation,
+               double *samples, uint64_t nsamples, double bytes_per_entry)
+{
+    double mean = 0.0;
+    uint64_t j;
+
+    for (j = 0; j < nsamples; ++j)
+        mean += samples[j];
+    mean /= nsamples;
+    qsort(samples, nsamples, sizeof(double), bm_compare_samples);
+
+    fprintf(stdout, "%s,%s,%" PRIu64 ",%s,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+            map->name, workload_names[workload], count, operation, mean,
+            samples[nsamples / 2], samples[nsamples * 90 / 100], samples[nsamples * 99 / 100],
+            bytes_per_entry);
+    fflush(stdout);
+}
+
+static
+bool bm_count_element(void *key, void *value, uint64_t *sum)
+{
+    *sum += (uintptr_t)key;
+    return true;
+}
+
+/* Run all operations on one map. The keys are given in the order to insert them. */
+static
+void bm_run(BMMap *map, BMWorkload workload, uint64_t count, void **keys, void **missing,
+            uint64_t *order, double *samples)
+{
+    uint64_t nsamples = (count + BM_BATCH - 1) / BM_BATCH;
+    uint64_t j, k, found = 0, missed = 0, removed = 0, start;
+    uint64_t sum;
+    BMZipf zipf;
+    void *data;
+
+    if (workload == BM_ZIPFIAN)
+        bm_zipf_init(&zipf, count);
+    /* Draw the keys to look up in advance, so that only the map is timed. */
+    for (j = 0; j < count; ++j)
+        order[j] = workload == BM_ZIPFIAN ? bm_zipf_next(&zipf) :
+                   workload == BM_RANDOM ? bm_random(&bm_random_state) % count : j;
+
+    size_t before = allocated;
+    data = map->create();
+
+    for (j = 0; j < nsamples; ++j) {
+        start = bm_now_ns();
+        for (k = j * BM_BATCH; k < (j + 1) * BM_BATCH && k < count; ++k)
+            map->insert(data, keys[k], keys[k]);
+        samples[j] = (double)(bm_now_ns() - start) / (k - j * BM_BATCH);
+    }
+    double bytes_per_entry = (double)(allocated - before) / count;
+    bm_report(map, workload, count, "insert", samples, nsamples, bytes_per_entry);
+
+    for (j = 0; j < nsamples; ++j) {
+        start = bm_now_ns();
+        for (k = j * BM_BATCH; k < (j + 1) * BM_BATCH && k < count; ++k)
+            found += map->find(data, keys[order[k]], NULL);
+        samples[j] = (double)(bm_now_ns() - start) / (k - j * BM_BATCH);
+    }
+    bm_report(map, workload, count, "find-hit", samples, nsamples, bytes_per_entry);
+
+    for (j = 0; j < nsamples; ++j) {
+        start = bm_now_ns();
+        for (k = j * BM_BATCH; k < (j + 1) * BM_BATCH && k < count; ++k)
+            missed += !map->find(data, missing[order[k]], NULL);
+        samples[j] = (double)(bm_now_ns() - start) / (k - j * BM_BATCH);
+    }
+    bm_report(map, workload, count, "find-miss", samples, nsamples, bytes_per_entry);
+
+    for (j = 0; j < BM_FOREACH_RUNS; ++j) {
+        sum = 0;
+        start = bm_now_ns();
+        map->foreach(data, (CUTraverseFunc)bm_count_element, &sum);
+        samples[j] = (double)(bm_now_ns() - start) / count;
+    }
+    bm_report(map, workload, count, "foreach", samples, BM_FOREACH_RUNS, bytes_per_entry);
+
+    /* Sequential keys are removed in ascending order, the others in random order. */
+    for (j = 0; j < count; ++j)
+        order[j] = j;
+    if (workload != BM_SEQUENTIAL) {
+        for (j = count - 1; j > 0; --j) {
+            k = bm_random(&bm_random_state) % (j + 1);
+            uint64_t tmp = order[j];
+            order[j] = order[k];
+            order[k] = tmp;
+        }
+    }
+    for (j = 0; j < nsamples; ++j) {
+        start = bm_now_ns();
+        for (k = j * BM_BATCH; k < (j + 1) * BM_BATCH && k < count; ++k)
+            removed += map->remove(data, keys[order[k]]);
+        samples[j] = (double)(bm_now_ns() - start) / (k - j * BM_BATCH);
+    }
+    bm_report(map, workload, count, "remove", samples, nsamples, bytes_per_entry);
+
+    if (found != count || missed != count || removed != count)
+        fprintf(stderr, "%s: found %" PRIu64 ", missed %" PRIu64 ", removed %" PRIu64 " of %" PRIu64 "\n",
+                map->name, found, missed, removed, count);
+
+    map->destroy(data);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t max_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000ULL;
+    uint64_t count, j;
+    uint32_t m, w;
+    CUMemoryHandler handler = { bm_alloc, bm_realloc, bm_free };
+
+    cu_set_memory_handler(&handler);
+
+    void **keys = malloc(max_count * sizeof(void *));
+    void **missing = malloc(max_count * sizeof(void *));
+    uint64_t *order = malloc(max_count * sizeof(uint64_t));
+    double *samples = malloc(((max_count + BM_BATCH - 1) / BM_BATCH + BM_FOREACH_RUNS) * sizeof(double));
+
+    fprintf(stdout, "map,workload,keys,operation,mean_ns,p50_ns,p90_ns,p99_ns,bytes_per_entry\n");
+    for (count = 1000; count <= max_count; count *= 10) {
+        for (w = 0; w < BM_WORKLOADS; ++w) {
+            /* Sequential keys are dense and ascending, the others spread over the key space. */
+            for (j = 0; j < count; ++j) {
+                keys[j] = w == BM_SEQUENTIAL ? (void *)(uintptr_t)(j + 1) : BM_KEY(j + 1);
+                missing[j] = w == BM_SEQUENTIAL ? (void *)(uintptr_t)(count + j + 1) : BM_KEY(count + j + 1);
+            }
+            for (m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m) {
+                if (maps[m].max_count && count > maps[m].max_count)
+                    continue;
+                bm_run(&maps[m], w, count, keys, missing, order, samples);
+            }
+        }
+    }
+
+    free(keys);
+    free(missing);
+    free(order);
+    free(samples);
+
+    return 0;
+}
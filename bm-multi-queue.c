@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "cu.h"
+#include "cu-heap.h"
+#include "cu-multi-queue.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Operations per thread, half inserts and half pops. */
+#define BM_OPERATIONS 1000000
+
+/* Elements in the queue before the threads start. */
+#define BM_INITIAL_SIZE 1000000
+
+typedef struct {
+    CUHeap heap;
+    pthread_mutex_t lock;
+} BMLockedHeap;
+
+typedef struct {
+    const char *name;
+    void *(*create)(uint32_t);
+    void (*destroy)(void *);
+    void (*insert)(void *, void *);
+    void *(*pop)(void *);
+} BMQueue;
+
+static
+int bm_compare_keys(void *a, void *b, void *data)
+{
+    /* The smallest key comes first. */
+    return (uintptr_t)a < (uintptr_t)b ? 1 : ((uintptr_t)a > (uintptr_t)b ? -1 : 0);
+}
+
+static void *bm_locked_heap_new(uint32_t nthreads)
+{
+    BMLockedHeap *queue = cu_alloc(sizeof(BMLockedHeap));
+    cu_heap_init(&queue->heap, bm_compare_keys, NULL);
+    pthread_mutex_init(&queue->lock, NULL);
+    return queue;
+}
+
+static void bm_locked_heap_destroy(BMLockedHeap *queue)
+{
+    cu_heap_clear(&queue->heap, NULL);
+    pthread_mutex_destroy(&queue->lock);
+    cu_free(queue);
+}
+
+static void bm_locked_heap_insert(BMLockedHeap *queue, void *element)
+{
+    pthread_mutex_lock(&queue->lock);
+    cu_heap_insert(&queue->heap, element);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void *bm_locked_heap_pop(BMLockedHeap *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    void *element = cu_heap_pop_root(&queue->heap);
+    pthread_mutex_unlock(&queue->lock);
+    return element;
+}
+
+static void *bm_multi_queue_new(uint32_t nthreads) { return cu_multi_queue_new(bm_compare_keys, NULL, nthreads); }
+static void bm_multi_queue_destroy(void *queue) { cu_multi_queue_destroy(queue, NULL); }
+
+static BMQueue queues[] = {
+    { "heap+mutex", bm_locked_heap_new, (void (*)(void *))bm_locked_heap_destroy,
+      (void (*)(void *, void *))bm_locked_heap_insert,
+      (void *(*)(void *))bm_locked_heap_pop },
+    { "multi-queue", bm_multi_queue_new, bm_multi_queue_destroy,
+      (void (*)(void *, void *))cu_multi_queue_insert,
+      (void *(*)(void *))cu_multi_queue_pop },
+};
+
+typedef struct {
+    BMQueue *queue;
+    void *data;
+    uint64_t seed;
+} BMThread;
+
+static
+void *bm_thread(BMThread *thread)
+{
+    uint64_t x = thread->seed;
+    uint64_t j;
+
+    for (j = 0; j < BM_OPERATIONS / 2; ++j) {
+        bm_random(&x);
+        thread->queue->insert(thread->data, (void *)(uintptr_t)((x >> 1) | 1));
+        thread->queue->pop(thread->data);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t max_threads = bm_max_threads(argc > 1 ? argv[1] : NULL);
+    uint32_t nthreads, q, t;
+    uint64_t j;
+
+    BMThread *threads = cu_alloc(max_threads * sizeof(BMThread));
+
+    fprintf(stdout, "%-14s %8s %14s\n", "queue", "threads", "Mops/s");
+    BM_FOREACH_THREAD_COUNT(nthreads, max_threads) {
+        for (q = 0; q < sizeof(queues) / sizeof(queues[0]); ++q) {
+            void *data = queues[q].create(nthreads);
+
+            for (j = 0; j < BM_INITIAL_SIZE; ++j)
+                queues[q].insert(data, (void *)(uintptr_t)((j * 0x9e3779b97f4a7c15ULL >> 1) | 1));
+
+            for (t = 0; t < nthreads; ++t)
+                threads[t] = (BMThread){ &queues[q], data, BM_SEED(t) };
+            double seconds = bm_run_threads((void *(*)(void *))bm_thread, threads, sizeof(BMThread), nthreads);
+
+            fprintf(stdout, "%-14s %8" PRIu32 " %14.2f\n", queues[q].name, nthreads,
+                    (double)nthreads * BM_OPERATIONS / seconds * 1e-6);
+            fflush(stdout);
+
+            queues[q].destroy(data);
+        }
+    }
+
+    cu_free(threads);
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cu.h"
+#include "cu-heap.h"
+#include "cu-priority-heap.h"
+#include "cu-radix-heap.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Largest step of a key over the key popped before it. */
+#define BM_MAX_DELAY 1000000
+
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *);
+    void (*insert)(void *, uint64_t);
+    uint64_t (*pop_min)(void *);
+} BMHeap;
+
+static
+int bm_compare_keys(void *a, void *b, void *data)
+{
+    /* The smallest key is on top. */
+    return (uintptr_t)a < (uintptr_t)b ? 1 : ((uintptr_t)a > (uintptr_t)b ? -1 : 0);
+}
+
+static void *bm_heap_new(void)
+{
+    CUHeap *heap = malloc(sizeof(CUHeap));
+    cu_heap_init(heap, bm_compare_keys, NULL);
+    return heap;
+}
+static void bm_heap_destroy(void *heap) { cu_heap_clear(heap, NULL); free(heap); }
+static void bm_heap_insert(void *heap, uint64_t key) { cu_heap_insert(heap, (void *)(uintptr_t)key); }
+static uint64_t bm_heap_pop_min(void *heap) { return (uintptr_t)cu_heap_pop_root(heap); }
+
+static void *bm_priority_heap_new(void)
+{
+    CUPriorityHeap *heap = malloc(sizeof(CUPriorityHeap));
+    cu_priority_heap_init(heap);
+    return heap;
+}
+static void bm_priority_heap_destroy(void *heap) { cu_priority_heap_clear(heap, NULL); free(heap); }
+static void bm_priority_heap_insert(void *heap, uint64_t key) { cu_priority_heap_insert(heap, NULL, key); }
+static uint64_t bm_priority_heap_pop_min(void *heap)
+{
+    uint64_t key;
+    cu_priority_heap_pop_root(heap, &key);
+    return key;
+}
+
+static void *bm_radix_heap_new(void)
+{
+    CURadixHeap *heap = malloc(sizeof(CURadixHeap));
+    cu_radix_heap_init(heap);
+    return heap;
+}
+static void bm_radix_heap_destroy(void *heap) { cu_radix_heap_clear(heap, NULL); free(heap); }
+static void bm_radix_heap_insert(void *heap, uint64_t key) { cu_radix_heap_insert(heap, NULL, key); }
+static uint64_t bm_radix_heap_pop_min(void *heap)
+{
+    uint64_t key;
+    cu_radix_heap_pop_min(heap, &key);
+    return key;
+}
+
+static BMHeap heaps[] = {
+    { "heap", bm_heap_new, bm_heap_destroy, bm_heap_insert, bm_heap_pop_min },
+    { "priority-heap", bm_priority_heap_new, bm_priority_heap_destroy, bm_priority_heap_insert, bm_priority_heap_pop_min },
+    { "radix-heap", bm_radix_heap_new, bm_radix_heap_destroy, bm_radix_heap_insert, bm_radix_heap_pop_min },
+};
+
+int main(int argc, char **argv)
+{
+    uint64_t max_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000ULL;
+    uint64_t count, j, key, previous, state, checksum;
+    uint32_t h;
+    uint64_t starttime;
+    void *heap;
+
+    fprintf(stdout, "%-14s %12s %14s %14s %14s\n", "heap", "elements", "fill ns/op", "timer ns/op", "drain ns/op");
+    for (count = 1000; count <= max_count; count *= 10) {
+        for (h = 0; h < sizeof(heaps) / sizeof(heaps[0]); ++h) {
+            heap = heaps[h].create();
+            state = 88172645463325252ULL;
+            checksum = 0;
+
+            /* Schedule events at random times. */
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j)
+                heaps[h].insert(heap, bm_random(&state) % BM_MAX_DELAY);
+            double fill_ns = bm_elapsed_ns(starttime, count);
+
+            /* Timer loop: handle the next event, which schedules another one later. */
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j) {
+                key = heaps[h].pop_min(heap);
+                checksum += key;
+                heaps[h].insert(heap, key + bm_random(&state) % BM_MAX_DELAY);
+            }
+            double timer_ns = bm_elapsed_ns(starttime, count);
+
+            previous = 0;
+            starttime = bm_now_ns();
+            for (j = 0; j < count; ++j) {
+                key = heaps[h].pop_min(heap);
+                if (key < previous)
+                    fprintf(stderr, "%s: popped %" PRIu64 " after %" PRIu64 "\n", heaps[h].name, key, previous);
+                previous = key;
+            }
+            double drain_ns = bm_elapsed_ns(starttime, count);
+
+            fprintf(stdout, "%-14s %12" PRIu64 " %14.1f %14.1f %14.1f   (checksum %" PRIu64 ")\n",
+                    heaps[h].name, count, fill_ns, timer_ns, drain_ns, checksum);
+            fflush(stdout);
+
+            heaps[h].destroy(heap);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "cu.h"
+#include "cu-avl-tree.h"
+#include "cu-skip-list.h"
+#include "bm-common.h"
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Operations per thread, and percentage of updates (half inserts, half removes). */
+#define BM_OPERATIONS 1000000
+#define BM_UPDATE_PERCENT 20
+
+typedef struct {
+    CUAVLTree *tree;
+    pthread_mutex_t lock;
+} BMLockedTree;
+
+static void *bm_locked_tree_new(void)
+{
+    BMLockedTree *map = cu_alloc(sizeof(BMLockedTree));
+    map->tree = cu_avl_tree_new(NULL, NULL, NULL, NULL);
+    pthread_mutex_init(&map->lock, NULL);
+    return map;
+}
+
+static void bm_locked_tree_destroy(BMLockedTree *map)
+{
+    cu_avl_tree_destroy(map->tree);
+    pthread_mutex_destroy(&map->lock);
+    cu_free(map);
+}
+
+static void bm_locked_tree_insert(BMLockedTree *map, void *key, void *value)
+{
+    pthread_mutex_lock(&map->lock);
+    cu_avl_tree_insert(map->tree, key, value);
+    pthread_mutex_unlock(&map->lock);
+}
+
+static bool bm_locked_tree_remove(BMLockedTree *map, void *key)
+{
+    pthread_mutex_lock(&map->lock);
+    bool rc = cu_avl_tree_remove(map->tree, key);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+static bool bm_locked_tree_find(BMLockedTree *map, void *key, void **data)
+{
+    pthread_mutex_lock(&map->lock);
+    bool rc = cu_avl_tree_find(map->tree, key, data);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+static void *bm_skip_list_new(void) { return cu_skip_list_new(NULL, NULL, NULL, NULL); }
+
+static BMMap maps[] = {
+    { .name = "avl-tree+mutex", .create = bm_locked_tree_new, .destroy = (void (*)(void *))bm_locked_tree_destroy,
+      .insert = (void (*)(void *, void *, void *))bm_locked_tree_insert,
+      .remove = (bool (*)(void *, void *))bm_locked_tree_remove,
+      .find = (bool (*)(void *, void *, void **))bm_locked_tree_find },
+    BM_MAP("skip-list", cu_skip_list, bm_skip_list_new, 0),
+};
+
+typedef struct {
+    BMMap *map;
+    void *data;
+    uint64_t key_count;
+    uint64_t seed;
+} BMThread;
+
+static
+void *bm_thread(BMThread *thread)
+{
+    uint64_t x = thread->seed;
+    uint64_t j, key;
+
+    for (j = 0; j < BM_OPERATIONS; ++j) {
+        bm_random(&x);
+        key = (x >> 8) % thread->key_count;
+        switch ((x >> 40) % 100) {
+            case 0 ... BM_UPDATE_PERCENT / 2 - 1:
+                thread->map->insert(thread->data, BM_KEY(key), BM_KEY(key));
+                break;
+            case BM_UPDATE_PERCENT / 2 ... BM_UPDATE_PERCENT - 1:
+                thread->map->remove(thread->data, BM_KEY(key));
+                break;
+            default:
+                thread->map->find(thread->data, BM_KEY(key), NULL);
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t key_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000ULL;
+    uint32_t max_threads = bm_max_threads(argc > 2 ? argv[2] : NULL);
+    uint32_t nthreads, m, t;
+    uint64_t j;
+
+    BMThread *threads = cu_alloc(max_threads * sizeof(BMThread));
+
+    fprintf(stdout, "%d%% updates on %" PRIu64 " keys\n", BM_UPDATE_PERCENT, key_count);
+    fprintf(stdout, "%-16s %8s %14s\n", "map", "threads", "Mops/s");
+    BM_FOREACH_THREAD_COUNT(nthreads, max_threads) {
+        for (m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m) {
+            void *data = maps[m].create();
+
+            /* Fill half of the keys, the updates keep it about there. */
+            for (j = 0; j < key_count; j += 2)
+                maps[m].insert(data, BM_KEY(j), BM_KEY(j));
+
+            for (t = 0; t < nthreads; ++t)
+                threads[t] = (BMThread){ &maps[m], data, key_count, BM_SEED(t) };
+            double seconds = bm_run_threads((void *(*)(void *))bm_thread, threads, sizeof(BMThread), nthreads);
+
+            fprintf(stdout, "%-16s %8" PRIu32 " %14.2f\n", maps[m].name, nthreads,
+                    (double)nthreads * BM_OPERATIONS / seconds * 1e-6);
+            fflush(stdout);
+
+            maps[m].destroy(data);
+        }
+    }
+
+    cu_free(threads);
+
+    return 0;
+}
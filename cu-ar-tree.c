@@ -0,0 +1,682 @@
+#include "cu-ar-tree.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* References to children: leaves have the lowest bit set. */
+#define REF_LEAF          ((uintptr_t)1)
+#define REF_IS_LEAF(ref)  ((ref) & REF_LEAF)
+#define REF_LEAF_PTR(ref) ((CUARTreeLeaf *)((ref) & ~REF_LEAF))
+#define REF_NODE_PTR(ref) ((CUARTreeNode *)(ref))
+
+/** @brief Kinds of memory, with their own pool each. */
+typedef enum {
+    NODE_4 = 0, /**< Up to 4 children, sorted keys. */
+    NODE_16, /**< Up to 16 children, sorted keys, searched with SSE2. */
+    NODE_48, /**< Up to 48 children, indexed by a byte array of 256 entries. */
+    NODE_256, /**< A child pointer for each byte. */
+    NODE_LEAF, /**< A single element. */
+    NODE_KINDS
+} CUARTreeNodeKind;
+
+/** @internal
+ *  @brief A single element.
+ */
+typedef struct {
+    uint64_t key; /**< The key as integer. */
+    void *value; /**< The value. */
+} CUARTreeLeaf;
+
+/** @internal
+ *  @brief Header of all inner nodes.
+ */
+typedef struct {
+    uint64_t prefix; /**< The first @a level bytes shared by all keys below, the rest is 0. */
+    uint8_t kind; /**< The CUARTreeNodeKind. */
+    uint8_t level; /**< The index of the byte that selects the child, 0 being the most significant. */
+    uint16_t count; /**< The number of children. */
+} CUARTreeNode;
+
+/** @internal */
+typedef struct {
+    CUARTreeNode node;
+    uint8_t keys[4]; /**< The bytes of the children, sorted. */
+    uintptr_t children[4];
+} CUARTreeNode4;
+
+/** @internal */
+typedef struct {
+    CUARTreeNode node;
+    uint8_t keys[16]; /**< The bytes of the children, sorted. */
+    uintptr_t children[16];
+} CUARTreeNode16;
+
+/** @internal */
+typedef struct {
+    CUARTreeNode node;
+    uint8_t index[256]; /**< For each byte, the index of the child plus one, or 0. */
+    uintptr_t children[48]; /**< Unused entries are 0. */
+} CUARTreeNode48;
+
+/** @internal */
+typedef struct {
+    CUARTreeNode node;
+    uintptr_t children[256]; /**< Missing children are 0. */
+} CUARTreeNode256;
+
+static const size_t _cu_ar_tree_node_sizes[NODE_KINDS] = {
+    sizeof(CUARTreeNode4),
+    sizeof(CUARTreeNode16),
+    sizeof(CUARTreeNode48),
+    sizeof(CUARTreeNode256),
+    sizeof(CUARTreeLeaf)
+};
+
+struct _CUARTree {
+    CUFixedSizeMemoryPool *node_mem[NODE_KINDS];
+
+    uintptr_t root; /**< Reference to the root, 0 if the tree is empty. */
+    size_t length;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+};
+
+/** @internal
+ *  @brief Return the byte of @a key selecting the child at @a level.
+ */
+static inline
+uint8_t _cu_ar_tree_key_byte(uint64_t key, uint32_t level)
+{
+    return (uint8_t)(key >> (56 - 8 * level));
+}
+
+/** @internal
+ *  @brief Return a mask for the first @a level bytes of a key.
+ */
+static inline
+uint64_t _cu_ar_tree_prefix_mask(uint32_t level)
+{
+    return level ? ~(uint64_t)0 << (64 - 8 * level) : 0;
+}
+
+/** @internal
+ *  @brief Return the index of the first byte in which two different keys differ.
+ */
+static inline
+uint32_t _cu_ar_tree_mismatch_level(uint64_t a, uint64_t b)
+{
+    return __builtin_clzll(a ^ b) / 8;
+}
+
+static
+void *_cu_ar_tree_alloc(CUARTree *tree, CUARTreeNodeKind kind)
+{
+    if (tree->node_mem[kind])
+        return cu_fixed_size_memory_pool_alloc(tree->node_mem[kind]);
+    return cu_alloc(_cu_ar_tree_node_sizes[kind]);
+}
+
+static
+void _cu_ar_tree_free(CUARTree *tree, CUARTreeNodeKind kind, void *ptr)
+{
+    if (tree->node_mem[kind])
+        cu_fixed_size_memory_pool_free(tree->node_mem[kind], ptr);
+    else
+        cu_free(ptr);
+}
+
+/** @internal
+ *  @brief Allocate an empty inner node.
+ */
+static
+CUARTreeNode *_cu_ar_tree_node_new(CUARTree *tree, CUARTreeNodeKind kind, uint64_t key, uint32_t level)
+{
+    CUARTreeNode *node = _cu_ar_tree_alloc(tree, kind);
+    memset(node, 0, _cu_ar_tree_node_sizes[kind]);
+    node->prefix = key & _cu_ar_tree_prefix_mask(level);
+    node->kind = kind;
+    node->level = level;
+    return node;
+}
+
+/** @internal
+ *  @brief Create a reference to a new leaf.
+ */
+static inline
+uintptr_t _cu_ar_tree_leaf_new(CUARTree *tree, uint64_t key, void *value)
+{
+    CUARTreeLeaf *leaf = _cu_ar_tree_alloc(tree, NODE_LEAF);
+    leaf->key = key;
+    leaf->value = value;
+    return (uintptr_t)leaf | REF_LEAF;
+}
+
+/** @internal
+ *  @brief Find the reference to the child of a node for a byte.
+ *  @return Pointer to the reference, or @a NULL if there is no such child.
+ */
+static inline
+uintptr_t *_cu_ar_tree_find_child(CUARTreeNode *node, uint8_t byte)
+{
+    uint32_t j;
+
+    switch (node->kind) {
+        case NODE_4: {
+            CUARTreeNode4 *n = (CUARTreeNode4 *)node;
+            for (j = 0; j < node->count; ++j) {
+                if (n->keys[j] == byte)
+                    return &n->children[j];
+            }
+            return NULL;
+        }
+        case NODE_16: {
+            CUARTreeNode16 *n = (CUARTreeNode16 *)node;
+#ifdef __SSE2__
+            uint32_t match = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+                                                                        _mm_loadu_si128((const __m128i *)n->keys)));
+            match &= (1u << node->count) - 1;
+            return match ? &n->children[__builtin_ctz(match)] : NULL;
+#else
+            for (j = 0; j < node->count; ++j) {
+                if (n->keys[j] == byte)
+                    return &n->children[j];
+            }
+            return NULL;
+#endif
+        }
+        case NODE_48: {
+            CUARTreeNode48 *n = (CUARTreeNode48 *)node;
+            return n->index[byte] ? &n->children[n->index[byte] - 1] : NULL;
+        }
+        default: {
+            CUARTreeNode256 *n = (CUARTreeNode256 *)node;
+            return n->children[byte] ? &n->children[byte] : NULL;
+        }
+    }
+}
+
+/** @internal
+ *  @brief Insert a child into a node with sorted keys that has room left.
+ */
+static inline
+void _cu_ar_tree_insert_sorted(uint8_t *keys, uintptr_t *children, uint32_t count, uint8_t byte, uintptr_t child)
+{
+    uint32_t pos = 0;
+    while (pos < count && keys[pos] < byte)
+        ++pos;
+    memmove(keys + pos + 1, keys + pos, count - pos);
+    memmove(children + pos + 1, children + pos, (count - pos) * sizeof(uintptr_t));
+    keys[pos] = byte;
+    children[pos] = child;
+}
+
+/** @internal
+ *  @brief Add a child to a node, replacing the node by a larger one if it is full.
+ *  @param[in] tree The tree.
+ *  @param[in] ref The reference to the node.
+ *  @param[in] byte The byte of the new child, not yet present in the node.
+ *  @param[in] child The reference to the child.
+ */
+static
+void _cu_ar_tree_add_child(CUARTree *tree, uintptr_t *ref, uint8_t byte, uintptr_t child)
+{
+    CUARTreeNode *node = REF_NODE_PTR(*ref);
+    CUARTreeNode *grown;
+    uint32_t j;
+
+    switch (node->kind) {
+        case NODE_4: {
+            CUARTreeNode4 *n = (CUARTreeNode4 *)node;
+            if (node->count < 4) {
+                _cu_ar_tree_insert_sorted(n->keys, n->children, node->count++, byte, child);
+                return;
+            }
+            CUARTreeNode16 *g = (CUARTreeNode16 *)(grown = _cu_ar_tree_node_new(tree, NODE_16, node->prefix, node->level));
+            memcpy(g->keys, n->keys, 4);
+            memcpy(g->children, n->children, 4 * sizeof(uintptr_t));
+            break;
+        }
+        case NODE_16: {
+            CUARTreeNode16 *n = (CUARTreeNode16 *)node;
+            if (node->count < 16) {
+                _cu_ar_tree_insert_sorted(n->keys, n->children, node->count++, byte, child);
+                return;
+            }
+            CUARTreeNode48 *g = (CUARTreeNode48 *)(grown = _cu_ar_tree_node_new(tree, NODE_48, node->prefix, node->level));
+            for (j = 0; j < 16; ++j) {
+                g->children[j] = n->children[j];
+                g->index[n->keys[j]] = j + 1;
+            }
+            break;
+        }
+        case NODE_48: {
+            CUARTreeNode48 *n = (CUARTreeNode48 *)node;
+            if (node->count < 48) {
+                /* Removals may leave holes, usually the slot after the last one is free. */
+                j = node->count;
+                if (n->children[j])
+                    for (j = 0; n->children[j]; ++j);
+                n->children[j] = child;
+                n->index[byte] = j + 1;
+                ++node->count;
+                return;
+            }
+            CUARTreeNode256 *g = (CUARTreeNode256 *)(grown = _cu_ar_tree_node_new(tree, NODE_256, node->prefix, node->level));
+            for (j = 0; j < 256; ++j) {
+                if (n->index[j])
+                    g->children[j] = n->children[n->index[j] - 1];
+            }
+            break;
+        }
+        default: {
+            CUARTreeNode256 *n = (CUARTreeNode256 *)node;
+            n->children[byte] = child;
+            ++node->count;
+            return;
+        }
+    }
+
+    grown->count = node->count;
+    _cu_ar_tree_free(tree, node->kind, node);
+    *ref = (uintptr_t)grown;
+    _cu_ar_tree_add_child(tree, ref, byte, child);
+}
+
+/** @internal
+ *  @brief Remove a child from a node, replacing the node by a smaller one if it gets sparse.
+ *  @details A node left with a single child is replaced by the child.
+ *  @param[in] tree The tree.
+ *  @param[in] ref The reference to the node.
+ *  @param[in] byte The byte of the child.
+ */
+static
+void _cu_ar_tree_remove_child(CUARTree *tree, uintptr_t *ref, uint8_t byte)
+{
+    CUARTreeNode *node = REF_NODE_PTR(*ref);
+    CUARTreeNode *shrunk;
+    uint32_t j, k;
+
+    switch (node->kind) {
+        case NODE_4: {
+            CUARTreeNode4 *n = (CUARTreeNode4 *)node;
+            for (j = 0; n->keys[j] != byte; ++j);
+            --node->count;
+            memmove(n->keys + j, n->keys + j + 1, node->count - j);
+            memmove(n->children + j, n->children + j + 1, (node->count - j) * sizeof(uintptr_t));
+            if (node->count > 1)
+                return;
+            /* The child keeps its own prefix, so it can take the place of the node directly. */
+            *ref = n->children[0];
+            _cu_ar_tree_free(tree, NODE_4, node);
+            return;
+        }
+        case NODE_16: {
+            CUARTreeNode16 *n = (CUARTreeNode16 *)node;
+            for (j = 0; n->keys[j] != byte; ++j);
+            --node->count;
+            memmove(n->keys + j, n->keys + j + 1, node->count - j);
+            memmove(n->children + j, n->children + j + 1, (node->count - j) * sizeof(uintptr_t));
+            if (node->count > 3)
+                return;
+            CUARTreeNode4 *s = (CUARTreeNode4 *)(shrunk = _cu_ar_tree_node_new(tree, NODE_4, node->prefix, node->level));
+            memcpy(s->keys, n->keys, node->count);
+            memcpy(s->children, n->children, node->count * sizeof(uintptr_t));
+            break;
+        }
+        case NODE_48: {
+            CUARTreeNode48 *n = (CUARTreeNode48 *)node;
+            n->children[n->index[byte] - 1] = 0;
+            n->index[byte] = 0;
+            if (--node->count > 12)
+                return;
+            CUARTreeNode16 *s = (CUARTreeNode16 *)(shrunk = _cu_ar_tree_node_new(tree, NODE_16, node->prefix, node->level));
+            for (j = 0, k = 0; j < 256; ++j) {
+                if (n->index[j]) {
+                    s->keys[k] = j;
+                    s->children[k++] = n->children[n->index[j] - 1];
+                }
+            }
+            break;
+        }
+        default: {
+            CUARTreeNode256 *n = (CUARTreeNode256 *)node;
+            n->children[byte] = 0;
+            if (--node->count > 37)
+                return;
+            CUARTreeNode48 *s = (CUARTreeNode48 *)(shrunk = _cu_ar_tree_node_new(tree, NODE_48, node->prefix, node->level));
+            for (j = 0, k = 0; j < 256; ++j) {
+                if (n->children[j]) {
+                    s->children[k] = n->children[j];
+                    s->index[j] = ++k;
+                }
+            }
+            break;
+        }
+    }
+
+    shrunk->count = node->count;
+    _cu_ar_tree_free(tree, node->kind, node);
+    *ref = (uintptr_t)shrunk;
+}
+
+/** @internal
+ *  @brief Free a subtree, destroying keys and values.
+ */
+static
+void _cu_ar_tree_clear_ref(CUARTree *tree, uintptr_t ref)
+{
+    if (REF_IS_LEAF(ref)) {
+        CUARTreeLeaf *leaf = REF_LEAF_PTR(ref);
+        if (tree->destroy_key)
+            tree->destroy_key((void *)(uintptr_t)leaf->key);
+        if (tree->destroy_value)
+            tree->destroy_value(leaf->value);
+        _cu_ar_tree_free(tree, NODE_LEAF, leaf);
+        return;
+    }
+
+    CUARTreeNode *node = REF_NODE_PTR(ref);
+    uintptr_t *children;
+    uint32_t j, count;
+
+    switch (node->kind) {
+        case NODE_4:   children = ((CUARTreeNode4 *)node)->children;   count = 4;   break;
+        case NODE_16:  children = ((CUARTreeNode16 *)node)->children;  count = 16;  break;
+        case NODE_48:  children = ((CUARTreeNode48 *)node)->children;  count = 48;  break;
+        default:       children = ((CUARTreeNode256 *)node)->children; count = 256; break;
+    }
+    if (node->kind == NODE_4 || node->kind == NODE_16)
+        count = node->count;
+    for (j = 0; j < count; ++j) {
+        if (children[j])
+            _cu_ar_tree_clear_ref(tree, children[j]);
+    }
+    _cu_ar_tree_free(tree, node->kind, node);
+}
+
+/** @internal
+ *  @brief Visit the elements of a subtree in a key range, in order.
+ *  @retval true Continue traversing.
+ *  @retval false The traverse function asked to stop.
+ */
+static
+bool _cu_ar_tree_foreach_ref(uintptr_t ref, uint64_t from, uint64_t to, CUTraverseFunc traverse, void *userdata)
+{
+    if (REF_IS_LEAF(ref)) {
+        CUARTreeLeaf *leaf = REF_LEAF_PTR(ref);
+        if (leaf->key < from || leaf->key > to)
+            return true;
+        return traverse((void *)(uintptr_t)leaf->key, leaf->value, userdata);
+    }
+
+    CUARTreeNode *node = REF_NODE_PTR(ref);
+    uint32_t j;
+
+    /* Skip the subtree if its keys are all outside of the range. */
+    if (node->prefix > to || (node->prefix | ~_cu_ar_tree_prefix_mask(node->level)) < from)
+        return true;
+
+    switch (node->kind) {
+        case NODE_4: {
+            CUARTreeNode4 *n = (CUARTreeNode4 *)node;
+            for (j = 0; j < node->count; ++j) {
+                if (!_cu_ar_tree_foreach_ref(n->children[j], from, to, traverse, userdata))
+                    return false;
+            }
+            break;
+        }
+        case NODE_16: {
+            CUARTreeNode16 *n = (CUARTreeNode16 *)node;
+            for (j = 0; j < node->count; ++j) {
+                if (!_cu_ar_tree_foreach_ref(n->children[j], from, to, traverse, userdata))
+                    return false;
+            }
+            break;
+        }
+        case NODE_48: {
+            CUARTreeNode48 *n = (CUARTreeNode48 *)node;
+            for (j = 0; j < 256; ++j) {
+                if (n->index[j] && !_cu_ar_tree_foreach_ref(n->children[n->index[j] - 1], from, to, traverse, userdata))
+                    return false;
+            }
+            break;
+        }
+        default: {
+            CUARTreeNode256 *n = (CUARTreeNode256 *)node;
+            for (j = 0; j < 256; ++j) {
+                if (n->children[j] && !_cu_ar_tree_foreach_ref(n->children[j], from, to, traverse, userdata))
+                    return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+CUARTree *cu_ar_tree_new_full(CUDestroyNotifyFunc destroy_key,
+                              CUDestroyNotifyFunc destroy_value,
+                              bool use_fixed_memory_pool)
+{
+    CUARTree *tree = cu_alloc0(sizeof(CUARTree));
+    uint32_t j;
+
+    tree->destroy_key = destroy_key;
+    tree->destroy_value = destroy_value;
+    if (use_fixed_memory_pool) {
+        for (j = 0; j < NODE_KINDS; ++j)
+            tree->node_mem[j] = cu_fixed_size_memory_pool_new(_cu_ar_tree_node_sizes[j], 0);
+    }
+
+    return tree;
+}
+
+CUARTree *cu_ar_tree_new(CUDestroyNotifyFunc destroy_key,
+                         CUDestroyNotifyFunc destroy_value)
+{
+    return cu_ar_tree_new_full(destroy_key, destroy_value, true);
+}
+
+void cu_ar_tree_clear(CUARTree *tree)
+{
+    if (cu_unlikely(!tree))
+        return;
+    if (tree->root)
+        _cu_ar_tree_clear_ref(tree, tree->root);
+    tree->root = 0;
+    tree->length = 0;
+}
+
+void cu_ar_tree_destroy(CUARTree *tree)
+{
+    if (cu_unlikely(!tree))
+        return;
+
+    uint32_t j;
+
+    cu_ar_tree_clear(tree);
+    for (j = 0; j < NODE_KINDS; ++j) {
+        if (tree->node_mem[j])
+            cu_fixed_size_memory_pool_destroy(tree->node_mem[j]);
+    }
+    cu_free(tree);
+}
+
+void cu_ar_tree_insert(CUARTree *tree,
+                       void *key,
+                       void *value)
+{
+    if (cu_unlikely(!tree))
+        return;
+
+    uint64_t ikey = (uint64_t)(uintptr_t)key;
+    uintptr_t *ref = &tree->root;
+    uintptr_t *child;
+    CUARTreeNode *node, *split;
+    uint32_t level;
+
+    for (;;) {
+        if (!*ref) {
+            *ref = _cu_ar_tree_leaf_new(tree, ikey, value);
+            ++tree->length;
+            return;
+        }
+
+        if (REF_IS_LEAF(*ref)) {
+            CUARTreeLeaf *leaf = REF_LEAF_PTR(*ref);
+            if (leaf->key == ikey) {
+                if (tree->destroy_key && (void *)(uintptr_t)leaf->key != key)
+                    tree->destroy_key(key);
+                if (tree->destroy_value && leaf->value != value)
+                    tree->destroy_value(leaf->value);
+                leaf->value = value;
+                return;
+            }
+            /* Both keys below a new node at the first differing byte. */
+            level = _cu_ar_tree_mismatch_level(ikey, leaf->key);
+            split = _cu_ar_tree_node_new(tree, NODE_4, ikey, level);
+            CUARTreeNode4 *n = (CUARTreeNode4 *)split;
+            _cu_ar_tree_insert_sorted(n->keys, n->children, 0, _cu_ar_tree_key_byte(leaf->key, level), *ref);
+            _cu_ar_tree_insert_sorted(n->keys, n->children, 1, _cu_ar_tree_key_byte(ikey, level),
+                                      _cu_ar_tree_leaf_new(tree, ikey, value));
+            split->count = 2;
+            *ref = (uintptr_t)split;
+            ++tree->length;
+            return;
+        }
+
+        node = REF_NODE_PTR(*ref);
+        if ((ikey & _cu_ar_tree_prefix_mask(node->level)) != node->prefix) {
+            /* The key leaves the skipped bytes of the node, split there. */
+            level = _cu_ar_tree_mismatch_level(ikey, node->prefix);
+            split = _cu_ar_tree_node_new(tree, NODE_4, ikey, level);
+            CUARTreeNode4 *n = (CUARTreeNode4 *)split;
+            _cu_ar_tree_insert_sorted(n->keys, n->children, 0, _cu_ar_tree_key_byte(node->prefix, level), *ref);
+            _cu_ar_tree_insert_sorted(n->keys, n->children, 1, _cu_ar_tree_key_byte(ikey, level),
+                                      _cu_ar_tree_leaf_new(tree, ikey, value));
+            split->count = 2;
+            *ref = (uintptr_t)split;
+            ++tree->length;
+            return;
+        }
+
+        child = _cu_ar_tree_find_child(node, _cu_ar_tree_key_byte(ikey, node->level));
+        if (!child) {
+            _cu_ar_tree_add_child(tree, ref, _cu_ar_tree_key_byte(ikey, node->level),
+                                  _cu_ar_tree_leaf_new(tree, ikey, value));
+            ++tree->length;
+            return;
+        }
+        ref = child;
+    }
+}
+
+bool cu_ar_tree_remove(CUARTree *tree, void *key)
+{
+    if (cu_unlikely(!tree))
+        return false;
+
+    uint64_t ikey = (uint64_t)(uintptr_t)key;
+    uintptr_t *ref = &tree->root;
+    uintptr_t *parent_ref = NULL;
+    CUARTreeNode *node;
+    CUARTreeLeaf *leaf;
+
+    while (*ref && !REF_IS_LEAF(*ref)) {
+        node = REF_NODE_PTR(*ref);
+        parent_ref = ref;
+        ref = _cu_ar_tree_find_child(node, _cu_ar_tree_key_byte(ikey, node->level));
+        if (!ref)
+            return false;
+    }
+    if (!*ref)
+        return false;
+
+    leaf = REF_LEAF_PTR(*ref);
+    if (leaf->key != ikey)
+        return false;
+
+    if (tree->destroy_key)
+        tree->destroy_key((void *)(uintptr_t)leaf->key);
+    if (tree->destroy_value)
+        tree->destroy_value(leaf->value);
+    _cu_ar_tree_free(tree, NODE_LEAF, leaf);
+    --tree->length;
+
+    if (parent_ref)
+        _cu_ar_tree_remove_child(tree, parent_ref, _cu_ar_tree_key_byte(ikey, REF_NODE_PTR(*parent_ref)->level));
+    else
+        tree->root = 0;
+    return true;
+}
+
+bool cu_ar_tree_find(CUARTree *tree,
+                     void *key,
+                     void **data)
+{
+    if (cu_unlikely(!tree || !tree->root))
+        return false;
+
+    uint64_t ikey = (uint64_t)(uintptr_t)key;
+    uintptr_t ref = tree->root;
+    uintptr_t *child;
+    CUARTreeNode *node;
+
+    /* The skipped bytes of the nodes are not checked on the way down, the leaf holds the full key. */
+    while (!REF_IS_LEAF(ref)) {
+        node = REF_NODE_PTR(ref);
+        child = _cu_ar_tree_find_child(node, _cu_ar_tree_key_byte(ikey, node->level));
+        if (!child)
+            return false;
+        ref = *child;
+    }
+
+    CUARTreeLeaf *leaf = REF_LEAF_PTR(ref);
+    if (leaf->key != ikey)
+        return false;
+    if (data)
+        *data = leaf->value;
+    return true;
+}
+
+size_t cu_ar_tree_length(CUARTree *tree)
+{
+    return tree ? tree->length : 0;
+}
+
+void cu_ar_tree_foreach(CUARTree *tree,
+                        CUTraverseFunc traverse,
+                        void *userdata)
+{
+    if (cu_unlikely(!tree || !traverse || !tree->root))
+        return;
+    _cu_ar_tree_foreach_ref(tree->root, 0, UINT64_MAX, traverse, userdata);
+}
+
+void cu_ar_tree_foreach_range(CUARTree *tree,
+                              void *from,
+                              void *to,
+                              CUTraverseFunc traverse,
+                              void *userdata)
+{
+    if (cu_unlikely(!tree || !traverse || !tree->root || from > to))
+        return;
+    _cu_ar_tree_foreach_ref(tree->root, (uint64_t)(uintptr_t)from, (uint64_t)(uintptr_t)to, traverse, userdata);
+}
+
+void cu_ar_tree_foreach_prefix(CUARTree *tree,
+                               void *prefix,
+                               uint32_t prefix_bits,
+                               CUTraverseFunc traverse,
+                               void *userdata)
+{
+    uint32_t free_bits = 8 * sizeof(void *) - (prefix_bits < 8 * sizeof(void *) ? prefix_bits : 8 * sizeof(void *));
+    uintptr_t mask = free_bits < 8 * sizeof(void *) ? ((uintptr_t)1 << free_bits) - 1 : UINTPTR_MAX;
+    uintptr_t from = (uintptr_t)prefix & ~mask;
+
+    cu_ar_tree_foreach_range(tree, (void *)from, (void *)(from | mask), traverse, userdata);
+}
@@ -0,0 +1,123 @@
+/** @file cu-ar-tree.h
+ *  Provide an ordered map for integer and pointer keys as adaptive radix tree.
+ *  @defgroup CUARTree Adaptive radix tree
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to an adaptive radix tree.
+ *  @details Keys are the pointer values themselves, interpreted as unsigned integers and split into
+ *           bytes, most significant first. Each level of the tree consumes one byte, so a lookup
+ *           needs no comparisons and at most eight steps. Inner nodes hold 4, 16, 48 or 256 children
+ *           and grow or shrink with their number of children. Byte sequences shared by all keys
+ *           below a node are skipped, and single keys are stored directly as leaves. The elements
+ *           are ordered like the pointer values, as in a @a CUAVLTree without compare function.
+ */
+typedef struct _CUARTree CUARTree;
+
+/** @brief Create a new radix tree, with full control.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @param[in] use_fixed_memory_pool Whether to use fixed size memory pools or cu_alloc()/cu_free().
+ *  @return Pointer to a newly created radix tree.
+ */
+CUARTree *cu_ar_tree_new_full(CUDestroyNotifyFunc destroy_key,
+                              CUDestroyNotifyFunc destroy_value,
+                              bool use_fixed_memory_pool);
+
+/** @brief Create a new radix tree with fixed size memory pools.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created radix tree.
+ */
+CUARTree *cu_ar_tree_new(CUDestroyNotifyFunc destroy_key,
+                         CUDestroyNotifyFunc destroy_value);
+
+/** @brief Clear a radix tree and free resources of keys/values.
+ *  @details The tree is still initialized and may be used further.
+ *  @param[in] tree The tree to clear.
+ */
+void cu_ar_tree_clear(CUARTree *tree);
+
+/** @brief Destroy a radix tree and free all resources.
+ *  @param[in] tree The tree to destroy.
+ */
+void cu_ar_tree_destroy(CUARTree *tree);
+
+/** @brief Insert a new element into a tree
+ *  @details If an element with the given @a key is already in the tree, the @a key and the old
+ *           value are destroyed. Ownership is passed to the tree.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_ar_tree_insert(CUARTree *tree,
+                       void *key,
+                       void *value);
+
+/** @brief Remove an element from the tree and free its resources.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element to destroy.
+ *  @retval true The element was present in the tree and was destroyed.
+ *  @retval false The element was not found in the tree.
+ */
+bool cu_ar_tree_remove(CUARTree *tree, void *key);
+
+/** @brief Find an element in the tree.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with a pointer to the value, if @a key was found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the tree.
+ */
+bool cu_ar_tree_find(CUARTree *tree,
+                     void *key,
+                     void **data);
+
+/** @brief Return the number of elements in the tree.
+ *  @param[in] tree The tree.
+ *  @return The number of elements.
+ */
+size_t cu_ar_tree_length(CUARTree *tree);
+
+/** @brief Call a function for each element in the tree.
+ *  @details The tree is processed in order.
+ *  @param[in] tree The tree.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_ar_tree_foreach(CUARTree *tree,
+                        CUTraverseFunc traverse,
+                        void *userdata);
+
+/** @brief Call a function for each element with a key in a given range.
+ *  @details The range is processed in order. Subtrees outside the range are skipped as a whole.
+ *  @param[in] tree The tree.
+ *  @param[in] from The smallest key to visit (inclusive).
+ *  @param[in] to The largest key to visit (inclusive).
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_ar_tree_foreach_range(CUARTree *tree,
+                              void *from,
+                              void *to,
+                              CUTraverseFunc traverse,
+                              void *userdata);
+
+/** @brief Call a function for each element whose key starts with the given bits.
+ *  @details The elements are processed in order.
+ *  @param[in] tree The tree.
+ *  @param[in] prefix A key whose highest @a prefix_bits bits are the prefix.
+ *  @param[in] prefix_bits The number of bits in the prefix, at most the number of bits of a pointer.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_ar_tree_foreach_prefix(CUARTree *tree,
+                               void *prefix,
+                               uint32_t prefix_bits,
+                               CUTraverseFunc traverse,
+                               void *userdata);
+
+/** @} */
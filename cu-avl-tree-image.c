@@ -0,0 +1,396 @@
+#include "cu-avl-tree-image.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CU_AVL_TREE_IMAGE_MAGIC   "CUAVLIMG"
+#define CU_AVL_TREE_IMAGE_VERSION 1
+
+/* Appended to the name of an image file while it is written. */
+#define CU_AVL_TREE_IMAGE_TMP_SUFFIX ".tmp"
+
+/** @internal
+ *  @brief The header at the start of an image file.
+ *  @details All offsets are relative to the start of the file. The key and value arrays hold
+ *           length + 1 slots, the first one is unused so that the root is at index 1.
+ */
+typedef struct {
+    char magic[8]; /**< CU_AVL_TREE_IMAGE_MAGIC, not null-terminated. */
+    uint32_t version; /**< CU_AVL_TREE_IMAGE_VERSION. */
+    uint32_t key_type; /**< The CUType of the keys. */
+    uint32_t value_type; /**< The CUType of the values. */
+    uint32_t reserved;
+    uint64_t length; /**< The number of elements. */
+    uint64_t keys_offset; /**< Offset of the key slots. */
+    uint64_t values_offset; /**< Offset of the value slots. */
+    uint64_t data_offset; /**< Offset of the encoded keys and values. */
+    uint64_t data_size; /**< Size of the encoded keys and values. */
+} CUAVLTreeImageHeader;
+
+/** @internal
+ *  @brief The slot of an encoded key or value.
+ */
+typedef struct {
+    uint64_t offset; /**< Offset of the encoded element, relative to the data section. */
+    uint64_t length; /**< Length of the encoded element. */
+} CUAVLTreeImageBlob;
+
+struct _CUAVLTreeImage {
+    void *map; /**< The mapped file. */
+    size_t map_size; /**< The size of the mapped file. */
+
+    size_t length; /**< The number of elements. */
+    CUType key_type;
+    CUType value_type;
+    const void *keys; /**< The key slots in Eytzinger order, starting at index 1. */
+    const void *values; /**< The value slots, in the same order. */
+    const uint8_t *data; /**< The encoded keys and values. */
+    uint64_t data_size;
+};
+
+/** @internal
+ *  @brief State while writing an image.
+ */
+typedef struct {
+    FILE *file;
+    CUType key_type;
+    CUType value_type;
+    CUAVLTreeImageEncodeFunc encode_key;
+    CUAVLTreeImageEncodeFunc encode_value;
+    void *userdata;
+
+    uint8_t *keys; /**< The key slots. */
+    uint8_t *values; /**< The value slots. */
+    size_t length; /**< The number of elements. */
+    size_t position; /**< The Eytzinger index of the next element in order. */
+
+    char *buffer; /**< Buffer for the encode functions. */
+    size_t buflen; /**< The size of @a buffer. */
+    uint64_t data_size; /**< The number of encoded bytes written so far. */
+    bool failed; /**< Set if writing failed. */
+} CUAVLTreeImageWriter;
+
+/** @internal
+ *  @brief Return the size of a slot of a given type.
+ */
+static inline
+size_t _cu_avl_tree_image_slot_size(CUType type)
+{
+    return type == CU_TYPE_BLOB ? sizeof(CUAVLTreeImageBlob) : sizeof(uint64_t);
+}
+
+/** @internal
+ *  @brief Return the Eytzinger index of the in-order successor of an index.
+ *  @param[in] position The index, starting at 1 for the root.
+ *  @param[in] length The number of elements.
+ *  @return The index of the successor, 0 after the last element.
+ */
+static inline
+size_t _cu_avl_tree_image_next_position(size_t position, size_t length)
+{
+    if (2 * position + 1 <= length) {
+        /* Leftmost node of the right subtree. */
+        position = 2 * position + 1;
+        while (2 * position <= length)
+            position *= 2;
+        return position;
+    }
+    /* Go up while we are a right child, then once more. */
+    while (position & 1)
+        position >>= 1;
+    return position >> 1;
+}
+
+/** @internal
+ *  @brief Count the elements of a tree.
+ */
+static
+bool _cu_avl_tree_image_count(void *key, void *value, size_t *count)
+{
+    ++*count;
+    return true;
+}
+
+/** @internal
+ *  @brief Write a key or value to its slot, encoding it if necessary.
+ *  @param[in] writer The writer.
+ *  @param[in] slot The slot.
+ *  @param[in] type The type of the element.
+ *  @param[in] encode The encode function for blobs.
+ *  @param[in] element The key or value.
+ */
+static
+void _cu_avl_tree_image_write_element(CUAVLTreeImageWriter *writer, uint8_t *slot, CUType type,
+                                      CUAVLTreeImageEncodeFunc encode, void *element)
+{
+    if (type != CU_TYPE_BLOB) {
+        uint64_t integer = (uint64_t)(uintptr_t)element;
+        memcpy(slot, &integer, sizeof(uint64_t));
+        return;
+    }
+
+    size_t length = encode(element, &writer->buffer, writer->buflen, writer->userdata);
+    /* A larger result means the buffer was replaced. */
+    if (length > writer->buflen)
+        writer->buflen = length;
+    if (length && fwrite(writer->buffer, 1, length, writer->file) != length)
+        writer->failed = true;
+
+    CUAVLTreeImageBlob blob = { .offset = writer->data_size, .length = length };
+    memcpy(slot, &blob, sizeof(CUAVLTreeImageBlob));
+    writer->data_size += length;
+}
+
+/** @internal
+ *  @brief Store an element of the tree at the next position of the image.
+ */
+static
+bool _cu_avl_tree_image_write_node(void *key, void *value, CUAVLTreeImageWriter *writer)
+{
+    size_t position = writer->position;
+
+    _cu_avl_tree_image_write_element(writer, writer->keys + position * _cu_avl_tree_image_slot_size(writer->key_type),
+                                     writer->key_type, writer->encode_key, key);
+    _cu_avl_tree_image_write_element(writer, writer->values + position * _cu_avl_tree_image_slot_size(writer->value_type),
+                                     writer->value_type, writer->encode_value, value);
+
+    writer->position = _cu_avl_tree_image_next_position(position, writer->length);
+    return !writer->failed;
+}
+
+bool cu_avl_tree_image_write(CUAVLTree *tree,
+                             const char *filename,
+                             CUType key_type,
+                             CUAVLTreeImageEncodeFunc encode_key,
+                             CUType value_type,
+                             CUAVLTreeImageEncodeFunc encode_value,
+                             void *userdata)
+{
+    if (cu_unlikely(!tree || !filename))
+        return false;
+    if ((key_type != CU_TYPE_UINT64 && key_type != CU_TYPE_BLOB) ||
+        (value_type != CU_TYPE_UINT64 && value_type != CU_TYPE_BLOB) ||
+        (key_type == CU_TYPE_BLOB && !encode_key) ||
+        (value_type == CU_TYPE_BLOB && !encode_value))
+        return false;
+
+    CUAVLTreeImageWriter writer = {
+        .key_type = key_type,
+        .value_type = value_type,
+        .encode_key = encode_key,
+        .encode_value = encode_value,
+        .userdata = userdata
+    };
+    cu_avl_tree_foreach(tree, (CUTraverseFunc)_cu_avl_tree_image_count, &writer.length);
+
+    CUAVLTreeImageHeader header;
+    memset(&header, 0, sizeof(CUAVLTreeImageHeader));
+    memcpy(header.magic, CU_AVL_TREE_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = CU_AVL_TREE_IMAGE_VERSION;
+    header.key_type = key_type;
+    header.value_type = value_type;
+    header.length = writer.length;
+
+    size_t keys_size = (writer.length + 1) * _cu_avl_tree_image_slot_size(key_type);
+    size_t values_size = (writer.length + 1) * _cu_avl_tree_image_slot_size(value_type);
+    header.keys_offset = sizeof(CUAVLTreeImageHeader);
+    header.values_offset = header.keys_offset + keys_size;
+    header.data_offset = header.values_offset + values_size;
+
+    /* Write to a temporary file and rename it over the target once complete, so that an old
+     * image survives a failed write. */
+    size_t filename_length = strlen(filename);
+    char *tmpname = cu_alloc(filename_length + sizeof(CU_AVL_TREE_IMAGE_TMP_SUFFIX));
+    memcpy(tmpname, filename, filename_length);
+    memcpy(tmpname + filename_length, CU_AVL_TREE_IMAGE_TMP_SUFFIX, sizeof(CU_AVL_TREE_IMAGE_TMP_SUFFIX));
+
+    writer.file = fopen(tmpname, "wb");
+    if (!writer.file) {
+        cu_free(tmpname);
+        return false;
+    }
+
+    writer.keys = cu_alloc0(keys_size);
+    writer.values = cu_alloc0(values_size);
+
+    /* Encoded elements are written in order behind the slots, which we write at the end. */
+    writer.position = 1;
+    while (2 * writer.position <= writer.length)
+        writer.position *= 2;
+    if (fseek(writer.file, header.data_offset, SEEK_SET) != 0)
+        writer.failed = true;
+    if (!writer.failed)
+        cu_avl_tree_foreach(tree, (CUTraverseFunc)_cu_avl_tree_image_write_node, &writer);
+    header.data_size = writer.data_size;
+
+    if (!writer.failed &&
+        (fseek(writer.file, 0, SEEK_SET) != 0 ||
+         fwrite(&header, sizeof(CUAVLTreeImageHeader), 1, writer.file) != 1 ||
+         fwrite(writer.keys, keys_size, 1, writer.file) != 1 ||
+         fwrite(writer.values, values_size, 1, writer.file) != 1))
+        writer.failed = true;
+
+    if (!writer.failed && (fflush(writer.file) != 0 || fsync(fileno(writer.file)) != 0))
+        writer.failed = true;
+    if (fclose(writer.file) != 0)
+        writer.failed = true;
+    if (!writer.failed && rename(tmpname, filename) != 0)
+        writer.failed = true;
+    if (writer.failed)
+        unlink(tmpname);
+
+    cu_free(tmpname);
+    cu_free(writer.keys);
+    cu_free(writer.values);
+    cu_free(writer.buffer);
+
+    return !writer.failed;
+}
+
+CUAVLTreeImage *cu_avl_tree_image_open(const char *filename)
+{
+    if (cu_unlikely(!filename))
+        return NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CUAVLTreeImageHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    /* Check that the header is valid and all sections are inside the file. The length is checked
+     * against the size of the file first, so that the section sizes below cannot overflow. */
+    const CUAVLTreeImageHeader *header = map;
+    size_t size = st.st_size;
+    if (memcmp(header->magic, CU_AVL_TREE_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CU_AVL_TREE_IMAGE_VERSION ||
+        (header->key_type != CU_TYPE_UINT64 && header->key_type != CU_TYPE_BLOB) ||
+        (header->value_type != CU_TYPE_UINT64 && header->value_type != CU_TYPE_BLOB) ||
+        header->keys_offset != sizeof(CUAVLTreeImageHeader) ||
+        header->length >= (size - header->keys_offset) /
+            (_cu_avl_tree_image_slot_size(header->key_type) + _cu_avl_tree_image_slot_size(header->value_type)) ||
+        header->values_offset != header->keys_offset +
+            (header->length + 1) * _cu_avl_tree_image_slot_size(header->key_type) ||
+        header->data_offset != header->values_offset +
+            (header->length + 1) * _cu_avl_tree_image_slot_size(header->value_type) ||
+        header->data_offset > size || header->data_size > size - header->data_offset) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    CUAVLTreeImage *image = cu_alloc0(sizeof(CUAVLTreeImage));
+    image->map = map;
+    image->map_size = size;
+    image->length = header->length;
+    image->key_type = header->key_type;
+    image->value_type = header->value_type;
+    image->keys = (const uint8_t *)map + header->keys_offset;
+    image->values = (const uint8_t *)map + header->values_offset;
+    image->data = (const uint8_t *)map + header->data_offset;
+    image->data_size = header->data_size;
+
+    return image;
+}
+
+void cu_avl_tree_image_close(CUAVLTreeImage *image)
+{
+    if (cu_unlikely(!image))
+        return;
+    munmap(image->map, image->map_size);
+    cu_free(image);
+}
+
+size_t cu_avl_tree_image_length(CUAVLTreeImage *image)
+{
+    return image ? image->length : 0;
+}
+
+/** @internal
+ *  @brief Compare an encoded key of the image with a key.
+ *  @return A value smaller than, equal to, or larger than zero, if the encoded key is smaller than,
+ *          equal to, or larger than @a key.
+ */
+static inline
+int _cu_avl_tree_image_compare_blob(CUAVLTreeImage *image, const CUAVLTreeImageBlob *blob,
+                                    const void *key, size_t key_length)
+{
+    int rc = 0;
+    if (cu_unlikely(blob->offset > image->data_size || blob->length > image->data_size - blob->offset))
+        return 1;
+    if (blob->length && key_length)
+        rc = memcmp(image->data + blob->offset, key, blob->length < key_length ? blob->length : key_length);
+    if (rc == 0 && blob->length != key_length)
+        rc = blob->length < key_length ? -1 : 1;
+    return rc;
+}
+
+bool cu_avl_tree_image_find(CUAVLTreeImage *image,
+                            const void *key,
+                            size_t key_length,
+                            const void **value,
+                            size_t *value_length)
+{
+    if (cu_unlikely(!image || !key))
+        return false;
+
+    size_t length = image->length;
+    size_t position = 1;
+
+    /* Descend without branching on the result, so the loop is not disturbed by mispredictions.
+     * The path is encoded in the bits of position. Afterwards, strip the trailing ones
+     * (the steps to the right after the last step to the left) to get the smallest key
+     * not less than the one we search. */
+    if (image->key_type == CU_TYPE_UINT64) {
+        const uint64_t *keys = image->keys;
+        uint64_t integer;
+        if (key_length != sizeof(uint64_t))
+            return false;
+        memcpy(&integer, key, sizeof(uint64_t));
+        while (position <= length) {
+            __builtin_prefetch(keys + 16 * position);
+            position = 2 * position + (keys[position] < integer);
+        }
+        position >>= __builtin_ffsll(~(long long)position);
+        if (position == 0 || keys[position] != integer)
+            return false;
+    }
+    else {
+        const CUAVLTreeImageBlob *keys = image->keys;
+        while (position <= length)
+            position = 2 * position + (_cu_avl_tree_image_compare_blob(image, &keys[position], key, key_length) < 0);
+        position >>= __builtin_ffsll(~(long long)position);
+        if (position == 0 || _cu_avl_tree_image_compare_blob(image, &keys[position], key, key_length) != 0)
+            return false;
+    }
+
+    if (image->value_type == CU_TYPE_UINT64) {
+        if (value)
+            *value = (const uint64_t *)image->values + position;
+        if (value_length)
+            *value_length = sizeof(uint64_t);
+    }
+    else {
+        const CUAVLTreeImageBlob *blob = (const CUAVLTreeImageBlob *)image->values + position;
+        if (blob->offset > image->data_size || blob->length > image->data_size - blob->offset)
+            return false;
+        if (value)
+            *value = image->data + blob->offset;
+        if (value_length)
+            *value_length = blob->length;
+    }
+    return true;
+}
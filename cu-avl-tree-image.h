@@ -0,0 +1,92 @@
+/** @file cu-avl-tree-image.h
+ *  Write an AVL tree to a flat file and search it in place.
+ *  @defgroup CUAVLTreeImage AVL tree image
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+#include <cu-avl-tree.h>
+
+/** @brief Handle to a read-only, memory mapped image of an AVL tree.
+ *  @details The elements are stored in an array in Eytzinger order (the children of the
+ *           element at position i are at 2i and 2i+1), so the image can be searched directly
+ *           in the mapped file, without loading or rebuilding anything. The image uses the
+ *           native byte order.
+ */
+typedef struct _CUAVLTreeImage CUAVLTreeImage;
+
+/** @brief Encode a key or value of a tree for an image.
+ *  @details Works like cu_blob_serialize(): If the encoded element does not fit into
+ *           @a buflen bytes, the function has to replace @a buffer with a larger one,
+ *           allocated by cu_alloc().
+ *  @param[in] 1 The key or value.
+ *  @param[in,out] 2 Pointer to the buffer receiving the encoded element.
+ *  @param[in] 3 The current size of the buffer.
+ *  @param[in] 4 Pointer to user defined data.
+ *  @return The size of the encoded element.
+ */
+typedef size_t (*CUAVLTreeImageEncodeFunc)(void *, char **, size_t, void *);
+
+/** @brief Write all elements of a tree to an image file.
+ *  @details Keys and values are either stored as integers (@a CU_TYPE_UINT64, the pointer value
+ *           itself is stored) or as byte strings produced by an encode function (@a CU_TYPE_BLOB).
+ *           The elements are stored in the order of the tree, but lookups in the image compare
+ *           integers or byte strings (like memcmp(), shorter strings first on a common prefix).
+ *           Both orders have to agree, e.g. by encoding integers in big endian order.
+ *  @param[in] tree The tree to write.
+ *  @param[in] filename The name of the image file, which is replaced. The image is written to
+ *                     @a filename with ".tmp" appended first and renamed once complete, so a
+ *                     previous image is kept if writing fails.
+ *  @param[in] key_type Either @a CU_TYPE_UINT64 or @a CU_TYPE_BLOB.
+ *  @param[in] encode_key Function to encode the keys, required for @a CU_TYPE_BLOB.
+ *  @param[in] value_type Either @a CU_TYPE_UINT64 or @a CU_TYPE_BLOB.
+ *  @param[in] encode_value Function to encode the values, required for @a CU_TYPE_BLOB.
+ *  @param[in] userdata Pointer passed as last argument to @a encode_key and @a encode_value.
+ *  @retval true The image was written.
+ *  @retval false The types are not supported or the file could not be written.
+ */
+bool cu_avl_tree_image_write(CUAVLTree *tree,
+                             const char *filename,
+                             CUType key_type,
+                             CUAVLTreeImageEncodeFunc encode_key,
+                             CUType value_type,
+                             CUAVLTreeImageEncodeFunc encode_value,
+                             void *userdata);
+
+/** @brief Map an image file into memory.
+ *  @param[in] filename The name of the image file.
+ *  @return The image, or @a NULL if the file could not be mapped or is no valid image.
+ */
+CUAVLTreeImage *cu_avl_tree_image_open(const char *filename);
+
+/** @brief Unmap an image and free all resources.
+ *  @details Pointers into the image returned by cu_avl_tree_image_find() become invalid.
+ *  @param[in] image The image.
+ */
+void cu_avl_tree_image_close(CUAVLTreeImage *image);
+
+/** @brief Return the number of elements in an image.
+ *  @param[in] image The image.
+ *  @return The number of elements.
+ */
+size_t cu_avl_tree_image_length(CUAVLTreeImage *image);
+
+/** @brief Find an element in an image.
+ *  @details For integer keys, @a key points to an uint64_t and @a key_length is 8.
+ *           Integer values are returned as pointer to an uint64_t in the image.
+ *  @param[in] image The image.
+ *  @param[in] key Pointer to the key of the element we search.
+ *  @param[in] key_length The length of the key in bytes.
+ *  @param[out] value Gets filled with a pointer to the value inside the image, if @a key was found.
+ *  @param[out] value_length Gets filled with the length of the value, if @a key was found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the image.
+ */
+bool cu_avl_tree_image_find(CUAVLTreeImage *image,
+                            const void *key,
+                            size_t key_length,
+                            const void **value,
+                            size_t *value_length);
+
+/** @} */
@@ -3,7 +3,10 @@
 #include "cu.h"
 #include "cu-fixed-stack.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /** @brief Balance of a node.
  *  @details Balance is a 2-bit field, 10b means leaning left, 01b means leaning right,
@@ -21,15 +24,26 @@ typedef struct _CUAVLTreeNode CUAVLTreeNode;
  */
 struct _CUAVLTreeNode {
     void *key; /**< Pointer to the key of the node, unique in the tree. */
-    void *value; /**< Pointer to the value of the node. */
-    CUAVLTreeNode *llink; /**< Reference to the left node. */
-    CUAVLTreeNode *rlink; /**< Reference to the right node. */
-
-    CUAVLTreeNodeBalance balance;
+    uintptr_t llink; /**< Reference to the left node. The lowest bit is set if the node leans left. */
+    uintptr_t rlink; /**< Reference to the right node. The lowest bit is set if the node leans right. */
+    void *value; /**< Pointer to the value of the node. Not allocated in key-only trees. */
 };
 
+/** @internal
+ *  @brief A node in an interval tree.
+ */
+typedef struct {
+    CUAVLTreeNode node; /**< The node, its key is the start of the interval. */
+    void *end; /**< The end of the interval, excluded. */
+    void *max_end; /**< The largest end in the subtree of this node. */
+} CUAVLTreeIntervalNode;
+
 struct _CUAVLTree {
     CUFixedSizeMemoryPool *node_mem;
+    /* Nodes joined or merged in from trees with a different memory. */
+    CUFixedSizeMemoryPool **foreign_mem; /* Pools holding some of the nodes, with a reference each. */
+    uint32_t foreign_count;
+    uint32_t foreign_alloc : 1; /* Some nodes were allocated by cu_alloc(). */
 
     CUAVLTreeNode *root;
 
@@ -44,8 +58,101 @@ struct _CUAVLTree {
     /* Keep stack around for find or delete and do not initialize with every access. */
     uint32_t max_height;
     CUFixedStack node_stack;
+
+    uint32_t finger_search : 1; /* Start lookups from the path of the last access. */
+    /* Persistent mode: list of all versions that may still be referenced, from the oldest
+     * to the current one. The lock protects the reference counts of the snapshots. */
+    CUAVLTreeSnapshot *oldest_snapshot;
+    CUAVLTreeSnapshot *current_snapshot;
+    pthread_mutex_t snapshot_lock;
+
+    uint32_t persistent : 1; /* Never modify nodes, but copy the path to changed nodes. */
+    uint32_t key_only : 1; /* Nodes have no value. */
+    uint32_t interval : 1; /* Nodes are CUAVLTreeIntervalNodes. */
+};
+
+/* The flags of retired nodes are stored in the lower bits of the pointer. */
+#define RETIRED_DESTROY_KEY   ((uintptr_t)1)
+#define RETIRED_DESTROY_VALUE ((uintptr_t)2)
+#define RETIRED_FLAGS         ((uintptr_t)3)
+
+/** @internal
+ *  @brief A single version of a persistent tree.
+ */
+struct _CUAVLTreeSnapshot {
+    CUAVLTree *tree; /**< The tree this snapshot belongs to. */
+    CUAVLTreeNode *root; /**< The root of this version. */
+    uint32_t height; /**< The height of this version. */
+    uint32_t ref_count; /**< Number of readers holding the snapshot, plus one if this is the current version. */
+
+    uintptr_t *retired; /**< Nodes of this version that are not part of the next one, with RETIRED_* flags. */
+    uint32_t retired_length; /**< Number of retired nodes. */
+    uint32_t retired_size; /**< Capacity of the retired array. */
+
+    CUAVLTreeSnapshot *next; /**< The next newer version. */
 };
 
+static CUAVLTreeNode *_cu_avl_tree_insert_node(CUAVLTree *tree, void *key, void *end, void *value);
+static void _cu_avl_tree_persistent_insert(CUAVLTree *tree, void *key, void *value);
+static bool _cu_avl_tree_persistent_remove(CUAVLTree *tree, void *key);
+static void _cu_avl_tree_persistent_clear(CUAVLTree *tree);
+static void _cu_avl_tree_persistent_destroy(CUAVLTree *tree);
+
+/** @internal
+ *  @brief Get the left child of a node.
+ */
+static inline
+CUAVLTreeNode *_cu_avl_tree_node_get_left(CUAVLTreeNode *node)
+{
+    return (CUAVLTreeNode *)(node->llink & ~(uintptr_t)1);
+}
+
+/** @internal
+ *  @brief Get the right child of a node.
+ */
+static inline
+CUAVLTreeNode *_cu_avl_tree_node_get_right(CUAVLTreeNode *node)
+{
+    return (CUAVLTreeNode *)(node->rlink & ~(uintptr_t)1);
+}
+
+/** @internal
+ *  @brief Set the left child of a node, keeping its balance.
+ */
+static inline
+void _cu_avl_tree_node_set_left(CUAVLTreeNode *node, CUAVLTreeNode *child)
+{
+    node->llink = (uintptr_t)child | (node->llink & 1);
+}
+
+/** @internal
+ *  @brief Set the right child of a node, keeping its balance.
+ */
+static inline
+void _cu_avl_tree_node_set_right(CUAVLTreeNode *node, CUAVLTreeNode *child)
+{
+    node->rlink = (uintptr_t)child | (node->rlink & 1);
+}
+
+/** @internal
+ *  @brief Get the balance of a node from the lowest bits of its links.
+ */
+static inline
+CUAVLTreeNodeBalance _cu_avl_tree_node_get_balance(CUAVLTreeNode *node)
+{
+    return (CUAVLTreeNodeBalance)((node->rlink & 1) | ((node->llink & 1) << 1));
+}
+
+/** @internal
+ *  @brief Set the balance of a node in the lowest bits of its links.
+ */
+static inline
+void _cu_avl_tree_node_set_balance(CUAVLTreeNode *node, CUAVLTreeNodeBalance balance)
+{
+    node->llink = (node->llink & ~(uintptr_t)1) | ((balance >> 1) & 1);
+    node->rlink = (node->rlink & ~(uintptr_t)1) | (balance & 1);
+}
+
 /** @internal 
  *  @brief Compare the raw pointer values.
  *  @details Used as a fallback if no @a compare function is passed to cu_avl_tree_new().
@@ -66,31 +173,125 @@ int _cu_avl_tree_compare_pointers(void *a, void *b, __attribute__((unused))void
     return 0;
 }
 
+/** @internal
+ *  @brief Get the size of the nodes of a tree.
+ *  @details Nodes of key-only trees end before the value.
+ *  @param[in] tree The tree.
+ *  @return The size of a single node in bytes.
+ */
+static inline
+size_t _cu_avl_tree_node_size(CUAVLTree *tree)
+{
+    if (tree->interval)
+        return sizeof(CUAVLTreeIntervalNode);
+    return tree->key_only ? offsetof(CUAVLTreeNode, value) : sizeof(CUAVLTreeNode);
+}
+
+/** @internal
+ *  @brief Get the value of a node, or @a NULL in key-only trees.
+ */
+static inline
+void *_cu_avl_tree_node_get_value(CUAVLTree *tree, CUAVLTreeNode *node)
+{
+    return tree->key_only ? NULL : node->value;
+}
+
 /** @internal
  *  @brief Wrapper to allocate memory for a single node.
  *  @details If the tree was created with a fixd size memory pool, get the memory from there,
  *           otherwise from cu_alloc.
- *  @param[in] pool The memory pool of the tree, or @a NULL.
+ *  @param[in] tree The tree.
  *  @return Pointer to a newly allocated node.
  */
 static
-CUAVLTreeNode *_cu_avl_tree_alloc(CUFixedSizeMemoryPool *pool)
+CUAVLTreeNode *_cu_avl_tree_alloc(CUAVLTree *tree)
 {
-    return (CUAVLTreeNode *)(pool ? cu_fixed_size_memory_pool_alloc(pool) : cu_alloc(sizeof(CUAVLTreeNode)));
+    return (CUAVLTreeNode *)(tree->node_mem ? cu_fixed_size_memory_pool_alloc(tree->node_mem)
+                                            : cu_alloc(_cu_avl_tree_node_size(tree)));
 }
 
 /** @internal
  *  @brief Wrapper to free memory of a node and return it to the pool, if present.
- *  @param[in] pool The memory pool of the tree, or @a NULL.
+ *  @details Nodes joined in from other trees are returned to the pool managing them.
+ *  @param[in] tree The tree holding the node.
  *  @param[in] node The node to free.
  */
 static
-void _cu_avl_tree_free(CUFixedSizeMemoryPool *pool, CUAVLTreeNode *node)
+void _cu_avl_tree_free(CUAVLTree *tree, CUAVLTreeNode *node)
 {
-    if (pool)
-        cu_fixed_size_memory_pool_free(pool, node);
-    else
-        cu_free(node);
+    uint32_t j;
+
+    if (cu_likely(!tree->foreign_count && !tree->foreign_alloc)) {
+        if (tree->node_mem)
+            cu_fixed_size_memory_pool_free(tree->node_mem, node);
+        else
+            cu_free(node);
+        return;
+    }
+
+    if (tree->node_mem && cu_fixed_size_memory_pool_free(tree->node_mem, node))
+        return;
+    for (j = 0; j < tree->foreign_count; ++j) {
+        if (cu_fixed_size_memory_pool_free(tree->foreign_mem[j], node))
+            return;
+    }
+    cu_free(node);
+}
+
+/** @internal
+ *  @brief Make the nodes of a pool freeable by a tree.
+ *  @details Takes a reference on the pool, unless the tree knows it already.
+ */
+static
+void _cu_avl_tree_add_foreign(CUAVLTree *tree, CUFixedSizeMemoryPool *pool)
+{
+    uint32_t j;
+
+    if (!pool) {
+        tree->foreign_alloc = true;
+        return;
+    }
+    if (pool == tree->node_mem)
+        return;
+    for (j = 0; j < tree->foreign_count; ++j) {
+        if (tree->foreign_mem[j] == pool)
+            return;
+    }
+    tree->foreign_mem = cu_realloc(tree->foreign_mem, (tree->foreign_count + 1) * sizeof(CUFixedSizeMemoryPool *));
+    tree->foreign_mem[tree->foreign_count++] = cu_fixed_size_memory_pool_ref(pool);
+}
+
+/** @internal
+ *  @brief Make all nodes of another tree freeable by a tree.
+ */
+static
+void _cu_avl_tree_add_foreign_of(CUAVLTree *tree, CUAVLTree *other)
+{
+    uint32_t j;
+
+    if (other->node_mem != tree->node_mem)
+        _cu_avl_tree_add_foreign(tree, other->node_mem);
+    for (j = 0; j < other->foreign_count; ++j)
+        _cu_avl_tree_add_foreign(tree, other->foreign_mem[j]);
+    if (other->foreign_alloc)
+        tree->foreign_alloc = true;
+}
+
+/** @internal
+ *  @brief Drop the references to the pools of other trees.
+ *  @details Only call this if no node of these pools is left in the tree.
+ */
+static
+void _cu_avl_tree_release_foreign(CUAVLTree *tree)
+{
+    uint32_t j;
+
+    for (j = 0; j < tree->foreign_count; ++j)
+        cu_fixed_size_memory_pool_unref(tree->foreign_mem[j]);
+    cu_free(tree->foreign_mem);
+    tree->foreign_mem = NULL;
+    tree->foreign_count = 0;
+    tree->foreign_alloc = false;
 }
 
 /** @internal
@@ -112,29 +313,58 @@ void _cu_avl_tree_node_stack_init(CUAVLTree *tree)
     }
 }
 
+/** @internal
+ *  @brief Forget the path of the last access.
+ *  @details The node stack always holds a path starting at the root, or is empty. Call this
+ *           whenever the structure of the tree is changed without maintaining the stack.
+ *  @param[in] tree The tree.
+ */
+static inline
+void _cu_avl_tree_forget_path(CUAVLTree *tree)
+{
+    tree->node_stack.length = 0;
+}
+
 CUAVLTree *cu_avl_tree_new_full(CUCompareDataFunc compare,
                                 void *compare_data,
                                 CUDestroyNotifyFunc destroy_key,
                                 CUDestroyNotifyFunc destroy_value,
                                 bool use_fixed_memory_pool)
 {
-    CUAVLTree *tree = cu_alloc(sizeof(CUAVLTree));
+    CUAVLTree *tree = cu_alloc0(sizeof(CUAVLTree));
     if (use_fixed_memory_pool) {
         tree->node_mem = cu_fixed_size_memory_pool_new(sizeof(CUAVLTreeNode), 0);
         cu_fixed_size_memory_pool_release_empty_groups(tree->node_mem, true);
     }
-    else {
-        tree->node_mem = NULL;
-    }
 
-    tree->root = NULL;
     tree->compare = compare ? compare : _cu_avl_tree_compare_pointers;
     tree->compare_data = compare_data;
     tree->destroy_key = destroy_key;
     tree->destroy_value = destroy_value;
 
-    tree->height = 0;
+    return tree;
+}
+
+CUAVLTree *cu_avl_tree_new_set(CUCompareDataFunc compare,
+                               void *compare_data,
+                               CUDestroyNotifyFunc destroy_key)
+{
+    CUAVLTree *tree = cu_avl_tree_new_full(compare, compare_data, destroy_key, NULL, false);
+    tree->key_only = 1;
+    tree->node_mem = cu_fixed_size_memory_pool_new(_cu_avl_tree_node_size(tree), 0);
+    cu_fixed_size_memory_pool_release_empty_groups(tree->node_mem, true);
+    return tree;
+}
 
+CUAVLTree *cu_avl_tree_new_interval(CUCompareDataFunc compare,
+                                    void *compare_data,
+                                    CUDestroyNotifyFunc destroy_key,
+                                    CUDestroyNotifyFunc destroy_value)
+{
+    CUAVLTree *tree = cu_avl_tree_new_full(compare, compare_data, destroy_key, destroy_value, false);
+    tree->interval = 1;
+    tree->node_mem = cu_fixed_size_memory_pool_new(_cu_avl_tree_node_size(tree), 0);
+    cu_fixed_size_memory_pool_release_empty_groups(tree->node_mem, true);
     return tree;
 }
 
@@ -151,39 +381,116 @@ CUAVLTree *cu_avl_tree_new(CUCompareDataFunc compare,
  *  @param[in] key The key to free.
  *  @param[in] value The value to free.
  *  @param[in] tree The tree in which the node is a member of.
+ *  @retval true Always, to continue the traversal.
  */
-void _cu_avl_tree_clear_node(void *key, void *value, CUAVLTree *tree)
+bool _cu_avl_tree_clear_node(void *key, void *value, CUAVLTree *tree)
 {
     if (tree->destroy_key)
         tree->destroy_key(key);
     if (tree->destroy_value)
         tree->destroy_value(value);
+    return true;
+}
+
+/** @internal
+ *  @brief Free the resources of all keys and values in a subtree, and the nodes themselves.
+ *  @param[in] tree The tree.
+ *  @param[in] node The root of the subtree.
+ */
+static
+void _cu_avl_tree_free_subtree(CUAVLTree *tree, CUAVLTreeNode *node)
+{
+    if (!node)
+        return;
+    _cu_avl_tree_free_subtree(tree, _cu_avl_tree_node_get_left(node));
+    _cu_avl_tree_free_subtree(tree, _cu_avl_tree_node_get_right(node));
+    _cu_avl_tree_clear_node(node->key, _cu_avl_tree_node_get_value(tree, node), tree);
+    _cu_avl_tree_free(tree, node);
 }
 
 void cu_avl_tree_clear(CUAVLTree *tree)
 {
     if (cu_unlikely(!tree))
         return;
+    if (tree->persistent) {
+        _cu_avl_tree_persistent_clear(tree);
+        return;
+    }
 
-    if (tree->destroy_key || tree->destroy_value)
-        cu_avl_tree_foreach(tree, (CUTraverseFunc)_cu_avl_tree_clear_node, tree);
-
-    if (tree->node_mem)
+    if (tree->node_mem && !cu_fixed_size_memory_pool_is_shared(tree->node_mem) &&
+            !tree->foreign_count && !tree->foreign_alloc) {
+        /* We are the only user of the pool, so all nodes can be released at once. */
+        if (tree->destroy_key || tree->destroy_value)
+            cu_avl_tree_foreach(tree, (CUTraverseFunc)_cu_avl_tree_clear_node, tree);
         cu_fixed_size_memory_pool_clear(tree->node_mem);
+    }
+    else {
+        _cu_avl_tree_free_subtree(tree, tree->root);
+    }
+    _cu_avl_tree_release_foreign(tree);
 
     tree->root = NULL;
+    tree->height = 0;
+    _cu_avl_tree_forget_path(tree);
 }
 
 void cu_avl_tree_destroy(CUAVLTree *tree)
 {
     if (cu_unlikely(!tree))
         return;
-    cu_avl_tree_clear(tree);
-    if (tree->node_mem)
-        cu_fixed_size_memory_pool_destroy(tree->node_mem);
+    if (tree->persistent)
+        _cu_avl_tree_persistent_destroy(tree);
+    else
+        cu_avl_tree_clear(tree);
+    cu_fixed_size_memory_pool_unref(tree->node_mem);
+    cu_fixed_stack_clear(&tree->node_stack);
     cu_free(tree);
 }
 
+/** @internal
+ *  @brief Find the deepest node on the path of the last access, whose subtree may contain the key.
+ *  @details Walk up the path, until the key is known to lie between the nearest bounds
+ *           given by the ancestors. The stack is cut below the returned node.
+ *  @param[in] tree The tree with a non-empty path on the node stack.
+ *  @param[in] key The key we look for.
+ *  @return The node from which to continue the descent.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_finger_start(CUAVLTree *tree, void *key)
+{
+    CUAVLTreeNode **path = (CUAVLTreeNode **)tree->node_stack.data;
+    size_t start = tree->node_stack.length - 1;
+    size_t j;
+    bool need_lower = true, need_upper = true;
+
+    for (j = start; j > 0 && (need_lower || need_upper); --j) {
+        if (path[j] == _cu_avl_tree_node_get_left(path[j - 1])) {
+            /* The key of the parent is an upper bound for the subtree. */
+            if (!need_upper)
+                continue;
+            if (tree->compare(key, path[j - 1]->key, tree->compare_data) > 0) {
+                need_upper = false;
+                continue;
+            }
+        }
+        else {
+            if (!need_lower)
+                continue;
+            if (tree->compare(key, path[j - 1]->key, tree->compare_data) < 0) {
+                need_lower = false;
+                continue;
+            }
+        }
+        /* The key is outside of the subtree, continue with the parent. Bounds checked so far
+         * belong to descendants of the parent and do not restrict it. */
+        start = j - 1;
+        need_lower = need_upper = true;
+    }
+
+    tree->node_stack.length = start;
+    return path[start];
+}
+
 /** @internal
  *  @brief Find the node for a given key and build the stack.
  *  @param[in] tree The tree in which we look for the key.
@@ -193,19 +500,25 @@ void cu_avl_tree_destroy(CUAVLTree *tree)
 static
 CUAVLTreeNode *_cu_avl_tree_find_node_build_path(CUAVLTree *tree, void *key)
 {
-    CUAVLTreeNode *node = tree->root;
+    CUAVLTreeNode *node;
     int rc;
 
-    _cu_avl_tree_node_stack_init(tree);
+    if (tree->finger_search && tree->node_stack.length && tree->height <= tree->max_height) {
+        node = _cu_avl_tree_finger_start(tree, key);
+    }
+    else {
+        _cu_avl_tree_node_stack_init(tree);
+        node = tree->root;
+    }
 
     while (node) {
         cu_fixed_pointer_stack_push(&tree->node_stack, node);
         rc = tree->compare(key, node->key, tree->compare_data);
         if (rc > 0) { /* key < node->key, walk left */
-            node = node->llink;
+            node = _cu_avl_tree_node_get_left(node);
         }
         else if (rc < 0) { /* key > node->key, walk right */
-            node = node->rlink;
+            node = _cu_avl_tree_node_get_right(node);
         }
         else
             return node;
@@ -224,10 +537,10 @@ CUAVLTreeNode *_cu_avl_tree_find_node_build_path(CUAVLTree *tree, void *key)
 static
 CUAVLTreeNode *_cu_avl_tree_build_path_to_predecessor(CUAVLTree *tree, CUAVLTreeNode *node)
 {
-    CUAVLTreeNode *N = node->llink;
+    CUAVLTreeNode *N = _cu_avl_tree_node_get_left(node);
     while (N) {
         cu_fixed_pointer_stack_push(&tree->node_stack, N);
-        N = N->rlink;
+        N = _cu_avl_tree_node_get_right(N);
     }
     return cu_fixed_pointer_stack_peek(&tree->node_stack);
 }
@@ -241,10 +554,10 @@ CUAVLTreeNode *_cu_avl_tree_build_path_to_predecessor(CUAVLTree *tree, CUAVLTree
 static
 CUAVLTreeNode *_cu_avl_tree_build_path_to_successor(CUAVLTree *tree, CUAVLTreeNode *node)
 {
-    CUAVLTreeNode *N = node->rlink;
+    CUAVLTreeNode *N = _cu_avl_tree_node_get_right(node);
     while (N) {
         cu_fixed_pointer_stack_push(&tree->node_stack, N);
-        N = N->llink;
+        N = _cu_avl_tree_node_get_left(N);
     }
     return cu_fixed_pointer_stack_peek(&tree->node_stack);
 }
@@ -263,17 +576,17 @@ CUAVLTreeNode *_cu_avl_tree_rotate_left(CUAVLTreeNode *X, CUAVLTreeNode *Z)
     fprintf(stderr, "rotate LEFT\n");
 #endif
     /* Exchange X and Z */
-    X->rlink = Z->llink;
-    Z->llink = X;
+    _cu_avl_tree_node_set_right(X, _cu_avl_tree_node_get_left(Z));
+    _cu_avl_tree_node_set_left(Z, X);
 
     /* Fix balance. */
-    if (Z->balance == BALANCE_BALANCED) { /* Only after deletion. */
-        X->balance = BALANCE_LEAN_RIGHT;
-        Z->balance = BALANCE_LEAN_LEFT;
+    if (_cu_avl_tree_node_get_balance(Z) == BALANCE_BALANCED) { /* Only after deletion. */
+        _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_RIGHT);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_LEAN_LEFT);
     }
     else {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_BALANCED;
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
 
     /* Z is the new root. */
@@ -294,17 +607,17 @@ CUAVLTreeNode *_cu_avl_tree_rotate_right(CUAVLTreeNode *X, CUAVLTreeNode *Z)
     fprintf(stderr, "rotate RIGHT\n");
 #endif
     /* Exchange X and Z */
-    X->llink = Z->rlink;
-    Z->rlink = X;
+    _cu_avl_tree_node_set_left(X, _cu_avl_tree_node_get_right(Z));
+    _cu_avl_tree_node_set_right(Z, X);
 
     /* Fix balance. */
-    if (Z->balance == BALANCE_BALANCED) { /* Could happen only after deletion. */
-        X->balance = BALANCE_LEAN_LEFT;
-        Z->balance = BALANCE_LEAN_RIGHT;
+    if (_cu_avl_tree_node_get_balance(Z) == BALANCE_BALANCED) { /* Could happen only after deletion. */
+        _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_LEFT);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_LEAN_RIGHT);
     }
     else {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_BALANCED;
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
 
     /* Z is the new root. */
@@ -323,28 +636,28 @@ CUAVLTreeNode *_cu_avl_tree_rotate_right_left(CUAVLTreeNode *X, CUAVLTreeNode *Z
 #ifdef DEBUG
     fprintf(stderr, "rotate RIGHT LEFT\n");
 #endif
-    CUAVLTreeNode *Y = Z->llink;
+    CUAVLTreeNode *Y = _cu_avl_tree_node_get_left(Z);
     /* Right rotation around Z. */
-    Z->llink = Y->rlink;
-    Y->rlink = Z;
+    _cu_avl_tree_node_set_left(Z, _cu_avl_tree_node_get_right(Y));
+    _cu_avl_tree_node_set_right(Y, Z);
     /* Left rotation around X. */
-    X->rlink = Y->llink;
-    Y->llink = X;
+    _cu_avl_tree_node_set_right(X, _cu_avl_tree_node_get_left(Y));
+    _cu_avl_tree_node_set_left(Y, X);
 
-    if (Y->balance == BALANCE_LEAN_LEFT) {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_LEAN_RIGHT;
+    if (_cu_avl_tree_node_get_balance(Y) == BALANCE_LEAN_LEFT) {
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_LEAN_RIGHT);
     }
-    else if (Y->balance == BALANCE_LEAN_RIGHT) {
-        X->balance = BALANCE_LEAN_LEFT;
-        Z->balance = BALANCE_BALANCED;
+    else if (_cu_avl_tree_node_get_balance(Y) == BALANCE_LEAN_RIGHT) {
+        _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_LEFT);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
     else {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_BALANCED;
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
 
-    Y->balance = BALANCE_BALANCED;
+    _cu_avl_tree_node_set_balance(Y, BALANCE_BALANCED);
 
     return Y;
 }
@@ -361,37 +674,93 @@ CUAVLTreeNode *_cu_avl_tree_rotate_left_right(CUAVLTreeNode *X, CUAVLTreeNode *Z
 #ifdef DEBUG
     fprintf(stderr, "rotate LEFT RIGHT\n");
 #endif
-    CUAVLTreeNode *Y = Z->rlink;
+    CUAVLTreeNode *Y = _cu_avl_tree_node_get_right(Z);
     /* Left rotation around Z. */
-    Z->rlink = Y->llink;
-    Y->llink = Z;
+    _cu_avl_tree_node_set_right(Z, _cu_avl_tree_node_get_left(Y));
+    _cu_avl_tree_node_set_left(Y, Z);
     /* Right rotation around X. */
-    X->llink = Y->rlink;
-    Y->rlink = X;
+    _cu_avl_tree_node_set_left(X, _cu_avl_tree_node_get_right(Y));
+    _cu_avl_tree_node_set_right(Y, X);
 
-    if (Y->balance == BALANCE_LEAN_RIGHT) {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_LEAN_LEFT;
+    if (_cu_avl_tree_node_get_balance(Y) == BALANCE_LEAN_RIGHT) {
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_LEAN_LEFT);
     }
-    else if (Y->balance == BALANCE_LEAN_LEFT) {
-        X->balance = BALANCE_LEAN_RIGHT;
-        Z->balance = BALANCE_BALANCED;
+    else if (_cu_avl_tree_node_get_balance(Y) == BALANCE_LEAN_LEFT) {
+        _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_RIGHT);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
     else {
-        X->balance = BALANCE_BALANCED;
-        Z->balance = BALANCE_BALANCED;
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        _cu_avl_tree_node_set_balance(Z, BALANCE_BALANCED);
     }
 
-    Y->balance = BALANCE_BALANCED;
+    _cu_avl_tree_node_set_balance(Y, BALANCE_BALANCED);
 
     return Y;
 }
 
-void cu_avl_tree_insert(CUAVLTree *tree,
-                        void *key,
-                        void *value)
+/** @internal
+ *  @brief Recompute the largest end in the subtree of a node of an interval tree.
+ *  @details The largest ends of the children have to be up to date.
+ *  @param[in] tree The interval tree.
+ *  @param[in] node The node.
+ */
+static inline
+void _cu_avl_tree_interval_update(CUAVLTree *tree, CUAVLTreeNode *node)
+{
+    CUAVLTreeIntervalNode *inode = (CUAVLTreeIntervalNode *)node;
+    CUAVLTreeIntervalNode *child;
+    void *max_end = inode->end;
+
+    if ((child = (CUAVLTreeIntervalNode *)_cu_avl_tree_node_get_left(node)) &&
+            tree->compare(max_end, child->max_end, tree->compare_data) > 0)
+        max_end = child->max_end;
+    if ((child = (CUAVLTreeIntervalNode *)_cu_avl_tree_node_get_right(node)) &&
+            tree->compare(max_end, child->max_end, tree->compare_data) > 0)
+        max_end = child->max_end;
+    inode->max_end = max_end;
+}
+
+/** @internal
+ *  @brief Recompute the largest ends of all nodes on the stack, from the top to the root.
+ *  @details Called after an element has been added to or removed from the subtree on top of the stack.
+ *  @param[in] tree The interval tree.
+ */
+static
+void _cu_avl_tree_interval_update_path(CUAVLTree *tree)
+{
+    CUAVLTreeNode **path = (CUAVLTreeNode **)tree->node_stack.data;
+    size_t j = tree->node_stack.length;
+    while (j > 0)
+        _cu_avl_tree_interval_update(tree, path[--j]);
+}
+
+/** @internal
+ *  @brief Recompute the largest ends of a subtree after a rotation.
+ *  @details Only the new root and its children may have changed their subtrees.
+ *  @param[in] tree The interval tree.
+ *  @param[in] N The root of the rotated subtree.
+ */
+static
+void _cu_avl_tree_interval_update_rotated(CUAVLTree *tree, CUAVLTreeNode *N)
+{
+    _cu_avl_tree_interval_update(tree, _cu_avl_tree_node_get_left(N));
+    _cu_avl_tree_interval_update(tree, _cu_avl_tree_node_get_right(N));
+    _cu_avl_tree_interval_update(tree, N);
+}
+
+/** @internal
+ *  @brief Insert an element, or replace the value of an existing one.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element.
+ *  @param[in] end The end of the interval, if @a tree is an interval tree.
+ *  @param[in] value The value of the element.
+ */
+static
+void _cu_avl_tree_insert(CUAVLTree *tree, void *key, void *end, void *value)
 {
-    CUAVLTreeNode *X, *Z, *N, *R;
+    CUAVLTreeNode *Z;
     /* Find the matching node and build the path to it. */
     Z = _cu_avl_tree_find_node_build_path(tree, key);
     if (Z != NULL) {
@@ -400,40 +769,120 @@ void cu_avl_tree_insert(CUAVLTree *tree,
             tree->destroy_key(key);
         if (tree->destroy_value && Z->value != value)
             tree->destroy_value(Z->value);
-        Z->value = value;
+        if (!tree->key_only)
+            Z->value = value;
+        if (tree->interval) {
+            ((CUAVLTreeIntervalNode *)Z)->end = end;
+            _cu_avl_tree_interval_update_path(tree);
+        }
+        return;
+    }
+
+    _cu_avl_tree_insert_node(tree, key, end, value);
+}
+
+void cu_avl_tree_insert(CUAVLTree *tree,
+                        void *key,
+                        void *value)
+{
+    if (cu_unlikely(!tree))
+        return;
+    if (tree->persistent) {
+        _cu_avl_tree_persistent_insert(tree, key, value);
+        return;
+    }
+
+    _cu_avl_tree_insert(tree, key, key, value);
+}
+
+void cu_avl_tree_insert_interval(CUAVLTree *tree,
+                                 void *start,
+                                 void *end,
+                                 void *value)
+{
+    if (cu_unlikely(!tree))
+        return;
+    if (tree->persistent) {
+        _cu_avl_tree_persistent_insert(tree, start, value);
         return;
     }
 
+    _cu_avl_tree_insert(tree, start, end, value);
+}
+
+void **cu_avl_tree_lookup_or_insert(CUAVLTree *tree,
+                                    void *key,
+                                    bool *inserted)
+{
+    if (cu_unlikely(!tree || tree->persistent))
+        return NULL;
+
+    CUAVLTreeNode *node = _cu_avl_tree_find_node_build_path(tree, key);
+    if (inserted)
+        *inserted = (node == NULL);
+    if (node == NULL)
+        node = _cu_avl_tree_insert_node(tree, key, key, NULL);
+    return tree->key_only ? NULL : &node->value;
+}
+
+void cu_avl_tree_set_finger_search(CUAVLTree *tree, bool enable)
+{
+    if (cu_unlikely(!tree))
+        return;
+    tree->finger_search = enable ? 1 : 0;
+}
+
+/** @internal
+ *  @brief Insert a new node below the node on top of the stack and rebalance the tree.
+ *  @details The path to the position of @a key has to be built by _cu_avl_tree_find_node_build_path(),
+ *           and @a key must not be in the tree.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the new node.
+ *  @param[in] end The end of the interval, if @a tree is an interval tree.
+ *  @param[in] value The value of the new node.
+ *  @return The new node.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_insert_node(CUAVLTree *tree, void *key, void *end, void *value)
+{
+    CUAVLTreeNode *X, *Z, *N, *R, *node;
+
     /* The key was not found in the tree. The head of the stack contains the predecessor of the new node. */
-    Z = _cu_avl_tree_alloc(tree->node_mem);
-    memset(Z, 0, sizeof(CUAVLTreeNode));
+    node = Z = _cu_avl_tree_alloc(tree);
+    memset(Z, 0, _cu_avl_tree_node_size(tree));
     Z->key = key;
-    Z->value = value;
+    if (!tree->key_only)
+        Z->value = value;
+    if (tree->interval)
+        ((CUAVLTreeIntervalNode *)Z)->end = ((CUAVLTreeIntervalNode *)Z)->max_end = end;
 
     X = cu_fixed_pointer_stack_peek(&tree->node_stack);
     if (X != NULL) {
         if (tree->compare(key, X->key, tree->compare_data) > 0) {
             /* key < X->key, insert to the left. */
-            X->llink = Z;
+            _cu_avl_tree_node_set_left(X, Z);
         }
         else {
-            X->rlink = Z;
+            _cu_avl_tree_node_set_right(X, Z);
         }
+        /* All nodes on the path now contain the new interval. Rotations keep that set. */
+        if (tree->interval)
+            _cu_avl_tree_interval_update_path(tree);
     }
     else {
         /* There is no node in this tree, i.e., it was empty. Set Z as the new root, increase the height and return. */
         tree->root = Z;
         ++tree->height;
-        return;
+        return node;
     }
 
     /* Find deepest imbalanced node and correct balance on the path from the new node to this one. */
-    while (X != NULL && X->balance == BALANCE_BALANCED) {
-        if (X->rlink == Z) {
-            X->balance = BALANCE_LEAN_RIGHT;
+    while (X != NULL && _cu_avl_tree_node_get_balance(X) == BALANCE_BALANCED) {
+        if (_cu_avl_tree_node_get_right(X) == Z) {
+            _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_RIGHT);
         }
         else {
-            X->balance = BALANCE_LEAN_LEFT;
+            _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_LEFT);
         }
 
         Z = cu_fixed_pointer_stack_pop(&tree->node_stack);
@@ -443,56 +892,62 @@ void cu_avl_tree_insert(CUAVLTree *tree,
     /* X is now the (former) deepest imbalanced node, on top of the stack. If X is zero, the height has been increased. */
     if (X == NULL) {
         ++tree->height;
-        return;
+        return node;
     }
 
     /* From here on, the balance of X is either LEFT or RIGHT. Otherwise, we would have continued the former loop
      * up to the point that X == NULL.
      */
-    if ((X->rlink == Z && X->balance == BALANCE_LEAN_LEFT) ||
-        (X->llink == Z && X->balance == BALANCE_LEAN_RIGHT)) {
+    if ((_cu_avl_tree_node_get_right(X) == Z && _cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_LEFT) ||
+        (_cu_avl_tree_node_get_left(X) == Z && _cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_RIGHT)) {
         /* This node has one leaf as a child on the opposite side of Z. Thus, this
          * node is now fully balanced, and there is nothing more to do.
          */
-        X->balance = BALANCE_BALANCED;
-        return;
+        _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
+        return node;
     }
 
     /* The imbalance has become too large, we have to apply rotations. However, the subtrees are
      * the same size as they were before the insertion. So the overall height does not change.
      */
-    if (X->rlink == Z && X->balance == BALANCE_LEAN_RIGHT) {
-        if (Z->balance == BALANCE_LEAN_LEFT)
+    if (_cu_avl_tree_node_get_right(X) == Z && _cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_RIGHT) {
+        if (_cu_avl_tree_node_get_balance(Z) == BALANCE_LEAN_LEFT)
             N = _cu_avl_tree_rotate_right_left(X, Z);
         else
             N = _cu_avl_tree_rotate_left(X, Z);
     }
     else {
-        if (Z->balance == BALANCE_LEAN_RIGHT)
+        if (_cu_avl_tree_node_get_balance(Z) == BALANCE_LEAN_RIGHT)
             N = _cu_avl_tree_rotate_left_right(X, Z);
         else
             N = _cu_avl_tree_rotate_right(X, Z);
     }
+    if (tree->interval)
+        _cu_avl_tree_interval_update_rotated(tree, N);
 
     cu_fixed_pointer_stack_pop(&tree->node_stack);
     R = cu_fixed_pointer_stack_peek(&tree->node_stack);
     if (R != NULL) {
         /* Place N instead of X on X’s parent node R. */
-        if (R->rlink == X)
-            R->rlink = N;
+        if (_cu_avl_tree_node_get_right(R) == X)
+            _cu_avl_tree_node_set_right(R, N);
         else
-            R->llink = N;
+            _cu_avl_tree_node_set_left(R, N);
     }
     else {
         /* N has become the new root of the whole tree. */
         tree->root = N;
     }
+
+    return node;
 }
 
 bool cu_avl_tree_remove(CUAVLTree *tree, void *key)
 {
     if (cu_unlikely(!tree))
         return false;
+    if (tree->persistent)
+        return _cu_avl_tree_persistent_remove(tree, key);
 
     CUAVLTreeNode *N, *X, *Z;
     /* Find the node containing the key and build the path to it. */
@@ -510,15 +965,18 @@ bool cu_avl_tree_remove(CUAVLTree *tree, void *key)
      *  2 -> Get predecessor or successor and build path to it. Move this node’s key/value to N’s key/value.
      *       This one becomes the new N. Now only 0 and 1 are possible.
      */
-    if (N->llink && N->rlink) {
+    if (_cu_avl_tree_node_get_left(N) && _cu_avl_tree_node_get_right(N)) {
         /* We have two children. */
         X = N;
-        if (N->balance == BALANCE_LEAN_LEFT)
+        if (_cu_avl_tree_node_get_balance(N) == BALANCE_LEAN_LEFT)
             N = _cu_avl_tree_build_path_to_predecessor(tree, X);
         else
             N = _cu_avl_tree_build_path_to_successor(tree, X);
         X->key = N->key;
-        X->value = N->value;
+        if (!tree->key_only)
+            X->value = N->value;
+        if (tree->interval)
+            ((CUAVLTreeIntervalNode *)X)->end = ((CUAVLTreeIntervalNode *)N)->end;
     }
     /* N is a leaf or a half-leaf and on top of the stack. X its parent. */
     N = cu_fixed_pointer_stack_pop(&tree->node_stack);
@@ -526,46 +984,50 @@ bool cu_avl_tree_remove(CUAVLTree *tree, void *key)
 
     /* In the following, X, the parent of N, will always be on top of the stack. */
     /* N has at most one child Z. Find it. It will become the new child of X in N’s position. */
-    if (N->llink)
-        Z = N->llink;
+    if (_cu_avl_tree_node_get_left(N))
+        Z = _cu_avl_tree_node_get_left(N);
     else
-        Z = N->rlink;
+        Z = _cu_avl_tree_node_get_right(N);
     if (X) {
-        if (X->llink == N)
-            X->llink = Z;
+        if (_cu_avl_tree_node_get_left(X) == N)
+            _cu_avl_tree_node_set_left(X, Z);
         else
-            X->rlink = Z;
+            _cu_avl_tree_node_set_right(X, Z);
     }
     else {
         /* If N was the root of the root of the tree. */
         tree->root = Z;
     }
     /* Free the resources of node N. */
-    _cu_avl_tree_free(tree->node_mem, N);
+    _cu_avl_tree_free(tree, N);
     N = Z;
 
+    /* The interval is gone from all nodes on the path. Rotations keep that set. */
+    if (tree->interval)
+        _cu_avl_tree_interval_update_path(tree);
+
     uint8_t balance;
     while ((X = cu_fixed_pointer_stack_pop(&tree->node_stack)) != NULL) {
-        if (X->balance == BALANCE_BALANCED) {
+        if (_cu_avl_tree_node_get_balance(X) == BALANCE_BALANCED) {
             /* The subtree with root X has been balanced. The subtree with root N has reduced
              * its height, thus making the tree under X leaning left or right, but still in limits.
              * Everything upwards remains unchanged.
              */
-            if (X->llink == N)
-                X->balance = BALANCE_LEAN_RIGHT;
+            if (_cu_avl_tree_node_get_left(X) == N)
+                _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_RIGHT);
             else
-                X->balance = BALANCE_LEAN_LEFT;
+                _cu_avl_tree_node_set_balance(X, BALANCE_LEAN_LEFT);
 
             /* The total height of the tree remains unchanged. */
             return true;
         }
-        if ((X->llink == N && X->balance == BALANCE_LEAN_LEFT) ||
-            (X->rlink == N && X->balance == BALANCE_LEAN_RIGHT)) {
+        if ((_cu_avl_tree_node_get_left(X) == N && _cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_LEFT) ||
+            (_cu_avl_tree_node_get_right(X) == N && _cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_RIGHT)) {
             /* The tree under N has a smaller height. If N was the child the node X was leaning to,
              * the node X is now balanced but its height also is smaller. We have to continue with
              * X’s parent.
              */
-            X->balance = BALANCE_BALANCED;
+            _cu_avl_tree_node_set_balance(X, BALANCE_BALANCED);
             N = X;
         }
         else {
@@ -573,29 +1035,31 @@ bool cu_avl_tree_remove(CUAVLTree *tree, void *key)
              * X was leaning to. We have to apply rotations. Z is the other sibling, to which side X is leaning to.
              * If Z was balanced before, we are done.
              */
-            if (X->balance == BALANCE_LEAN_LEFT) {
-                Z = X->llink;
-                balance = Z->balance;
+            if (_cu_avl_tree_node_get_balance(X) == BALANCE_LEAN_LEFT) {
+                Z = _cu_avl_tree_node_get_left(X);
+                balance = _cu_avl_tree_node_get_balance(Z);
                 if (balance == BALANCE_LEAN_RIGHT)
                     N = _cu_avl_tree_rotate_left_right(X, Z);
                 else
                     N = _cu_avl_tree_rotate_right(X, Z);
             }
             else {
-                Z = X->rlink;
-                balance = Z->balance;
+                Z = _cu_avl_tree_node_get_right(X);
+                balance = _cu_avl_tree_node_get_balance(Z);
                 if (balance == BALANCE_LEAN_LEFT)
                     N = _cu_avl_tree_rotate_right_left(X, Z);
                 else
                     N = _cu_avl_tree_rotate_left(X, Z);
             }
+            if (tree->interval)
+                _cu_avl_tree_interval_update_rotated(tree, N);
             /* Z is now used as the parent of X, N is the new root in this rotated tree. */
             Z = cu_fixed_pointer_stack_peek(&tree->node_stack);
             if (Z) {
-                if (Z->llink == X)
-                    Z->llink = N;
+                if (_cu_avl_tree_node_get_left(Z) == X)
+                    _cu_avl_tree_node_set_left(Z, N);
                 else
-                    Z->rlink = N;
+                    _cu_avl_tree_node_set_right(Z, N);
             }
             else {
                 /* The loop will terminate in the next iteration. The total height was reduced by one,
@@ -624,7 +1088,7 @@ bool cu_avl_tree_find(CUAVLTree *tree,
     CUAVLTreeNode *node = _cu_avl_tree_find_node_build_path(tree, key);
     if (node) {
         if (data)
-            *data = node->value;
+            *data = _cu_avl_tree_node_get_value(tree, node);
         return true;
     }
     return false;
@@ -644,7 +1108,7 @@ void cu_avl_tree_foreach(CUAVLTree *tree,
     while (1) {
         while (node) {
             cu_fixed_pointer_stack_push(&tree->node_stack, node);
-            node = node->llink;
+            node = _cu_avl_tree_node_get_left(node);
         }
 
         if (!tree->node_stack.length)
@@ -652,15 +1116,1453 @@ void cu_avl_tree_foreach(CUAVLTree *tree,
 
         node = (CUAVLTreeNode *)cu_fixed_pointer_stack_pop(&tree->node_stack);
 #ifdef DEBUG_BTREE_DOT
-        fprintf(stdout, "n%p [label=\"%p, bal: %u\"];\n", node, node->key, node->balance);
-        if (node->llink)
-            fprintf(stdout, "n%p -> n%p [label=\"L\"];\n", node, node->llink);
-        if (node->rlink)
-            fprintf(stdout, "n%p -> n%p [label=\"R\"];\n", node, node->rlink);
+        fprintf(stdout, "n%p [label=\"%p, bal: %u\"];\n", node, node->key, _cu_avl_tree_node_get_balance(node));
+        if (_cu_avl_tree_node_get_left(node))
+            fprintf(stdout, "n%p -> n%p [label=\"L\"];\n", node, _cu_avl_tree_node_get_left(node));
+        if (_cu_avl_tree_node_get_right(node))
+            fprintf(stdout, "n%p -> n%p [label=\"R\"];\n", node, _cu_avl_tree_node_get_right(node));
 #endif
-        if (!traverse(node->key, node->value, userdata))
+        if (!traverse(node->key, _cu_avl_tree_node_get_value(tree, node), userdata))
             break;
 
-        node = node->rlink;
+        node = _cu_avl_tree_node_get_right(node);
+    }
+
+    _cu_avl_tree_forget_path(tree);
+}
+
+/** @internal
+ *  @brief Get the height of the left subtree of a node.
+ *  @param[in] node The node.
+ *  @param[in] height The height of the subtree with root @a node.
+ *  @return The height of the left subtree.
+ */
+static inline
+uint32_t _cu_avl_tree_left_height(CUAVLTreeNode *node, uint32_t height)
+{
+    return _cu_avl_tree_node_get_balance(node) == BALANCE_LEAN_RIGHT ? height - 2 : height - 1;
+}
+
+/** @internal
+ *  @brief Get the height of the right subtree of a node.
+ *  @param[in] node The node.
+ *  @param[in] height The height of the subtree with root @a node.
+ *  @return The height of the right subtree.
+ */
+static inline
+uint32_t _cu_avl_tree_right_height(CUAVLTreeNode *node, uint32_t height)
+{
+    return _cu_avl_tree_node_get_balance(node) == BALANCE_LEAN_LEFT ? height - 2 : height - 1;
+}
+
+/** @internal
+ *  @brief Set both children of a node and derive its balance from their heights.
+ *  @details The heights of @a left and @a right may differ by at most one.
+ *  @param[in] node The node.
+ *  @param[in] left The new left child.
+ *  @param[in] hl The height of @a left.
+ *  @param[in] right The new right child.
+ *  @param[in] hr The height of @a right.
+ *  @return The height of the subtree with root @a node.
+ */
+static inline
+uint32_t _cu_avl_tree_node_set_children(CUAVLTreeNode *node,
+                                        CUAVLTreeNode *left, uint32_t hl,
+                                        CUAVLTreeNode *right, uint32_t hr)
+{
+    _cu_avl_tree_node_set_left(node, left);
+    _cu_avl_tree_node_set_right(node, right);
+    if (hl > hr) {
+        _cu_avl_tree_node_set_balance(node, BALANCE_LEAN_LEFT);
+        return hl + 1;
     }
+    if (hl < hr) {
+        _cu_avl_tree_node_set_balance(node, BALANCE_LEAN_RIGHT);
+        return hr + 1;
+    }
+    _cu_avl_tree_node_set_balance(node, BALANCE_BALANCED);
+    return hl + 1;
+}
+
+/** @internal
+ *  @brief Make a node the root of two subtrees whose heights differ by at most two.
+ *  @details Apply a single or double rotation if necessary. Unlike the rotations used for
+ *           insertion and deletion, the balances are derived from the heights of the subtrees,
+ *           so this works for every possible configuration.
+ *  @param[in] X The node to become the root.
+ *  @param[in] left The new left subtree of @a X.
+ *  @param[in] hl The height of @a left.
+ *  @param[in] right The new right subtree of @a X.
+ *  @param[in] hr The height of @a right.
+ *  @param[out] height The height of the resulting subtree.
+ *  @return The new root of the subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_rebalance(CUAVLTreeNode *X,
+                                      CUAVLTreeNode *left, uint32_t hl,
+                                      CUAVLTreeNode *right, uint32_t hr,
+                                      uint32_t *height)
+{
+    CUAVLTreeNode *Z, *Y, *Y1, *Y2;
+    uint32_t hz1, hz2, hy1, hy2, h1, h2;
+
+    if (hr > hl + 1) {
+        Z = right;
+        hz1 = _cu_avl_tree_left_height(Z, hr);
+        hz2 = _cu_avl_tree_right_height(Z, hr);
+        if (hz1 > hz2) {
+            /* Rotate right around Z, then left around X. */
+            Y = _cu_avl_tree_node_get_left(Z);
+            hy1 = _cu_avl_tree_left_height(Y, hz1);
+            hy2 = _cu_avl_tree_right_height(Y, hz1);
+            Y1 = _cu_avl_tree_node_get_left(Y);
+            Y2 = _cu_avl_tree_node_get_right(Y);
+            h1 = _cu_avl_tree_node_set_children(X, left, hl, Y1, hy1);
+            h2 = _cu_avl_tree_node_set_children(Z, Y2, hy2, _cu_avl_tree_node_get_right(Z), hz2);
+            *height = _cu_avl_tree_node_set_children(Y, X, h1, Z, h2);
+            return Y;
+        }
+        h1 = _cu_avl_tree_node_set_children(X, left, hl, _cu_avl_tree_node_get_left(Z), hz1);
+        *height = _cu_avl_tree_node_set_children(Z, X, h1, _cu_avl_tree_node_get_right(Z), hz2);
+        return Z;
+    }
+
+    if (hl > hr + 1) {
+        Z = left;
+        hz1 = _cu_avl_tree_left_height(Z, hl);
+        hz2 = _cu_avl_tree_right_height(Z, hl);
+        if (hz2 > hz1) {
+            /* Rotate left around Z, then right around X. */
+            Y = _cu_avl_tree_node_get_right(Z);
+            hy1 = _cu_avl_tree_left_height(Y, hz2);
+            hy2 = _cu_avl_tree_right_height(Y, hz2);
+            Y1 = _cu_avl_tree_node_get_left(Y);
+            Y2 = _cu_avl_tree_node_get_right(Y);
+            h1 = _cu_avl_tree_node_set_children(Z, _cu_avl_tree_node_get_left(Z), hz1, Y1, hy1);
+            h2 = _cu_avl_tree_node_set_children(X, Y2, hy2, right, hr);
+            *height = _cu_avl_tree_node_set_children(Y, Z, h1, X, h2);
+            return Y;
+        }
+        h2 = _cu_avl_tree_node_set_children(X, _cu_avl_tree_node_get_right(Z), hz2, right, hr);
+        *height = _cu_avl_tree_node_set_children(Z, _cu_avl_tree_node_get_left(Z), hz1, X, h2);
+        return Z;
+    }
+
+    *height = _cu_avl_tree_node_set_children(X, left, hl, right, hr);
+    return X;
+}
+
+/** @internal
+ *  @brief Join two subtrees and a middle node, where all keys in @a left are smaller than
+ *         the key of @a K, and all keys in @a right are larger.
+ *  @details Walk down the spine of the higher tree until the heights match. This takes
+ *           O(|hl - hr| + 1) time.
+ *  @param[in] left The left subtree.
+ *  @param[in] hl The height of @a left.
+ *  @param[in] K The middle node.
+ *  @param[in] right The right subtree.
+ *  @param[in] hr The height of @a right.
+ *  @param[out] height The height of the joined tree.
+ *  @return The root of the joined tree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_join_nodes(CUAVLTreeNode *left, uint32_t hl,
+                                       CUAVLTreeNode *K,
+                                       CUAVLTreeNode *right, uint32_t hr,
+                                       uint32_t *height)
+{
+    CUAVLTreeNode *C;
+    uint32_t hc;
+
+    if (hl > hr + 1) {
+        C = _cu_avl_tree_join_nodes(_cu_avl_tree_node_get_right(left), _cu_avl_tree_right_height(left, hl), K, right, hr, &hc);
+        return _cu_avl_tree_rebalance(left, _cu_avl_tree_node_get_left(left), _cu_avl_tree_left_height(left, hl), C, hc, height);
+    }
+    if (hr > hl + 1) {
+        C = _cu_avl_tree_join_nodes(left, hl, K, _cu_avl_tree_node_get_left(right), _cu_avl_tree_left_height(right, hr), &hc);
+        return _cu_avl_tree_rebalance(right, C, hc, _cu_avl_tree_node_get_right(right), _cu_avl_tree_right_height(right, hr), height);
+    }
+
+    *height = _cu_avl_tree_node_set_children(K, left, hl, right, hr);
+    return K;
+}
+
+/** @internal
+ *  @brief Detach the node with the largest key from a subtree.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] height The height of the subtree.
+ *  @param[out] last Receives the detached node.
+ *  @param[out] new_height The height of the remaining subtree.
+ *  @return The root of the remaining subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_detach_last(CUAVLTreeNode *node, uint32_t height,
+                                        CUAVLTreeNode **last, uint32_t *new_height)
+{
+    if (!_cu_avl_tree_node_get_right(node)) {
+        *last = node;
+        *new_height = height - 1;
+        return _cu_avl_tree_node_get_left(node);
+    }
+    uint32_t hc;
+    CUAVLTreeNode *C = _cu_avl_tree_detach_last(_cu_avl_tree_node_get_right(node), _cu_avl_tree_right_height(node, height), last, &hc);
+    return _cu_avl_tree_rebalance(node, _cu_avl_tree_node_get_left(node), _cu_avl_tree_left_height(node, height), C, hc, new_height);
+}
+
+/** @internal
+ *  @brief Join two subtrees, where all keys in @a left are smaller than those in @a right.
+ *  @param[in] left The left subtree.
+ *  @param[in] hl The height of @a left.
+ *  @param[in] right The right subtree.
+ *  @param[in] hr The height of @a right.
+ *  @param[out] height The height of the joined tree.
+ *  @return The root of the joined tree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_join_subtrees(CUAVLTreeNode *left, uint32_t hl,
+                                          CUAVLTreeNode *right, uint32_t hr,
+                                          uint32_t *height)
+{
+    if (!left) {
+        *height = hr;
+        return right;
+    }
+    CUAVLTreeNode *K;
+    left = _cu_avl_tree_detach_last(left, hl, &K, &hl);
+    return _cu_avl_tree_join_nodes(left, hl, K, right, hr, height);
+}
+
+/** @internal
+ *  @brief Split a subtree into the nodes with keys smaller than @a key and all others.
+ *  @param[in] tree The tree providing the compare function.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] height The height of the subtree.
+ *  @param[in] key The key at which to split.
+ *  @param[out] left Receives the root of the smaller part.
+ *  @param[out] hl Receives the height of @a left.
+ *  @param[out] right Receives the root of the larger part.
+ *  @param[out] hr Receives the height of @a right.
+ */
+static
+void _cu_avl_tree_split_nodes(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height, void *key,
+                              CUAVLTreeNode **left, uint32_t *hl,
+                              CUAVLTreeNode **right, uint32_t *hr)
+{
+    if (!node) {
+        *left = *right = NULL;
+        *hl = *hr = 0;
+        return;
+    }
+
+    CUAVLTreeNode *L = _cu_avl_tree_node_get_left(node), *R = _cu_avl_tree_node_get_right(node), *T;
+    uint32_t hL = _cu_avl_tree_left_height(node, height);
+    uint32_t hR = _cu_avl_tree_right_height(node, height);
+    uint32_t hT;
+    int rc = tree->compare(key, node->key, tree->compare_data);
+
+    if (rc > 0) { /* key < node->key, the node belongs to the right part. */
+        _cu_avl_tree_split_nodes(tree, L, hL, key, left, hl, &T, &hT);
+        *right = _cu_avl_tree_join_nodes(T, hT, node, R, hR, hr);
+    }
+    else if (rc < 0) { /* key > node->key, the node belongs to the left part. */
+        _cu_avl_tree_split_nodes(tree, R, hR, key, &T, &hT, right, hr);
+        *left = _cu_avl_tree_join_nodes(L, hL, node, T, hT, hl);
+    }
+    else {
+        *left = L;
+        *hl = hL;
+        *right = _cu_avl_tree_join_nodes(NULL, 0, node, R, hR, hr);
+    }
+}
+
+/** @internal
+ *  @brief Store the nodes of a subtree in order in an array.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] nodes The array.
+ *  @param[in] length The number of nodes already in the array.
+ *  @return The number of nodes in the array after adding the subtree.
+ */
+static
+size_t _cu_avl_tree_collect_nodes(CUAVLTreeNode *node, CUAVLTreeNode **nodes, size_t length)
+{
+    while (node) {
+        length = _cu_avl_tree_collect_nodes(_cu_avl_tree_node_get_left(node), nodes, length);
+        nodes[length++] = node;
+        node = _cu_avl_tree_node_get_right(node);
+    }
+    return length;
+}
+
+/** @internal
+ *  @brief Count the nodes of a subtree.
+ *  @param[in] node The root of the subtree.
+ *  @return The number of nodes.
+ */
+static
+size_t _cu_avl_tree_count_nodes(CUAVLTreeNode *node)
+{
+    size_t count = 0;
+    while (node) {
+        count += 1 + _cu_avl_tree_count_nodes(_cu_avl_tree_node_get_left(node));
+        node = _cu_avl_tree_node_get_right(node);
+    }
+    return count;
+}
+
+/** @internal
+ *  @brief Build a perfectly balanced subtree from a sorted array of nodes.
+ *  @param[in] nodes The nodes, sorted by their keys.
+ *  @param[in] length The number of nodes.
+ *  @param[out] height Receives the height of the subtree.
+ *  @return The root of the subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_build_from_nodes(CUAVLTreeNode **nodes, size_t length, uint32_t *height)
+{
+    if (length == 0) {
+        *height = 0;
+        return NULL;
+    }
+    size_t middle = length / 2;
+    uint32_t hl, hr;
+    CUAVLTreeNode *left = _cu_avl_tree_build_from_nodes(nodes, middle, &hl);
+    CUAVLTreeNode *right = _cu_avl_tree_build_from_nodes(nodes + middle + 1, length - middle - 1, &hr);
+    *height = _cu_avl_tree_node_set_children(nodes[middle], left, hl, right, hr);
+    return nodes[middle];
+}
+
+/** @internal
+ *  @brief Create an empty tree sharing callbacks and node memory with another tree.
+ *  @details The new tree can free all nodes of @a tree, so nodes can be moved to it.
+ *  @param[in] tree The original tree.
+ *  @return The new tree.
+ */
+static
+CUAVLTree *_cu_avl_tree_new_sibling(CUAVLTree *tree)
+{
+    CUAVLTree *sibling = cu_alloc0(sizeof(CUAVLTree));
+    sibling->node_mem = cu_fixed_size_memory_pool_ref(tree->node_mem);
+    sibling->compare = tree->compare;
+    sibling->compare_data = tree->compare_data;
+    sibling->destroy_key = tree->destroy_key;
+    sibling->destroy_value = tree->destroy_value;
+    sibling->finger_search = tree->finger_search;
+    sibling->key_only = tree->key_only;
+    _cu_avl_tree_add_foreign_of(sibling, tree);
+    return sibling;
+}
+
+void cu_avl_tree_split(CUAVLTree *tree, void *key, CUAVLTree **left, CUAVLTree **right)
+{
+    if (left)
+        *left = NULL;
+    if (right)
+        *right = NULL;
+    if (cu_unlikely(!tree || tree->persistent || tree->interval))
+        return;
+
+    CUAVLTree *L = _cu_avl_tree_new_sibling(tree);
+    CUAVLTree *R = _cu_avl_tree_new_sibling(tree);
+
+    _cu_avl_tree_split_nodes(tree, tree->root, tree->height, key, &L->root, &L->height, &R->root, &R->height);
+
+    tree->root = NULL;
+    tree->height = 0;
+    _cu_avl_tree_forget_path(tree);
+    _cu_avl_tree_release_foreign(tree);
+
+    if (left)
+        *left = L;
+    else
+        cu_avl_tree_destroy(L);
+    if (right)
+        *right = R;
+    else
+        cu_avl_tree_destroy(R);
+}
+
+bool cu_avl_tree_join(CUAVLTree *a, CUAVLTree *b)
+{
+    if (cu_unlikely(!a || !b || a == b || a->persistent || b->persistent || a->interval || b->interval ||
+                    a->key_only != b->key_only))
+        return false;
+    if (!b->root)
+        return true;
+
+    if (a->root) {
+        /* All keys of a have to be smaller than those in b. */
+        CUAVLTreeNode *last = a->root, *first = b->root;
+        while (_cu_avl_tree_node_get_right(last))
+            last = _cu_avl_tree_node_get_right(last);
+        while (_cu_avl_tree_node_get_left(first))
+            first = _cu_avl_tree_node_get_left(first);
+        if (a->compare(last->key, first->key, a->compare_data) <= 0)
+            return false;
+    }
+
+    /* The nodes of b stay where they are, a only learns how to free them. */
+    _cu_avl_tree_add_foreign_of(a, b);
+    a->root = _cu_avl_tree_join_subtrees(a->root, a->height, b->root, b->height, &a->height);
+    _cu_avl_tree_forget_path(a);
+
+    b->root = NULL;
+    b->height = 0;
+    _cu_avl_tree_forget_path(b);
+    _cu_avl_tree_release_foreign(b);
+
+    return true;
+}
+
+void cu_avl_tree_merge(CUAVLTree *a, CUAVLTree *b)
+{
+    if (cu_unlikely(!a || !b || a == b || !b->root || a->persistent || b->persistent ||
+                    a->interval || b->interval || a->key_only != b->key_only))
+        return;
+
+    size_t na = _cu_avl_tree_count_nodes(a->root);
+    size_t nb = _cu_avl_tree_count_nodes(b->root);
+    CUAVLTreeNode **nodes = cu_alloc((2 * na + nb) * sizeof(CUAVLTreeNode *));
+    CUAVLTreeNode **na_nodes = nodes + na + nb;
+    CUAVLTreeNode **nb_nodes = nodes + na;
+    size_t ja = 0, jb = 0, length = 0;
+    int rc;
+
+    _cu_avl_tree_add_foreign_of(a, b);
+
+    /* Collect both trees in order. The nodes of b are stored at the end of the merged
+     * range, so we can merge in place from the front. */
+    _cu_avl_tree_collect_nodes(a->root, na_nodes, 0);
+    _cu_avl_tree_collect_nodes(b->root, nb_nodes, 0);
+
+    while (ja < na && jb < nb) {
+        rc = a->compare(na_nodes[ja]->key, nb_nodes[jb]->key, a->compare_data);
+        if (rc > 0) {
+            nodes[length++] = na_nodes[ja++];
+        }
+        else if (rc < 0) {
+            nodes[length++] = nb_nodes[jb++];
+        }
+        else {
+            /* Same semantics as inserting the element of b into a. */
+            if (a->destroy_key && na_nodes[ja]->key != nb_nodes[jb]->key)
+                a->destroy_key(nb_nodes[jb]->key);
+            if (a->destroy_value && na_nodes[ja]->value != nb_nodes[jb]->value)
+                a->destroy_value(na_nodes[ja]->value);
+            if (!a->key_only)
+                na_nodes[ja]->value = nb_nodes[jb]->value;
+            _cu_avl_tree_free(b, nb_nodes[jb++]);
+            nodes[length++] = na_nodes[ja++];
+        }
+    }
+    while (ja < na)
+        nodes[length++] = na_nodes[ja++];
+    while (jb < nb)
+        nodes[length++] = nb_nodes[jb++];
+
+    a->root = _cu_avl_tree_build_from_nodes(nodes, length, &a->height);
+    _cu_avl_tree_forget_path(a);
+    cu_free(nodes);
+
+    b->root = NULL;
+    b->height = 0;
+    _cu_avl_tree_forget_path(b);
+    _cu_avl_tree_release_foreign(b);
+}
+
+/****************************
+ *  Interval queries.
+ ****************************/
+
+/** @internal
+ *  @brief Report all intervals in a subtree that overlap a range.
+ *  @details Subtrees whose largest end is not beyond @a from are skipped, as are right subtrees
+ *           of nodes starting after @a to.
+ *  @param[in] tree The interval tree.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] from The start of the range.
+ *  @param[in] to The end of the range.
+ *  @param[in] include_to Whether intervals starting at @a to overlap.
+ *  @param[in] traverse Function to call for each interval.
+ *  @param[in] userdata Pointer passed as third argument to @a traverse.
+ *  @retval true Continue.
+ *  @retval false The traversal was cancelled.
+ */
+static
+bool _cu_avl_tree_interval_foreach(CUAVLTree *tree, CUAVLTreeNode *node,
+                                   void *from, void *to, bool include_to,
+                                   CUTraverseFunc traverse, void *userdata)
+{
+    CUAVLTreeIntervalNode *inode;
+    int rc;
+
+    while (node) {
+        inode = (CUAVLTreeIntervalNode *)node;
+        /* max_end <= from: nothing in this subtree reaches the range. */
+        if (tree->compare(from, inode->max_end, tree->compare_data) <= 0)
+            return true;
+        if (!_cu_avl_tree_interval_foreach(tree, _cu_avl_tree_node_get_left(node), from, to, include_to,
+                                           traverse, userdata))
+            return false;
+        rc = tree->compare(node->key, to, tree->compare_data);
+        if (rc < 0 || (rc == 0 && !include_to))
+            return true;
+        if (tree->compare(from, inode->end, tree->compare_data) > 0 &&
+                !traverse(node->key, node->value, userdata))
+            return false;
+        node = _cu_avl_tree_node_get_right(node);
+    }
+    return true;
+}
+
+bool cu_avl_tree_find_stabbing(CUAVLTree *tree,
+                               void *point,
+                               void **start,
+                               void **data)
+{
+    if (cu_unlikely(!tree || !tree->interval))
+        return false;
+
+    CUAVLTreeNode *node = tree->root;
+    CUAVLTreeIntervalNode *left;
+
+    while (node) {
+        if (tree->compare(point, node->key, tree->compare_data) > 0) {
+            /* point < start, so only the left subtree may contain it. */
+            node = _cu_avl_tree_node_get_left(node);
+            continue;
+        }
+        /* All intervals on the left start before the point, it is contained in one of them,
+         * if one reaches beyond the point. Prefer them, they start first. */
+        left = (CUAVLTreeIntervalNode *)_cu_avl_tree_node_get_left(node);
+        if (left && tree->compare(point, left->max_end, tree->compare_data) > 0) {
+            node = &left->node;
+            continue;
+        }
+        if (tree->compare(point, ((CUAVLTreeIntervalNode *)node)->end, tree->compare_data) > 0) {
+            if (start)
+                *start = node->key;
+            if (data)
+                *data = node->value;
+            return true;
+        }
+        node = _cu_avl_tree_node_get_right(node);
+    }
+    return false;
+}
+
+void cu_avl_tree_foreach_stabbing(CUAVLTree *tree,
+                                  void *point,
+                                  CUTraverseFunc traverse,
+                                  void *userdata)
+{
+    if (cu_unlikely(!tree || !tree->interval || !traverse))
+        return;
+    _cu_avl_tree_interval_foreach(tree, tree->root, point, point, true, traverse, userdata);
+}
+
+void cu_avl_tree_foreach_overlapping(CUAVLTree *tree,
+                                     void *from,
+                                     void *to,
+                                     CUTraverseFunc traverse,
+                                     void *userdata)
+{
+    if (cu_unlikely(!tree || !tree->interval || !traverse))
+        return;
+    _cu_avl_tree_interval_foreach(tree, tree->root, from, to, false, traverse, userdata);
+}
+
+bool cu_avl_tree_find_interval(CUAVLTree *tree,
+                               void *start,
+                               void **end,
+                               void **data)
+{
+    if (cu_unlikely(!tree || !tree->interval))
+        return false;
+    CUAVLTreeNode *node = _cu_avl_tree_find_node_build_path(tree, start);
+    if (!node)
+        return false;
+    if (end)
+        *end = ((CUAVLTreeIntervalNode *)node)->end;
+    if (data)
+        *data = node->value;
+    return true;
+}
+
+/****************************
+ *  Batch updates.
+ ****************************/
+
+/** @internal
+ *  @brief An element of a batch update.
+ */
+typedef struct {
+    void *key;
+    void *value;
+} CUAVLTreeBatchItem;
+
+/** @internal
+ *  @brief Sort a batch by key, keeping the order of equal keys.
+ *  @param[in] tree The tree providing the compare function.
+ *  @param[in,out] items The batch.
+ *  @param[in] tmp Memory for @a length elements.
+ *  @param[in] length The number of elements in @a items.
+ */
+static
+void _cu_avl_tree_batch_sort(CUAVLTree *tree, CUAVLTreeBatchItem *items, CUAVLTreeBatchItem *tmp, size_t length)
+{
+    if (length < 2)
+        return;
+
+    size_t middle = length / 2;
+    size_t a = 0, b = middle, j = 0;
+    _cu_avl_tree_batch_sort(tree, items, tmp, middle);
+    _cu_avl_tree_batch_sort(tree, items + middle, tmp, length - middle);
+
+    /* Nothing to do for already sorted batches. */
+    if (tree->compare(items[middle - 1].key, items[middle].key, tree->compare_data) >= 0)
+        return;
+
+    while (a < middle && b < length) {
+        if (tree->compare(items[a].key, items[b].key, tree->compare_data) >= 0)
+            tmp[j++] = items[a++];
+        else
+            tmp[j++] = items[b++];
+    }
+    while (a < middle)
+        tmp[j++] = items[a++];
+    /* The rest of the second half is already in place. */
+    memcpy(items, tmp, j * sizeof(CUAVLTreeBatchItem));
+}
+
+/** @internal
+ *  @brief Find the first element of a sorted batch that is not smaller than a key.
+ *  @param[in] tree The tree providing the compare function.
+ *  @param[in] items The sorted batch.
+ *  @param[in] length The number of elements in @a items.
+ *  @param[in] key The key.
+ *  @param[out] equal Receives whether the element found has the same key.
+ *  @return The index of the element, or @a length.
+ */
+static
+size_t _cu_avl_tree_batch_partition(CUAVLTree *tree, CUAVLTreeBatchItem *items, size_t length,
+                                    void *key, bool *equal)
+{
+    size_t lo = 0, hi = length, middle;
+    while (lo < hi) {
+        middle = lo + (hi - lo) / 2;
+        if (tree->compare(items[middle].key, key, tree->compare_data) > 0)
+            lo = middle + 1;
+        else
+            hi = middle;
+    }
+    *equal = lo < length && tree->compare(items[lo].key, key, tree->compare_data) == 0;
+    return lo;
+}
+
+/** @internal
+ *  @brief Build a perfectly balanced subtree with new nodes for a sorted batch.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_batch_build(CUAVLTree *tree, CUAVLTreeBatchItem *items, size_t length, uint32_t *height)
+{
+    if (length == 0) {
+        *height = 0;
+        return NULL;
+    }
+    size_t middle = length / 2;
+    uint32_t hl, hr;
+    CUAVLTreeNode *node = _cu_avl_tree_alloc(tree);
+    node->key = items[middle].key;
+    if (!tree->key_only)
+        node->value = items[middle].value;
+    CUAVLTreeNode *left = _cu_avl_tree_batch_build(tree, items, middle, &hl);
+    CUAVLTreeNode *right = _cu_avl_tree_batch_build(tree, items + middle + 1, length - middle - 1, &hr);
+    *height = _cu_avl_tree_node_set_children(node, left, hl, right, hr);
+    return node;
+}
+
+/** @internal
+ *  @brief Insert a sorted batch of unique keys into a subtree.
+ *  @details The batch is partitioned at the root and both parts are inserted into the
+ *           subtrees independently, which are joined again with the root. So every node is
+ *           compared once per level, and each subtree is rebalanced only once.
+ *  @return The root of the new subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_batch_insert_nodes(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height,
+                                               CUAVLTreeBatchItem *items, size_t length, uint32_t *new_height)
+{
+    if (length == 0) {
+        *new_height = height;
+        return node;
+    }
+    if (!node)
+        return _cu_avl_tree_batch_build(tree, items, length, new_height);
+
+    bool equal;
+    size_t split = _cu_avl_tree_batch_partition(tree, items, length, node->key, &equal);
+    if (equal) {
+        /* Same semantics as cu_avl_tree_insert(). */
+        if (tree->destroy_key && node->key != items[split].key)
+            tree->destroy_key(items[split].key);
+        if (tree->destroy_value && node->value != items[split].value)
+            tree->destroy_value(node->value);
+        if (!tree->key_only)
+            node->value = items[split].value;
+    }
+
+    uint32_t hl, hr;
+    CUAVLTreeNode *left = _cu_avl_tree_batch_insert_nodes(tree, _cu_avl_tree_node_get_left(node),
+                                                          _cu_avl_tree_left_height(node, height),
+                                                          items, split, &hl);
+    CUAVLTreeNode *right = _cu_avl_tree_batch_insert_nodes(tree, _cu_avl_tree_node_get_right(node),
+                                                           _cu_avl_tree_right_height(node, height),
+                                                           items + split + equal, length - split - equal, &hr);
+    return _cu_avl_tree_join_nodes(left, hl, node, right, hr, new_height);
+}
+
+/** @internal
+ *  @brief Remove all keys of a sorted batch from a subtree.
+ *  @return The root of the new subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_batch_remove_nodes(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height,
+                                               CUAVLTreeBatchItem *items, size_t length,
+                                               size_t *removed, uint32_t *new_height)
+{
+    if (length == 0 || !node) {
+        *new_height = height;
+        return node;
+    }
+
+    bool equal;
+    size_t split = _cu_avl_tree_batch_partition(tree, items, length, node->key, &equal);
+
+    uint32_t hl, hr;
+    CUAVLTreeNode *left = _cu_avl_tree_batch_remove_nodes(tree, _cu_avl_tree_node_get_left(node),
+                                                          _cu_avl_tree_left_height(node, height),
+                                                          items, split, removed, &hl);
+    CUAVLTreeNode *right = _cu_avl_tree_batch_remove_nodes(tree, _cu_avl_tree_node_get_right(node),
+                                                           _cu_avl_tree_right_height(node, height),
+                                                           items + split, length - split, removed, &hr);
+    if (!equal)
+        return _cu_avl_tree_join_nodes(left, hl, node, right, hr, new_height);
+
+    _cu_avl_tree_clear_node(node->key, _cu_avl_tree_node_get_value(tree, node), tree);
+    _cu_avl_tree_free(tree, node);
+    ++*removed;
+    return _cu_avl_tree_join_subtrees(left, hl, right, hr, new_height);
+}
+
+void cu_avl_tree_insert_batch(CUAVLTree *tree,
+                              void **keys,
+                              void **values,
+                              size_t length)
+{
+    if (cu_unlikely(!tree || !keys || !length))
+        return;
+
+    size_t j, unique;
+    if (tree->persistent || tree->interval) {
+        for (j = 0; j < length; ++j)
+            cu_avl_tree_insert(tree, keys[j], values ? values[j] : NULL);
+        return;
+    }
+
+    CUAVLTreeBatchItem *items = cu_alloc(2 * length * sizeof(CUAVLTreeBatchItem));
+    for (j = 0; j < length; ++j) {
+        items[j].key = keys[j];
+        items[j].value = values ? values[j] : NULL;
+    }
+    _cu_avl_tree_batch_sort(tree, items, items + length, length);
+
+    /* Equal keys within the batch behave as if inserted one after another. */
+    for (j = 1, unique = 0; j < length; ++j) {
+        if (tree->compare(items[unique].key, items[j].key, tree->compare_data) == 0) {
+            if (tree->destroy_key && items[unique].key != items[j].key)
+                tree->destroy_key(items[j].key);
+            if (tree->destroy_value && items[unique].value != items[j].value)
+                tree->destroy_value(items[unique].value);
+            items[unique].value = items[j].value;
+        }
+        else {
+            items[++unique] = items[j];
+        }
+    }
+
+    tree->root = _cu_avl_tree_batch_insert_nodes(tree, tree->root, tree->height, items, unique + 1, &tree->height);
+    _cu_avl_tree_forget_path(tree);
+
+    cu_free(items);
+}
+
+size_t cu_avl_tree_remove_batch(CUAVLTree *tree,
+                                void **keys,
+                                size_t length)
+{
+    if (cu_unlikely(!tree || !keys || !length))
+        return 0;
+
+    size_t j, unique, removed = 0;
+    if (tree->persistent || tree->interval) {
+        for (j = 0; j < length; ++j)
+            removed += cu_avl_tree_remove(tree, keys[j]);
+        return removed;
+    }
+
+    CUAVLTreeBatchItem *items = cu_alloc(2 * length * sizeof(CUAVLTreeBatchItem));
+    for (j = 0; j < length; ++j) {
+        items[j].key = keys[j];
+        items[j].value = NULL;
+    }
+    _cu_avl_tree_batch_sort(tree, items, items + length, length);
+    for (j = 1, unique = 0; j < length; ++j) {
+        if (tree->compare(items[unique].key, items[j].key, tree->compare_data) != 0)
+            items[++unique] = items[j];
+    }
+
+    tree->root = _cu_avl_tree_batch_remove_nodes(tree, tree->root, tree->height, items, unique + 1,
+                                                 &removed, &tree->height);
+    _cu_avl_tree_forget_path(tree);
+
+    cu_free(items);
+    return removed;
+}
+
+/****************************
+ *  Parallel traversal.
+ ****************************/
+
+/** @internal
+ *  @brief A part of the tree, processed by a single thread.
+ *  @details All elements of @a subtree come before @a node. Either may be @a NULL.
+ */
+typedef struct {
+    CUAVLTreeNode *subtree; /**< Root of a subtree, processed in order. */
+    CUAVLTreeNode *node; /**< A single node processed after the subtree. */
+    void *partial; /**< The partial result of this chunk. */
+} CUAVLTreeChunk;
+
+/** @internal
+ *  @brief State shared by all threads of a parallel traversal.
+ */
+typedef struct {
+    CUAVLTree *tree;
+    CUAVLTreeChunk *chunks; /**< The chunks in order of their keys. */
+    uint32_t chunk_count; /**< Number of chunks. */
+    uint32_t next_chunk; /**< Index of the next chunk to process. */
+    uint32_t stop; /**< Set if some callback cancelled the traversal. */
+    CUTraverseFunc traverse;
+    CUAVLTreePartialFunc new_partial;
+    void *userdata;
+} CUAVLTreeParallelJob;
+
+/** @internal
+ *  @brief Cut the top levels of a subtree into chunks.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] depth The number of levels to cut.
+ *  @param[out] chunks Array receiving the chunks in order.
+ *  @param[in] length The number of chunks already in @a chunks.
+ *  @return The number of chunks in @a chunks.
+ */
+static
+uint32_t _cu_avl_tree_parallel_collect_chunks(CUAVLTreeNode *node, uint32_t depth,
+                                              CUAVLTreeChunk *chunks, uint32_t length)
+{
+    if (!node)
+        return length;
+    if (depth == 0) {
+        chunks[length].subtree = node;
+        chunks[length].node = NULL;
+        return length + 1;
+    }
+
+    length = _cu_avl_tree_parallel_collect_chunks(_cu_avl_tree_node_get_left(node), depth - 1, chunks, length);
+    /* Attach the node to the chunk of its left subtree, if there is one. */
+    if (length && !chunks[length - 1].node) {
+        chunks[length - 1].node = node;
+    }
+    else {
+        chunks[length].subtree = NULL;
+        chunks[length].node = node;
+        ++length;
+    }
+    return _cu_avl_tree_parallel_collect_chunks(_cu_avl_tree_node_get_right(node), depth - 1, chunks, length);
+}
+
+/** @internal
+ *  @brief Process the elements of a single chunk in order.
+ *  @param[in] job The job.
+ *  @param[in] stack Memory for a path of the height of the tree.
+ *  @param[in] chunk The chunk.
+ *  @param[in] data Passed as third argument to the callback.
+ *  @retval true All elements were processed.
+ *  @retval false The traversal was cancelled.
+ */
+static
+bool _cu_avl_tree_parallel_process_chunk(CUAVLTreeParallelJob *job, CUAVLTreeNode **stack,
+                                         CUAVLTreeChunk *chunk, void *data)
+{
+    CUAVLTree *tree = job->tree;
+    CUAVLTreeNode *node = chunk->subtree;
+    uint32_t length = 0;
+
+    while (1) {
+        while (node) {
+            stack[length++] = node;
+            node = _cu_avl_tree_node_get_left(node);
+        }
+
+        if (!length)
+            break;
+
+        node = stack[--length];
+        if (__atomic_load_n(&job->stop, __ATOMIC_RELAXED) ||
+                !job->traverse(node->key, _cu_avl_tree_node_get_value(tree, node), data))
+            return false;
+
+        node = _cu_avl_tree_node_get_right(node);
+    }
+
+    if (!chunk->node)
+        return true;
+    /* Another thread may have cancelled while this chunk was processing its subtree. */
+    if (__atomic_load_n(&job->stop, __ATOMIC_RELAXED))
+        return false;
+    return job->traverse(chunk->node->key, _cu_avl_tree_node_get_value(tree, chunk->node), data);
+}
+
+/** @internal
+ *  @brief Worker of a parallel traversal, processing chunks until none are left.
+ *  @param[in] job The job.
+ *  @return Always @a NULL.
+ */
+static
+void *_cu_avl_tree_parallel_worker(CUAVLTreeParallelJob *job)
+{
+    CUAVLTreeNode **stack = cu_alloc(job->tree->height * sizeof(CUAVLTreeNode *));
+    CUAVLTreeChunk *chunk;
+    uint32_t j;
+    void *data;
+
+    while ((j = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED)) < job->chunk_count) {
+        chunk = &job->chunks[j];
+        data = job->userdata;
+        if (job->new_partial)
+            data = chunk->partial = job->new_partial(job->userdata);
+        if (__atomic_load_n(&job->stop, __ATOMIC_RELAXED))
+            continue;
+        if (!_cu_avl_tree_parallel_process_chunk(job, stack, chunk, data))
+            __atomic_store_n(&job->stop, 1, __ATOMIC_RELAXED);
+    }
+
+    cu_free(stack);
+    return NULL;
+}
+
+/** @internal
+ *  @brief Split the tree into chunks and process them on a number of threads.
+ *  @details The calling thread is one of the workers. The chunks are left in @a job.
+ *  @param[in] job The job, with all members up to @a chunks set.
+ *  @param[in] nthreads The number of threads, or 0 to use one per online processor.
+ */
+static
+void _cu_avl_tree_parallel_run(CUAVLTreeParallelJob *job, uint32_t nthreads)
+{
+    uint32_t j, depth = 2;
+    pthread_t *threads;
+
+    if (nthreads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = online > 0 ? (uint32_t)online : 1;
+    }
+
+    /* About four chunks per thread, so that threads finishing early can help out. */
+    while ((1U << depth) < 4 * nthreads && depth < 16)
+        ++depth;
+    if (depth >= job->tree->height)
+        depth = job->tree->height ? job->tree->height - 1 : 0;
+
+    job->chunks = cu_alloc0((2U << depth) * sizeof(CUAVLTreeChunk));
+    job->chunk_count = _cu_avl_tree_parallel_collect_chunks(job->tree->root, depth, job->chunks, 0);
+    job->next_chunk = 0;
+    job->stop = 0;
+
+    if (nthreads > job->chunk_count)
+        nthreads = job->chunk_count ? job->chunk_count : 1;
+
+    threads = cu_alloc(nthreads * sizeof(pthread_t));
+    for (j = 1; j < nthreads; ++j) {
+        /* If we do not get a thread, the remaining workers have more to do. */
+        if (pthread_create(&threads[j], NULL, (void *(*)(void *))_cu_avl_tree_parallel_worker, job) != 0)
+            break;
+    }
+    nthreads = j;
+
+    _cu_avl_tree_parallel_worker(job);
+
+    for (j = 1; j < nthreads; ++j)
+        pthread_join(threads[j], NULL);
+    cu_free(threads);
+}
+
+void cu_avl_tree_parallel_foreach(CUAVLTree *tree,
+                                  uint32_t nthreads,
+                                  CUTraverseFunc traverse,
+                                  void *userdata)
+{
+    if (!tree || !tree->root || !traverse)
+        return;
+
+    CUAVLTreeParallelJob job = {
+        .tree = tree,
+        .traverse = traverse,
+        .new_partial = NULL,
+        .userdata = userdata
+    };
+    _cu_avl_tree_parallel_run(&job, nthreads);
+    cu_free(job.chunks);
+}
+
+void *cu_avl_tree_parallel_reduce(CUAVLTree *tree,
+                                  uint32_t nthreads,
+                                  CUAVLTreePartialFunc new_partial,
+                                  CUTraverseFunc traverse,
+                                  CUAVLTreeReduceFunc reduce,
+                                  void *userdata)
+{
+    if (cu_unlikely(!tree || !new_partial || !traverse || !reduce))
+        return NULL;
+    if (!tree->root)
+        return new_partial(userdata);
+
+    CUAVLTreeParallelJob job = {
+        .tree = tree,
+        .traverse = traverse,
+        .new_partial = new_partial,
+        .userdata = userdata
+    };
+    _cu_avl_tree_parallel_run(&job, nthreads);
+
+    /* Combine the partial results in order of the keys. */
+    void *result = job.chunks[0].partial;
+    uint32_t j;
+    for (j = 1; j < job.chunk_count; ++j)
+        result = reduce(result, job.chunks[j].partial, userdata);
+
+    cu_free(job.chunks);
+    return result;
+}
+
+/****************************
+ *  Persistent trees.
+ ****************************/
+
+CUAVLTree *cu_avl_tree_new_persistent(CUCompareDataFunc compare,
+                                      void *compare_data,
+                                      CUDestroyNotifyFunc destroy_key,
+                                      CUDestroyNotifyFunc destroy_value)
+{
+    CUAVLTree *tree = cu_avl_tree_new_full(compare, compare_data, destroy_key, destroy_value, true);
+    tree->persistent = 1;
+    pthread_mutex_init(&tree->snapshot_lock, NULL);
+
+    /* The initial, empty version. */
+    tree->current_snapshot = cu_alloc0(sizeof(CUAVLTreeSnapshot));
+    tree->current_snapshot->tree = tree;
+    tree->current_snapshot->ref_count = 1;
+    tree->oldest_snapshot = tree->current_snapshot;
+
+    return tree;
+}
+
+/** @internal
+ *  @brief Remember a node of the current version that is not part of the next version.
+ *  @param[in] tree The tree.
+ *  @param[in] node The node.
+ *  @param[in] flags Which resources to free together with the node.
+ */
+static
+void _cu_avl_tree_persistent_retire(CUAVLTree *tree, CUAVLTreeNode *node, uintptr_t flags)
+{
+    CUAVLTreeSnapshot *snapshot = tree->current_snapshot;
+    if (cu_unlikely(snapshot->retired_length == snapshot->retired_size)) {
+        snapshot->retired_size = snapshot->retired_size ? 2 * snapshot->retired_size : 64;
+        snapshot->retired = cu_realloc(snapshot->retired, snapshot->retired_size * sizeof(uintptr_t));
+    }
+    snapshot->retired[snapshot->retired_length++] = (uintptr_t)node | flags;
+}
+
+/** @internal
+ *  @brief Copy a node of the current version, which may then be modified.
+ *  @param[in] tree The tree.
+ *  @param[in] node The node to copy.
+ *  @return The copy.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_persistent_copy(CUAVLTree *tree, CUAVLTreeNode *node)
+{
+    CUAVLTreeNode *copy = _cu_avl_tree_alloc(tree);
+    memcpy(copy, node, sizeof(CUAVLTreeNode));
+    _cu_avl_tree_persistent_retire(tree, node, 0);
+    return copy;
+}
+
+/** @internal
+ *  @brief Free all retired nodes of a version and the version itself.
+ *  @param[in] tree The tree.
+ *  @param[in] snapshot The version.
+ */
+static
+void _cu_avl_tree_persistent_free_snapshot(CUAVLTree *tree, CUAVLTreeSnapshot *snapshot)
+{
+    uint32_t j;
+    CUAVLTreeNode *node;
+    for (j = 0; j < snapshot->retired_length; ++j) {
+        node = (CUAVLTreeNode *)(snapshot->retired[j] & ~RETIRED_FLAGS);
+        if (tree->destroy_key && (snapshot->retired[j] & RETIRED_DESTROY_KEY))
+            tree->destroy_key(node->key);
+        if (tree->destroy_value && (snapshot->retired[j] & RETIRED_DESTROY_VALUE))
+            tree->destroy_value(node->value);
+        _cu_avl_tree_free(tree, node);
+    }
+    cu_free(snapshot->retired);
+    cu_free(snapshot);
+}
+
+void cu_avl_tree_reclaim(CUAVLTree *tree)
+{
+    if (cu_unlikely(!tree || !tree->persistent))
+        return;
+
+    /* A node retired in some version is contained in this and possibly older versions only.
+     * So we can free the nodes as soon as no reader holds this or an older version. */
+    CUAVLTreeSnapshot *reclaim = NULL, *last = NULL;
+    pthread_mutex_lock(&tree->snapshot_lock);
+    while (tree->oldest_snapshot != tree->current_snapshot && tree->oldest_snapshot->ref_count == 0) {
+        if (!reclaim)
+            reclaim = tree->oldest_snapshot;
+        last = tree->oldest_snapshot;
+        tree->oldest_snapshot = tree->oldest_snapshot->next;
+    }
+    pthread_mutex_unlock(&tree->snapshot_lock);
+
+    /* Free the memory outside the lock, the versions are no longer reachable by readers. */
+    CUAVLTreeSnapshot *next;
+    while (reclaim) {
+        next = reclaim == last ? NULL : reclaim->next;
+        _cu_avl_tree_persistent_free_snapshot(tree, reclaim);
+        reclaim = next;
+    }
+}
+
+/** @internal
+ *  @brief Make a new root the current version and release the old version.
+ *  @param[in] tree The tree.
+ *  @param[in] root The root of the new version.
+ *  @param[in] height The height of the new version.
+ */
+static
+void _cu_avl_tree_persistent_publish(CUAVLTree *tree, CUAVLTreeNode *root, uint32_t height)
+{
+    CUAVLTreeSnapshot *snapshot = cu_alloc0(sizeof(CUAVLTreeSnapshot));
+    snapshot->tree = tree;
+    snapshot->root = root;
+    snapshot->height = height;
+    snapshot->ref_count = 1;
+
+    pthread_mutex_lock(&tree->snapshot_lock);
+    tree->current_snapshot->next = snapshot;
+    --tree->current_snapshot->ref_count;
+    tree->current_snapshot = snapshot;
+    pthread_mutex_unlock(&tree->snapshot_lock);
+
+    tree->root = root;
+    tree->height = height;
+    _cu_avl_tree_forget_path(tree);
+
+    cu_avl_tree_reclaim(tree);
+}
+
+/** @internal
+ *  @brief Like _cu_avl_tree_rebalance(), but copy the nodes that have to be rotated first.
+ *  @details Only used after a removal, where the higher subtree is always part of the current version.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_persistent_rebalance(CUAVLTree *tree, CUAVLTreeNode *X,
+                                                 CUAVLTreeNode *left, uint32_t hl,
+                                                 CUAVLTreeNode *right, uint32_t hr,
+                                                 uint32_t *height)
+{
+    if (hr > hl + 1) {
+        right = _cu_avl_tree_persistent_copy(tree, right);
+        if (_cu_avl_tree_left_height(right, hr) > _cu_avl_tree_right_height(right, hr))
+            _cu_avl_tree_node_set_left(right, _cu_avl_tree_persistent_copy(tree, _cu_avl_tree_node_get_left(right)));
+    }
+    else if (hl > hr + 1) {
+        left = _cu_avl_tree_persistent_copy(tree, left);
+        if (_cu_avl_tree_right_height(left, hl) > _cu_avl_tree_left_height(left, hl))
+            _cu_avl_tree_node_set_right(left, _cu_avl_tree_persistent_copy(tree, _cu_avl_tree_node_get_right(left)));
+    }
+    return _cu_avl_tree_rebalance(X, left, hl, right, hr, height);
+}
+
+/** @internal
+ *  @brief Insert into a subtree by copying the path to the new node.
+ *  @details All rotations only affect nodes on the copied path.
+ *  @return The root of the new version of the subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_persistent_insert_node(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height,
+                                                   void *key, void *value, uint32_t *new_height)
+{
+    CUAVLTreeNode *copy, *C;
+    uint32_t hc;
+
+    if (!node) {
+        copy = _cu_avl_tree_alloc(tree);
+        memset(copy, 0, sizeof(CUAVLTreeNode));
+        copy->key = key;
+        copy->value = value;
+        *new_height = 1;
+        return copy;
+    }
+
+    int rc = tree->compare(key, node->key, tree->compare_data);
+    if (rc == 0) {
+        /* Keep the original key. The old value may still be used by readers of older versions. */
+        if (tree->destroy_key && node->key != key)
+            tree->destroy_key(key);
+        copy = _cu_avl_tree_alloc(tree);
+        memcpy(copy, node, sizeof(CUAVLTreeNode));
+        copy->value = value;
+        _cu_avl_tree_persistent_retire(tree, node, node->value != value ? RETIRED_DESTROY_VALUE : 0);
+        *new_height = height;
+        return copy;
+    }
+
+    copy = _cu_avl_tree_persistent_copy(tree, node);
+    if (rc > 0) {
+        C = _cu_avl_tree_persistent_insert_node(tree, _cu_avl_tree_node_get_left(node), _cu_avl_tree_left_height(node, height),
+                                                key, value, &hc);
+        return _cu_avl_tree_rebalance(copy, C, hc, _cu_avl_tree_node_get_right(copy), _cu_avl_tree_right_height(node, height), new_height);
+    }
+    C = _cu_avl_tree_persistent_insert_node(tree, _cu_avl_tree_node_get_right(node), _cu_avl_tree_right_height(node, height),
+                                            key, value, &hc);
+    return _cu_avl_tree_rebalance(copy, _cu_avl_tree_node_get_left(copy), _cu_avl_tree_left_height(node, height), C, hc, new_height);
+}
+
+/** @internal
+ *  @brief Detach the node with the smallest key from a subtree by copying the path to it.
+ *  @return The root of the new version of the subtree.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_persistent_detach_first(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height,
+                                                    CUAVLTreeNode **first, uint32_t *new_height)
+{
+    if (!_cu_avl_tree_node_get_left(node)) {
+        *first = node;
+        *new_height = height - 1;
+        return _cu_avl_tree_node_get_right(node);
+    }
+    uint32_t hc;
+    CUAVLTreeNode *C = _cu_avl_tree_persistent_detach_first(tree, _cu_avl_tree_node_get_left(node), _cu_avl_tree_left_height(node, height),
+                                                            first, &hc);
+    CUAVLTreeNode *copy = _cu_avl_tree_persistent_copy(tree, node);
+    return _cu_avl_tree_persistent_rebalance(tree, copy, C, hc, _cu_avl_tree_node_get_right(node), _cu_avl_tree_right_height(node, height),
+                                             new_height);
+}
+
+/** @internal
+ *  @brief Remove a key from a subtree by copying the path to it.
+ *  @return The root of the new version of the subtree, or @a node, if the key has not been found.
+ */
+static
+CUAVLTreeNode *_cu_avl_tree_persistent_remove_node(CUAVLTree *tree, CUAVLTreeNode *node, uint32_t height,
+                                                   void *key, bool *found, uint32_t *new_height)
+{
+    CUAVLTreeNode *copy, *C;
+    uint32_t hc;
+    uint32_t hl, hr;
+
+    if (!node) {
+        *found = false;
+        *new_height = 0;
+        return NULL;
+    }
+
+    hl = _cu_avl_tree_left_height(node, height);
+    hr = _cu_avl_tree_right_height(node, height);
+
+    int rc = tree->compare(key, node->key, tree->compare_data);
+    if (rc > 0) {
+        C = _cu_avl_tree_persistent_remove_node(tree, _cu_avl_tree_node_get_left(node), hl, key, found, &hc);
+        if (!*found) {
+            *new_height = height;
+            return node;
+        }
+        copy = _cu_avl_tree_persistent_copy(tree, node);
+        return _cu_avl_tree_persistent_rebalance(tree, copy, C, hc, _cu_avl_tree_node_get_right(node), hr, new_height);
+    }
+    if (rc < 0) {
+        C = _cu_avl_tree_persistent_remove_node(tree, _cu_avl_tree_node_get_right(node), hr, key, found, &hc);
+        if (!*found) {
+            *new_height = height;
+            return node;
+        }
+        copy = _cu_avl_tree_persistent_copy(tree, node);
+        return _cu_avl_tree_persistent_rebalance(tree, copy, _cu_avl_tree_node_get_left(node), hl, C, hc, new_height);
+    }
+
+    *found = true;
+    _cu_avl_tree_persistent_retire(tree, node, RETIRED_DESTROY_KEY | RETIRED_DESTROY_VALUE);
+    if (!_cu_avl_tree_node_get_left(node)) {
+        *new_height = hr;
+        return _cu_avl_tree_node_get_right(node);
+    }
+    if (!_cu_avl_tree_node_get_right(node)) {
+        *new_height = hl;
+        return _cu_avl_tree_node_get_left(node);
+    }
+
+    /* Replace the node by a copy of its successor. */
+    CUAVLTreeNode *first;
+    C = _cu_avl_tree_persistent_detach_first(tree, _cu_avl_tree_node_get_right(node), hr, &first, &hc);
+    copy = _cu_avl_tree_persistent_copy(tree, first);
+    return _cu_avl_tree_persistent_rebalance(tree, copy, _cu_avl_tree_node_get_left(node), hl, C, hc, new_height);
+}
+
+static
+void _cu_avl_tree_persistent_insert(CUAVLTree *tree, void *key, void *value)
+{
+    uint32_t height;
+    CUAVLTreeNode *root = _cu_avl_tree_persistent_insert_node(tree, tree->root, tree->height, key, value, &height);
+    _cu_avl_tree_persistent_publish(tree, root, height);
+}
+
+static
+bool _cu_avl_tree_persistent_remove(CUAVLTree *tree, void *key)
+{
+    uint32_t height;
+    bool found;
+    CUAVLTreeNode *root = _cu_avl_tree_persistent_remove_node(tree, tree->root, tree->height, key, &found, &height);
+    if (found)
+        _cu_avl_tree_persistent_publish(tree, root, height);
+    return found;
+}
+
+/** @internal
+ *  @brief Retire all nodes of a subtree, together with their keys and values.
+ */
+static
+void _cu_avl_tree_persistent_retire_subtree(CUAVLTree *tree, CUAVLTreeNode *node)
+{
+    while (node) {
+        _cu_avl_tree_persistent_retire_subtree(tree, _cu_avl_tree_node_get_left(node));
+        _cu_avl_tree_persistent_retire(tree, node, RETIRED_DESTROY_KEY | RETIRED_DESTROY_VALUE);
+        node = _cu_avl_tree_node_get_right(node);
+    }
+}
+
+static
+void _cu_avl_tree_persistent_clear(CUAVLTree *tree)
+{
+    if (!tree->root)
+        return;
+    _cu_avl_tree_persistent_retire_subtree(tree, tree->root);
+    _cu_avl_tree_persistent_publish(tree, NULL, 0);
+}
+
+static
+void _cu_avl_tree_persistent_destroy(CUAVLTree *tree)
+{
+    CUAVLTreeSnapshot *snapshot = tree->oldest_snapshot, *next;
+    while (snapshot != tree->current_snapshot) {
+        next = snapshot->next;
+        _cu_avl_tree_persistent_free_snapshot(tree, snapshot);
+        snapshot = next;
+    }
+    _cu_avl_tree_free_subtree(tree, tree->root);
+    _cu_avl_tree_persistent_free_snapshot(tree, snapshot);
+    pthread_mutex_destroy(&tree->snapshot_lock);
+}
+
+CUAVLTreeSnapshot *cu_avl_tree_snapshot_acquire(CUAVLTree *tree)
+{
+    if (cu_unlikely(!tree || !tree->persistent))
+        return NULL;
+    CUAVLTreeSnapshot *snapshot;
+    pthread_mutex_lock(&tree->snapshot_lock);
+    snapshot = tree->current_snapshot;
+    ++snapshot->ref_count;
+    pthread_mutex_unlock(&tree->snapshot_lock);
+    return snapshot;
+}
+
+void cu_avl_tree_snapshot_release(CUAVLTreeSnapshot *snapshot)
+{
+    if (cu_unlikely(!snapshot))
+        return;
+    pthread_mutex_lock(&snapshot->tree->snapshot_lock);
+    --snapshot->ref_count;
+    pthread_mutex_unlock(&snapshot->tree->snapshot_lock);
+}
+
+bool cu_avl_tree_snapshot_find(CUAVLTreeSnapshot *snapshot,
+                               void *key,
+                               void **data)
+{
+    if (cu_unlikely(!snapshot))
+        return false;
+
+    CUAVLTree *tree = snapshot->tree;
+    CUAVLTreeNode *node = snapshot->root;
+    int rc;
+
+    while (node) {
+        rc = tree->compare(key, node->key, tree->compare_data);
+        if (rc > 0) {
+            node = _cu_avl_tree_node_get_left(node);
+        }
+        else if (rc < 0) {
+            node = _cu_avl_tree_node_get_right(node);
+        }
+        else {
+            if (data)
+                *data = node->value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void cu_avl_tree_snapshot_foreach(CUAVLTreeSnapshot *snapshot,
+                                  CUTraverseFunc traverse,
+                                  void *userdata)
+{
+    if (!snapshot || !snapshot->root || !traverse)
+        return;
+
+    /* The node stack of the tree belongs to the writer, so use our own. */
+    CUAVLTreeNode **stack = cu_alloc(snapshot->height * sizeof(CUAVLTreeNode *));
+    CUAVLTreeNode *node = snapshot->root;
+    uint32_t length = 0;
+
+    while (1) {
+        while (node) {
+            stack[length++] = node;
+            node = _cu_avl_tree_node_get_left(node);
+        }
+
+        if (!length)
+            break;
+
+        node = stack[--length];
+        if (!traverse(node->key, node->value, userdata))
+            break;
+
+        node = _cu_avl_tree_node_get_right(node);
+    }
+
+    cu_free(stack);
 }
@@ -12,6 +12,25 @@
  */
 typedef struct _CUAVLTree CUAVLTree;
 
+/** @brief Handle to a single version of a persistent AVL tree.
+ *  @details See cu_avl_tree_new_persistent().
+ */
+typedef struct _CUAVLTreeSnapshot CUAVLTreeSnapshot;
+
+/** @brief Create an empty partial result for cu_avl_tree_parallel_reduce().
+ *  @param[in] 1 Pointer to user defined data.
+ *  @return The new partial result.
+ */
+typedef void *(*CUAVLTreePartialFunc)(void *);
+
+/** @brief Combine two partial results of cu_avl_tree_parallel_reduce().
+ *  @param[in] 1 The partial result of the smaller keys.
+ *  @param[in] 2 The partial result of the larger keys.
+ *  @param[in] 3 Pointer to user defined data.
+ *  @return The combined result. The function is responsible for freeing the inputs, if necessary.
+ */
+typedef void *(*CUAVLTreeReduceFunc)(void *, void *, void *);
+
 /** @brief Create a new AVL tree, with full control.
  *  @param[in] compare Pointer to a function that compares two keys. If not specified,
  *                     the pointer values are compared.
@@ -40,6 +59,41 @@ CUAVLTree *cu_avl_tree_new(CUCompareDataFunc compare,
                            CUDestroyNotifyFunc destroy_key,
                            CUDestroyNotifyFunc destroy_value);
 
+/** @brief Create a new AVL tree that only stores keys.
+ *  @details The nodes of such a set have no room for a value, so more of them fit into each
+ *           cache line and each group of the memory pool. Values passed to cu_avl_tree_insert()
+ *           are ignored, and cu_avl_tree_find() and cu_avl_tree_foreach() report @a NULL values.
+ *           cu_avl_tree_lookup_or_insert() always returns @a NULL.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @return Pointer to a newly created AVL tree.
+ */
+CUAVLTree *cu_avl_tree_new_set(CUCompareDataFunc compare,
+                               void *compare_data,
+                               CUDestroyNotifyFunc destroy_key);
+
+/** @brief Create a new AVL tree that stores intervals.
+ *  @details Each element covers the half-open interval from its key (the start) up to, but
+ *           excluding, an end given to cu_avl_tree_insert_interval(). Starts and ends are compared
+ *           with @a compare, and every node remembers the largest end in its subtree, so all
+ *           intervals containing a point or overlapping a range are found in O(log(n) + k).
+ *           Elements are still unique by their start. The tree does not take ownership of the ends.
+ *           cu_avl_tree_insert() inserts an empty interval ending at its start. Split, join, merge
+ *           and persistence are not supported for interval trees.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created AVL tree.
+ */
+CUAVLTree *cu_avl_tree_new_interval(CUCompareDataFunc compare,
+                                    void *compare_data,
+                                    CUDestroyNotifyFunc destroy_key,
+                                    CUDestroyNotifyFunc destroy_value);
+
 /** @brief Clear an AVL tree and free resources of keys/values.
  *  @details Only the keys and values are destroyed. The tree is still initialized
  *           and may be used further.
@@ -92,4 +146,265 @@ void cu_avl_tree_foreach(CUAVLTree *tree,
                          CUTraverseFunc traverse,
                          void *userdata);
 
+/** @brief Insert an interval into an interval tree.
+ *  @details Behaves like cu_avl_tree_insert() with @a start as key. If an interval with the same
+ *           start is already in the tree, its end is replaced as well.
+ *  @param[in] tree The interval tree.
+ *  @param[in] start The start of the interval, used as key.
+ *  @param[in] end The end of the interval, which is not part of it.
+ *  @param[in] value The value to be inserted for the interval.
+ */
+void cu_avl_tree_insert_interval(CUAVLTree *tree,
+                                 void *start,
+                                 void *end,
+                                 void *value);
+
+/** @brief Find an interval by its start.
+ *  @param[in] tree The interval tree.
+ *  @param[in] start The start of the interval.
+ *  @param[out] end Gets filled with the end of the interval, if it was found.
+ *  @param[out] data Gets filled with a pointer to the value, if the interval was found.
+ *  @retval true The interval was found.
+ *  @retval false There is no interval with this start.
+ */
+bool cu_avl_tree_find_interval(CUAVLTree *tree,
+                               void *start,
+                               void **end,
+                               void **data);
+
+/** @brief Find the interval with the smallest start that contains a point.
+ *  @details Takes O(log(n)). For disjoint intervals, this is the only one.
+ *  @param[in] tree The interval tree.
+ *  @param[in] point The point.
+ *  @param[out] start Gets filled with the start of the interval, if one was found.
+ *  @param[out] data Gets filled with a pointer to the value, if an interval was found.
+ *  @retval true An interval containing @a point was found.
+ *  @retval false No interval contains @a point.
+ */
+bool cu_avl_tree_find_stabbing(CUAVLTree *tree,
+                               void *point,
+                               void **start,
+                               void **data);
+
+/** @brief Call a function for each interval containing a point.
+ *  @details The intervals are processed in order of their starts.
+ *  @param[in] tree The interval tree.
+ *  @param[in] point The point.
+ *  @param[in] traverse Function to call for each interval, with its start and value.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_avl_tree_foreach_stabbing(CUAVLTree *tree,
+                                  void *point,
+                                  CUTraverseFunc traverse,
+                                  void *userdata);
+
+/** @brief Call a function for each interval overlapping a range.
+ *  @details The range is half-open like the intervals. The intervals are processed in order of
+ *           their starts.
+ *  @param[in] tree The interval tree.
+ *  @param[in] from The start of the range.
+ *  @param[in] to The end of the range, which is not part of it.
+ *  @param[in] traverse Function to call for each interval, with its start and value.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_avl_tree_foreach_overlapping(CUAVLTree *tree,
+                                     void *from,
+                                     void *to,
+                                     CUTraverseFunc traverse,
+                                     void *userdata);
+
+/** @brief Find an element, or insert it if it is not in the tree yet.
+ *  @details Unlike a cu_avl_tree_find() followed by cu_avl_tree_insert(), this walks the tree only once.
+ *           If the element is inserted, its value is @a NULL and ownership of @a key is passed to the
+ *           tree. Otherwise, @a key is not used and remains owned by the caller. The returned
+ *           pointer is valid until the tree is modified next. Not supported for persistent trees.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element.
+ *  @param[out] inserted If not @a NULL, receives whether a new element has been inserted.
+ *  @return Pointer to the value of the element, which may be set by the caller.
+ */
+void **cu_avl_tree_lookup_or_insert(CUAVLTree *tree,
+                                    void *key,
+                                    bool *inserted);
+
+/** @brief Start each lookup from the path of the previous access.
+ *  @details Instead of descending from the root, the tree walks up the last path only as far as
+ *           needed to reach a subtree that contains the key. For sequential or clustered keys,
+ *           this saves most of the comparisons. For random keys, it costs a few more.
+ *           Affects find, insert, remove and cu_avl_tree_lookup_or_insert(). Disabled by default.
+ *  @param[in] tree The tree.
+ *  @param[in] enable Whether to use finger search.
+ */
+void cu_avl_tree_set_finger_search(CUAVLTree *tree, bool enable);
+
+/** @brief Insert many elements at once.
+ *  @details The batch is sorted and merged into the tree in a single pass, so every node on
+ *           the affected paths is visited only once and each subtree is rebalanced only once.
+ *           Batches that are already sorted need no extra comparisons for sorting. The result
+ *           is the same as calling cu_avl_tree_insert() for each element in the order given.
+ *  @param[in] tree The tree.
+ *  @param[in] keys The keys of the elements.
+ *  @param[in] values The values of the elements, or @a NULL to insert @a NULL values.
+ *  @param[in] length The number of elements.
+ */
+void cu_avl_tree_insert_batch(CUAVLTree *tree,
+                              void **keys,
+                              void **values,
+                              size_t length);
+
+/** @brief Remove many elements at once and free their resources.
+ *  @details Like cu_avl_tree_insert_batch(), the tree is walked only once.
+ *  @param[in] tree The tree.
+ *  @param[in] keys The keys of the elements to remove. Keys not in the tree are ignored.
+ *  @param[in] length The number of keys.
+ *  @return The number of elements removed.
+ */
+size_t cu_avl_tree_remove_batch(CUAVLTree *tree,
+                                void **keys,
+                                size_t length);
+
+/** @brief Call a function for each element in the tree, using several threads.
+ *  @details The top levels of the tree are cut into independent subtrees, which are processed
+ *           in order by a pool of threads, the calling thread being one of them. Elements of
+ *           different subtrees are processed concurrently, so @a traverse has to be thread-safe.
+ *           If it returns false, all threads stop as soon as possible. The tree must not be
+ *           modified until this returns.
+ *  @param[in] tree The tree.
+ *  @param[in] nthreads The number of threads to use, or 0 for one per online processor.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_avl_tree_parallel_foreach(CUAVLTree *tree,
+                                  uint32_t nthreads,
+                                  CUTraverseFunc traverse,
+                                  void *userdata);
+
+/** @brief Aggregate all elements of a tree, using several threads.
+ *  @details Like cu_avl_tree_parallel_foreach(), but each subtree gets its own partial result,
+ *           created by @a new_partial and passed as third argument to @a traverse. Afterwards,
+ *           the partial results are combined in order of their keys with @a reduce, so the
+ *           combination does not need to be commutative. If @a traverse cancels the
+ *           traversal, subtrees not processed yet contribute empty partial results.
+ *  @param[in] tree The tree.
+ *  @param[in] nthreads The number of threads to use, or 0 for one per online processor.
+ *  @param[in] new_partial Function creating an empty partial result.
+ *  @param[in] traverse Function to call for each element, with the partial result of its subtree.
+ *  @param[in] reduce Function combining two adjacent partial results.
+ *  @param[in] userdata Pointer passed to @a new_partial and @a reduce.
+ *  @return The combined result of all elements, or the empty result for an empty tree.
+ */
+void *cu_avl_tree_parallel_reduce(CUAVLTree *tree,
+                                  uint32_t nthreads,
+                                  CUAVLTreePartialFunc new_partial,
+                                  CUTraverseFunc traverse,
+                                  CUAVLTreeReduceFunc reduce,
+                                  void *userdata);
+
+/** @brief Split a tree at a given key.
+ *  @details All elements with a key smaller than @a key are moved to a new tree returned in @a left,
+ *           all other elements (including @a key itself) to a new tree returned in @a right. This
+ *           takes O(log(n)) time, as no element is copied or compared more than once per level.
+ *           The new trees share the callbacks and the memory pool of @a tree, which is empty
+ *           afterwards but still has to be destroyed.
+ *  @param[in] tree The tree to split.
+ *  @param[in] key The key at which to split.
+ *  @param[out] left Receives the tree holding the smaller keys. If @a NULL, these elements are destroyed.
+ *  @param[out] right Receives the tree holding the other keys. If @a NULL, these elements are destroyed.
+ */
+void cu_avl_tree_split(CUAVLTree *tree,
+                       void *key,
+                       CUAVLTree **left,
+                       CUAVLTree **right);
+
+/** @brief Concatenate two trees with disjoint key ranges.
+ *  @details All keys in @a a have to be smaller than all keys in @a b. The elements of @a b are
+ *           moved to @a a in O(log(n)) time, no node is copied. If the trees do not share their
+ *           memory pool (e.g., because they were not created by cu_avl_tree_split()), @a a takes
+ *           a reference on the pool of @a b, which adds O(p) for @a p pools joined into @a a so
+ *           far. Until @a a is cleared, removing an element from it then has to look up the pool
+ *           of its node, and @a a must not be used concurrently with @a b. @a b is empty
+ *           afterwards. Both trees have to use the same compare function and both or neither
+ *           have to be key-only.
+ *  @param[in] a The tree with the smaller keys. Receives all elements.
+ *  @param[in] b The tree with the larger keys.
+ *  @retval true The trees have been joined.
+ *  @retval false The key ranges overlap. Nothing has been changed.
+ */
+bool cu_avl_tree_join(CUAVLTree *a, CUAVLTree *b);
+
+/** @brief Merge two trees with overlapping key ranges.
+ *  @details All elements of @a b are moved to @a a in O(n + m) time. If a key is present in
+ *           both trees, this behaves as if the element of @a b had been inserted into @a a.
+ *           Nodes are not copied, memory pools are shared as for cu_avl_tree_join().
+ *           @a b is empty afterwards. Both trees have to use the same compare function
+ *           and both or neither have to be key-only.
+ *  @param[in] a The tree receiving all elements.
+ *  @param[in] b The tree to merge into @a a.
+ */
+void cu_avl_tree_merge(CUAVLTree *a, CUAVLTree *b);
+
+/** @brief Create a new persistent AVL tree.
+ *  @details A persistent tree never modifies a node that is visible to readers. Every insertion
+ *           or removal copies the path from the root to the changed node and publishes the new
+ *           root as the current version. Readers may take a snapshot of the current version with
+ *           cu_avl_tree_snapshot_acquire() and walk it from any thread without further locking,
+ *           while a single writer keeps modifying the tree. Nodes (and replaced or removed keys
+ *           and values) are freed by the writer once no snapshot refers to them any more.
+ *           All other functions may only be called by the writer. cu_avl_tree_split(),
+ *           cu_avl_tree_join() and cu_avl_tree_merge() are not supported for persistent trees.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created persistent AVL tree.
+ */
+CUAVLTree *cu_avl_tree_new_persistent(CUCompareDataFunc compare,
+                                      void *compare_data,
+                                      CUDestroyNotifyFunc destroy_key,
+                                      CUDestroyNotifyFunc destroy_value);
+
+/** @brief Get a reference to the current version of a persistent tree.
+ *  @details The snapshot is not affected by later changes of the tree. It has to be released
+ *           with cu_avl_tree_snapshot_release() before the tree is destroyed. May be called
+ *           from any thread.
+ *  @param[in] tree The persistent tree.
+ *  @return The current version, or @a NULL if @a tree is not persistent.
+ */
+CUAVLTreeSnapshot *cu_avl_tree_snapshot_acquire(CUAVLTree *tree);
+
+/** @brief Release a snapshot.
+ *  @details The memory is reclaimed by the writer during its next modification or
+ *           cu_avl_tree_reclaim().
+ *  @param[in] snapshot The snapshot acquired with cu_avl_tree_snapshot_acquire().
+ */
+void cu_avl_tree_snapshot_release(CUAVLTreeSnapshot *snapshot);
+
+/** @brief Find an element in a snapshot.
+ *  @param[in] snapshot The snapshot.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with a pointer to the value, if @a key was found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the snapshot.
+ */
+bool cu_avl_tree_snapshot_find(CUAVLTreeSnapshot *snapshot,
+                               void *key,
+                               void **data);
+
+/** @brief Call a function for each element in a snapshot.
+ *  @details The snapshot is processed in order.
+ *  @param[in] snapshot The snapshot.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_avl_tree_snapshot_foreach(CUAVLTreeSnapshot *snapshot,
+                                  CUTraverseFunc traverse,
+                                  void *userdata);
+
+/** @brief Free the memory of all versions that are no longer referenced.
+ *  @details This is done automatically after each modification. Only the writer may call this.
+ *  @param[in] tree The persistent tree.
+ */
+void cu_avl_tree_reclaim(CUAVLTree *tree);
+
 /** @} */
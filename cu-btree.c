@@ -0,0 +1,698 @@
+#include "cu-btree.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+
+/* Maximal number of keys in a single node. The default of 16 keys takes 128 bytes (on 64 bit
+ * systems). Nodes are not aligned to cache lines, so a binary search within a node touches at
+ * most three lines. */
+#ifndef CFG_CU_BTREE_NODE_KEYS
+#define CFG_CU_BTREE_NODE_KEYS 16
+#endif
+
+#if CFG_CU_BTREE_NODE_KEYS < 4
+#error "CFG_CU_BTREE_NODE_KEYS has to be at least 4."
+#endif
+
+#define BTREE_MAX_KEYS CFG_CU_BTREE_NODE_KEYS
+#define BTREE_MIN_KEYS (CFG_CU_BTREE_NODE_KEYS / 2)
+
+/* Every node but the root has at least BTREE_MIN_KEYS + 1 >= 3 children, so 48 levels
+ * are more than enough for any number of elements fitting into memory. */
+#define BTREE_MAX_HEIGHT 48
+
+typedef struct _CUBTreeNode CUBTreeNode;
+/** @internal
+ *  @brief A node in the tree.
+ *  @details The keys are placed first, such that the search inside the node only touches
+ *           the first cache lines of the node.
+ */
+struct _CUBTreeNode {
+    void *keys[BTREE_MAX_KEYS]; /**< The keys. In inner nodes, keys[j] is the smallest key in children[j+1]. */
+    uint32_t length; /**< The number of keys in this node. */
+    uint32_t is_leaf; /**< Whether this node is a leaf. */
+    union {
+        struct {
+            void *values[BTREE_MAX_KEYS]; /**< The values belonging to the keys. */
+            CUBTreeNode *prev; /**< The leaf to the left. */
+            CUBTreeNode *next; /**< The leaf to the right. */
+        } leaf; /**< Data of leaves. */
+        CUBTreeNode *children[BTREE_MAX_KEYS + 1]; /**< Data of inner nodes, length + 1 children. */
+    };
+};
+
+/** @internal
+ *  @brief An entry in the path from the root to a leaf.
+ */
+typedef struct {
+    CUBTreeNode *node; /**< The inner node. */
+    uint32_t index; /**< The index of the child we descended to. */
+} CUBTreePathEntry;
+
+struct _CUBTree {
+    CUFixedSizeMemoryPool *node_mem;
+
+    CUBTreeNode *root;
+
+    CUCompareDataFunc compare;
+    void *compare_data;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+
+    size_t length;
+    uint32_t height;
+};
+
+/** @internal
+ *  @brief Compare the raw pointer values.
+ *  @details Used as a fallback if no @a compare function is passed to cu_btree_new().
+ *  @param[in] a The first value.
+ *  @param[in] b The second value.
+ *  @param[in] nil Unused.
+ *  @retval 1 The value of @a b is larger than @a a.
+ *  @retval 0 The values of @a a and @a b are the same.
+ *  @retval -1 The value of @a a is larger than @a b.
+ */
+static
+int _cu_btree_compare_pointers(void *a, void *b, __attribute__((unused))void *nil)
+{
+    if (a < b)
+        return 1;
+    if (a > b)
+        return -1;
+    return 0;
+}
+
+/** @internal
+ *  @brief Allocate memory for a single node.
+ *  @param[in] tree The tree.
+ *  @param[in] is_leaf Whether the new node is a leaf.
+ *  @return Pointer to a newly allocated, empty node.
+ */
+static
+CUBTreeNode *_cu_btree_node_new(CUBTree *tree, bool is_leaf)
+{
+    CUBTreeNode *node = (CUBTreeNode *)(tree->node_mem ? cu_fixed_size_memory_pool_alloc(tree->node_mem)
+                                                       : cu_alloc(sizeof(CUBTreeNode)));
+    node->length = 0;
+    node->is_leaf = is_leaf;
+    if (is_leaf) {
+        node->leaf.prev = NULL;
+        node->leaf.next = NULL;
+    }
+    return node;
+}
+
+/** @internal
+ *  @brief Return the memory of a node to the pool or the system.
+ *  @param[in] tree The tree.
+ *  @param[in] node The node to free.
+ */
+static
+void _cu_btree_node_free(CUBTree *tree, CUBTreeNode *node)
+{
+    if (tree->node_mem)
+        cu_fixed_size_memory_pool_free(tree->node_mem, node);
+    else
+        cu_free(node);
+}
+
+CUBTree *cu_btree_new_full(CUCompareDataFunc compare,
+                           void *compare_data,
+                           CUDestroyNotifyFunc destroy_key,
+                           CUDestroyNotifyFunc destroy_value,
+                           bool use_fixed_memory_pool)
+{
+    CUBTree *tree = cu_alloc0(sizeof(CUBTree));
+    if (use_fixed_memory_pool) {
+        tree->node_mem = cu_fixed_size_memory_pool_new(sizeof(CUBTreeNode), 0);
+        cu_fixed_size_memory_pool_release_empty_groups(tree->node_mem, true);
+    }
+
+    tree->compare = compare ? compare : _cu_btree_compare_pointers;
+    tree->compare_data = compare_data;
+    tree->destroy_key = destroy_key;
+    tree->destroy_value = destroy_value;
+
+    return tree;
+}
+
+CUBTree *cu_btree_new(CUCompareDataFunc compare,
+                      void *compare_data,
+                      CUDestroyNotifyFunc destroy_key,
+                      CUDestroyNotifyFunc destroy_value)
+{
+    return cu_btree_new_full(compare, compare_data, destroy_key, destroy_value, true);
+}
+
+/** @internal
+ *  @brief Free a subtree and the resources of all keys and values in it.
+ *  @param[in] tree The tree.
+ *  @param[in] node The root of the subtree.
+ *  @param[in] free_nodes Whether to return the nodes themselves, or just the keys and values.
+ */
+static
+void _cu_btree_clear_subtree(CUBTree *tree, CUBTreeNode *node, bool free_nodes)
+{
+    uint32_t j;
+    if (node->is_leaf) {
+        for (j = 0; j < node->length; ++j) {
+            if (tree->destroy_key)
+                tree->destroy_key(node->keys[j]);
+            if (tree->destroy_value)
+                tree->destroy_value(node->leaf.values[j]);
+        }
+    }
+    else {
+        for (j = 0; j <= node->length; ++j)
+            _cu_btree_clear_subtree(tree, node->children[j], free_nodes);
+    }
+    if (free_nodes)
+        _cu_btree_node_free(tree, node);
+}
+
+void cu_btree_clear(CUBTree *tree)
+{
+    if (cu_unlikely(!tree))
+        return;
+
+    if (tree->root) {
+        if (tree->node_mem) {
+            /* The pool releases all nodes at once. Only walk the tree if there is something to destroy. */
+            if (tree->destroy_key || tree->destroy_value)
+                _cu_btree_clear_subtree(tree, tree->root, false);
+            cu_fixed_size_memory_pool_clear(tree->node_mem);
+        }
+        else {
+            _cu_btree_clear_subtree(tree, tree->root, true);
+        }
+    }
+
+    tree->root = NULL;
+    tree->length = 0;
+    tree->height = 0;
+}
+
+void cu_btree_destroy(CUBTree *tree)
+{
+    if (cu_unlikely(!tree))
+        return;
+    cu_btree_clear(tree);
+    if (tree->node_mem)
+        cu_fixed_size_memory_pool_destroy(tree->node_mem);
+    cu_free(tree);
+}
+
+/** @internal
+ *  @brief Determine the child of an inner node in which the key has to be.
+ *  @param[in] tree The tree.
+ *  @param[in] node The inner node.
+ *  @param[in] key The key we look for.
+ *  @return The index of the child, i.e., the number of separators smaller or equal to @a key.
+ */
+static inline
+uint32_t _cu_btree_inner_search(CUBTree *tree, CUBTreeNode *node, void *key)
+{
+    uint32_t lo = 0, hi = node->length, mid;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (tree->compare(key, node->keys[mid], tree->compare_data) > 0) /* key < keys[mid] */
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/** @internal
+ *  @brief Search a key in a leaf.
+ *  @param[in] tree The tree.
+ *  @param[in] leaf The leaf.
+ *  @param[in] key The key we look for.
+ *  @param[out] index The index of the key, or the position where it would have to be inserted.
+ *  @retval true The key is in the leaf.
+ *  @retval false The key is not in the leaf.
+ */
+static inline
+bool _cu_btree_leaf_search(CUBTree *tree, CUBTreeNode *leaf, void *key, uint32_t *index)
+{
+    uint32_t lo = 0, hi = leaf->length, mid;
+    int rc;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        rc = tree->compare(key, leaf->keys[mid], tree->compare_data);
+        if (rc > 0) { /* key < keys[mid] */
+            hi = mid;
+        }
+        else if (rc < 0) { /* key > keys[mid] */
+            lo = mid + 1;
+        }
+        else {
+            *index = mid;
+            return true;
+        }
+    }
+    *index = lo;
+    return false;
+}
+
+/** @internal
+ *  @brief Walk down to the leaf that may contain a key and remember the path.
+ *  @param[in] tree The tree. Must not be empty.
+ *  @param[in] key The key we look for.
+ *  @param[out] path The inner nodes on the way, may be @a NULL.
+ *  @param[out] depth The number of entries in @a path.
+ *  @return The leaf in which @a key is or has to be inserted.
+ */
+static
+CUBTreeNode *_cu_btree_find_leaf_build_path(CUBTree *tree, void *key, CUBTreePathEntry *path, uint32_t *depth)
+{
+    CUBTreeNode *node = tree->root;
+    uint32_t j, d = 0;
+    while (!node->is_leaf) {
+        j = _cu_btree_inner_search(tree, node, key);
+        if (path) {
+            path[d].node = node;
+            path[d].index = j;
+        }
+        ++d;
+        node = node->children[j];
+    }
+    if (depth)
+        *depth = d;
+    return node;
+}
+
+/** @internal
+ *  @brief Insert a key and value into a leaf that has free space.
+ */
+static inline
+void _cu_btree_leaf_insert_at(CUBTreeNode *leaf, uint32_t index, void *key, void *value)
+{
+    memmove(&leaf->keys[index + 1], &leaf->keys[index], (leaf->length - index) * sizeof(void *));
+    memmove(&leaf->leaf.values[index + 1], &leaf->leaf.values[index], (leaf->length - index) * sizeof(void *));
+    leaf->keys[index] = key;
+    leaf->leaf.values[index] = value;
+    ++leaf->length;
+}
+
+/** @internal
+ *  @brief Insert a key and value into a full leaf by splitting it.
+ *  @return The new right sibling of @a leaf.
+ */
+static
+CUBTreeNode *_cu_btree_leaf_split_insert(CUBTree *tree, CUBTreeNode *leaf, uint32_t index, void *key, void *value)
+{
+    void *keys[BTREE_MAX_KEYS + 1];
+    void *values[BTREE_MAX_KEYS + 1];
+    const uint32_t total = BTREE_MAX_KEYS + 1;
+    const uint32_t nleft = (total + 1) / 2;
+
+    memcpy(keys, leaf->keys, index * sizeof(void *));
+    memcpy(values, leaf->leaf.values, index * sizeof(void *));
+    keys[index] = key;
+    values[index] = value;
+    memcpy(&keys[index + 1], &leaf->keys[index], (BTREE_MAX_KEYS - index) * sizeof(void *));
+    memcpy(&values[index + 1], &leaf->leaf.values[index], (BTREE_MAX_KEYS - index) * sizeof(void *));
+
+    CUBTreeNode *right = _cu_btree_node_new(tree, true);
+
+    memcpy(leaf->keys, keys, nleft * sizeof(void *));
+    memcpy(leaf->leaf.values, values, nleft * sizeof(void *));
+    leaf->length = nleft;
+
+    memcpy(right->keys, &keys[nleft], (total - nleft) * sizeof(void *));
+    memcpy(right->leaf.values, &values[nleft], (total - nleft) * sizeof(void *));
+    right->length = total - nleft;
+
+    right->leaf.next = leaf->leaf.next;
+    if (right->leaf.next)
+        right->leaf.next->leaf.prev = right;
+    right->leaf.prev = leaf;
+    leaf->leaf.next = right;
+
+    return right;
+}
+
+/** @internal
+ *  @brief Insert a separator and the child to its right into an inner node with free space.
+ *  @param[in] node The inner node.
+ *  @param[in] index The index of the child that has been split.
+ *  @param[in] separator The smallest key in @a child.
+ *  @param[in] child The new right sibling of children[index].
+ */
+static inline
+void _cu_btree_inner_insert_at(CUBTreeNode *node, uint32_t index, void *separator, CUBTreeNode *child)
+{
+    memmove(&node->keys[index + 1], &node->keys[index], (node->length - index) * sizeof(void *));
+    memmove(&node->children[index + 2], &node->children[index + 1], (node->length - index) * sizeof(CUBTreeNode *));
+    node->keys[index] = separator;
+    node->children[index + 1] = child;
+    ++node->length;
+}
+
+/** @internal
+ *  @brief Insert a separator and a child into a full inner node by splitting it.
+ *  @param[in] tree The tree.
+ *  @param[in] node The inner node.
+ *  @param[in] index The index of the child that has been split.
+ *  @param[in,out] separator The smallest key in @a child. Receives the separator for the new node.
+ *  @param[in] child The new right sibling of children[index].
+ *  @return The new right sibling of @a node.
+ */
+static
+CUBTreeNode *_cu_btree_inner_split_insert(CUBTree *tree, CUBTreeNode *node, uint32_t index,
+                                          void **separator, CUBTreeNode *child)
+{
+    void *keys[BTREE_MAX_KEYS + 1];
+    CUBTreeNode *children[BTREE_MAX_KEYS + 2];
+    const uint32_t total = BTREE_MAX_KEYS + 1;
+    const uint32_t middle = total / 2;
+
+    memcpy(keys, node->keys, index * sizeof(void *));
+    keys[index] = *separator;
+    memcpy(&keys[index + 1], &node->keys[index], (BTREE_MAX_KEYS - index) * sizeof(void *));
+
+    memcpy(children, node->children, (index + 1) * sizeof(CUBTreeNode *));
+    children[index + 1] = child;
+    memcpy(&children[index + 2], &node->children[index + 1], (BTREE_MAX_KEYS - index) * sizeof(CUBTreeNode *));
+
+    CUBTreeNode *right = _cu_btree_node_new(tree, false);
+
+    /* Keys [0, middle) stay, keys[middle] moves up, keys (middle, total) go to the right. */
+    memcpy(node->keys, keys, middle * sizeof(void *));
+    memcpy(node->children, children, (middle + 1) * sizeof(CUBTreeNode *));
+    node->length = middle;
+
+    memcpy(right->keys, &keys[middle + 1], (total - middle - 1) * sizeof(void *));
+    memcpy(right->children, &children[middle + 1], (total - middle) * sizeof(CUBTreeNode *));
+    right->length = total - middle - 1;
+
+    *separator = keys[middle];
+
+    return right;
+}
+
+void cu_btree_insert(CUBTree *tree,
+                     void *key,
+                     void *value)
+{
+    if (cu_unlikely(!tree))
+        return;
+
+    if (cu_unlikely(!tree->root)) {
+        tree->root = _cu_btree_node_new(tree, true);
+        tree->root->keys[0] = key;
+        tree->root->leaf.values[0] = value;
+        tree->root->length = 1;
+        tree->height = 1;
+        tree->length = 1;
+        return;
+    }
+
+    CUBTreePathEntry path[BTREE_MAX_HEIGHT];
+    uint32_t depth, index;
+    CUBTreeNode *leaf = _cu_btree_find_leaf_build_path(tree, key, path, &depth);
+
+    if (_cu_btree_leaf_search(tree, leaf, key, &index)) {
+        /* The key was already in the tree. Free the key and original value and set the value. */
+        if (tree->destroy_key && leaf->keys[index] != key)
+            tree->destroy_key(key);
+        if (tree->destroy_value && leaf->leaf.values[index] != value)
+            tree->destroy_value(leaf->leaf.values[index]);
+        leaf->leaf.values[index] = value;
+        return;
+    }
+
+    ++tree->length;
+
+    if (leaf->length < BTREE_MAX_KEYS) {
+        _cu_btree_leaf_insert_at(leaf, index, key, value);
+        return;
+    }
+
+    /* The leaf is full. Split it and insert the new leaf into the parent, splitting
+     * full inner nodes on the way up. */
+    CUBTreeNode *right = _cu_btree_leaf_split_insert(tree, leaf, index, key, value);
+    void *separator = right->keys[0];
+    CUBTreeNode *parent;
+
+    while (depth > 0) {
+        --depth;
+        parent = path[depth].node;
+        if (parent->length < BTREE_MAX_KEYS) {
+            _cu_btree_inner_insert_at(parent, path[depth].index, separator, right);
+            return;
+        }
+        right = _cu_btree_inner_split_insert(tree, parent, path[depth].index, &separator, right);
+    }
+
+    /* The root has been split. */
+    parent = _cu_btree_node_new(tree, false);
+    parent->keys[0] = separator;
+    parent->children[0] = tree->root;
+    parent->children[1] = right;
+    parent->length = 1;
+    tree->root = parent;
+    ++tree->height;
+}
+
+/** @internal
+ *  @brief Remove a separator and the child to its right from an inner node.
+ *  @param[in] node The inner node.
+ *  @param[in] index The index of the separator.
+ */
+static inline
+void _cu_btree_inner_remove_at(CUBTreeNode *node, uint32_t index)
+{
+    memmove(&node->keys[index], &node->keys[index + 1], (node->length - index - 1) * sizeof(void *));
+    memmove(&node->children[index + 1], &node->children[index + 2], (node->length - index - 1) * sizeof(CUBTreeNode *));
+    --node->length;
+}
+
+/** @internal
+ *  @brief Fix an underfull leaf by borrowing from or merging with a sibling.
+ *  @param[in] tree The tree.
+ *  @param[in] parent The parent of the leaf.
+ *  @param[in] index The index of the leaf in @a parent.
+ */
+static
+void _cu_btree_rebalance_leaf(CUBTree *tree, CUBTreeNode *parent, uint32_t index)
+{
+    CUBTreeNode *node = parent->children[index];
+    CUBTreeNode *left = index > 0 ? parent->children[index - 1] : NULL;
+    CUBTreeNode *right = index < parent->length ? parent->children[index + 1] : NULL;
+
+    if (left && left->length > BTREE_MIN_KEYS) {
+        /* Borrow the largest element of the left sibling. */
+        _cu_btree_leaf_insert_at(node, 0, left->keys[left->length - 1], left->leaf.values[left->length - 1]);
+        --left->length;
+        parent->keys[index - 1] = node->keys[0];
+    }
+    else if (right && right->length > BTREE_MIN_KEYS) {
+        /* Borrow the smallest element of the right sibling. */
+        node->keys[node->length] = right->keys[0];
+        node->leaf.values[node->length] = right->leaf.values[0];
+        ++node->length;
+        --right->length;
+        memmove(right->keys, &right->keys[1], right->length * sizeof(void *));
+        memmove(right->leaf.values, &right->leaf.values[1], right->length * sizeof(void *));
+        parent->keys[index] = right->keys[0];
+    }
+    else {
+        /* Merge with a sibling. Always merge the right node into the left one. */
+        if (!left) {
+            left = node;
+            node = right;
+            ++index;
+        }
+        memcpy(&left->keys[left->length], node->keys, node->length * sizeof(void *));
+        memcpy(&left->leaf.values[left->length], node->leaf.values, node->length * sizeof(void *));
+        left->length += node->length;
+        left->leaf.next = node->leaf.next;
+        if (left->leaf.next)
+            left->leaf.next->leaf.prev = left;
+        _cu_btree_inner_remove_at(parent, index - 1);
+        _cu_btree_node_free(tree, node);
+    }
+}
+
+/** @internal
+ *  @brief Fix an underfull inner node by borrowing from or merging with a sibling.
+ *  @param[in] tree The tree.
+ *  @param[in] parent The parent of the node.
+ *  @param[in] index The index of the node in @a parent.
+ */
+static
+void _cu_btree_rebalance_inner(CUBTree *tree, CUBTreeNode *parent, uint32_t index)
+{
+    CUBTreeNode *node = parent->children[index];
+    CUBTreeNode *left = index > 0 ? parent->children[index - 1] : NULL;
+    CUBTreeNode *right = index < parent->length ? parent->children[index + 1] : NULL;
+
+    if (left && left->length > BTREE_MIN_KEYS) {
+        /* Rotate the last child of the left sibling over the separator. */
+        memmove(&node->keys[1], node->keys, node->length * sizeof(void *));
+        memmove(&node->children[1], node->children, (node->length + 1) * sizeof(CUBTreeNode *));
+        node->keys[0] = parent->keys[index - 1];
+        node->children[0] = left->children[left->length];
+        ++node->length;
+        parent->keys[index - 1] = left->keys[left->length - 1];
+        --left->length;
+    }
+    else if (right && right->length > BTREE_MIN_KEYS) {
+        /* Rotate the first child of the right sibling over the separator. */
+        node->keys[node->length] = parent->keys[index];
+        node->children[node->length + 1] = right->children[0];
+        ++node->length;
+        parent->keys[index] = right->keys[0];
+        memmove(right->keys, &right->keys[1], (right->length - 1) * sizeof(void *));
+        memmove(right->children, &right->children[1], right->length * sizeof(CUBTreeNode *));
+        --right->length;
+    }
+    else {
+        /* Merge with a sibling, pulling down the separator. */
+        if (!left) {
+            left = node;
+            node = right;
+            ++index;
+        }
+        left->keys[left->length] = parent->keys[index - 1];
+        memcpy(&left->keys[left->length + 1], node->keys, node->length * sizeof(void *));
+        memcpy(&left->children[left->length + 1], node->children, (node->length + 1) * sizeof(CUBTreeNode *));
+        left->length += node->length + 1;
+        _cu_btree_inner_remove_at(parent, index - 1);
+        _cu_btree_node_free(tree, node);
+    }
+}
+
+bool cu_btree_remove(CUBTree *tree, void *key)
+{
+    if (cu_unlikely(!tree || !tree->root))
+        return false;
+
+    CUBTreePathEntry path[BTREE_MAX_HEIGHT];
+    uint32_t depth, index, d;
+    CUBTreeNode *node = _cu_btree_find_leaf_build_path(tree, key, path, &depth);
+
+    if (!_cu_btree_leaf_search(tree, node, key, &index))
+        return false;
+
+    if (tree->destroy_key)
+        tree->destroy_key(node->keys[index]);
+    if (tree->destroy_value)
+        tree->destroy_value(node->leaf.values[index]);
+
+    --node->length;
+    memmove(&node->keys[index], &node->keys[index + 1], (node->length - index) * sizeof(void *));
+    memmove(&node->leaf.values[index], &node->leaf.values[index + 1], (node->length - index) * sizeof(void *));
+    --tree->length;
+
+    if (depth == 0) {
+        /* The leaf is the root. */
+        if (node->length == 0) {
+            _cu_btree_node_free(tree, node);
+            tree->root = NULL;
+            tree->height = 0;
+        }
+        return true;
+    }
+
+    /* Separators reference the smallest key of their right subtree. If we removed this key,
+     * the separator has to be replaced, as the key itself might have been freed. The separator
+     * is in the deepest ancestor where we did not take the leftmost child. */
+    if (index == 0) {
+        for (d = depth; d > 0; --d) {
+            if (path[d - 1].index > 0) {
+                path[d - 1].node->keys[path[d - 1].index - 1] = node->keys[0];
+                break;
+            }
+        }
+    }
+
+    while (depth > 0 && node->length < BTREE_MIN_KEYS) {
+        --depth;
+        if (node->is_leaf)
+            _cu_btree_rebalance_leaf(tree, path[depth].node, path[depth].index);
+        else
+            _cu_btree_rebalance_inner(tree, path[depth].node, path[depth].index);
+        node = path[depth].node;
+    }
+
+    if (!tree->root->is_leaf && tree->root->length == 0) {
+        /* The root has only a single child left. */
+        node = tree->root;
+        tree->root = node->children[0];
+        _cu_btree_node_free(tree, node);
+        --tree->height;
+    }
+
+    return true;
+}
+
+bool cu_btree_find(CUBTree *tree,
+                   void *key,
+                   void **data)
+{
+    if (cu_unlikely(!tree || !tree->root))
+        return false;
+
+    uint32_t index;
+    CUBTreeNode *leaf = _cu_btree_find_leaf_build_path(tree, key, NULL, NULL);
+    if (_cu_btree_leaf_search(tree, leaf, key, &index)) {
+        if (data)
+            *data = leaf->leaf.values[index];
+        return true;
+    }
+    return false;
+}
+
+size_t cu_btree_length(CUBTree *tree)
+{
+    return tree ? tree->length : 0;
+}
+
+void cu_btree_foreach(CUBTree *tree,
+                      CUTraverseFunc traverse,
+                      void *userdata)
+{
+    if (!tree || !tree->root || !traverse)
+        return;
+
+    CUBTreeNode *leaf = tree->root;
+    uint32_t j;
+    while (!leaf->is_leaf)
+        leaf = leaf->children[0];
+
+    for ( ; leaf; leaf = leaf->leaf.next) {
+        for (j = 0; j < leaf->length; ++j) {
+            if (!traverse(leaf->keys[j], leaf->leaf.values[j], userdata))
+                return;
+        }
+    }
+}
+
+void cu_btree_foreach_range(CUBTree *tree,
+                            void *from,
+                            void *to,
+                            CUTraverseFunc traverse,
+                            void *userdata)
+{
+    if (!tree || !tree->root || !traverse)
+        return;
+
+    uint32_t j;
+    CUBTreeNode *leaf = _cu_btree_find_leaf_build_path(tree, from, NULL, NULL);
+    _cu_btree_leaf_search(tree, leaf, from, &j);
+
+    for ( ; leaf; leaf = leaf->leaf.next, j = 0) {
+        for ( ; j < leaf->length; ++j) {
+            /* Stop as soon as to < key. */
+            if (tree->compare(to, leaf->keys[j], tree->compare_data) > 0)
+                return;
+            if (!traverse(leaf->keys[j], leaf->leaf.values[j], userdata))
+                return;
+        }
+    }
+}
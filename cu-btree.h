@@ -0,0 +1,117 @@
+/** @file cu-btree.h
+ *  Provide an ordered map as a B+-tree with wide nodes.
+ *  @defgroup CUBTree B+-tree
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to a B+-tree.
+ *  @details A B+-tree keeps many keys in each node, so that a lookup touches only a few
+ *           nodes, each of them spanning a few cache lines. All elements are stored in the
+ *           leaves, which are linked for fast ordered scans. Keys, values, compare and destroy
+ *           functions behave exactly as for @a CUAVLTree.
+ */
+typedef struct _CUBTree CUBTree;
+
+/** @brief Create a new B+-tree, with full control.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @param[in] use_fixed_memory_pool Whether to use a fixed size memory pool or cu_alloc()/cu_free().
+ *  @return Pointer to a newly created B+-tree.
+ */
+CUBTree *cu_btree_new_full(CUCompareDataFunc compare,
+                           void *compare_data,
+                           CUDestroyNotifyFunc destroy_key,
+                           CUDestroyNotifyFunc destroy_value,
+                           bool use_fixed_memory_pool);
+
+/** @brief Create a new B+-tree with fixed sized memory pool.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created B+-tree.
+ */
+CUBTree *cu_btree_new(CUCompareDataFunc compare,
+                      void *compare_data,
+                      CUDestroyNotifyFunc destroy_key,
+                      CUDestroyNotifyFunc destroy_value);
+
+/** @brief Clear a B+-tree and free resources of keys/values.
+ *  @details The tree is still initialized and may be used further.
+ *  @param[in] tree The tree to clear.
+ */
+void cu_btree_clear(CUBTree *tree);
+
+/** @brief Destroy a B+-tree and free all resources.
+ *  @param[in] tree The tree to destroy.
+ */
+void cu_btree_destroy(CUBTree *tree);
+
+/** @brief Insert a new element into a tree
+ *  @details If an element with the given @a key is already in the tree, the @a key and the old
+ *           value are destroyed. Ownership is passed to the tree.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_btree_insert(CUBTree *tree,
+                     void *key,
+                     void *value);
+
+/** @brief Remove an element from the tree and free its resources.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element to destroy.
+ *  @retval true The element was present in the tree and was destroyed.
+ *  @retval false The element was not found in the tree.
+ */
+bool cu_btree_remove(CUBTree *tree, void *key);
+
+/** @brief Find an element in the tree.
+ *  @param[in] tree The tree.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with a pointer to the value, if @a key was found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the tree.
+ */
+bool cu_btree_find(CUBTree *tree,
+                   void *key,
+                   void **data);
+
+/** @brief Return the number of elements in the tree.
+ *  @param[in] tree The tree.
+ *  @return The number of elements.
+ */
+size_t cu_btree_length(CUBTree *tree);
+
+/** @brief Call a function for each element in the tree.
+ *  @details The tree is processed in order.
+ *  @param[in] tree The tree.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_btree_foreach(CUBTree *tree,
+                      CUTraverseFunc traverse,
+                      void *userdata);
+
+/** @brief Call a function for each element with a key in a given range.
+ *  @details The range is processed in order, following the links between the leaves.
+ *  @param[in] tree The tree.
+ *  @param[in] from The smallest key to visit (inclusive).
+ *  @param[in] to The largest key to visit (inclusive).
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_btree_foreach_range(CUBTree *tree,
+                            void *from,
+                            void *to,
+                            CUTraverseFunc traverse,
+                            void *userdata);
+
+/** @} */
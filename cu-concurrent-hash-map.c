@@ -0,0 +1,509 @@
+#include "cu-concurrent-hash-map.h"
+#include "cu-epoch.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* The highest bits of the hash select one of 2^SHARD_BITS shards. */
+#define SHARD_BITS 6
+#define SHARD_COUNT (1 << SHARD_BITS)
+
+/* Initial number of buckets of each shard. */
+#define MIN_BUCKETS 16
+
+/* Number of old buckets moved to the new array by each write during a resize. */
+#define MIGRATE_STEP 32
+
+/* Readers take the lock after this many failed optimistic attempts. */
+#define OPTIMISTIC_RETRIES 8
+
+/* Size of a cache line, to keep shards apart. */
+#define CACHE_LINE 64
+
+/* Kinds of retired objects. */
+typedef enum {
+    RETIRED_NODE = 0, /* A removed element. */
+    RETIRED_VALUE, /* A node only holding a replaced value. */
+    RETIRED_BUCKETS /* A bucket array after resizing. */
+} CUConcurrentHashMapRetiredKind;
+
+typedef struct _CUConcurrentHashMapNode CUConcurrentHashMapNode;
+/** @internal
+ *  @brief An element in the chain of a bucket.
+ */
+struct _CUConcurrentHashMapNode {
+    CUEpochEntry retired; /**< Link for deferred freeing. */
+    uint32_t kind; /**< RETIRED_NODE or RETIRED_VALUE. */
+    uint32_t hash; /**< The lower bits of the mixed hash, select the bucket. */
+    CUConcurrentHashMapNode *next; /**< The next element in the bucket. */
+    void *key;
+    void *value;
+};
+
+/** @internal
+ *  @brief An array of buckets.
+ */
+typedef struct {
+    CUEpochEntry retired; /**< Link for deferred freeing. */
+    uint32_t kind; /**< RETIRED_BUCKETS. */
+    size_t size; /**< Number of buckets, a power of two. */
+    CUConcurrentHashMapNode *buckets[];
+} CUConcurrentHashMapBuckets;
+
+/** @internal
+ *  @brief A part of the map with its own lock.
+ */
+typedef struct {
+    pthread_mutex_t lock; /**< Held by writers. */
+    uint32_t seq; /**< Odd while a writer changes the shard. */
+    CUConcurrentHashMapBuckets *table; /**< The current buckets. */
+    CUConcurrentHashMapBuckets *old_table; /**< The previous buckets during a resize, else NULL. */
+    size_t migrated; /**< The buckets of @a old_table before this one have been moved. */
+    size_t length; /**< Number of elements in the shard. */
+    char padding[CACHE_LINE];
+} CUConcurrentHashMapShard;
+
+struct _CUConcurrentHashMap {
+    CUConcurrentHashMapShard shards[SHARD_COUNT];
+
+    CUHashFunc hash;
+    CUEqualFunc equal;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+
+    CUEpoch *epoch; /**< Delays freeing removed nodes and old buckets until no reader can access them. */
+};
+
+/** @internal
+ *  @brief Mix the bits of a hash, so that weak hashes (like pointers) spread over all shards and buckets.
+ */
+static inline
+uint64_t _cu_concurrent_hash_map_hash(CUConcurrentHashMap *map, void *key)
+{
+    uint64_t hash = map->hash ? map->hash(key) : (uint64_t)(uintptr_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/** @internal
+ *  @brief Compare two keys for equality.
+ */
+static inline
+bool _cu_concurrent_hash_map_equal(CUConcurrentHashMap *map, void *a, void *b)
+{
+    return a == b || (map->equal && map->equal(a, b));
+}
+
+/** @internal
+ *  @brief Allocate an empty bucket array.
+ */
+static
+CUConcurrentHashMapBuckets *_cu_concurrent_hash_map_buckets_new(size_t size)
+{
+    CUConcurrentHashMapBuckets *table = cu_alloc0(sizeof(CUConcurrentHashMapBuckets) +
+                                                  size * sizeof(CUConcurrentHashMapNode *));
+    table->kind = RETIRED_BUCKETS;
+    table->size = size;
+    return table;
+}
+
+/** @internal
+ *  @brief Free an object after no reader can access it any more.
+ */
+static
+void _cu_concurrent_hash_map_free_retired(CUEpochEntry *entry, CUConcurrentHashMap *map)
+{
+    /* All retired objects start with the entry followed by their kind. */
+    CUConcurrentHashMapNode *node = (CUConcurrentHashMapNode *)((char *)entry - offsetof(CUConcurrentHashMapNode, retired));
+
+    switch (node->kind) {
+        case RETIRED_NODE:
+            if (map->destroy_key)
+                map->destroy_key(node->key);
+            /* fall through */
+        case RETIRED_VALUE:
+            if (map->destroy_value)
+                map->destroy_value(node->value);
+            break;
+    }
+    cu_free(node);
+}
+
+/** @internal
+ *  @brief Start changing a shard. The lock must be held.
+ */
+static inline
+void _cu_concurrent_hash_map_write_begin(CUConcurrentHashMapShard *shard)
+{
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** @internal
+ *  @brief Finish changing a shard.
+ */
+static inline
+void _cu_concurrent_hash_map_write_end(CUConcurrentHashMapShard *shard)
+{
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+}
+
+/** @internal
+ *  @brief Search a key in the chain of its bucket.
+ *  @return The node of the key, or @a NULL.
+ */
+static inline
+CUConcurrentHashMapNode *_cu_concurrent_hash_map_search(CUConcurrentHashMap *map,
+                                                        CUConcurrentHashMapBuckets *table,
+                                                        void *key,
+                                                        uint32_t hash)
+{
+    CUConcurrentHashMapNode *node = __atomic_load_n(&table->buckets[hash & (table->size - 1)], __ATOMIC_ACQUIRE);
+    while (node) {
+        if (node->hash == hash && _cu_concurrent_hash_map_equal(map, node->key, key))
+            return node;
+        node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+/** @internal
+ *  @brief Search a key in the current and, during a resize, the old buckets of a shard.
+ *  @details Without the lock, the result is only valid if the shard did not change meanwhile.
+ */
+static inline
+CUConcurrentHashMapNode *_cu_concurrent_hash_map_shard_search(CUConcurrentHashMap *map,
+                                                              CUConcurrentHashMapShard *shard,
+                                                              void *key,
+                                                              uint32_t hash)
+{
+    CUConcurrentHashMapNode *node;
+    CUConcurrentHashMapBuckets *table;
+
+    node = _cu_concurrent_hash_map_search(map, __atomic_load_n(&shard->table, __ATOMIC_ACQUIRE), key, hash);
+    if (node)
+        return node;
+    table = __atomic_load_n(&shard->old_table, __ATOMIC_ACQUIRE);
+    return table ? _cu_concurrent_hash_map_search(map, table, key, hash) : NULL;
+}
+
+/** @internal
+ *  @brief Move some buckets of the old array to the new one.
+ *  @details Must be called between _cu_concurrent_hash_map_write_begin() and _cu_concurrent_hash_map_write_end(),
+ *           inside a critical section.
+ *  @param[in] map The map.
+ *  @param[in] shard The shard.
+ *  @param[in] count The number of old buckets to move.
+ */
+static
+void _cu_concurrent_hash_map_migrate(CUConcurrentHashMap *map, CUConcurrentHashMapShard *shard, size_t count)
+{
+    CUConcurrentHashMapBuckets *old_table = shard->old_table;
+    CUConcurrentHashMapBuckets *table = shard->table;
+    CUConcurrentHashMapNode *node, *next, **bucket;
+
+    if (!old_table)
+        return;
+
+    while (count-- && shard->migrated < old_table->size) {
+        node = old_table->buckets[shard->migrated];
+        __atomic_store_n(&old_table->buckets[shard->migrated], NULL, __ATOMIC_RELAXED);
+        while (node) {
+            next = node->next;
+            bucket = &table->buckets[node->hash & (table->size - 1)];
+            __atomic_store_n(&node->next, *bucket, __ATOMIC_RELEASE);
+            __atomic_store_n(bucket, node, __ATOMIC_RELEASE);
+            node = next;
+        }
+        ++shard->migrated;
+    }
+
+    if (shard->migrated == old_table->size) {
+        __atomic_store_n(&shard->old_table, NULL, __ATOMIC_RELEASE);
+        cu_epoch_retire(map->epoch, &old_table->retired);
+    }
+}
+
+/** @internal
+ *  @brief Start moving a shard to twice the number of buckets.
+ *  @details Same requirements as _cu_concurrent_hash_map_migrate().
+ */
+static
+void _cu_concurrent_hash_map_grow(CUConcurrentHashMap *map, CUConcurrentHashMapShard *shard)
+{
+    /* Finish a resize still in progress first. */
+    if (shard->old_table)
+        _cu_concurrent_hash_map_migrate(map, shard, shard->old_table->size);
+
+    shard->migrated = 0;
+    __atomic_store_n(&shard->old_table, shard->table, __ATOMIC_RELEASE);
+    __atomic_store_n(&shard->table, _cu_concurrent_hash_map_buckets_new(2 * shard->table->size), __ATOMIC_RELEASE);
+}
+
+/** @internal
+ *  @brief Retire all nodes of a bucket array and empty it.
+ */
+static
+void _cu_concurrent_hash_map_retire_buckets(CUConcurrentHashMap *map, CUConcurrentHashMapBuckets *table)
+{
+    CUConcurrentHashMapNode *node, *next;
+    size_t j;
+
+    for (j = 0; j < table->size; ++j) {
+        node = table->buckets[j];
+        __atomic_store_n(&table->buckets[j], NULL, __ATOMIC_RELAXED);
+        while (node) {
+            next = node->next;
+            cu_epoch_retire(map->epoch, &node->retired);
+            node = next;
+        }
+    }
+}
+
+CUConcurrentHashMap *cu_concurrent_hash_map_new(CUHashFunc hash,
+                                                CUEqualFunc equal,
+                                                CUDestroyNotifyFunc destroy_key,
+                                                CUDestroyNotifyFunc destroy_value)
+{
+    CUConcurrentHashMap *map = cu_alloc0(sizeof(CUConcurrentHashMap));
+    uint32_t j;
+
+    map->hash = hash;
+    map->equal = equal;
+    map->destroy_key = destroy_key;
+    map->destroy_value = destroy_value;
+    map->epoch = cu_epoch_new((CUEpochFreeFunc)_cu_concurrent_hash_map_free_retired, map);
+
+    for (j = 0; j < SHARD_COUNT; ++j) {
+        pthread_mutex_init(&map->shards[j].lock, NULL);
+        map->shards[j].table = _cu_concurrent_hash_map_buckets_new(MIN_BUCKETS);
+    }
+
+    return map;
+}
+
+void cu_concurrent_hash_map_clear(CUConcurrentHashMap *map)
+{
+    if (cu_unlikely(!map))
+        return;
+
+    CUConcurrentHashMapShard *shard;
+    uint32_t j;
+
+    uint32_t guard = cu_epoch_enter(map->epoch);
+    for (j = 0; j < SHARD_COUNT; ++j) {
+        shard = &map->shards[j];
+        pthread_mutex_lock(&shard->lock);
+        _cu_concurrent_hash_map_write_begin(shard);
+
+        _cu_concurrent_hash_map_retire_buckets(map, shard->table);
+        if (shard->old_table) {
+            _cu_concurrent_hash_map_retire_buckets(map, shard->old_table);
+            cu_epoch_retire(map->epoch, &shard->old_table->retired);
+            __atomic_store_n(&shard->old_table, NULL, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&shard->length, 0, __ATOMIC_RELAXED);
+
+        _cu_concurrent_hash_map_write_end(shard);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    cu_epoch_leave(map->epoch, guard);
+}
+
+void cu_concurrent_hash_map_destroy(CUConcurrentHashMap *map)
+{
+    if (cu_unlikely(!map))
+        return;
+
+    uint32_t j;
+
+    cu_concurrent_hash_map_clear(map);
+    cu_epoch_destroy(map->epoch);
+    for (j = 0; j < SHARD_COUNT; ++j) {
+        cu_free(map->shards[j].table);
+        pthread_mutex_destroy(&map->shards[j].lock);
+    }
+    cu_free(map);
+}
+
+void cu_concurrent_hash_map_insert(CUConcurrentHashMap *map,
+                                   void *key,
+                                   void *value)
+{
+    if (cu_unlikely(!map))
+        return;
+
+    uint64_t hash = _cu_concurrent_hash_map_hash(map, key);
+    CUConcurrentHashMapShard *shard = &map->shards[hash >> (64 - SHARD_BITS)];
+    CUConcurrentHashMapNode *node, **bucket;
+
+    uint32_t guard = cu_epoch_enter(map->epoch);
+    pthread_mutex_lock(&shard->lock);
+    _cu_concurrent_hash_map_write_begin(shard);
+
+    _cu_concurrent_hash_map_migrate(map, shard, MIGRATE_STEP);
+
+    node = _cu_concurrent_hash_map_shard_search(map, shard, key, (uint32_t)hash);
+    if (node) {
+        /* Readers may still use the old value, so destroy it later. */
+        void *old_value = node->value;
+        __atomic_store_n(&node->value, value, __ATOMIC_RELEASE);
+        if (map->destroy_key && node->key != key)
+            map->destroy_key(key);
+        if (map->destroy_value && old_value != value) {
+            CUConcurrentHashMapNode *holder = cu_alloc0(sizeof(CUConcurrentHashMapNode));
+            holder->kind = RETIRED_VALUE;
+            holder->value = old_value;
+            cu_epoch_retire(map->epoch, &holder->retired);
+        }
+    }
+    else {
+        node = cu_alloc(sizeof(CUConcurrentHashMapNode));
+        node->kind = RETIRED_NODE;
+        node->hash = (uint32_t)hash;
+        node->key = key;
+        node->value = value;
+        bucket = &shard->table->buckets[node->hash & (shard->table->size - 1)];
+        node->next = *bucket;
+        __atomic_store_n(bucket, node, __ATOMIC_RELEASE);
+
+        if (__atomic_add_fetch(&shard->length, 1, __ATOMIC_RELAXED) > shard->table->size)
+            _cu_concurrent_hash_map_grow(map, shard);
+    }
+
+    _cu_concurrent_hash_map_write_end(shard);
+    pthread_mutex_unlock(&shard->lock);
+    cu_epoch_leave(map->epoch, guard);
+}
+
+bool cu_concurrent_hash_map_remove(CUConcurrentHashMap *map, void *key)
+{
+    if (cu_unlikely(!map))
+        return false;
+
+    uint64_t hash = _cu_concurrent_hash_map_hash(map, key);
+    CUConcurrentHashMapShard *shard = &map->shards[hash >> (64 - SHARD_BITS)];
+    CUConcurrentHashMapBuckets *tables[2];
+    CUConcurrentHashMapNode *node, **link;
+    bool found = false;
+    uint32_t j;
+
+    uint32_t guard = cu_epoch_enter(map->epoch);
+    pthread_mutex_lock(&shard->lock);
+    _cu_concurrent_hash_map_write_begin(shard);
+
+    _cu_concurrent_hash_map_migrate(map, shard, MIGRATE_STEP);
+
+    tables[0] = shard->table;
+    tables[1] = shard->old_table;
+    for (j = 0; j < 2 && tables[j] && !found; ++j) {
+        link = &tables[j]->buckets[(uint32_t)hash & (tables[j]->size - 1)];
+        for (node = *link; node; link = &node->next, node = node->next) {
+            if (node->hash == (uint32_t)hash && _cu_concurrent_hash_map_equal(map, node->key, key)) {
+                __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+                cu_epoch_retire(map->epoch, &node->retired);
+                __atomic_sub_fetch(&shard->length, 1, __ATOMIC_RELAXED);
+                found = true;
+                break;
+            }
+        }
+    }
+
+    _cu_concurrent_hash_map_write_end(shard);
+    pthread_mutex_unlock(&shard->lock);
+    cu_epoch_leave(map->epoch, guard);
+
+    return found;
+}
+
+bool cu_concurrent_hash_map_find(CUConcurrentHashMap *map,
+                                 void *key,
+                                 void **data)
+{
+    if (cu_unlikely(!map))
+        return false;
+
+    uint64_t hash = _cu_concurrent_hash_map_hash(map, key);
+    CUConcurrentHashMapShard *shard = &map->shards[hash >> (64 - SHARD_BITS)];
+    CUConcurrentHashMapNode *node;
+    void *value = NULL;
+    uint32_t seq, tries;
+
+    uint32_t guard = cu_epoch_enter(map->epoch);
+
+    for (tries = 0; ; ++tries) {
+        if (cu_unlikely(tries == OPTIMISTIC_RETRIES)) {
+            /* Too many concurrent writes, wait for our turn. */
+            pthread_mutex_lock(&shard->lock);
+            node = _cu_concurrent_hash_map_shard_search(map, shard, key, (uint32_t)hash);
+            if (node)
+                value = node->value;
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+
+        seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        /* The nodes cannot be freed while we are in the critical section, but they may move
+         * between buckets. A changed sequence number tells us to look again. */
+        node = _cu_concurrent_hash_map_shard_search(map, shard, key, (uint32_t)hash);
+        if (node)
+            value = __atomic_load_n(&node->value, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (cu_likely(__atomic_load_n(&shard->seq, __ATOMIC_RELAXED) == seq))
+            break;
+    }
+
+    cu_epoch_leave(map->epoch, guard);
+
+    if (node && data)
+        *data = value;
+    return node != NULL;
+}
+
+void cu_concurrent_hash_map_foreach(CUConcurrentHashMap *map,
+                                    CUTraverseFunc traverse,
+                                    void *userdata)
+{
+    if (cu_unlikely(!map || !traverse))
+        return;
+
+    CUConcurrentHashMapShard *shard;
+    CUConcurrentHashMapBuckets *tables[2];
+    CUConcurrentHashMapNode *node;
+    uint32_t j, t;
+    size_t k;
+    bool stop = false;
+
+    for (j = 0; j < SHARD_COUNT && !stop; ++j) {
+        shard = &map->shards[j];
+        pthread_mutex_lock(&shard->lock);
+        tables[0] = shard->table;
+        tables[1] = shard->old_table;
+        for (t = 0; t < 2 && tables[t] && !stop; ++t) {
+            for (k = 0; k < tables[t]->size && !stop; ++k) {
+                for (node = tables[t]->buckets[k]; node && !stop; node = node->next)
+                    stop = !traverse(node->key, node->value, userdata);
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+size_t cu_concurrent_hash_map_length(CUConcurrentHashMap *map)
+{
+    if (cu_unlikely(!map))
+        return 0;
+
+    size_t length = 0;
+    uint32_t j;
+    for (j = 0; j < SHARD_COUNT; ++j)
+        length += __atomic_load_n(&map->shards[j].length, __ATOMIC_RELAXED);
+    return length;
+}
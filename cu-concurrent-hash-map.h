@@ -0,0 +1,97 @@
+/** @file cu-concurrent-hash-map.h
+ *  Provide a hash map shared by many threads.
+ *  @defgroup CUConcurrentHashMap Concurrent hash map
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to a concurrent hash map.
+ *  @details The map is split into shards by the hash of the keys. Each shard has its own lock
+ *           for writers, while readers do not lock at all: they search optimistically and retry
+ *           if a writer changed the shard meanwhile (seqlock). A shard that gets too full is
+ *           moved to a larger bucket array a few buckets per write, so no single insert has to
+ *           rehash a whole shard. Removed elements are destroyed once no thread can still be
+ *           accessing them.
+ */
+typedef struct _CUConcurrentHashMap CUConcurrentHashMap;
+
+/** @brief Create a new concurrent hash map.
+ *  @param[in] hash Function to compute the hash of a key. If not specified, the pointer value
+ *                  is hashed.
+ *  @param[in] equal Function to check two keys for equality. If not specified, the pointer values
+ *                   are compared.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created map.
+ */
+CUConcurrentHashMap *cu_concurrent_hash_map_new(CUHashFunc hash,
+                                                CUEqualFunc equal,
+                                                CUDestroyNotifyFunc destroy_key,
+                                                CUDestroyNotifyFunc destroy_value);
+
+/** @brief Remove all elements from a map.
+ *  @details The shards are cleared one after another, so concurrent inserts may survive.
+ *  @param[in] map The map.
+ */
+void cu_concurrent_hash_map_clear(CUConcurrentHashMap *map);
+
+/** @brief Destroy a map and free all resources.
+ *  @details No other thread may access the map at the same time.
+ *  @param[in] map The map to destroy.
+ */
+void cu_concurrent_hash_map_destroy(CUConcurrentHashMap *map);
+
+/** @brief Insert a new element into a map.
+ *  @details If an element with the given @a key is already in the map, the @a key and the old
+ *           value are destroyed. Ownership is passed to the map.
+ *  @param[in] map The map.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_concurrent_hash_map_insert(CUConcurrentHashMap *map,
+                                   void *key,
+                                   void *value);
+
+/** @brief Remove an element from a map.
+ *  @details Key and value are destroyed when no other thread can access them any more.
+ *  @param[in] map The map.
+ *  @param[in] key The key of the element to be removed.
+ *  @retval true The element was removed.
+ *  @retval false The element was not in the map.
+ */
+bool cu_concurrent_hash_map_remove(CUConcurrentHashMap *map, void *key);
+
+/** @brief Find an element in a map.
+ *  @details If other threads may remove the element concurrently, the caller has to make sure
+ *           that the value stays valid, e.g. by not setting a function to destroy values.
+ *  @param[in] map The map.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with the value of the element, if found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the map.
+ */
+bool cu_concurrent_hash_map_find(CUConcurrentHashMap *map,
+                                 void *key,
+                                 void **data);
+
+/** @brief Call a function for all elements of a map, in no particular order.
+ *  @details Each shard is locked while its elements are visited, so @a traverse must not
+ *           modify the map.
+ *  @param[in] map The map.
+ *  @param[in] traverse The function called for each element. If it returns @a false, stop.
+ *  @param[in] userdata Pointer passed as third argument to @a traverse.
+ */
+void cu_concurrent_hash_map_foreach(CUConcurrentHashMap *map,
+                                    CUTraverseFunc traverse,
+                                    void *userdata);
+
+/** @brief Return the number of elements in a map.
+ *  @details With concurrent updates, this is only a snapshot.
+ *  @param[in] map The map.
+ *  @return The number of elements.
+ */
+size_t cu_concurrent_hash_map_length(CUConcurrentHashMap *map);
+
+/** @} */
@@ -0,0 +1,149 @@
+#include "cu-epoch.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+
+/* Number of counter pairs, threads are spread over them to avoid contention. */
+#define CU_EPOCH_STRIPES 16
+
+/* Try to advance the epoch after this many elements were retired. */
+#define CU_EPOCH_ADVANCE_INTERVAL 64
+
+/* Size of a cache line, to keep counters of different stripes apart. */
+#define CU_EPOCH_CACHE_LINE 64
+
+/** @internal
+ *  @brief Number of threads inside a critical section, by the parity of the epoch they entered.
+ */
+typedef struct {
+    uint64_t active[2];
+    char padding[CU_EPOCH_CACHE_LINE - 2 * sizeof(uint64_t)];
+} CUEpochStripe;
+
+struct _CUEpoch {
+    uint64_t epoch; /**< The global epoch. */
+    char padding[CU_EPOCH_CACHE_LINE - sizeof(uint64_t)];
+
+    CUEpochStripe stripes[CU_EPOCH_STRIPES];
+
+    /* Elements retired in the epochs e, e - 1 and e - 2, at index e % 3. When the epoch advances
+     * to e + 1, no thread can still be in e - 1, so the list at (e + 2) % 3 can be freed and
+     * is reused for e + 1. */
+    CUEpochEntry *limbo[3];
+    uint64_t retired_count; /**< Number of retired elements, to trigger advancing the epoch. */
+
+    CUEpochFreeFunc free_entry;
+    void *userdata;
+};
+
+/* The stripe of each thread, assigned round robin. */
+static uint32_t _cu_epoch_next_stripe;
+static __thread uint32_t _cu_epoch_thread_stripe = UINT32_MAX;
+
+/** @internal
+ *  @brief Return the stripe of the calling thread.
+ */
+static inline
+uint32_t _cu_epoch_get_stripe(void)
+{
+    if (cu_unlikely(_cu_epoch_thread_stripe == UINT32_MAX))
+        _cu_epoch_thread_stripe = __atomic_fetch_add(&_cu_epoch_next_stripe, 1, __ATOMIC_RELAXED) % CU_EPOCH_STRIPES;
+    return _cu_epoch_thread_stripe;
+}
+
+/** @internal
+ *  @brief Free a list of retired elements.
+ */
+static
+void _cu_epoch_free_list(CUEpoch *epoch, CUEpochEntry *entry)
+{
+    CUEpochEntry *next;
+    while (entry) {
+        next = entry->next;
+        epoch->free_entry(entry, epoch->userdata);
+        entry = next;
+    }
+}
+
+/** @internal
+ *  @brief Advance the epoch if no thread is left in the previous one.
+ *  @param[in] epoch The epoch domain.
+ *  @retval true The epoch was advanced.
+ *  @retval false Some thread is still in the previous epoch, or another thread advanced it.
+ */
+static
+bool _cu_epoch_try_advance(CUEpoch *epoch)
+{
+    uint64_t current = __atomic_load_n(&epoch->epoch, __ATOMIC_SEQ_CST);
+    uint32_t j;
+
+    /* Threads in the epoch before the current one have the other parity. */
+    for (j = 0; j < CU_EPOCH_STRIPES; ++j) {
+        if (__atomic_load_n(&epoch->stripes[j].active[(current + 1) & 1], __ATOMIC_SEQ_CST))
+            return false;
+    }
+    if (!__atomic_compare_exchange_n(&epoch->epoch, &current, current + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return false;
+
+    _cu_epoch_free_list(epoch, __atomic_exchange_n(&epoch->limbo[(current + 2) % 3], NULL, __ATOMIC_ACQUIRE));
+    return true;
+}
+
+CUEpoch *cu_epoch_new(CUEpochFreeFunc free_entry, void *userdata)
+{
+    CUEpoch *epoch = cu_alloc0(sizeof(CUEpoch));
+    epoch->free_entry = free_entry;
+    epoch->userdata = userdata;
+    return epoch;
+}
+
+void cu_epoch_destroy(CUEpoch *epoch)
+{
+    if (cu_unlikely(!epoch))
+        return;
+    cu_epoch_reclaim(epoch);
+    cu_free(epoch);
+}
+
+uint32_t cu_epoch_enter(CUEpoch *epoch)
+{
+    uint32_t stripe = _cu_epoch_get_stripe();
+    uint64_t current;
+
+    /* Announce the epoch we observed. If it changed meanwhile, the announcement may have come too late
+     * for a thread advancing the epoch, so try again with the new one. */
+    for (;;) {
+        current = __atomic_load_n(&epoch->epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&epoch->stripes[stripe].active[current & 1], 1, __ATOMIC_SEQ_CST);
+        if (cu_likely(__atomic_load_n(&epoch->epoch, __ATOMIC_SEQ_CST) == current))
+            break;
+        __atomic_fetch_sub(&epoch->stripes[stripe].active[current & 1], 1, __ATOMIC_RELEASE);
+    }
+
+    return (stripe << 1) | (uint32_t)(current & 1);
+}
+
+void cu_epoch_leave(CUEpoch *epoch, uint32_t guard)
+{
+    __atomic_fetch_sub(&epoch->stripes[guard >> 1].active[guard & 1], 1, __ATOMIC_RELEASE);
+}
+
+void cu_epoch_retire(CUEpoch *epoch, CUEpochEntry *entry)
+{
+    uint64_t current = __atomic_load_n(&epoch->epoch, __ATOMIC_SEQ_CST);
+    CUEpochEntry **head = &epoch->limbo[current % 3];
+
+    entry->next = __atomic_load_n(head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(head, &entry->next, entry, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    if (__atomic_add_fetch(&epoch->retired_count, 1, __ATOMIC_RELAXED) % CU_EPOCH_ADVANCE_INTERVAL == 0)
+        _cu_epoch_try_advance(epoch);
+}
+
+void cu_epoch_reclaim(CUEpoch *epoch)
+{
+    uint32_t j;
+    for (j = 0; j < 3; ++j)
+        _cu_epoch_free_list(epoch, __atomic_exchange_n(&epoch->limbo[j], NULL, __ATOMIC_ACQUIRE));
+}
@@ -0,0 +1,75 @@
+/** @file cu-epoch.h
+ *  Epoch based reclamation of memory shared between threads.
+ *  @defgroup CUEpoch Epoch based reclamation
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+
+/** @brief Handle to an epoch domain.
+ *  @details Threads reading a lock-free structure enclose each access in cu_epoch_enter() and
+ *           cu_epoch_leave(). Elements removed from the structure are passed to cu_epoch_retire()
+ *           and freed once no thread can still be reading them, i.e. after every thread that
+ *           was inside a critical section at the time of the removal has left it.
+ */
+typedef struct _CUEpoch CUEpoch;
+
+typedef struct _CUEpochEntry CUEpochEntry;
+/** @brief Link of a retired element.
+ *  @details Embed this into elements that may be retired. It is only used after the element
+ *           was removed from the shared structure.
+ */
+struct _CUEpochEntry {
+    CUEpochEntry *next; /**< The next entry retired in the same epoch. */
+};
+
+/** @brief Free a retired element.
+ *  @param[in] 1 The entry embedded in the element.
+ *  @param[in] 2 Pointer to user defined data.
+ */
+typedef void (*CUEpochFreeFunc)(CUEpochEntry *, void *);
+
+/** @brief Create a new epoch domain.
+ *  @param[in] free_entry Function called for each retired element once it is safe to free it.
+ *  @param[in] userdata Pointer passed as second argument to @a free_entry.
+ *  @return The new epoch domain.
+ */
+CUEpoch *cu_epoch_new(CUEpochFreeFunc free_entry, void *userdata);
+
+/** @brief Free all retired elements and the epoch domain.
+ *  @details No thread may be inside a critical section.
+ *  @param[in] epoch The epoch domain.
+ */
+void cu_epoch_destroy(CUEpoch *epoch);
+
+/** @brief Enter a critical section.
+ *  @details Elements retired after this call are not freed until the section is left.
+ *           Critical sections must not be nested.
+ *  @param[in] epoch The epoch domain.
+ *  @return A guard that has to be passed to cu_epoch_leave().
+ */
+uint32_t cu_epoch_enter(CUEpoch *epoch);
+
+/** @brief Leave a critical section.
+ *  @param[in] epoch The epoch domain.
+ *  @param[in] guard The guard returned by cu_epoch_enter().
+ */
+void cu_epoch_leave(CUEpoch *epoch, uint32_t guard);
+
+/** @brief Pass an element that was removed from a shared structure for deferred freeing.
+ *  @details Must be called inside a critical section, after the element became unreachable
+ *           for threads entering a new critical section. From time to time, this advances
+ *           the epoch and frees the elements that are safe to free.
+ *  @param[in] epoch The epoch domain.
+ *  @param[in] entry The entry embedded in the removed element.
+ */
+void cu_epoch_retire(CUEpoch *epoch, CUEpochEntry *entry);
+
+/** @brief Free all retired elements.
+ *  @details No thread may be inside a critical section.
+ *  @param[in] epoch The epoch domain.
+ */
+void cu_epoch_reclaim(CUEpoch *epoch);
+
+/** @} */
@@ -0,0 +1,429 @@
+#include "cu-hash-table.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of control bytes compared at once. */
+#define GROUP_WIDTH 16
+
+/* Control bytes of free slots have the highest bit set, full ones hold 7 bits of the hash. */
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+/* The smallest number of slots of a non-empty table. Must be at least GROUP_WIDTH. */
+#define MIN_CAPACITY 16
+
+/** @internal
+ *  @brief A slot of the table.
+ */
+typedef struct {
+    void *key; /**< The key, stored inline. */
+    void *value; /**< The value. */
+} CUHashTableSlot;
+
+struct _CUHashTable {
+    /* One control byte per slot, followed by a copy of the first GROUP_WIDTH ones, so that
+     * a group starting at any slot can be loaded without wrapping around. */
+    int8_t *ctrl;
+    CUHashTableSlot *slots;
+    size_t capacity; /**< Number of slots, 0 or a power of two. */
+    size_t length; /**< Number of elements. */
+    size_t growth_left; /**< Number of empty slots that may be filled before growing. */
+
+    CUHashFunc hash;
+    CUEqualFunc equal;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+};
+
+/** @internal
+ *  @brief Return a bit mask of the slots in the group starting at @a ctrl with control byte @a value.
+ */
+static inline
+uint32_t _cu_hash_table_group_match(const int8_t *ctrl, int8_t value)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    uint32_t j;
+    for (j = 0; j < GROUP_WIDTH; ++j)
+        mask |= (uint32_t)(ctrl[j] == value) << j;
+    return mask;
+#endif
+}
+
+/** @internal
+ *  @brief Return a bit mask of the empty or deleted slots in the group starting at @a ctrl.
+ */
+static inline
+uint32_t _cu_hash_table_group_match_free(const int8_t *ctrl)
+{
+#ifdef __SSE2__
+    /* Free slots are exactly those with the highest bit set. */
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t mask = 0;
+    uint32_t j;
+    for (j = 0; j < GROUP_WIDTH; ++j)
+        mask |= (uint32_t)(ctrl[j] < 0) << j;
+    return mask;
+#endif
+}
+
+/** @internal
+ *  @brief Mix the bits of a hash, so that weak hashes (like pointers) spread over all slots.
+ */
+static inline
+uint64_t _cu_hash_table_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/** @internal
+ *  @brief Compute the mixed hash of a key.
+ */
+static inline
+uint64_t _cu_hash_table_hash(CUHashTable *table, void *key)
+{
+    return _cu_hash_table_mix(table->hash ? table->hash(key) : (uint64_t)(uintptr_t)key);
+}
+
+/** @internal
+ *  @brief Compare two keys for equality.
+ */
+static inline
+bool _cu_hash_table_equal(CUHashTable *table, void *a, void *b)
+{
+    return a == b || (table->equal && table->equal(a, b));
+}
+
+/** @internal
+ *  @brief Return the number of elements a table of @a capacity slots holds before growing.
+ */
+static inline
+size_t _cu_hash_table_max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
+}
+
+/** @internal
+ *  @brief Return the number of slots needed for @a count elements.
+ */
+static inline
+size_t _cu_hash_table_capacity_for(size_t count)
+{
+    size_t capacity = MIN_CAPACITY;
+    while (_cu_hash_table_max_load(capacity) < count)
+        capacity *= 2;
+    return capacity;
+}
+
+/** @internal
+ *  @brief Set the control byte of a slot, and its copy behind the end.
+ */
+static inline
+void _cu_hash_table_set_ctrl(CUHashTable *table, size_t index, int8_t value)
+{
+    table->ctrl[index] = value;
+    if (index < GROUP_WIDTH)
+        table->ctrl[table->capacity + index] = value;
+}
+
+/** @internal
+ *  @brief Find the slot of a key.
+ *  @return The index of the slot, or @a SIZE_MAX if the key is not in the table.
+ */
+static inline
+size_t _cu_hash_table_find_index(CUHashTable *table, void *key, uint64_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t position = (hash >> 7) & mask;
+    size_t step = 0;
+    size_t index;
+    uint32_t match;
+
+    for (;;) {
+        match = _cu_hash_table_group_match(table->ctrl + position, (int8_t)(hash & 0x7f));
+        while (match) {
+            index = (position + __builtin_ctz(match)) & mask;
+            if (cu_likely(_cu_hash_table_equal(table, table->slots[index].key, key)))
+                return index;
+            match &= match - 1;
+        }
+        /* An empty slot ends the probe sequence of every key that would have been placed here. */
+        if (cu_likely(_cu_hash_table_group_match(table->ctrl + position, CTRL_EMPTY)))
+            return SIZE_MAX;
+        /* Triangular probing visits every group exactly once for power of two capacities. */
+        step += GROUP_WIDTH;
+        position = (position + step) & mask;
+    }
+}
+
+/** @internal
+ *  @brief Find the first empty or deleted slot in the probe sequence of a hash.
+ *  @return The index of the slot.
+ */
+static inline
+size_t _cu_hash_table_find_free(CUHashTable *table, uint64_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t position = (hash >> 7) & mask;
+    size_t step = 0;
+    uint32_t match;
+
+    while (!(match = _cu_hash_table_group_match_free(table->ctrl + position))) {
+        step += GROUP_WIDTH;
+        position = (position + step) & mask;
+    }
+    return (position + __builtin_ctz(match)) & mask;
+}
+
+/** @internal
+ *  @brief Move all elements to a new array of slots.
+ *  @param[in] table The hash table.
+ *  @param[in] capacity The new number of slots, a power of two of at least MIN_CAPACITY.
+ */
+static
+void _cu_hash_table_resize(CUHashTable *table, size_t capacity)
+{
+    int8_t *old_ctrl = table->ctrl;
+    CUHashTableSlot *old_slots = table->slots;
+    size_t old_capacity = table->capacity;
+    size_t j, index;
+    uint64_t hash;
+
+    table->ctrl = cu_alloc(capacity + GROUP_WIDTH);
+    memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    table->slots = cu_alloc(capacity * sizeof(CUHashTableSlot));
+    table->capacity = capacity;
+    table->growth_left = _cu_hash_table_max_load(capacity) - table->length;
+
+    for (j = 0; j < old_capacity; ++j) {
+        if (old_ctrl[j] < 0)
+            continue;
+        hash = _cu_hash_table_hash(table, old_slots[j].key);
+        index = _cu_hash_table_find_free(table, hash);
+        _cu_hash_table_set_ctrl(table, index, (int8_t)(hash & 0x7f));
+        table->slots[index] = old_slots[j];
+    }
+
+    cu_free(old_ctrl);
+    cu_free(old_slots);
+}
+
+CUHashTable *cu_hash_table_new(CUHashFunc hash,
+                               CUEqualFunc equal,
+                               CUDestroyNotifyFunc destroy_key,
+                               CUDestroyNotifyFunc destroy_value)
+{
+    CUHashTable *table = cu_alloc0(sizeof(CUHashTable));
+
+    table->hash = hash;
+    table->equal = equal;
+    table->destroy_key = destroy_key;
+    table->destroy_value = destroy_value;
+
+    return table;
+}
+
+void cu_hash_table_clear(CUHashTable *table)
+{
+    if (cu_unlikely(!table))
+        return;
+
+    size_t j;
+
+    if (table->destroy_key || table->destroy_value) {
+        for (j = 0; j < table->capacity; ++j) {
+            if (table->ctrl[j] < 0)
+                continue;
+            if (table->destroy_key)
+                table->destroy_key(table->slots[j].key);
+            if (table->destroy_value)
+                table->destroy_value(table->slots[j].value);
+        }
+    }
+
+    if (table->capacity)
+        memset(table->ctrl, CTRL_EMPTY, table->capacity + GROUP_WIDTH);
+    table->length = 0;
+    table->growth_left = table->capacity ? _cu_hash_table_max_load(table->capacity) : 0;
+}
+
+void cu_hash_table_destroy(CUHashTable *table)
+{
+    if (cu_unlikely(!table))
+        return;
+
+    cu_hash_table_clear(table);
+    cu_free(table->ctrl);
+    cu_free(table->slots);
+    cu_free(table);
+}
+
+void cu_hash_table_insert(CUHashTable *table,
+                          void *key,
+                          void *value)
+{
+    if (cu_unlikely(!table))
+        return;
+
+    uint64_t hash = _cu_hash_table_hash(table, key);
+    size_t index;
+
+    if (cu_unlikely(table->capacity == 0))
+        _cu_hash_table_resize(table, MIN_CAPACITY);
+
+    index = _cu_hash_table_find_index(table, key, hash);
+    if (index != SIZE_MAX) {
+        if (table->destroy_key && table->slots[index].key != key)
+            table->destroy_key(key);
+        if (table->destroy_value && table->slots[index].value != value)
+            table->destroy_value(table->slots[index].value);
+        table->slots[index].value = value;
+        return;
+    }
+
+    index = _cu_hash_table_find_free(table, hash);
+    if (cu_unlikely(table->ctrl[index] == CTRL_EMPTY && table->growth_left == 0)) {
+        /* If most of the used slots are deleted ones, cleaning up suffices. */
+        if (table->length <= _cu_hash_table_max_load(table->capacity) / 2)
+            _cu_hash_table_resize(table, table->capacity);
+        else
+            _cu_hash_table_resize(table, table->capacity * 2);
+        index = _cu_hash_table_find_free(table, hash);
+    }
+
+    table->growth_left -= table->ctrl[index] == CTRL_EMPTY;
+    _cu_hash_table_set_ctrl(table, index, (int8_t)(hash & 0x7f));
+    table->slots[index].key = key;
+    table->slots[index].value = value;
+    ++table->length;
+}
+
+bool cu_hash_table_remove(CUHashTable *table, void *key)
+{
+    if (cu_unlikely(!table || table->length == 0))
+        return false;
+
+    size_t index = _cu_hash_table_find_index(table, key, _cu_hash_table_hash(table, key));
+    if (index == SIZE_MAX)
+        return false;
+
+    if (table->destroy_key)
+        table->destroy_key(table->slots[index].key);
+    if (table->destroy_value)
+        table->destroy_value(table->slots[index].value);
+    --table->length;
+
+    /* If every group containing this slot also contains an empty slot, no probe sequence
+     * went past this slot, so it can become empty again. Otherwise leave a marker. */
+    size_t mask = table->capacity - 1;
+    uint32_t empty_after = _cu_hash_table_group_match(table->ctrl + index, CTRL_EMPTY);
+    uint32_t empty_before = _cu_hash_table_group_match(table->ctrl + ((index - GROUP_WIDTH) & mask), CTRL_EMPTY);
+    if (empty_after && empty_before &&
+        (uint32_t)__builtin_ctz(empty_after) + (uint32_t)(__builtin_clz(empty_before) - (32 - GROUP_WIDTH)) < GROUP_WIDTH) {
+        _cu_hash_table_set_ctrl(table, index, CTRL_EMPTY);
+        ++table->growth_left;
+    }
+    else {
+        _cu_hash_table_set_ctrl(table, index, CTRL_DELETED);
+    }
+
+    return true;
+}
+
+bool cu_hash_table_find(CUHashTable *table,
+                        void *key,
+                        void **data)
+{
+    if (cu_unlikely(!table || table->length == 0))
+        return false;
+
+    size_t index = _cu_hash_table_find_index(table, key, _cu_hash_table_hash(table, key));
+    if (index == SIZE_MAX)
+        return false;
+    if (data)
+        *data = table->slots[index].value;
+    return true;
+}
+
+void cu_hash_table_foreach(CUHashTable *table,
+                           CUTraverseFunc traverse,
+                           void *userdata)
+{
+    if (cu_unlikely(!table || !traverse))
+        return;
+
+    size_t position;
+    uint32_t full;
+
+    for (position = 0; position < table->capacity; position += GROUP_WIDTH) {
+        full = ~_cu_hash_table_group_match_free(table->ctrl + position) & ((1u << GROUP_WIDTH) - 1);
+        while (full) {
+            CUHashTableSlot *slot = &table->slots[position + __builtin_ctz(full)];
+            if (!traverse(slot->key, slot->value, userdata))
+                return;
+            full &= full - 1;
+        }
+    }
+}
+
+size_t cu_hash_table_length(CUHashTable *table)
+{
+    return table ? table->length : 0;
+}
+
+void cu_hash_table_reserve(CUHashTable *table, size_t count)
+{
+    if (cu_unlikely(!table))
+        return;
+    if (count > table->length + table->growth_left)
+        _cu_hash_table_resize(table, _cu_hash_table_capacity_for(count));
+}
+
+void cu_hash_table_rehash(CUHashTable *table, size_t count)
+{
+    if (cu_unlikely(!table))
+        return;
+
+    if (count < table->length)
+        count = table->length;
+    if (count == 0) {
+        cu_free(table->ctrl);
+        cu_free(table->slots);
+        table->ctrl = NULL;
+        table->slots = NULL;
+        table->capacity = 0;
+        table->growth_left = 0;
+        return;
+    }
+    _cu_hash_table_resize(table, _cu_hash_table_capacity_for(count));
+}
+
+uint64_t cu_hash_table_hash_string(void *key)
+{
+    /* FNV-1a, the result is mixed further by the table. */
+    const unsigned char *str = key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*str) {
+        hash ^= *str++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool cu_hash_table_equal_string(void *a, void *b)
+{
+    return strcmp(a, b) == 0;
+}
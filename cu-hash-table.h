@@ -0,0 +1,118 @@
+/** @file cu-hash-table.h
+ *  Provide a hash table with open addressing.
+ *  @defgroup CUHashTable Hash table
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to a hash table.
+ *  @details Keys and values are stored directly in a single array of slots, next to an array of
+ *           control bytes holding 7 bits of the hash of each key. A lookup compares the control
+ *           bytes of 16 slots at once and only touches slots whose bits match. Small keys, like
+ *           integers cast to pointers, need no memory of their own.
+ */
+typedef struct _CUHashTable CUHashTable;
+
+/** @brief Create a new hash table.
+ *  @param[in] hash Function to compute the hash of a key. If not specified, the pointer value
+ *                  is hashed.
+ *  @param[in] equal Function to check two keys for equality. If not specified, the pointer values
+ *                   are compared.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created hash table.
+ */
+CUHashTable *cu_hash_table_new(CUHashFunc hash,
+                               CUEqualFunc equal,
+                               CUDestroyNotifyFunc destroy_key,
+                               CUDestroyNotifyFunc destroy_value);
+
+/** @brief Remove all elements from a hash table.
+ *  @details The allocated slots are kept.
+ *  @param[in] table The hash table.
+ */
+void cu_hash_table_clear(CUHashTable *table);
+
+/** @brief Destroy a hash table and free all resources.
+ *  @param[in] table The hash table to destroy.
+ */
+void cu_hash_table_destroy(CUHashTable *table);
+
+/** @brief Insert a new element into a hash table.
+ *  @details If an element with the given @a key is already in the table, the @a key and the old
+ *           value are destroyed. Ownership is passed to the table.
+ *  @param[in] table The hash table.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_hash_table_insert(CUHashTable *table,
+                          void *key,
+                          void *value);
+
+/** @brief Remove an element from a hash table.
+ *  @details Key and value are destroyed.
+ *  @param[in] table The hash table.
+ *  @param[in] key The key of the element to be removed.
+ *  @retval true The element was removed.
+ *  @retval false The element was not in the table.
+ */
+bool cu_hash_table_remove(CUHashTable *table, void *key);
+
+/** @brief Find an element in a hash table.
+ *  @param[in] table The hash table.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with the value of the element, if found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the table.
+ */
+bool cu_hash_table_find(CUHashTable *table,
+                        void *key,
+                        void **data);
+
+/** @brief Call a function for all elements of a hash table, in no particular order.
+ *  @param[in] table The hash table.
+ *  @param[in] traverse The function called for each element. If it returns @a false, stop.
+ *  @param[in] userdata Pointer passed as third argument to @a traverse.
+ */
+void cu_hash_table_foreach(CUHashTable *table,
+                           CUTraverseFunc traverse,
+                           void *userdata);
+
+/** @brief Return the number of elements in a hash table.
+ *  @param[in] table The hash table.
+ *  @return The number of elements.
+ */
+size_t cu_hash_table_length(CUHashTable *table);
+
+/** @brief Make room for a number of elements.
+ *  @details Inserting up to @a count elements does not rehash the table afterwards.
+ *  @param[in] table The hash table.
+ *  @param[in] count The number of elements.
+ */
+void cu_hash_table_reserve(CUHashTable *table, size_t count);
+
+/** @brief Rebuild a hash table with room for at least @a count elements.
+ *  @details This drops the markers of removed elements, which otherwise lengthen the lookups,
+ *           and may shrink the table. @a count is raised to the current number of elements.
+ *  @param[in] table The hash table.
+ *  @param[in] count The number of elements.
+ */
+void cu_hash_table_rehash(CUHashTable *table, size_t count);
+
+/** @brief Hash a null-terminated string.
+ *  @param[in] key The string.
+ *  @return The hash value.
+ */
+uint64_t cu_hash_table_hash_string(void *key);
+
+/** @brief Compare two null-terminated strings for equality.
+ *  @param[in] a The first string.
+ *  @param[in] b The second string.
+ *  @retval true Both strings are equal.
+ *  @retval false The strings differ.
+ */
+bool cu_hash_table_equal_string(void *a, void *b);
+
+/** @} */
@@ -0,0 +1,71 @@
+/** @file cu-heap-internal.h
+ *  @internal
+ *  Array layout shared by CUHeap, CUPriorityHeap and CUIndexedHeap.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cu-memory.h"
+
+/* The children of each element start at a multiple of this (the size of a cache line). */
+#define HEAP_ALIGNMENT 64
+
+/* Initial capacity of a heap, and the smallest it shrinks to. */
+#define HEAP_MIN_LENGTH 64
+
+/* Largest supported arity (1 << HEAP_MAX_ARITY_SHIFT). */
+#define HEAP_MAX_ARITY_SHIFT 4
+
+#define HEAP_PARENT(heap, pos) (((pos) - 1) >> (heap)->arity_shift)
+#define HEAP_FIRST_CHILD(heap, pos) (((pos) << (heap)->arity_shift) + 1)
+
+/** @internal
+ *  @brief Return the arity shift for a number of children.
+ *  @details Arities that are no power of two are rounded down, values up to 2 give a binary heap.
+ */
+static inline
+uint32_t _cu_heap_arity_shift(uint32_t arity)
+{
+    uint32_t shift = arity > 2 ? 31 - __builtin_clz(arity) : 1;
+    return shift < HEAP_MAX_ARITY_SHIFT ? shift : HEAP_MAX_ARITY_SHIFT;
+}
+
+/** @internal
+ *  @brief Resize the array of a heap.
+ *  @details The array is placed such that the element at index 1 starts a cache line, which puts
+ *           the children of every element at the start of a cache line.
+ *  @param[in,out] storage The memory holding the array, reallocated.
+ *  @param[in] array The array inside @a storage, ignored if @a storage is @a NULL.
+ *  @param[in] length The number of elements in the array to keep.
+ *  @param[in] max_length The new capacity, at least @a length.
+ *  @param[in] entry_size The size of an element.
+ *  @return The array inside the new @a storage.
+ */
+static inline
+void *_cu_heap_resize_storage(void **storage, void *array, uint32_t length, uint32_t max_length, size_t entry_size)
+{
+    size_t offset = *storage ? (size_t)((char *)array - (char *)*storage) : 0;
+    size_t new_offset;
+
+    *storage = cu_realloc(*storage, max_length * entry_size + HEAP_ALIGNMENT);
+    /* Round the address of the element at index 1 up to the next cache line. */
+    new_offset = (((uintptr_t)*storage + entry_size + HEAP_ALIGNMENT - 1) & ~(uintptr_t)(HEAP_ALIGNMENT - 1))
+                 - entry_size - (uintptr_t)*storage;
+    if (new_offset != offset)
+        memmove((char *)*storage + new_offset, (char *)*storage + offset, length * entry_size);
+    return (char *)*storage + new_offset;
+}
+
+/** @internal
+ *  @brief Return the capacity a heap grows to, doubling from @a max_length until @a count fits.
+ */
+static inline
+uint32_t _cu_heap_grow_length(uint32_t max_length, uint32_t count)
+{
+    uint64_t new_length = max_length ? max_length : HEAP_MIN_LENGTH;
+
+    while (new_length < count)
+        new_length *= 2;
+    return new_length < UINT32_MAX ? (uint32_t)new_length : UINT32_MAX;
+}
@@ -1,10 +1,12 @@
 #include "cu-heap.h"
+#include "cu-heap-internal.h"
 #include "cu-memory.h"
 #include "cu.h"
 #include <assert.h>
 
 void cu_heap_init_full(CUHeap *heap, CUCompareDataFunc compare, void *compare_data,
-                                     CUHeapSetPositionCallback position_cb, void *position_data)
+                                     CUHeapSetPositionCallback position_cb, void *position_data,
+                                     uint32_t arity)
 {
     memset(heap, 0, sizeof(CUHeap));
 
@@ -13,11 +15,13 @@ void cu_heap_init_full(CUHeap *heap, CUCompareDataFunc compare, void *compare_da
 
     heap->set_position_cb = position_cb;
     heap->set_position_cb_data = position_data;
+
+    heap->arity_shift = _cu_heap_arity_shift(arity);
 }
 
 void cu_heap_init(CUHeap *heap, CUCompareDataFunc compare, void *compare_data)
 {
-    cu_heap_init_full(heap, compare, compare_data, NULL, NULL);
+    cu_heap_init_full(heap, compare, compare_data, NULL, NULL, 0);
 }
 
 void cu_heap_clear(CUHeap *heap, CUDestroyNotifyFunc destroy_data)
@@ -28,76 +32,208 @@ void cu_heap_clear(CUHeap *heap, CUDestroyNotifyFunc destroy_data)
             for (j = 0; j < heap->length; ++j)
                 destroy_data(heap->data[j]);
         }
-        cu_free(heap->data);
-        memset(heap, 0, sizeof(CUHeap));
+        cu_free(heap->storage);
+        heap->storage = NULL;
+        heap->data = NULL;
+        heap->length = 0;
+        heap->max_length = 0;
     }
 }
 
+/** @internal
+ *  @brief Resize the array of a heap.
+ *  @details The array is placed such that the element at index 1 starts a cache line.
+ *  @param[in] heap The heap.
+ *  @param[in] max_length The new capacity, at least the length of the heap.
+ */
+static
+void _cu_heap_resize(CUHeap *heap, uint32_t max_length)
+{
+    heap->data = _cu_heap_resize_storage(&heap->storage, heap->data, heap->length, max_length, sizeof(void *));
+    heap->max_length = max_length;
+}
+
+/** @internal
+ *  @brief Grow the array of a heap geometrically to hold at least @a count elements.
+ */
+static
+void _cu_heap_grow(CUHeap *heap, uint32_t count)
+{
+    _cu_heap_resize(heap, _cu_heap_grow_length(heap->max_length, count));
+}
+
+/** @internal
+ *  @brief Halve the array of a heap if shrinking is enabled and it is less than a quarter full.
+ */
 static inline
-void _cu_heap_exchange_links(CUHeap *heap, uint32_t j1, uint32_t j2)
-{
-    void *t = heap->data[j1];
-    heap->data[j1] = heap->data[j2];
-    heap->data[j2] = t;
-    if (heap->set_position_cb) {
-        heap->set_position_cb(heap->data[j1], j1, heap->set_position_cb_data);
-        heap->set_position_cb(heap->data[j2], j2, heap->set_position_cb_data);
-    }
+void _cu_heap_shrink(CUHeap *heap)
+{
+    if (heap->shrink && heap->length < heap->max_length / 4 &&
+            heap->max_length / 2 >= HEAP_MIN_LENGTH && heap->max_length / 2 >= heap->reserved_length)
+        _cu_heap_resize(heap, heap->max_length / 2);
 }
 
+/** @internal
+ *  @brief Store an element at a position and inform the element about it.
+ */
+static inline
+void _cu_heap_set(CUHeap *heap, uint32_t pos, void *element)
+{
+    heap->data[pos] = element;
+    if (heap->set_position_cb)
+        heap->set_position_cb(element, pos, heap->set_position_cb_data);
+}
+
+/** @internal
+ *  @brief Move the element at a position up until its parent is not smaller.
+ *  @details Smaller parents are moved down into the hole, the element itself is stored only once.
+ */
 static
 void _cu_heap_upheap(CUHeap *heap, uint32_t pos)
 {
-    while (pos && heap->compare(heap->data[(pos-1)/2], heap->data[pos], heap->compare_data) < 0) {
-        _cu_heap_exchange_links(heap, pos, (pos-1)/2);
-        pos = (pos-1)/2;
+    void *element = heap->data[pos];
+    uint32_t parent;
+
+    while (pos) {
+        parent = HEAP_PARENT(heap, pos);
+        if (heap->compare(heap->data[parent], element, heap->compare_data) >= 0)
+            break;
+        _cu_heap_set(heap, pos, heap->data[parent]);
+        pos = parent;
     }
+    _cu_heap_set(heap, pos, element);
 }
 
+/** @internal
+ *  @brief Move the element at a position down until no child is larger.
+ */
 static
 void _cu_heap_downheap(CUHeap *heap, uint32_t pos)
 {
-    uint32_t j;
-    while (2 * pos + 1 < heap->length) {
-        j = 2 * pos + 1;
-        /* select larger child */
-        if (j < heap->length - 1 && heap->compare(heap->data[j], heap->data[j+1], heap->compare_data) < 0)
-            ++j;
-        if (heap->compare(heap->data[pos], heap->data[j], heap->compare_data) > 0)
+    void *element = heap->data[pos];
+    uint32_t child, last, j;
+
+    while ((child = HEAP_FIRST_CHILD(heap, pos)) < heap->length) {
+        /* select largest child */
+        last = child + (1u << heap->arity_shift);
+        if (last > heap->length)
+            last = heap->length;
+        for (j = child + 1; j < last; ++j) {
+            if (heap->compare(heap->data[child], heap->data[j], heap->compare_data) < 0)
+                child = j;
+        }
+        if (heap->compare(element, heap->data[child], heap->compare_data) >= 0)
             break;
-        _cu_heap_exchange_links(heap, pos, j);
-        pos = j;
+        _cu_heap_set(heap, pos, heap->data[child]);
+        pos = child;
     }
+    _cu_heap_set(heap, pos, element);
 }
 
 static
 void _cu_heap_reheap(CUHeap *heap, uint32_t pos)
 {
-    if (pos && heap->compare(heap->data[(pos-1)/2], heap->data[pos], heap->compare_data) < 0) {
+    if (pos && heap->compare(heap->data[HEAP_PARENT(heap, pos)], heap->data[pos], heap->compare_data) < 0)
         _cu_heap_upheap(heap, pos);
-    }
-    else if ((2*pos + 1 < heap->length && heap->compare(heap->data[pos], heap->data[2*pos+1], heap->compare_data) < 0) ||
-             (2*pos + 2 < heap->length && heap->compare(heap->data[pos], heap->data[2*pos+2], heap->compare_data) < 0)) {
+    else
         _cu_heap_downheap(heap, pos);
+}
+
+/** @internal
+ *  @brief Restore the heap order after the elements from position @a first on have changed.
+ *  @details Only ancestors of the changed elements may violate the heap order. It is restored
+ *           level by level, from the parents of the changed elements up to the root (Floyd).
+ *           Positions are reported at the end, once for every element on the heap.
+ */
+static
+void _cu_heap_heapify(CUHeap *heap, uint32_t first)
+{
+    CUHeapSetPositionCallback set_position_cb = heap->set_position_cb;
+    uint32_t last = heap->length - 1, j;
+
+    heap->set_position_cb = NULL;
+    while (last > 0) {
+        first = first ? HEAP_PARENT(heap, first) : 0;
+        last = HEAP_PARENT(heap, last);
+        for (j = last + 1; j-- > first; )
+            _cu_heap_downheap(heap, j);
+        /* All remaining ancestors have just been handled. */
+        if (first == 0)
+            break;
+    }
+    heap->set_position_cb = set_position_cb;
+
+    if (set_position_cb) {
+        for (j = 0; j < heap->length; ++j)
+            set_position_cb(heap->data[j], j, heap->set_position_cb_data);
     }
 }
 
+void cu_heap_reserve(CUHeap *heap, uint32_t count)
+{
+    if (cu_unlikely(!heap))
+        return;
+    heap->reserved_length = count;
+    if (count > heap->max_length)
+        _cu_heap_resize(heap, count);
+}
+
+void cu_heap_set_shrink(CUHeap *heap, bool shrink)
+{
+    if (cu_unlikely(!heap))
+        return;
+    heap->shrink = shrink;
+}
+
 void cu_heap_insert(CUHeap *heap, void *element)
 {
     if (cu_unlikely(!heap))
         return;
-    if (cu_unlikely(heap->length == heap->max_length)) {
-        heap->max_length += 512; /* Let heap grow linearly (on 64 bit systems, use increments of 4K). */
-        heap->data = cu_realloc(heap->data, heap->max_length * sizeof(void *));
-    }
+    if (cu_unlikely(heap->length == heap->max_length))
+        _cu_heap_grow(heap, heap->length + 1);
     assert(heap->max_length);
 
     heap->data[heap->length] = element;
-    if (heap->set_position_cb)
-        heap->set_position_cb(element, heap->length, heap->set_position_cb_data);
     _cu_heap_upheap(heap, heap->length++);
 }
 
+void cu_heap_insert_bulk(CUHeap *heap, void **elements, uint32_t count)
+{
+    if (cu_unlikely(!heap || !elements || !count))
+        return;
+
+    uint32_t length = heap->length + count;
+    uint32_t j, first;
+
+    /* Inserting one by one costs about log(n) moves per element, heapifying touches all. */
+    if ((uint64_t)count * (32 - __builtin_clz(length)) < length) {
+        for (j = 0; j < count; ++j)
+            cu_heap_insert(heap, elements[j]);
+        return;
+    }
+
+    if (length > heap->max_length)
+        _cu_heap_grow(heap, length);
+    memcpy(heap->data + heap->length, elements, count * sizeof(void *));
+
+    first = heap->length;
+    heap->length = length;
+    _cu_heap_heapify(heap, first);
+}
+
+void cu_heap_init_from_array(CUHeap *heap, CUCompareDataFunc compare, void *compare_data,
+                             void **elements, uint32_t count)
+{
+    cu_heap_init(heap, compare, compare_data);
+    if (cu_unlikely(!elements || !count))
+        return;
+
+    _cu_heap_resize(heap, count);
+    memcpy(heap->data, elements, count * sizeof(void *));
+    heap->length = count;
+    _cu_heap_heapify(heap, 0);
+}
+
 void *cu_heap_pop_root(CUHeap *heap)
 {
     if (cu_unlikely(!heap || !heap->data || heap->length == 0))
@@ -105,8 +241,11 @@ void *cu_heap_pop_root(CUHeap *heap)
 
     void *data = heap->data[0];
 
-    _cu_heap_exchange_links(heap, 0, --heap->length);
-    _cu_heap_downheap(heap, 0);
+    if (--heap->length) {
+        heap->data[0] = heap->data[heap->length];
+        _cu_heap_downheap(heap, 0);
+    }
+    _cu_heap_shrink(heap);
 
     if (heap->set_position_cb)
         heap->set_position_cb(data, (uint32_t)(-1), heap->set_position_cb_data);
@@ -128,11 +267,101 @@ void cu_heap_update(CUHeap *heap, uint32_t pos)
     _cu_heap_reheap(heap, pos);
 }
 
+/** @internal
+ *  @brief Sort positions descending, by radix sort on their bytes.
+ *  @param[in,out] positions The positions to sort.
+ *  @param[in] buffer Room for @a count positions.
+ *  @param[in] count The number of positions.
+ *  @param[in] bits The number of significant bits of all positions.
+ */
+static
+void _cu_heap_sort_positions(uint32_t *positions, uint32_t *buffer, uint32_t count, uint32_t bits)
+{
+    uint32_t offsets[256];
+    uint32_t *from = positions, *to = buffer, *tmp;
+    uint32_t shift, j, sum, digit;
+
+    for (shift = 0; shift < bits; shift += 8) {
+        memset(offsets, 0, sizeof(offsets));
+        for (j = 0; j < count; ++j)
+            ++offsets[255 - ((from[j] >> shift) & 0xff)];
+        for (j = 0, sum = 0; j < 256; ++j) {
+            digit = offsets[j];
+            offsets[j] = sum;
+            sum += digit;
+        }
+        for (j = 0; j < count; ++j)
+            to[offsets[255 - ((from[j] >> shift) & 0xff)]++] = from[j];
+        tmp = from;
+        from = to;
+        to = tmp;
+    }
+    if (from != positions)
+        memcpy(positions, from, count * sizeof(uint32_t));
+}
+
+void cu_heap_update_batch(CUHeap *heap, const uint32_t *positions, uint32_t count)
+{
+    if (cu_unlikely(!heap || !heap->data || !positions || !count))
+        return;
+
+    uint32_t bits = 32 - __builtin_clz(heap->length | 1);
+    uint32_t *dirty = cu_alloc(count * sizeof(uint32_t));
+    uint32_t *parents;
+    uint32_t dirty_count = 0, parent_count = 0, d = 0, p = 0, j, pos, last;
+
+    for (j = 0; j < count; ++j) {
+        if (positions[j] < heap->length)
+            dirty[dirty_count++] = positions[j];
+    }
+
+    /* Beyond n / log(n) changed elements, their ancestors are about all inner elements anyway. */
+    if ((uint64_t)dirty_count * bits > heap->length) {
+        cu_free(dirty);
+        _cu_heap_heapify(heap, 0);
+        return;
+    }
+
+    /* Every changed element adds at most one ancestor per level. */
+    parents = cu_alloc(dirty_count * bits * sizeof(uint32_t) + sizeof(uint32_t));
+    _cu_heap_sort_positions(dirty, parents, dirty_count, bits);
+
+    /* Floyd on the changed elements, and on those ancestors that end up smaller than a child:
+     * for all others, the heap order below them still holds. Both the changed positions and
+     * the parents to handle are visited in descending order, so merging them handles every
+     * element after its descendants, and each only once. */
+    last = heap->length;
+    while (d < dirty_count || p < parent_count) {
+        if (p == parent_count || (d < dirty_count && dirty[d] > parents[p]))
+            pos = dirty[d++];
+        else
+            pos = parents[p++];
+        if (pos == last)
+            continue;
+        last = pos;
+        _cu_heap_downheap(heap, pos);
+        if (pos && heap->compare(heap->data[HEAP_PARENT(heap, pos)], heap->data[pos], heap->compare_data) < 0)
+            parents[parent_count++] = HEAP_PARENT(heap, pos);
+    }
+
+    cu_free(parents);
+    cu_free(dirty);
+}
+
 void cu_heap_remove(CUHeap *heap, uint32_t pos)
 {
     if (cu_unlikely(!heap || !heap->data || pos >= heap->length))
         return;
-    _cu_heap_exchange_links(heap, pos, --heap->length);
-    /* Can happen in both directions, e.g., if we are in another subtree. */
-    _cu_heap_reheap(heap, pos);
+
+    void *data = heap->data[pos];
+
+    if (pos != --heap->length) {
+        heap->data[pos] = heap->data[heap->length];
+        /* Can happen in both directions, e.g., if we are in another subtree. */
+        _cu_heap_reheap(heap, pos);
+    }
+    _cu_heap_shrink(heap);
+
+    if (heap->set_position_cb)
+        heap->set_position_cb(data, (uint32_t)(-1), heap->set_position_cb_data);
 }
@@ -16,11 +16,19 @@
 typedef void (*CUHeapSetPositionCallback)(void *, uint32_t, void *);
 
 /** @brief The heap.
+ *  @details The children of the element at index @a j are at the indices @a arity * @a j + 1
+ *           up to @a arity * (@a j + 1). The array is placed such that these always start at a
+ *           cache line, so with an arity of up to 8 (on 64 bit systems), all children of an element
+ *           share a single cache line.
  */
 typedef struct {
     uint32_t max_length; /**< Maximal capacity of the heap. */
     uint32_t length; /**< The number of elements on the heap. */
     void **data; /**< Array of pointers to the data on the heap. */
+    void *storage; /**< The memory holding @a data. */
+    uint32_t arity_shift; /**< The number of children of each element is 1 << arity_shift. */
+    uint32_t reserved_length; /**< The capacity is not shrunk below this, see cu_heap_reserve(). */
+    bool shrink; /**< Whether to release memory when the heap gets small, see cu_heap_set_shrink(). */
 
     CUCompareDataFunc compare; /**< Callback to compare to elements on the heap. */
     void *compare_data; /**< User defined data to pass as third element to compare(). */
@@ -37,14 +45,38 @@ typedef struct {
 void cu_heap_init(CUHeap *heap, CUCompareDataFunc compare, void *compare_data);
 
 /** @brief Initialize a heap with more control.
+ *  @details A larger arity makes the heap flatter, so fewer levels have to be passed when an
+ *           element moves down, at the cost of more comparisons per level. For large heaps, 4 or
+ *           8 children per element are usually faster than 2, since all children of an element
+ *           are in the same cache line.
  *  @param[in] heap Pointer to the heap to initialize.
  *  @param[in] compare Pointer to the callback to compare two elements.
  *  @param[in] compare_data Pointer to the data passed as third element to compare().
  *  @param[in] position_cb Pointer to the callback to inform about the changed position in the heap.
  *  @param[in] position_data Pointer to the data passed as third element to position_cb().
+ *  @param[in] arity The number of children of each element. Must be a power of two up to 16,
+ *                   other values are rounded down. 0 selects a binary heap.
  */
 void cu_heap_init_full(CUHeap *heap, CUCompareDataFunc compare, void *compare_data,
-                                     CUHeapSetPositionCallback position_cb, void *position_data);
+                                     CUHeapSetPositionCallback position_cb, void *position_data,
+                                     uint32_t arity);
+
+/** @brief Make room for a number of elements.
+ *  @details The heap grows geometrically by itself, but reserving the final size in advance
+ *           avoids copying the array. The capacity is not shrunk below @a count afterwards.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] count The number of elements the heap should hold without growing.
+ */
+void cu_heap_reserve(CUHeap *heap, uint32_t count);
+
+/** @brief Release memory when the heap gets small.
+ *  @details If enabled, the capacity is halved whenever a pop or remove leaves the heap less
+ *           than a quarter full, but not below the size passed to cu_heap_reserve(). Disabled
+ *           by default.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] shrink Whether to shrink the heap.
+ */
+void cu_heap_set_shrink(CUHeap *heap, bool shrink);
 
 /** @brief Remove all elements and clear the heap.
  *  @param[in] heap Pointer to the heap to clear.
@@ -58,6 +90,30 @@ void cu_heap_clear(CUHeap *heap, CUDestroyNotifyFunc destroy_data);
  */
 void cu_heap_insert(CUHeap *heap, void *element);
 
+/** @brief Insert many elements on the heap at once.
+ *  @details If the batch is large compared to the heap, the elements are appended and the heap
+ *           order is restored bottom-up (Floyd), which takes linear time. The position callback
+ *           is then called once for every element on the heap at the end, instead of for every
+ *           move. Small batches are inserted one by one.
+ *  @param[in] heap Pointer to the heap to insert into.
+ *  @param[in] elements Pointers to the elements to be inserted.
+ *  @param[in] count The number of elements.
+ */
+void cu_heap_insert_bulk(CUHeap *heap, void **elements, uint32_t count);
+
+/** @brief Initialize a heap holding the elements of an array.
+ *  @details Like cu_heap_init(), but the heap starts with a copy of @a elements, brought into
+ *           heap order bottom-up (Floyd) in linear time instead of O(n log(n)) for inserting the
+ *           elements one by one.
+ *  @param[in] heap Pointer to the heap to initialize.
+ *  @param[in] compare Pointer to the callback to compare two elements.
+ *  @param[in] compare_data Pointer to the data passed as third element to compare().
+ *  @param[in] elements Pointers to the elements. The array is copied.
+ *  @param[in] count The number of elements.
+ */
+void cu_heap_init_from_array(CUHeap *heap, CUCompareDataFunc compare, void *compare_data,
+                             void **elements, uint32_t count);
+
 /** @brief Return the element on top of the heap and remove it.
  *  @param[in] heap Pointer to the heap to pop from.
  *  @return Pointer to the element on top of the heap, or @a NULL if the heap was empty.
@@ -76,6 +132,18 @@ void *cu_heap_peek_root(CUHeap *heap);
  */
 void cu_heap_update(CUHeap *heap, uint32_t pos);
 
+/** @brief Update the heap after several elements have changed.
+ *  @details Instead of moving each element on its own, the heap order is restored once for the
+ *           changed elements and their ancestors, bottom-up. If more than about n / log(n)
+ *           elements changed, the whole heap is rebuilt in linear time instead, and the position
+ *           callback is called once for every element at the end. Positions may be given more
+ *           than once.
+ *  @param[in] heap Pointer to the heap to be updated.
+ *  @param[in] positions The indices of the elements that have changed.
+ *  @param[in] count The number of indices.
+ */
+void cu_heap_update_batch(CUHeap *heap, const uint32_t *positions, uint32_t count);
+
 /** @brief Remove an arbitrary element from the heap.
  *  @param[in] heap Pointer to the heap to remove the element from.
  *  @param[in] pos The index of the element to be removed.
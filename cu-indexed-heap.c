@@ -0,0 +1,222 @@
+#include "cu-indexed-heap.h"
+#include "cu-heap-internal.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <assert.h>
+
+void cu_indexed_heap_init_full(CUIndexedHeap *heap, bool largest_first, uint32_t arity)
+{
+    memset(heap, 0, sizeof(CUIndexedHeap));
+
+    heap->key_mask = largest_first ? ~0ULL : 0;
+
+    heap->arity_shift = _cu_heap_arity_shift(arity ? arity : 4);
+}
+
+void cu_indexed_heap_init(CUIndexedHeap *heap)
+{
+    cu_indexed_heap_init_full(heap, false, 0);
+}
+
+void cu_indexed_heap_clear(CUIndexedHeap *heap)
+{
+    if (heap) {
+        cu_free(heap->storage);
+        cu_free(heap->positions);
+        heap->storage = NULL;
+        heap->entries = NULL;
+        heap->positions = NULL;
+        heap->length = 0;
+        heap->max_length = 0;
+        heap->id_count = 0;
+    }
+}
+
+/** @internal
+ *  @brief Resize the array of a heap.
+ *  @details The array is placed such that the element at index 1 starts a cache line.
+ *  @param[in] heap The heap.
+ *  @param[in] max_length The new capacity, at least the length of the heap.
+ */
+static
+void _cu_indexed_heap_resize(CUIndexedHeap *heap, uint32_t max_length)
+{
+    heap->entries = _cu_heap_resize_storage(&heap->storage, heap->entries, heap->length, max_length, sizeof(CUIndexedHeapEntry));
+    heap->max_length = max_length;
+}
+
+/** @internal
+ *  @brief Make the positions cover all ids below @a id_count, marking new ones as not on the heap.
+ */
+static
+void _cu_indexed_heap_resize_positions(CUIndexedHeap *heap, uint32_t id_count)
+{
+    heap->positions = cu_realloc(heap->positions, id_count * sizeof(uint32_t));
+    /* All bytes set gives CU_INDEXED_HEAP_NONE. */
+    memset(heap->positions + heap->id_count, 0xff, (id_count - heap->id_count) * sizeof(uint32_t));
+    heap->id_count = id_count;
+}
+
+void cu_indexed_heap_reserve(CUIndexedHeap *heap, uint32_t id_count)
+{
+    if (cu_unlikely(!heap))
+        return;
+    if (id_count > heap->id_count)
+        _cu_indexed_heap_resize_positions(heap, id_count);
+    if (id_count > heap->max_length)
+        _cu_indexed_heap_resize(heap, id_count);
+}
+
+/** @internal
+ *  @brief Store an element at a position and remember the position of its id.
+ */
+static inline
+void _cu_indexed_heap_set(CUIndexedHeap *heap, uint32_t pos, CUIndexedHeapEntry entry)
+{
+    heap->entries[pos] = entry;
+    heap->positions[entry.id] = pos;
+}
+
+/** @internal
+ *  @brief Move an element up from a position until its parent has no larger key.
+ */
+static
+void _cu_indexed_heap_upheap(CUIndexedHeap *heap, uint32_t pos, CUIndexedHeapEntry entry)
+{
+    uint32_t parent;
+
+    while (pos) {
+        parent = HEAP_PARENT(heap, pos);
+        if (heap->entries[parent].key <= entry.key)
+            break;
+        _cu_indexed_heap_set(heap, pos, heap->entries[parent]);
+        pos = parent;
+    }
+    _cu_indexed_heap_set(heap, pos, entry);
+}
+
+/** @internal
+ *  @brief Move an element down from a position until no child has a smaller key.
+ */
+static
+void _cu_indexed_heap_downheap(CUIndexedHeap *heap, uint32_t pos, CUIndexedHeapEntry entry)
+{
+    CUIndexedHeapEntry *entries = heap->entries;
+    uint32_t child, last, j;
+
+    while ((child = HEAP_FIRST_CHILD(heap, pos)) < heap->length) {
+        /* select smallest child */
+        last = child + (1u << heap->arity_shift);
+        if (last > heap->length)
+            last = heap->length;
+        for (j = child + 1; j < last; ++j)
+            child = entries[j].key < entries[child].key ? j : child;
+        if (entry.key <= entries[child].key)
+            break;
+        _cu_indexed_heap_set(heap, pos, entries[child]);
+        pos = child;
+    }
+    _cu_indexed_heap_set(heap, pos, entry);
+}
+
+/** @internal
+ *  @brief Put an element at a position and restore the heap order in either direction.
+ */
+static
+void _cu_indexed_heap_reheap(CUIndexedHeap *heap, uint32_t pos, CUIndexedHeapEntry entry)
+{
+    if (pos && heap->entries[HEAP_PARENT(heap, pos)].key > entry.key)
+        _cu_indexed_heap_upheap(heap, pos, entry);
+    else
+        _cu_indexed_heap_downheap(heap, pos, entry);
+}
+
+/** @internal
+ *  @brief Remove the element at a position.
+ */
+static
+void _cu_indexed_heap_remove_at(CUIndexedHeap *heap, uint32_t pos)
+{
+    heap->positions[heap->entries[pos].id] = CU_INDEXED_HEAP_NONE;
+    if (pos != --heap->length)
+        _cu_indexed_heap_reheap(heap, pos, heap->entries[heap->length]);
+}
+
+void cu_indexed_heap_insert(CUIndexedHeap *heap, uint32_t id, uint64_t priority)
+{
+    if (cu_unlikely(!heap || id == CU_INDEXED_HEAP_NONE))
+        return;
+
+    CUIndexedHeapEntry entry = { priority ^ heap->key_mask, id };
+    uint64_t id_count;
+
+    if (id < heap->id_count && heap->positions[id] != CU_INDEXED_HEAP_NONE) {
+        _cu_indexed_heap_reheap(heap, heap->positions[id], entry);
+        return;
+    }
+
+    if (cu_unlikely(id >= heap->id_count)) {
+        /* Grow geometrically, ids are expected to be dense. */
+        id_count = heap->id_count ? heap->id_count : HEAP_MIN_LENGTH;
+        while (id_count <= id)
+            id_count *= 2;
+        _cu_indexed_heap_resize_positions(heap, id_count < CU_INDEXED_HEAP_NONE ? (uint32_t)id_count : CU_INDEXED_HEAP_NONE);
+    }
+    if (cu_unlikely(heap->length == heap->max_length))
+        _cu_indexed_heap_resize(heap, _cu_heap_grow_length(heap->max_length, heap->length + 1));
+    assert(heap->max_length);
+
+    _cu_indexed_heap_upheap(heap, heap->length++, entry);
+}
+
+bool cu_indexed_heap_pop_root(CUIndexedHeap *heap, uint32_t *id, uint64_t *priority)
+{
+    if (cu_unlikely(!heap || heap->length == 0))
+        return false;
+
+    if (id)
+        *id = heap->entries[0].id;
+    if (priority)
+        *priority = heap->entries[0].key ^ heap->key_mask;
+    _cu_indexed_heap_remove_at(heap, 0);
+
+    return true;
+}
+
+bool cu_indexed_heap_peek_root(CUIndexedHeap *heap, uint32_t *id, uint64_t *priority)
+{
+    if (cu_unlikely(!heap || heap->length == 0))
+        return false;
+
+    if (id)
+        *id = heap->entries[0].id;
+    if (priority)
+        *priority = heap->entries[0].key ^ heap->key_mask;
+
+    return true;
+}
+
+bool cu_indexed_heap_update(CUIndexedHeap *heap, uint32_t id, uint64_t priority)
+{
+    if (cu_unlikely(!heap || id >= heap->id_count || heap->positions[id] == CU_INDEXED_HEAP_NONE))
+        return false;
+    _cu_indexed_heap_reheap(heap, heap->positions[id], (CUIndexedHeapEntry){ priority ^ heap->key_mask, id });
+    return true;
+}
+
+bool cu_indexed_heap_remove(CUIndexedHeap *heap, uint32_t id)
+{
+    if (cu_unlikely(!heap || id >= heap->id_count || heap->positions[id] == CU_INDEXED_HEAP_NONE))
+        return false;
+    _cu_indexed_heap_remove_at(heap, heap->positions[id]);
+    return true;
+}
+
+bool cu_indexed_heap_contains(CUIndexedHeap *heap, uint32_t id, uint64_t *priority)
+{
+    if (cu_unlikely(!heap || id >= heap->id_count || heap->positions[id] == CU_INDEXED_HEAP_NONE))
+        return false;
+    if (priority)
+        *priority = heap->entries[heap->positions[id]].key ^ heap->key_mask;
+    return true;
+}
@@ -0,0 +1,116 @@
+/** @file cu-indexed-heap.h
+ *  A heap of integer ids that knows the position of each id.
+ *  @defgroup CUIndexedHeap Indexed heap
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+#include <cu-types.h>
+
+/** @brief Position of an id that is not on the heap. */
+#define CU_INDEXED_HEAP_NONE ((uint32_t)(-1))
+
+/** @brief An id on the heap together with its priority. */
+typedef struct {
+    uint64_t key; /**< The priority, transformed for the order of the heap. */
+    uint32_t id; /**< The id. */
+} CUIndexedHeapEntry;
+
+/** @brief The heap.
+ *  @details Elements are identified by dense integer ids, e.g., indices into an array owned by
+ *           the caller. The heap keeps the position of every id in a side array, so the priority
+ *           of an id can be changed or the id be removed without any callback, and without the
+ *           elements having to store their position. Priorities are stored inline as for
+ *           @a CUPriorityHeap, priorities of type @a double can be converted with
+ *           cu_priority_heap_key_from_double().
+ */
+typedef struct {
+    uint32_t max_length; /**< Maximal capacity of the heap. */
+    uint32_t length; /**< The number of ids on the heap. */
+    CUIndexedHeapEntry *entries; /**< Array of the ids on the heap. */
+    void *storage; /**< The memory holding @a entries. */
+    uint32_t arity_shift; /**< The number of children of each element is 1 << arity_shift. */
+    uint64_t key_mask; /**< Applied to priorities to get keys, all bits are set if the largest priority is on top. */
+
+    uint32_t *positions; /**< The index of each id in @a entries, or CU_INDEXED_HEAP_NONE. */
+    uint32_t id_count; /**< The number of ids covered by @a positions. */
+} CUIndexedHeap;
+
+/** @brief Initialize a heap with the smallest priority on top.
+ *  @param[in] heap Pointer to the heap to initialize.
+ */
+void cu_indexed_heap_init(CUIndexedHeap *heap);
+
+/** @brief Initialize a heap with more control.
+ *  @param[in] heap Pointer to the heap to initialize.
+ *  @param[in] largest_first Whether the id with the largest priority is on top, instead of the smallest.
+ *  @param[in] arity The number of children of each element. Must be a power of two up to 16,
+ *                   other values are rounded down. 0 selects the default of 4.
+ */
+void cu_indexed_heap_init_full(CUIndexedHeap *heap, bool largest_first, uint32_t arity);
+
+/** @brief Make room for a number of ids.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] id_count The ids from 0 to @a id_count - 1 can be inserted without growing.
+ */
+void cu_indexed_heap_reserve(CUIndexedHeap *heap, uint32_t id_count);
+
+/** @brief Remove all ids and free the memory of the heap.
+ *  @param[in] heap Pointer to the heap to clear.
+ */
+void cu_indexed_heap_clear(CUIndexedHeap *heap);
+
+/** @brief Insert an id on the heap.
+ *  @details If the id is already on the heap, its priority is changed.
+ *  @param[in] heap Pointer to the heap to insert into.
+ *  @param[in] id The id. Must be smaller than CU_INDEXED_HEAP_NONE.
+ *  @param[in] priority The priority of the id.
+ */
+void cu_indexed_heap_insert(CUIndexedHeap *heap, uint32_t id, uint64_t priority);
+
+/** @brief Return the id on top of the heap and remove it.
+ *  @param[in] heap Pointer to the heap to pop from.
+ *  @param[out] id If not @a NULL, receives the id.
+ *  @param[out] priority If not @a NULL, receives the priority of the id.
+ *  @retval true An id has been popped.
+ *  @retval false The heap was empty.
+ */
+bool cu_indexed_heap_pop_root(CUIndexedHeap *heap, uint32_t *id, uint64_t *priority);
+
+/** @brief Return the id on top of the heap without removing it.
+ *  @param[in] heap Pointer to the heap to peek from.
+ *  @param[out] id If not @a NULL, receives the id.
+ *  @param[out] priority If not @a NULL, receives the priority of the id.
+ *  @retval true The heap is not empty.
+ *  @retval false The heap was empty.
+ */
+bool cu_indexed_heap_peek_root(CUIndexedHeap *heap, uint32_t *id, uint64_t *priority);
+
+/** @brief Change the priority of an id on the heap, in either direction.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] id The id.
+ *  @param[in] priority The new priority of the id.
+ *  @retval true The priority has been changed.
+ *  @retval false The id is not on the heap.
+ */
+bool cu_indexed_heap_update(CUIndexedHeap *heap, uint32_t id, uint64_t priority);
+
+/** @brief Remove an id from the heap.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] id The id.
+ *  @retval true The id has been removed.
+ *  @retval false The id was not on the heap.
+ */
+bool cu_indexed_heap_remove(CUIndexedHeap *heap, uint32_t id);
+
+/** @brief Determine whether an id is on the heap.
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] id The id.
+ *  @param[out] priority If not @a NULL and the id is on the heap, receives its priority.
+ *  @retval true The id is on the heap.
+ *  @retval false The id is not on the heap.
+ */
+bool cu_indexed_heap_contains(CUIndexedHeap *heap, uint32_t id, uint64_t *priority);
+
+/** @} */
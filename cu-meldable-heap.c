@@ -0,0 +1,381 @@
+#include "cu-meldable-heap.h"
+#include "cu-memory.h"
+#include "cu.h"
+
+/** @internal
+ *  @brief A node of the heap.
+ *  @details The children of a node form a list linked by @a next. The first child points back to
+ *           its parent with @a prev, all others to their previous sibling.
+ */
+struct _CUMeldableHeapNode {
+    void *data; /**< The element. */
+    CUMeldableHeapNode *child; /**< The first child. */
+    CUMeldableHeapNode *next; /**< The next sibling. */
+    CUMeldableHeapNode *prev; /**< The previous sibling, or the parent of a first child. */
+};
+
+struct _CUMeldableHeap {
+    CUMeldableHeapNode *root;
+    size_t length;
+
+    CUCompareDataFunc compare;
+    void *compare_data;
+    CUDestroyNotifyFunc destroy_data;
+
+    CUFixedSizeMemoryPool *node_mem;
+
+    /* Nodes melded in from heaps with a different memory. */
+    CUFixedSizeMemoryPool **foreign_mem; /**< Pools holding some of the nodes, with a reference each. */
+    uint32_t foreign_count; /**< The number of pools in @a foreign_mem. */
+    bool foreign_alloc; /**< Whether some nodes were allocated by cu_alloc(). */
+};
+
+/** @internal
+ *  @brief Wrapper to allocate memory for a single node.
+ *  @details If the heap was created with a fixed size memory pool, get the memory from there,
+ *           otherwise from cu_alloc.
+ */
+static
+CUMeldableHeapNode *_cu_meldable_heap_alloc(CUMeldableHeap *heap)
+{
+    return (CUMeldableHeapNode *)(heap->node_mem ? cu_fixed_size_memory_pool_alloc(heap->node_mem)
+                                                 : cu_alloc(sizeof(CUMeldableHeapNode)));
+}
+
+/** @internal
+ *  @brief Wrapper to free memory of a node and return it to the pool, if present.
+ */
+static
+void _cu_meldable_heap_free(CUMeldableHeap *heap, CUMeldableHeapNode *node)
+{
+    uint32_t j;
+
+    if (cu_likely(!heap->foreign_count && !heap->foreign_alloc)) {
+        if (heap->node_mem)
+            cu_fixed_size_memory_pool_free(heap->node_mem, node);
+        else
+            cu_free(node);
+        return;
+    }
+
+    /* The node may come from a melded heap, find the pool managing it. */
+    if (heap->node_mem && cu_fixed_size_memory_pool_free(heap->node_mem, node))
+        return;
+    for (j = 0; j < heap->foreign_count; ++j) {
+        if (cu_fixed_size_memory_pool_free(heap->foreign_mem[j], node))
+            return;
+    }
+    cu_free(node);
+}
+
+/** @internal
+ *  @brief Drop the references to the pools of melded heaps.
+ *  @details Only call this if no node of these pools is left on the heap.
+ */
+static
+void _cu_meldable_heap_release_foreign(CUMeldableHeap *heap)
+{
+    uint32_t j;
+
+    for (j = 0; j < heap->foreign_count; ++j)
+        cu_fixed_size_memory_pool_unref(heap->foreign_mem[j]);
+    cu_free(heap->foreign_mem);
+    heap->foreign_mem = NULL;
+    heap->foreign_count = 0;
+    heap->foreign_alloc = false;
+}
+
+/** @internal
+ *  @brief Make the nodes of a pool freeable by a heap, taking a reference on the pool.
+ *  @details Takes over the reference, if @a take_ref is @a false.
+ */
+static
+void _cu_meldable_heap_add_foreign(CUMeldableHeap *heap, CUFixedSizeMemoryPool *pool, bool take_ref)
+{
+    uint32_t j;
+    bool known = pool == heap->node_mem;
+
+    for (j = 0; j < heap->foreign_count && !known; ++j)
+        known = heap->foreign_mem[j] == pool;
+    if (known) {
+        if (!take_ref)
+            cu_fixed_size_memory_pool_unref(pool);
+        return;
+    }
+
+    heap->foreign_mem = cu_realloc(heap->foreign_mem, (heap->foreign_count + 1) * sizeof(CUFixedSizeMemoryPool *));
+    heap->foreign_mem[heap->foreign_count++] = take_ref ? cu_fixed_size_memory_pool_ref(pool) : pool;
+}
+
+CUMeldableHeap *cu_meldable_heap_new_full(CUCompareDataFunc compare,
+                                          void *compare_data,
+                                          CUDestroyNotifyFunc destroy_data,
+                                          bool use_fixed_memory_pool)
+{
+    CUMeldableHeap *heap = cu_alloc0(sizeof(CUMeldableHeap));
+
+    heap->compare = compare;
+    heap->compare_data = compare_data;
+    heap->destroy_data = destroy_data;
+    if (use_fixed_memory_pool)
+        heap->node_mem = cu_fixed_size_memory_pool_new(sizeof(CUMeldableHeapNode), 0);
+
+    return heap;
+}
+
+CUMeldableHeap *cu_meldable_heap_new(CUCompareDataFunc compare,
+                                     void *compare_data,
+                                     CUDestroyNotifyFunc destroy_data)
+{
+    return cu_meldable_heap_new_full(compare, compare_data, destroy_data, true);
+}
+
+CUMeldableHeap *cu_meldable_heap_new_sibling(CUMeldableHeap *heap)
+{
+    if (cu_unlikely(!heap))
+        return NULL;
+
+    CUMeldableHeap *sibling = cu_alloc0(sizeof(CUMeldableHeap));
+
+    sibling->compare = heap->compare;
+    sibling->compare_data = heap->compare_data;
+    sibling->destroy_data = heap->destroy_data;
+    if (heap->node_mem)
+        sibling->node_mem = cu_fixed_size_memory_pool_ref(heap->node_mem);
+
+    return sibling;
+}
+
+void cu_meldable_heap_clear(CUMeldableHeap *heap)
+{
+    if (cu_unlikely(!heap))
+        return;
+
+    CUMeldableHeapNode *list = heap->root, *node, *last;
+    bool release_nodes = !heap->node_mem || cu_fixed_size_memory_pool_is_shared(heap->node_mem) ||
+                         heap->foreign_count || heap->foreign_alloc;
+
+    if (heap->destroy_data || release_nodes) {
+        /* Visit all nodes without recursion, by putting the children in front of the list. */
+        while (list) {
+            node = list;
+            list = node->next;
+            if (node->child) {
+                for (last = node->child; last->next; last = last->next);
+                last->next = list;
+                list = node->child;
+            }
+            if (heap->destroy_data)
+                heap->destroy_data(node->data);
+            if (release_nodes)
+                _cu_meldable_heap_free(heap, node);
+        }
+    }
+    if (!release_nodes) {
+        /* We are the only user of the pool, so all nodes can be released at once. */
+        cu_fixed_size_memory_pool_clear(heap->node_mem);
+    }
+    _cu_meldable_heap_release_foreign(heap);
+
+    heap->root = NULL;
+    heap->length = 0;
+}
+
+void cu_meldable_heap_destroy(CUMeldableHeap *heap)
+{
+    if (cu_unlikely(!heap))
+        return;
+    cu_meldable_heap_clear(heap);
+    if (heap->node_mem)
+        cu_fixed_size_memory_pool_unref(heap->node_mem);
+    cu_free(heap);
+}
+
+/** @internal
+ *  @brief Link two trees, the root coming later becomes the first child of the other.
+ *  @return The root of the combined tree.
+ */
+static inline
+CUMeldableHeapNode *_cu_meldable_heap_link(CUMeldableHeap *heap, CUMeldableHeapNode *a, CUMeldableHeapNode *b)
+{
+    CUMeldableHeapNode *tmp;
+
+    if (heap->compare(b->data, a->data, heap->compare_data) > 0) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->prev = a;
+    b->next = a->child;
+    if (a->child)
+        a->child->prev = b;
+    a->child = b;
+    return a;
+}
+
+/** @internal
+ *  @brief Combine a list of siblings into a single tree.
+ *  @details The siblings are linked in pairs from left to right, then the pairs are linked from
+ *           right to left. This keeps the amortized cost of a pop at O(log(n)).
+ *  @return The root of the combined tree.
+ */
+static
+CUMeldableHeapNode *_cu_meldable_heap_combine(CUMeldableHeap *heap, CUMeldableHeapNode *first)
+{
+    CUMeldableHeapNode *pairs = NULL, *a, *b, *root;
+
+    if (!first)
+        return NULL;
+
+    /* First pass, the linked pairs are collected in reverse order. */
+    while (first) {
+        a = first;
+        b = a->next;
+        if (!b) {
+            a->next = pairs;
+            pairs = a;
+            break;
+        }
+        first = b->next;
+        a->next = b->next = NULL;
+        a = _cu_meldable_heap_link(heap, a, b);
+        a->next = pairs;
+        pairs = a;
+    }
+
+    /* Second pass. */
+    root = pairs;
+    pairs = pairs->next;
+    root->next = NULL;
+    while (pairs) {
+        a = pairs;
+        pairs = a->next;
+        a->next = NULL;
+        root = _cu_meldable_heap_link(heap, root, a);
+    }
+    root->prev = NULL;
+
+    return root;
+}
+
+/** @internal
+ *  @brief Detach a node other than the root, together with its children, from its parent.
+ */
+static inline
+void _cu_meldable_heap_cut(CUMeldableHeapNode *node)
+{
+    if (node->prev->child == node)
+        node->prev->child = node->next;
+    else
+        node->prev->next = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+CUMeldableHeapNode *cu_meldable_heap_insert(CUMeldableHeap *heap, void *element)
+{
+    if (cu_unlikely(!heap))
+        return NULL;
+
+    CUMeldableHeapNode *node = _cu_meldable_heap_alloc(heap);
+
+    node->data = element;
+    node->child = NULL;
+    node->next = NULL;
+    node->prev = NULL;
+
+    heap->root = heap->root ? _cu_meldable_heap_link(heap, heap->root, node) : node;
+    ++heap->length;
+
+    return node;
+}
+
+void *cu_meldable_heap_peek_root(CUMeldableHeap *heap)
+{
+    if (cu_unlikely(!heap || !heap->root))
+        return NULL;
+    return heap->root->data;
+}
+
+void *cu_meldable_heap_pop_root(CUMeldableHeap *heap)
+{
+    if (cu_unlikely(!heap || !heap->root))
+        return NULL;
+    return cu_meldable_heap_remove(heap, heap->root);
+}
+
+void cu_meldable_heap_decrease_key(CUMeldableHeap *heap, CUMeldableHeapNode *node)
+{
+    if (cu_unlikely(!heap || !node || node == heap->root))
+        return;
+
+    _cu_meldable_heap_cut(node);
+    heap->root = _cu_meldable_heap_link(heap, heap->root, node);
+}
+
+void *cu_meldable_heap_remove(CUMeldableHeap *heap, CUMeldableHeapNode *node)
+{
+    if (cu_unlikely(!heap || !node))
+        return NULL;
+
+    void *data = node->data;
+    CUMeldableHeapNode *subtree = _cu_meldable_heap_combine(heap, node->child);
+
+    if (node == heap->root) {
+        heap->root = subtree;
+    }
+    else {
+        _cu_meldable_heap_cut(node);
+        if (subtree)
+            heap->root = _cu_meldable_heap_link(heap, heap->root, subtree);
+    }
+    --heap->length;
+    _cu_meldable_heap_free(heap, node);
+
+    return data;
+}
+
+bool cu_meldable_heap_meld(CUMeldableHeap *a, CUMeldableHeap *b)
+{
+    if (cu_unlikely(!a || !b))
+        return false;
+    if (a == b || !b->root)
+        return true;
+
+    uint32_t j;
+
+    /* The nodes of b stay where they are, a only learns how to free them. */
+    if (b->node_mem != a->node_mem) {
+        if (b->node_mem)
+            _cu_meldable_heap_add_foreign(a, b->node_mem, true);
+        else
+            a->foreign_alloc = true;
+    }
+    for (j = 0; j < b->foreign_count; ++j)
+        _cu_meldable_heap_add_foreign(a, b->foreign_mem[j], false);
+    a->foreign_alloc |= b->foreign_alloc;
+    cu_free(b->foreign_mem);
+    b->foreign_mem = NULL;
+    b->foreign_count = 0;
+    b->foreign_alloc = false;
+
+    a->root = a->root ? _cu_meldable_heap_link(a, a->root, b->root) : b->root;
+    a->length += b->length;
+
+    b->root = NULL;
+    b->length = 0;
+
+    return true;
+}
+
+size_t cu_meldable_heap_size(CUMeldableHeap *heap)
+{
+    return heap ? heap->length : 0;
+}
+
+void *cu_meldable_heap_node_get_data(CUMeldableHeapNode *node)
+{
+    return node ? node->data : NULL;
+}
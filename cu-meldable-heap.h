@@ -0,0 +1,129 @@
+/** @file cu-meldable-heap.h
+ *  A heap that can be merged with another one in constant time.
+ *  @defgroup CUMeldableHeap Meldable heap
+ *  @{
+ */
+#pragma once
+
+#include <stddef.h>
+#include <cu-types.h>
+
+/** @brief Handle to a meldable heap.
+ *  @details The heap is a pairing heap: a tree in which every node comes before its children,
+ *           without any balance. Inserting, melding two heaps and moving an element towards the
+ *           top only link two trees in O(1). Popping the top combines its children pairwise in
+ *           O(log(n)) amortized time. Elements are ordered as in @a CUHeap, i.e., the element
+ *           @a a with compare(a, b) >= 0 for all other elements @a b is on top.
+ */
+typedef struct _CUMeldableHeap CUMeldableHeap;
+
+/** @brief Handle to an element on a meldable heap.
+ *  @details Returned by cu_meldable_heap_insert(). It stays valid until the element is popped or
+ *           removed, also when the heap is melded into another one.
+ */
+typedef struct _CUMeldableHeapNode CUMeldableHeapNode;
+
+/** @brief Create a new meldable heap, with full control.
+ *  @param[in] compare Function to compare two elements.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_data Function to free the resources of elements left on the heap when it
+ *                          is cleared or destroyed.
+ *  @param[in] use_fixed_memory_pool Whether to use a fixed size memory pool or cu_alloc()/cu_free().
+ *  @return Pointer to a newly created heap.
+ */
+CUMeldableHeap *cu_meldable_heap_new_full(CUCompareDataFunc compare,
+                                          void *compare_data,
+                                          CUDestroyNotifyFunc destroy_data,
+                                          bool use_fixed_memory_pool);
+
+/** @brief Create a new meldable heap with fixed sized memory pool.
+ *  @param[in] compare Function to compare two elements.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_data Function to free the resources of elements left on the heap when it
+ *                          is cleared or destroyed.
+ *  @return Pointer to a newly created heap.
+ */
+CUMeldableHeap *cu_meldable_heap_new(CUCompareDataFunc compare,
+                                     void *compare_data,
+                                     CUDestroyNotifyFunc destroy_data);
+
+/** @brief Create an empty heap that can be melded with another one.
+ *  @details The new heap has the same callbacks as @a heap and shares its memory pool, if any.
+ *  @param[in] heap The original heap.
+ *  @return Pointer to a newly created heap.
+ */
+CUMeldableHeap *cu_meldable_heap_new_sibling(CUMeldableHeap *heap);
+
+/** @brief Remove all elements from a heap and free their resources.
+ *  @param[in] heap The heap to clear.
+ */
+void cu_meldable_heap_clear(CUMeldableHeap *heap);
+
+/** @brief Destroy a heap and free all resources.
+ *  @param[in] heap The heap to destroy.
+ */
+void cu_meldable_heap_destroy(CUMeldableHeap *heap);
+
+/** @brief Insert an element on the heap.
+ *  @param[in] heap The heap.
+ *  @param[in] element Pointer to the element.
+ *  @return Handle to the element on the heap.
+ */
+CUMeldableHeapNode *cu_meldable_heap_insert(CUMeldableHeap *heap, void *element);
+
+/** @brief Return the element on top of the heap without removing it.
+ *  @param[in] heap The heap.
+ *  @return Pointer to the element on top of the heap, or @a NULL if the heap was empty.
+ */
+void *cu_meldable_heap_peek_root(CUMeldableHeap *heap);
+
+/** @brief Return the element on top of the heap and remove it.
+ *  @param[in] heap The heap.
+ *  @return Pointer to the element on top of the heap, or @a NULL if the heap was empty.
+ */
+void *cu_meldable_heap_pop_root(CUMeldableHeap *heap);
+
+/** @brief Inform the heap that an element moved towards the top (e.g., its key decreased).
+ *  @details Takes O(1). If the element moved away from the top, use cu_meldable_heap_remove()
+ *           and insert it again instead.
+ *  @param[in] heap The heap containing the element.
+ *  @param[in] node The handle of the element.
+ */
+void cu_meldable_heap_decrease_key(CUMeldableHeap *heap, CUMeldableHeapNode *node);
+
+/** @brief Remove an arbitrary element from the heap.
+ *  @details The handle is invalid afterwards.
+ *  @param[in] heap The heap containing the element.
+ *  @param[in] node The handle of the element.
+ *  @return Pointer to the element.
+ */
+void *cu_meldable_heap_remove(CUMeldableHeap *heap, CUMeldableHeapNode *node);
+
+/** @brief Move all elements of one heap to another.
+ *  @details Keeps all handles valid, the nodes are not copied. If both heaps share their memory
+ *           pool (e.g., one was created by cu_meldable_heap_new_sibling() of the other) or both
+ *           do not use a pool, this takes O(1). Otherwise, @a a takes a reference on the pools
+ *           of @a b, which takes O(p) for @a p pools melded into @a a so far, and freeing a node
+ *           of @a a then has to look up its pool until @a a is cleared. As with siblings, both
+ *           heaps must not be used concurrently afterwards. Both heaps have to use the same
+ *           compare function. @a b is empty afterwards.
+ *  @param[in] a The heap receiving all elements.
+ *  @param[in] b The heap to meld into @a a.
+ *  @retval true The heaps have been melded.
+ *  @retval false One of the heaps is @a NULL.
+ */
+bool cu_meldable_heap_meld(CUMeldableHeap *a, CUMeldableHeap *b);
+
+/** @brief Return the number of elements on the heap.
+ *  @param[in] heap The heap.
+ *  @return The number of elements.
+ */
+size_t cu_meldable_heap_size(CUMeldableHeap *heap);
+
+/** @brief Return the element of a handle.
+ *  @param[in] node The handle of the element.
+ *  @return Pointer to the element.
+ */
+void *cu_meldable_heap_node_get_data(CUMeldableHeapNode *node);
+
+/** @} */
@@ -92,6 +92,8 @@ struct _CUFixedSizeMemoryPool {
 
     size_t total_free;      /* number of free elements in the whole pool. */
 
+    uint32_t ref_count;     /* number of users sharing this pool. */
+
     /* FIXME: use a balanced tree here. */
     CUHeap free_memory;
     CUAVLTree *managed_memory;
@@ -178,12 +180,14 @@ CUFixedSizeMemoryPool *cu_fixed_size_memory_pool_new(size_t element_size, size_t
         pool->group_size = group_size;
 
     pool->alloc_size = pool->group_size * pool->element_size + MEMORY_GROUP_HEADER_SIZE;
+    pool->ref_count = 1;
 
     cu_heap_init_full(&pool->free_memory,
                       (CUCompareDataFunc)_cu_fixed_size_memory_pool_compare_free_space,
                       pool,
                       (CUHeapSetPositionCallback)_cu_fixed_size_memory_pool_set_heap_position,
-                      pool);
+                      pool,
+                      0);
     pool->managed_memory = cu_avl_tree_new_full((CUCompareDataFunc)_cu_fixed_size_memory_pool_compare_memory_range,
                                              pool,
                                              NULL,                             /* Do not free keys (group indices). */
@@ -255,6 +259,24 @@ void cu_fixed_size_memory_pool_destroy(CUFixedSizeMemoryPool *pool)
     }
 }
 
+CUFixedSizeMemoryPool *cu_fixed_size_memory_pool_ref(CUFixedSizeMemoryPool *pool)
+{
+    if (pool)
+        ++pool->ref_count;
+    return pool;
+}
+
+void cu_fixed_size_memory_pool_unref(CUFixedSizeMemoryPool *pool)
+{
+    if (pool && --pool->ref_count == 0)
+        cu_fixed_size_memory_pool_destroy(pool);
+}
+
+bool cu_fixed_size_memory_pool_is_shared(CUFixedSizeMemoryPool *pool)
+{
+    return pool && pool->ref_count > 1;
+}
+
 /* Get a new element from the pool. */
 void *cu_fixed_size_memory_pool_alloc(CUFixedSizeMemoryPool *pool)
 {
@@ -118,6 +118,27 @@ void cu_fixed_size_memory_pool_clear(CUFixedSizeMemoryPool *pool);
  */
 void cu_fixed_size_memory_pool_destroy(CUFixedSizeMemoryPool *pool);
 
+/** @brief Increase the reference count of a pool.
+ *  @details Structures that move their elements between each other can share a single pool.
+ *           A newly created pool has a reference count of one.
+ *  @param[in] pool The memory pool.
+ *  @return The memory pool.
+ */
+CUFixedSizeMemoryPool *cu_fixed_size_memory_pool_ref(CUFixedSizeMemoryPool *pool);
+
+/** @brief Decrease the reference count of a pool.
+ *  @details If the reference count drops to zero, the pool is destroyed.
+ *  @param[in] pool The memory pool.
+ */
+void cu_fixed_size_memory_pool_unref(CUFixedSizeMemoryPool *pool);
+
+/** @brief Determine whether more than one reference to the pool is held.
+ *  @param[in] pool The memory pool.
+ *  @retval true The pool is shared, so it must not be cleared by a single user.
+ *  @retval false There is at most a single user of the pool.
+ */
+bool cu_fixed_size_memory_pool_is_shared(CUFixedSizeMemoryPool *pool);
+
 /** @brief Get a new element from the pool.
  *  @param[in] pool The pool handling the memory.
  *  @return Pointer to the newly allocated memory.
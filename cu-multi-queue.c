@@ -0,0 +1,201 @@
+#include "cu-multi-queue.h"
+#include "cu-heap.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <pthread.h>
+
+/* Default number of heaps per thread. */
+#define HEAPS_PER_THREAD 2
+
+/* Arity of the heaps, see cu_heap_init_full(). */
+#define HEAP_ARITY 4
+
+/* Inserting threads wait for a lock after failing to get this many. */
+#define INSERT_ATTEMPTS 4
+
+/* Size of a cache line, to keep heaps apart. */
+#define CACHE_LINE 64
+
+/** @internal
+ *  @brief A heap with its own lock.
+ *  @details Each heap starts a cache line and is padded to a multiple of it, so that threads
+ *           working on neighbouring heaps do not share lines.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock; /**< Held while the heap is accessed. */
+    CUHeap heap; /**< The elements. */
+    uint32_t length; /**< Copy of the length of @a heap, readable without the lock. */
+} CUMultiQueueHeap;
+
+struct _CUMultiQueue {
+    CUMultiQueueHeap *heaps; /**< Inside @a storage, aligned to a cache line. */
+    void *storage; /**< The memory holding @a heaps. */
+    uint32_t heap_count;
+
+    CUCompareDataFunc compare;
+    void *compare_data;
+};
+
+/* State of the random generator choosing heaps, per thread. */
+static __thread uint64_t _cu_multi_queue_random_state;
+
+/** @internal
+ *  @brief Choose a random heap.
+ */
+static inline
+uint32_t _cu_multi_queue_random_heap(CUMultiQueue *queue)
+{
+    uint64_t x = _cu_multi_queue_random_state;
+    if (cu_unlikely(x == 0))
+        x = ((uint64_t)(uintptr_t)&_cu_multi_queue_random_state * 0x9e3779b97f4a7c15ULL) | 1;
+    /* xorshift64 */
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    _cu_multi_queue_random_state = x;
+
+    return (uint32_t)(((x >> 32) * queue->heap_count) >> 32);
+}
+
+CUMultiQueue *cu_multi_queue_new_full(CUCompareDataFunc compare, void *compare_data,
+                                      uint32_t nthreads, uint32_t heaps_per_thread,
+                                      bool strict)
+{
+    CUMultiQueue *queue = cu_alloc0(sizeof(CUMultiQueue));
+    uint32_t j;
+
+    queue->compare = compare;
+    queue->compare_data = compare_data;
+
+    if (nthreads == 0)
+        nthreads = 1;
+    if (heaps_per_thread == 0)
+        heaps_per_thread = HEAPS_PER_THREAD;
+    queue->heap_count = strict ? 1 : nthreads * heaps_per_thread;
+
+    /* cu_alloc() does not align to cache lines, so round the start up. */
+    queue->storage = cu_alloc0(queue->heap_count * sizeof(CUMultiQueueHeap) + CACHE_LINE - 1);
+    queue->heaps = (CUMultiQueueHeap *)(((uintptr_t)queue->storage + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+    for (j = 0; j < queue->heap_count; ++j) {
+        pthread_mutex_init(&queue->heaps[j].lock, NULL);
+        cu_heap_init_full(&queue->heaps[j].heap, compare, compare_data, NULL, NULL, HEAP_ARITY);
+    }
+
+    return queue;
+}
+
+CUMultiQueue *cu_multi_queue_new(CUCompareDataFunc compare, void *compare_data, uint32_t nthreads)
+{
+    return cu_multi_queue_new_full(compare, compare_data, nthreads, 0, false);
+}
+
+void cu_multi_queue_destroy(CUMultiQueue *queue, CUDestroyNotifyFunc destroy_data)
+{
+    if (cu_unlikely(!queue))
+        return;
+
+    uint32_t j;
+
+    for (j = 0; j < queue->heap_count; ++j) {
+        cu_heap_clear(&queue->heaps[j].heap, destroy_data);
+        pthread_mutex_destroy(&queue->heaps[j].lock);
+    }
+    cu_free(queue->storage);
+    cu_free(queue);
+}
+
+void cu_multi_queue_insert(CUMultiQueue *queue, void *element)
+{
+    if (cu_unlikely(!queue))
+        return;
+
+    CUMultiQueueHeap *heap;
+    uint32_t attempt = 0;
+
+    /* Any heap will do, so rather try another one than wait. */
+    do {
+        heap = &queue->heaps[_cu_multi_queue_random_heap(queue)];
+    } while (pthread_mutex_trylock(&heap->lock) != 0 && ++attempt < INSERT_ATTEMPTS);
+    if (attempt == INSERT_ATTEMPTS)
+        pthread_mutex_lock(&heap->lock);
+
+    cu_heap_insert(&heap->heap, element);
+    __atomic_store_n(&heap->length, heap->heap.length, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&heap->lock);
+}
+
+/** @internal
+ *  @brief Pop the top of a heap. The lock must be held.
+ */
+static inline
+void *_cu_multi_queue_pop_heap(CUMultiQueueHeap *heap)
+{
+    void *element = cu_heap_pop_root(&heap->heap);
+    __atomic_store_n(&heap->length, heap->heap.length, __ATOMIC_RELAXED);
+    return element;
+}
+
+void *cu_multi_queue_pop(CUMultiQueue *queue)
+{
+    if (cu_unlikely(!queue))
+        return NULL;
+
+    CUMultiQueueHeap *first, *second;
+    void *element = NULL;
+    uint32_t attempt, j, start;
+
+    for (attempt = 0; attempt < queue->heap_count; ++attempt) {
+        first = &queue->heaps[_cu_multi_queue_random_heap(queue)];
+        second = &queue->heaps[_cu_multi_queue_random_heap(queue)];
+        if (__atomic_load_n(&first->length, __ATOMIC_RELAXED) == 0) {
+            if (__atomic_load_n(&second->length, __ATOMIC_RELAXED) == 0)
+                continue;
+            first = second;
+        }
+        if (pthread_mutex_trylock(&first->lock) != 0)
+            continue;
+
+        /* Without the second lock, the first heap alone is still a valid choice. */
+        if (second != first && pthread_mutex_trylock(&second->lock) == 0) {
+            if (second->heap.length &&
+                    (!first->heap.length ||
+                     queue->compare(second->heap.data[0], first->heap.data[0], queue->compare_data) > 0))
+                element = _cu_multi_queue_pop_heap(second);
+            pthread_mutex_unlock(&second->lock);
+        }
+        if (!element && first->heap.length)
+            element = _cu_multi_queue_pop_heap(first);
+        pthread_mutex_unlock(&first->lock);
+
+        if (element)
+            return element;
+    }
+
+    /* The queue looks empty, make sure by checking every heap. */
+    start = _cu_multi_queue_random_heap(queue);
+    for (j = 0; j < queue->heap_count && !element; ++j) {
+        first = &queue->heaps[(start + j) % queue->heap_count];
+        if (__atomic_load_n(&first->length, __ATOMIC_RELAXED) == 0)
+            continue;
+        pthread_mutex_lock(&first->lock);
+        if (first->heap.length)
+            element = _cu_multi_queue_pop_heap(first);
+        pthread_mutex_unlock(&first->lock);
+    }
+
+    return element;
+}
+
+size_t cu_multi_queue_size(CUMultiQueue *queue)
+{
+    if (cu_unlikely(!queue))
+        return 0;
+
+    size_t size = 0;
+    uint32_t j;
+
+    for (j = 0; j < queue->heap_count; ++j)
+        size += __atomic_load_n(&queue->heaps[j].length, __ATOMIC_RELAXED);
+    return size;
+}
@@ -0,0 +1,72 @@
+/** @file cu-multi-queue.h
+ *  Provide a priority queue shared by many threads.
+ *  @defgroup CUMultiQueue Concurrent relaxed priority queue
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cu-types.h>
+
+/** @brief Handle to a concurrent priority queue.
+ *  @details The queue consists of several heaps (@a CUHeap), each with its own lock. An element
+ *           is inserted into a random heap. A pop looks at two random heaps and takes the top of
+ *           the better one. Threads rarely wait for each other this way, but the order is relaxed:
+ *           a pop returns one of the first few elements of the queue, not necessarily the first.
+ *           The more heaps, the less contention and the more relaxed the order. Elements are
+ *           ordered as in @a CUHeap, i.e., the element @a a with compare(a, b) >= 0 for all
+ *           other elements @a b comes first.
+ */
+typedef struct _CUMultiQueue CUMultiQueue;
+
+/** @brief Create a new queue, with full control.
+ *  @param[in] compare Function to compare two elements.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] nthreads The number of threads expected to use the queue.
+ *  @param[in] heaps_per_thread The number of heaps per thread. 0 selects the default of 2.
+ *  @param[in] strict If set, a single heap is used, so elements are popped exactly in order.
+ *                    This serializes all threads and is meant for testing.
+ *  @return Pointer to a newly created queue.
+ */
+CUMultiQueue *cu_multi_queue_new_full(CUCompareDataFunc compare, void *compare_data,
+                                      uint32_t nthreads, uint32_t heaps_per_thread,
+                                      bool strict);
+
+/** @brief Create a new queue with two heaps per thread.
+ *  @param[in] compare Function to compare two elements.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] nthreads The number of threads expected to use the queue.
+ *  @return Pointer to a newly created queue.
+ */
+CUMultiQueue *cu_multi_queue_new(CUCompareDataFunc compare, void *compare_data, uint32_t nthreads);
+
+/** @brief Destroy a queue and free all resources.
+ *  @details No other thread may access the queue at the same time.
+ *  @param[in] queue The queue to destroy.
+ *  @param[in] destroy_data Function to call to free the resources of each element in the queue.
+ */
+void cu_multi_queue_destroy(CUMultiQueue *queue, CUDestroyNotifyFunc destroy_data);
+
+/** @brief Insert an element into the queue.
+ *  @param[in] queue The queue.
+ *  @param[in] element Pointer to the element.
+ */
+void cu_multi_queue_insert(CUMultiQueue *queue, void *element);
+
+/** @brief Remove one of the first elements from the queue.
+ *  @details Returns @a NULL only if all heaps were found empty, which may miss elements inserted
+ *           concurrently.
+ *  @param[in] queue The queue.
+ *  @return Pointer to the element, or @a NULL if the queue was empty.
+ */
+void *cu_multi_queue_pop(CUMultiQueue *queue);
+
+/** @brief Return the number of elements in the queue.
+ *  @details While other threads change the queue, the result is only approximate.
+ *  @param[in] queue The queue.
+ *  @return The number of elements.
+ */
+size_t cu_multi_queue_size(CUMultiQueue *queue);
+
+/** @} */
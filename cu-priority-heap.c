@@ -0,0 +1,215 @@
+#include "cu-priority-heap.h"
+#include "cu-heap-internal.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <assert.h>
+
+void cu_priority_heap_init_full(CUPriorityHeap *heap, bool largest_first,
+                                CUHeapSetPositionCallback position_cb, void *position_data,
+                                uint32_t arity)
+{
+    memset(heap, 0, sizeof(CUPriorityHeap));
+
+    heap->key_mask = largest_first ? ~0ULL : 0;
+
+    heap->set_position_cb = position_cb;
+    heap->set_position_cb_data = position_data;
+
+    heap->arity_shift = _cu_heap_arity_shift(arity ? arity : 4);
+}
+
+void cu_priority_heap_init(CUPriorityHeap *heap)
+{
+    cu_priority_heap_init_full(heap, false, NULL, NULL, 0);
+}
+
+void cu_priority_heap_clear(CUPriorityHeap *heap, CUDestroyNotifyFunc destroy_data)
+{
+    if (heap) {
+        if (destroy_data) {
+            uint32_t j;
+            for (j = 0; j < heap->length; ++j)
+                destroy_data(heap->entries[j].data);
+        }
+        cu_free(heap->storage);
+        heap->storage = NULL;
+        heap->entries = NULL;
+        heap->length = 0;
+        heap->max_length = 0;
+    }
+}
+
+/** @internal
+ *  @brief Resize the array of a heap.
+ *  @details The array is placed such that the element at index 1 starts a cache line.
+ *  @param[in] heap The heap.
+ *  @param[in] max_length The new capacity, at least the length of the heap.
+ */
+static
+void _cu_priority_heap_resize(CUPriorityHeap *heap, uint32_t max_length)
+{
+    heap->entries = _cu_heap_resize_storage(&heap->storage, heap->entries, heap->length, max_length, sizeof(CUPriorityHeapEntry));
+    heap->max_length = max_length;
+}
+
+/** @internal
+ *  @brief Grow the array of a heap geometrically to hold at least @a count elements.
+ */
+static
+void _cu_priority_heap_grow(CUPriorityHeap *heap, uint32_t count)
+{
+    _cu_priority_heap_resize(heap, _cu_heap_grow_length(heap->max_length, count));
+}
+
+/** @internal
+ *  @brief Halve the array of a heap if shrinking is enabled and it is less than a quarter full.
+ */
+static inline
+void _cu_priority_heap_shrink(CUPriorityHeap *heap)
+{
+    if (heap->shrink && heap->length < heap->max_length / 4 &&
+            heap->max_length / 2 >= HEAP_MIN_LENGTH && heap->max_length / 2 >= heap->reserved_length)
+        _cu_priority_heap_resize(heap, heap->max_length / 2);
+}
+
+/** @internal
+ *  @brief Store an element at a position and inform the element about it.
+ */
+static inline
+void _cu_priority_heap_set(CUPriorityHeap *heap, uint32_t pos, CUPriorityHeapEntry entry)
+{
+    heap->entries[pos] = entry;
+    if (heap->set_position_cb)
+        heap->set_position_cb(entry.data, pos, heap->set_position_cb_data);
+}
+
+/** @internal
+ *  @brief Move an element up from a position until its parent has no larger key.
+ */
+static
+void _cu_priority_heap_upheap(CUPriorityHeap *heap, uint32_t pos, CUPriorityHeapEntry entry)
+{
+    uint32_t parent;
+
+    while (pos) {
+        parent = HEAP_PARENT(heap, pos);
+        if (heap->entries[parent].key <= entry.key)
+            break;
+        _cu_priority_heap_set(heap, pos, heap->entries[parent]);
+        pos = parent;
+    }
+    _cu_priority_heap_set(heap, pos, entry);
+}
+
+/** @internal
+ *  @brief Move an element down from a position until no child has a smaller key.
+ */
+static
+void _cu_priority_heap_downheap(CUPriorityHeap *heap, uint32_t pos, CUPriorityHeapEntry entry)
+{
+    CUPriorityHeapEntry *entries = heap->entries;
+    uint32_t child, last, j;
+
+    while ((child = HEAP_FIRST_CHILD(heap, pos)) < heap->length) {
+        /* select smallest child */
+        last = child + (1u << heap->arity_shift);
+        if (last > heap->length)
+            last = heap->length;
+        for (j = child + 1; j < last; ++j)
+            child = entries[j].key < entries[child].key ? j : child;
+        if (entry.key <= entries[child].key)
+            break;
+        _cu_priority_heap_set(heap, pos, entries[child]);
+        pos = child;
+    }
+    _cu_priority_heap_set(heap, pos, entry);
+}
+
+/** @internal
+ *  @brief Put an element at a position and restore the heap order in either direction.
+ */
+static
+void _cu_priority_heap_reheap(CUPriorityHeap *heap, uint32_t pos, CUPriorityHeapEntry entry)
+{
+    if (pos && heap->entries[HEAP_PARENT(heap, pos)].key > entry.key)
+        _cu_priority_heap_upheap(heap, pos, entry);
+    else
+        _cu_priority_heap_downheap(heap, pos, entry);
+}
+
+void cu_priority_heap_reserve(CUPriorityHeap *heap, uint32_t count)
+{
+    if (cu_unlikely(!heap))
+        return;
+    heap->reserved_length = count;
+    if (count > heap->max_length)
+        _cu_priority_heap_resize(heap, count);
+}
+
+void cu_priority_heap_set_shrink(CUPriorityHeap *heap, bool shrink)
+{
+    if (cu_unlikely(!heap))
+        return;
+    heap->shrink = shrink;
+}
+
+void cu_priority_heap_insert(CUPriorityHeap *heap, void *element, uint64_t priority)
+{
+    if (cu_unlikely(!heap))
+        return;
+    if (cu_unlikely(heap->length == heap->max_length))
+        _cu_priority_heap_grow(heap, heap->length + 1);
+    assert(heap->max_length);
+
+    _cu_priority_heap_upheap(heap, heap->length++, (CUPriorityHeapEntry){ priority ^ heap->key_mask, element });
+}
+
+void *cu_priority_heap_pop_root(CUPriorityHeap *heap, uint64_t *priority)
+{
+    if (cu_unlikely(!heap || !heap->entries || heap->length == 0))
+        return NULL;
+
+    CUPriorityHeapEntry root = heap->entries[0];
+
+    if (--heap->length)
+        _cu_priority_heap_downheap(heap, 0, heap->entries[heap->length]);
+    _cu_priority_heap_shrink(heap);
+
+    if (heap->set_position_cb)
+        heap->set_position_cb(root.data, (uint32_t)(-1), heap->set_position_cb_data);
+    if (priority)
+        *priority = root.key ^ heap->key_mask;
+
+    return root.data;
+}
+
+void *cu_priority_heap_peek_root(CUPriorityHeap *heap, uint64_t *priority)
+{
+    if (cu_unlikely(!heap || !heap->entries || !heap->length))
+        return NULL;
+    if (priority)
+        *priority = heap->entries[0].key ^ heap->key_mask;
+    return heap->entries[0].data;
+}
+
+void cu_priority_heap_update(CUPriorityHeap *heap, uint32_t pos, uint64_t priority)
+{
+    if (cu_unlikely(!heap || !heap->entries || pos >= heap->length))
+        return;
+    _cu_priority_heap_reheap(heap, pos, (CUPriorityHeapEntry){ priority ^ heap->key_mask, heap->entries[pos].data });
+}
+
+void cu_priority_heap_remove(CUPriorityHeap *heap, uint32_t pos)
+{
+    if (cu_unlikely(!heap || !heap->entries || pos >= heap->length))
+        return;
+
+    void *data = heap->entries[pos].data;
+
+    if (pos != --heap->length)
+        _cu_priority_heap_reheap(heap, pos, heap->entries[heap->length]);
+    _cu_priority_heap_shrink(heap);
+
+    if (heap->set_position_cb)
+        heap->set_position_cb(data, (uint32_t)(-1), heap->set_position_cb_data);
+}
@@ -0,0 +1,141 @@
+/** @file cu-priority-heap.h
+ *  A heap of elements with numeric priorities stored inline.
+ *  @defgroup CUPriorityHeap Heap with inline priorities
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <cu-types.h>
+#include <cu-heap.h>
+
+/** @brief An element on the heap together with its priority.
+ *  @details The priority is stored such that the element on top has the smallest @a key.
+ */
+typedef struct {
+    uint64_t key; /**< The priority, transformed for the order of the heap. */
+    void *data; /**< Pointer to the element. */
+} CUPriorityHeapEntry;
+
+/** @brief The heap.
+ *  @details Unlike @a CUHeap, the priorities are kept in the array next to the pointers to the
+ *           elements. Comparisons are plain integer comparisons on contiguous memory, no callback
+ *           is called and no element is dereferenced. Priorities of type @a double are supported
+ *           by converting them with cu_priority_heap_key_from_double(), which keeps their order.
+ *           As for @a CUHeap, the position of each element can be tracked with a callback and be
+ *           used to update its priority or to remove it.
+ */
+typedef struct {
+    uint32_t max_length; /**< Maximal capacity of the heap. */
+    uint32_t length; /**< The number of elements on the heap. */
+    CUPriorityHeapEntry *entries; /**< Array of the elements on the heap. */
+    void *storage; /**< The memory holding @a entries. */
+    uint32_t arity_shift; /**< The number of children of each element is 1 << arity_shift. */
+    uint32_t reserved_length; /**< The capacity is not shrunk below this, see cu_priority_heap_reserve(). */
+    bool shrink; /**< Whether to release memory when the heap gets small, see cu_priority_heap_set_shrink(). */
+    uint64_t key_mask; /**< Applied to priorities to get keys, all bits are set if the largest priority is on top. */
+
+    CUHeapSetPositionCallback set_position_cb; /**< Callback to inform about the changed position of an element. */
+    void *set_position_cb_data; /**< User defined data to pass as third element to set_position_cb(). */
+} CUPriorityHeap;
+
+/** @brief Convert a priority of type @a double to an integer priority of the same order.
+ *  @param[in] priority The priority. Must not be NaN.
+ *  @return The integer priority.
+ */
+static inline
+uint64_t cu_priority_heap_key_from_double(double priority)
+{
+    uint64_t bits;
+    memcpy(&bits, &priority, sizeof(bits));
+    /* Negative numbers are ordered reversely by their bits. */
+    return bits ^ ((uint64_t)((int64_t)bits >> 63) | 0x8000000000000000ULL);
+}
+
+/** @brief Convert an integer priority back to the @a double it was created from.
+ *  @param[in] key The priority returned by cu_priority_heap_key_from_double().
+ *  @return The priority.
+ */
+static inline
+double cu_priority_heap_key_to_double(uint64_t key)
+{
+    uint64_t bits = key ^ ((key & 0x8000000000000000ULL) ? 0x8000000000000000ULL : ~0ULL);
+    double priority;
+    memcpy(&priority, &bits, sizeof(priority));
+    return priority;
+}
+
+/** @brief Initialize a heap with the smallest priority on top.
+ *  @param[in] heap Pointer to the heap to initialize.
+ */
+void cu_priority_heap_init(CUPriorityHeap *heap);
+
+/** @brief Initialize a heap with more control.
+ *  @param[in] heap Pointer to the heap to initialize.
+ *  @param[in] largest_first Whether the element with the largest priority is on top, instead of the smallest.
+ *  @param[in] position_cb Pointer to the callback to inform about the changed position in the heap.
+ *  @param[in] position_data Pointer to the data passed as third element to position_cb().
+ *  @param[in] arity The number of children of each element. Must be a power of two up to 16,
+ *                   other values are rounded down. 0 selects the default of 4, so that all children
+ *                   of an element share a cache line.
+ */
+void cu_priority_heap_init_full(CUPriorityHeap *heap, bool largest_first,
+                                CUHeapSetPositionCallback position_cb, void *position_data,
+                                uint32_t arity);
+
+/** @brief Make room for a number of elements.
+ *  @details See cu_heap_reserve().
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] count The number of elements the heap should hold without growing.
+ */
+void cu_priority_heap_reserve(CUPriorityHeap *heap, uint32_t count);
+
+/** @brief Release memory when the heap gets small.
+ *  @details See cu_heap_set_shrink().
+ *  @param[in] heap Pointer to the heap.
+ *  @param[in] shrink Whether to shrink the heap.
+ */
+void cu_priority_heap_set_shrink(CUPriorityHeap *heap, bool shrink);
+
+/** @brief Remove all elements and clear the heap.
+ *  @param[in] heap Pointer to the heap to clear.
+ *  @param[in] destroy_data Function to call to free the resources of each element on the heap.
+ */
+void cu_priority_heap_clear(CUPriorityHeap *heap, CUDestroyNotifyFunc destroy_data);
+
+/** @brief Insert an element on the heap.
+ *  @param[in] heap Pointer to the heap to insert into.
+ *  @param[in] element Pointer to the element to be inserted.
+ *  @param[in] priority The priority of the element.
+ */
+void cu_priority_heap_insert(CUPriorityHeap *heap, void *element, uint64_t priority);
+
+/** @brief Return the element on top of the heap and remove it.
+ *  @param[in] heap Pointer to the heap to pop from.
+ *  @param[out] priority If not @a NULL, receives the priority of the element.
+ *  @return Pointer to the element on top of the heap, or @a NULL if the heap was empty.
+ */
+void *cu_priority_heap_pop_root(CUPriorityHeap *heap, uint64_t *priority);
+
+/** @brief Return the element on top of the heap without removing it.
+ *  @param[in] heap Pointer to the heap to peek from.
+ *  @param[out] priority If not @a NULL, receives the priority of the element.
+ *  @return Pointer to the element on top of the heap, or @a NULL if the heap was empty.
+ */
+void *cu_priority_heap_peek_root(CUPriorityHeap *heap, uint64_t *priority);
+
+/** @brief Change the priority of an element.
+ *  @param[in] heap Pointer to the heap to be updated.
+ *  @param[in] pos The index of the element.
+ *  @param[in] priority The new priority of the element.
+ */
+void cu_priority_heap_update(CUPriorityHeap *heap, uint32_t pos, uint64_t priority);
+
+/** @brief Remove an arbitrary element from the heap.
+ *  @param[in] heap Pointer to the heap to remove the element from.
+ *  @param[in] pos The index of the element to be removed.
+ */
+void cu_priority_heap_remove(CUPriorityHeap *heap, uint32_t pos);
+
+/** @} */
@@ -0,0 +1,108 @@
+#include "cu-radix-heap.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <string.h>
+
+/* Initial capacity of a bucket. */
+#define MIN_BUCKET_LENGTH 16
+
+void cu_radix_heap_init(CURadixHeap *heap)
+{
+    memset(heap, 0, sizeof(CURadixHeap));
+}
+
+void cu_radix_heap_clear(CURadixHeap *heap, CUDestroyNotifyFunc destroy_data)
+{
+    uint32_t b, j;
+
+    if (cu_unlikely(!heap))
+        return;
+    for (b = 0; b < CU_RADIX_HEAP_BUCKETS; ++b) {
+        if (destroy_data) {
+            for (j = 0; j < heap->buckets[b].length; ++j)
+                destroy_data(heap->buckets[b].entries[j].data);
+        }
+        cu_free(heap->buckets[b].entries);
+    }
+    memset(heap, 0, sizeof(CURadixHeap));
+}
+
+/** @internal
+ *  @brief Return the bucket of a key, given the key popped last.
+ */
+static inline
+uint32_t _cu_radix_heap_bucket(uint64_t key, uint64_t last)
+{
+    return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+}
+
+/** @internal
+ *  @brief Append an element to a bucket.
+ */
+static inline
+void _cu_radix_heap_push(CURadixHeap *heap, uint32_t b, CURadixHeapEntry entry)
+{
+    CURadixHeapBucket *bucket = &heap->buckets[b];
+
+    if (cu_unlikely(bucket->length == bucket->max_length)) {
+        bucket->max_length = bucket->max_length ? 2 * bucket->max_length : MIN_BUCKET_LENGTH;
+        bucket->entries = cu_realloc(bucket->entries, bucket->max_length * sizeof(CURadixHeapEntry));
+    }
+    bucket->entries[bucket->length++] = entry;
+    if (b)
+        heap->nonempty |= 1ULL << (b - 1);
+}
+
+bool cu_radix_heap_insert(CURadixHeap *heap, void *element, uint64_t key)
+{
+    if (cu_unlikely(!heap || key < heap->last))
+        return false;
+
+    _cu_radix_heap_push(heap, _cu_radix_heap_bucket(key, heap->last), (CURadixHeapEntry){ key, element });
+    ++heap->size;
+    return true;
+}
+
+/** @internal
+ *  @brief Refill bucket 0 from the first non-empty bucket.
+ *  @details The smallest key in that bucket becomes the last key. All keys in the bucket then
+ *           differ from it in a lower bit than before, so every element moves to a lower bucket.
+ */
+static
+void _cu_radix_heap_redistribute(CURadixHeap *heap)
+{
+    uint32_t b = __builtin_ctzll(heap->nonempty) + 1;
+    CURadixHeapBucket *bucket = &heap->buckets[b];
+    uint64_t last = bucket->entries[0].key;
+    uint32_t j;
+
+    for (j = 1; j < bucket->length; ++j) {
+        if (bucket->entries[j].key < last)
+            last = bucket->entries[j].key;
+    }
+    heap->last = last;
+
+    for (j = 0; j < bucket->length; ++j)
+        _cu_radix_heap_push(heap, _cu_radix_heap_bucket(bucket->entries[j].key, last), bucket->entries[j]);
+    bucket->length = 0;
+    heap->nonempty &= ~(1ULL << (b - 1));
+}
+
+void *cu_radix_heap_pop_min(CURadixHeap *heap, uint64_t *key)
+{
+    if (cu_unlikely(!heap || heap->size == 0))
+        return NULL;
+
+    if (heap->buckets[0].length == 0)
+        _cu_radix_heap_redistribute(heap);
+
+    --heap->size;
+    if (key)
+        *key = heap->last;
+    return heap->buckets[0].entries[--heap->buckets[0].length].data;
+}
+
+size_t cu_radix_heap_size(CURadixHeap *heap)
+{
+    return heap ? heap->size : 0;
+}
@@ -0,0 +1,79 @@
+/** @file cu-radix-heap.h
+ *  A heap for monotone integer priorities.
+ *  @defgroup CURadixHeap Radix heap
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cu-types.h>
+
+/** @brief Number of buckets of a radix heap, one for each bit of a key plus one for equal keys. */
+#define CU_RADIX_HEAP_BUCKETS 65
+
+/** @brief An element on the heap together with its key. */
+typedef struct {
+    uint64_t key; /**< The priority of the element. */
+    void *data; /**< Pointer to the element. */
+} CURadixHeapEntry;
+
+/** @brief A bucket of elements whose keys share a prefix with the last key popped. */
+typedef struct {
+    CURadixHeapEntry *entries; /**< Array of the elements in the bucket, in no particular order. */
+    uint32_t length; /**< The number of elements in the bucket. */
+    uint32_t max_length; /**< Maximal capacity of the bucket. */
+} CURadixHeapBucket;
+
+/** @brief The heap.
+ *  @details A radix heap only supports keys that are not smaller than the key popped last, as
+ *           for timestamps or distances in Dijkstra’s algorithm. Bucket @a i holds the elements
+ *           whose key differs from the last key popped in bit @a i - 1 at the highest, bucket 0
+ *           those equal to it. Inserting appends to a bucket in O(1). Popping takes from bucket 0,
+ *           or, if that is empty, redistributes the first non-empty bucket into lower ones. Each
+ *           element thereby moves at most 64 times in total, and all moves are sequential scans
+ *           of arrays.
+ */
+typedef struct {
+    uint64_t last; /**< The key popped last, all keys on the heap are at least as large. */
+    size_t size; /**< The number of elements on the heap. */
+    uint64_t nonempty; /**< Bit @a i - 1 is set if bucket @a i is not empty, for @a i > 0. */
+    CURadixHeapBucket buckets[CU_RADIX_HEAP_BUCKETS]; /**< The buckets. */
+} CURadixHeap;
+
+/** @brief Initialize a heap.
+ *  @param[in] heap Pointer to the heap to initialize.
+ */
+void cu_radix_heap_init(CURadixHeap *heap);
+
+/** @brief Remove all elements and clear the heap.
+ *  @details Afterwards, any key may be inserted again.
+ *  @param[in] heap Pointer to the heap to clear.
+ *  @param[in] destroy_data Function to call to free the resources of each element on the heap.
+ */
+void cu_radix_heap_clear(CURadixHeap *heap, CUDestroyNotifyFunc destroy_data);
+
+/** @brief Insert an element on the heap.
+ *  @param[in] heap Pointer to the heap to insert into.
+ *  @param[in] element Pointer to the element to be inserted.
+ *  @param[in] key The priority of the element. Must not be smaller than the key popped last.
+ *  @retval true The element was inserted.
+ *  @retval false The key was smaller than the key popped last, nothing was inserted.
+ */
+bool cu_radix_heap_insert(CURadixHeap *heap, void *element, uint64_t key);
+
+/** @brief Return an element with the smallest key and remove it.
+ *  @details Elements with equal keys are popped in no particular order.
+ *  @param[in] heap Pointer to the heap to pop from.
+ *  @param[out] key If not @a NULL, receives the key of the element.
+ *  @return Pointer to the element, or @a NULL if the heap was empty.
+ */
+void *cu_radix_heap_pop_min(CURadixHeap *heap, uint64_t *key);
+
+/** @brief Return the number of elements on the heap.
+ *  @param[in] heap Pointer to the heap.
+ *  @return The number of elements.
+ */
+size_t cu_radix_heap_size(CURadixHeap *heap);
+
+/** @} */
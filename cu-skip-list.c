@@ -0,0 +1,449 @@
+#include "cu-skip-list.h"
+#include "cu-epoch.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The height of a node is at least 1 and at most this. With a probability of 1/4 to grow by
+ * one level, this suffices for about 4^20 elements. */
+#define CU_SKIP_LIST_MAX_HEIGHT 20
+
+/* A set lowest bit in the link to the successor marks the node as removed on that level. */
+#define LINK_MARK           ((uintptr_t)1)
+#define LINK_NODE(link)     ((CUSkipListNode *)((link) & ~LINK_MARK))
+#define LINK_IS_MARKED(link) ((link) & LINK_MARK)
+
+/* Flags in the state of a node. The thread setting the second flag retires the node. */
+#define NODE_STATE_INSERTED ((uint32_t)1) /* The inserting thread has finished linking the node. */
+#define NODE_STATE_REMOVED  ((uint32_t)2) /* The removing thread has unlinked the node. */
+
+typedef struct _CUSkipListNode CUSkipListNode;
+/** @internal
+ *  @brief A node in the skip list.
+ */
+struct _CUSkipListNode {
+    void *key; /**< Pointer to the key of the node, unique in the list. */
+    void *value; /**< Pointer to the value of the node. Replaced atomically. */
+    CUEpochEntry retired; /**< Link for deferred freeing. */
+    uint32_t height; /**< The number of levels. 0 for the holder of a replaced value. */
+    uint32_t state; /**< Combination of NODE_STATE_* flags. */
+    uintptr_t next[]; /**< The successors on each level, with LINK_MARK. */
+};
+
+struct _CUSkipList {
+    CUSkipListNode *head; /**< Sentinel before the first node, with the maximal height. */
+    uint32_t level; /**< Upper bound of the height of all nodes, searches start here. */
+
+    CUCompareDataFunc compare;
+    void *compare_data;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+
+    CUEpoch *epoch; /**< Delays freeing removed nodes until no thread can access them. */
+};
+
+/* State of the random generator for node heights, per thread. */
+static __thread uint64_t _cu_skip_list_random_state;
+
+static
+int _cu_skip_list_compare_pointers(void *a, void *b, __attribute__((unused))void *nil)
+{
+    if (a < b)
+        return 1;
+    if (a > b)
+        return -1;
+    return 0;
+}
+
+/** @internal
+ *  @brief Choose the height of a new node.
+ *  @details Each level is kept with a probability of 1/4.
+ */
+static inline
+uint32_t _cu_skip_list_random_height(void)
+{
+    uint64_t x = _cu_skip_list_random_state;
+    if (cu_unlikely(x == 0))
+        x = ((uint64_t)(uintptr_t)&_cu_skip_list_random_state * 0x9e3779b97f4a7c15ULL) | 1;
+    /* xorshift64 */
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    _cu_skip_list_random_state = x;
+
+    return 1 + __builtin_ctzll(x | (1ULL << (2 * (CU_SKIP_LIST_MAX_HEIGHT - 1)))) / 2;
+}
+
+/** @internal
+ *  @brief Allocate a node of a given height.
+ *  @details Nodes come from cu_alloc(), as the fixed size memory pools would need a lock shared
+ *           by all threads.
+ */
+static
+CUSkipListNode *_cu_skip_list_node_alloc(uint32_t height)
+{
+    CUSkipListNode *node = cu_alloc(sizeof(CUSkipListNode) + height * sizeof(uintptr_t));
+
+    node->height = height;
+    node->state = 0;
+    return node;
+}
+
+/** @internal
+ *  @brief Free a node after it has been removed from the list and no thread can access it any more.
+ *  @details Also frees the holders of replaced values.
+ */
+static
+void _cu_skip_list_free_retired(CUEpochEntry *entry, CUSkipList *list)
+{
+    CUSkipListNode *node = (CUSkipListNode *)((char *)entry - offsetof(CUSkipListNode, retired));
+
+    if (node->height == 0) {
+        list->destroy_value(node->value);
+        cu_free(node);
+        return;
+    }
+
+    if (list->destroy_key)
+        list->destroy_key(node->key);
+    if (list->destroy_value)
+        list->destroy_value(node->value);
+    cu_free(node);
+}
+
+/** @internal
+ *  @brief Mark the end of inserting or removing a node, and retire it if both have finished.
+ *  @param[in] list The skip list.
+ *  @param[in] node The node.
+ *  @param[in] flag The step that has finished.
+ */
+static inline
+void _cu_skip_list_node_finish(CUSkipList *list, CUSkipListNode *node, uint32_t flag)
+{
+    uint32_t state = __atomic_fetch_or(&node->state, flag, __ATOMIC_ACQ_REL);
+    if ((state | flag) == (NODE_STATE_INSERTED | NODE_STATE_REMOVED))
+        cu_epoch_retire(list->epoch, &node->retired);
+}
+
+/** @internal
+ *  @brief Search for the position of a key, unlinking removed nodes on the way.
+ *  @details Must be called inside a critical section.
+ *  @param[in] list The skip list.
+ *  @param[in] key The key.
+ *  @param[in] top Search the levels below this one.
+ *  @param[out] preds Gets filled with the last node before @a key on each level.
+ *  @param[out] succs Gets filled with the first node not before @a key on each level.
+ *  @retval true @a succs[0] has the key.
+ *  @retval false The key is not in the list.
+ */
+static
+bool _cu_skip_list_search(CUSkipList *list, void *key, uint32_t top,
+                          CUSkipListNode **preds, CUSkipListNode **succs)
+{
+    CUSkipListNode *pred, *curr, *succ;
+    uintptr_t link, expected;
+    uint32_t level;
+    int rc;
+
+retry:
+    rc = -1;
+    pred = list->head;
+    for (level = top; level-- > 0;) {
+        curr = LINK_NODE(__atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE));
+        while (curr) {
+            link = __atomic_load_n(&curr->next[level], __ATOMIC_ACQUIRE);
+            if (LINK_IS_MARKED(link)) {
+                /* Unlink the removed node. This fails if pred was removed or got a new successor. */
+                succ = LINK_NODE(link);
+                expected = (uintptr_t)curr;
+                if (!__atomic_compare_exchange_n(&pred->next[level], &expected, (uintptr_t)succ, false,
+                                                 __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                    goto retry;
+                curr = succ;
+                continue;
+            }
+            rc = list->compare(curr->key, key, list->compare_data);
+            if (rc <= 0)
+                break;
+            pred = curr;
+            curr = LINK_NODE(link);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return succs[0] && rc == 0;
+}
+
+/** @internal
+ *  @brief Raise the level at which searches start to at least @a height.
+ *  @return The new level.
+ */
+static inline
+uint32_t _cu_skip_list_raise_level(CUSkipList *list, uint32_t height)
+{
+    uint32_t level = __atomic_load_n(&list->level, __ATOMIC_RELAXED);
+    while (level < height) {
+        if (__atomic_compare_exchange_n(&list->level, &level, height, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return height;
+    }
+    return level;
+}
+
+CUSkipList *cu_skip_list_new(CUCompareDataFunc compare,
+                             void *compare_data,
+                             CUDestroyNotifyFunc destroy_key,
+                             CUDestroyNotifyFunc destroy_value)
+{
+    CUSkipList *list = cu_alloc0(sizeof(CUSkipList));
+
+    list->head = cu_alloc0(sizeof(CUSkipListNode) + CU_SKIP_LIST_MAX_HEIGHT * sizeof(uintptr_t));
+    list->head->height = CU_SKIP_LIST_MAX_HEIGHT;
+    list->level = 1;
+
+    list->compare = compare ? compare : _cu_skip_list_compare_pointers;
+    list->compare_data = compare_data;
+    list->destroy_key = destroy_key;
+    list->destroy_value = destroy_value;
+
+    list->epoch = cu_epoch_new((CUEpochFreeFunc)_cu_skip_list_free_retired, list);
+
+    return list;
+}
+
+void cu_skip_list_clear(CUSkipList *list)
+{
+    if (cu_unlikely(!list))
+        return;
+
+    CUSkipListNode *node, *next;
+    uint32_t j;
+
+    cu_epoch_reclaim(list->epoch);
+
+    /* Without concurrent access, the lowest level contains exactly the elements. */
+    node = LINK_NODE(list->head->next[0]);
+    while (node) {
+        next = LINK_NODE(node->next[0]);
+        if (list->destroy_key)
+            list->destroy_key(node->key);
+        if (list->destroy_value)
+            list->destroy_value(node->value);
+        cu_free(node);
+        node = next;
+    }
+
+    for (j = 0; j < CU_SKIP_LIST_MAX_HEIGHT; ++j)
+        list->head->next[j] = 0;
+    list->level = 1;
+}
+
+void cu_skip_list_destroy(CUSkipList *list)
+{
+    if (cu_unlikely(!list))
+        return;
+
+    cu_skip_list_clear(list);
+    cu_epoch_destroy(list->epoch);
+    cu_free(list->head);
+    cu_free(list);
+}
+
+void cu_skip_list_insert(CUSkipList *list,
+                         void *key,
+                         void *value)
+{
+    if (cu_unlikely(!list))
+        return;
+
+    CUSkipListNode *preds[CU_SKIP_LIST_MAX_HEIGHT];
+    CUSkipListNode *succs[CU_SKIP_LIST_MAX_HEIGHT];
+    CUSkipListNode *node = NULL;
+    uint32_t height = _cu_skip_list_random_height();
+    uint32_t top = _cu_skip_list_raise_level(list, height);
+    uint32_t level;
+    uintptr_t link, expected;
+
+    uint32_t guard = cu_epoch_enter(list->epoch);
+
+    for (;;) {
+        if (_cu_skip_list_search(list, key, top, preds, succs)) {
+            /* Replace the value. Readers may still use the old one, so destroy it later. */
+            void *old_value = __atomic_exchange_n(&succs[0]->value, value, __ATOMIC_ACQ_REL);
+            if (list->destroy_key && succs[0]->key != key)
+                list->destroy_key(key);
+            if (list->destroy_value && old_value != value) {
+                CUSkipListNode *holder = cu_alloc0(sizeof(CUSkipListNode));
+                holder->value = old_value;
+                cu_epoch_retire(list->epoch, &holder->retired);
+            }
+            if (node)
+                cu_free(node);
+            cu_epoch_leave(list->epoch, guard);
+            return;
+        }
+
+        if (!node) {
+            node = _cu_skip_list_node_alloc(height);
+            node->key = key;
+            node->value = value;
+        }
+        for (level = 0; level < height; ++level)
+            node->next[level] = (uintptr_t)succs[level];
+
+        /* The node is in the list once it is linked on the lowest level. */
+        expected = (uintptr_t)succs[0];
+        if (__atomic_compare_exchange_n(&preds[0]->next[0], &expected, (uintptr_t)node, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    for (level = 1; level < height; ++level) {
+        for (;;) {
+            /* Stop if the node is being removed already. */
+            link = __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+            if (LINK_IS_MARKED(link))
+                goto done;
+            if (LINK_NODE(link) != succs[level] &&
+                !__atomic_compare_exchange_n(&node->next[level], &link, (uintptr_t)succs[level], false,
+                                             __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                goto done;
+
+            expected = (uintptr_t)succs[level];
+            if (__atomic_compare_exchange_n(&preds[level]->next[level], &expected, (uintptr_t)node, false,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                break;
+
+            /* The neighborhood changed, find the new one. */
+            _cu_skip_list_search(list, key, top, preds, succs);
+            if (succs[0] != node)
+                goto done;
+        }
+    }
+
+done:
+    /* A concurrent removal may have searched before we linked the upper levels. Unlink them again. */
+    if (LINK_IS_MARKED(__atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE)))
+        _cu_skip_list_search(list, key, top, preds, succs);
+    _cu_skip_list_node_finish(list, node, NODE_STATE_INSERTED);
+
+    cu_epoch_leave(list->epoch, guard);
+}
+
+bool cu_skip_list_remove(CUSkipList *list, void *key)
+{
+    if (cu_unlikely(!list))
+        return false;
+
+    CUSkipListNode *preds[CU_SKIP_LIST_MAX_HEIGHT];
+    CUSkipListNode *succs[CU_SKIP_LIST_MAX_HEIGHT];
+    CUSkipListNode *node;
+    uint32_t top = __atomic_load_n(&list->level, __ATOMIC_RELAXED);
+    uint32_t level;
+    uintptr_t link;
+
+    uint32_t guard = cu_epoch_enter(list->epoch);
+
+    if (!_cu_skip_list_search(list, key, top, preds, succs)) {
+        cu_epoch_leave(list->epoch, guard);
+        return false;
+    }
+    node = succs[0];
+
+    /* Mark from the top, so the node is unlinked on all levels once it is marked on the lowest. */
+    for (level = node->height; level-- > 1;) {
+        link = __atomic_load_n(&node->next[level], __ATOMIC_RELAXED);
+        while (!LINK_IS_MARKED(link) &&
+               !__atomic_compare_exchange_n(&node->next[level], &link, link | LINK_MARK, true,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    }
+
+    /* Whoever marks the lowest level has removed the element. */
+    link = __atomic_load_n(&node->next[0], __ATOMIC_RELAXED);
+    do {
+        if (LINK_IS_MARKED(link)) {
+            cu_epoch_leave(list->epoch, guard);
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&node->next[0], &link, link | LINK_MARK, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    top = __atomic_load_n(&list->level, __ATOMIC_RELAXED);
+    _cu_skip_list_search(list, key, top, preds, succs);
+    _cu_skip_list_node_finish(list, node, NODE_STATE_REMOVED);
+
+    cu_epoch_leave(list->epoch, guard);
+    return true;
+}
+
+bool cu_skip_list_find(CUSkipList *list,
+                       void *key,
+                       void **data)
+{
+    if (cu_unlikely(!list))
+        return false;
+
+    CUSkipListNode *pred, *curr;
+    uintptr_t link;
+    uint32_t level = __atomic_load_n(&list->level, __ATOMIC_RELAXED);
+    bool found = false;
+    int rc;
+
+    uint32_t guard = cu_epoch_enter(list->epoch);
+
+    /* Only read, skipping removed nodes instead of unlinking them. */
+    pred = list->head;
+    while (level-- > 0) {
+        curr = LINK_NODE(__atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE));
+        while (curr) {
+            link = __atomic_load_n(&curr->next[level], __ATOMIC_ACQUIRE);
+            if (LINK_IS_MARKED(link)) {
+                curr = LINK_NODE(link);
+                continue;
+            }
+            rc = list->compare(curr->key, key, list->compare_data);
+            if (rc > 0) {
+                pred = curr;
+                curr = LINK_NODE(link);
+                continue;
+            }
+            if (rc == 0 && !LINK_IS_MARKED(__atomic_load_n(&curr->next[0], __ATOMIC_ACQUIRE))) {
+                if (data)
+                    *data = __atomic_load_n(&curr->value, __ATOMIC_ACQUIRE);
+                found = true;
+                goto out;
+            }
+            break;
+        }
+    }
+
+out:
+    cu_epoch_leave(list->epoch, guard);
+    return found;
+}
+
+void cu_skip_list_foreach(CUSkipList *list,
+                          CUTraverseFunc traverse,
+                          void *userdata)
+{
+    if (cu_unlikely(!list || !traverse))
+        return;
+
+    CUSkipListNode *node;
+    uintptr_t link;
+
+    uint32_t guard = cu_epoch_enter(list->epoch);
+
+    node = LINK_NODE(__atomic_load_n(&list->head->next[0], __ATOMIC_ACQUIRE));
+    while (node) {
+        link = __atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE);
+        if (!LINK_IS_MARKED(link) &&
+            !traverse(node->key, __atomic_load_n(&node->value, __ATOMIC_ACQUIRE), userdata))
+            break;
+        node = LINK_NODE(link);
+    }
+
+    cu_epoch_leave(list->epoch, guard);
+}
@@ -0,0 +1,88 @@
+/** @file cu-skip-list.h
+ *  Ordered map that can be modified by many threads at once.
+ *  @defgroup CUSkipList Skip list
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to a skip list.
+ *  @details A skip list is a sorted linked list with additional express lanes. Insert, remove and
+ *           find take O(log(n)) expected time and are lock-free, so any number of threads can use
+ *           the list concurrently without external locking. Removed elements are destroyed once no
+ *           thread can still be accessing them. Nodes are allocated with cu_alloc(), so the list is
+ *           only as lock-free as the memory handler.
+ */
+typedef struct _CUSkipList CUSkipList;
+
+/** @brief Create a new skip list.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created skip list.
+ */
+CUSkipList *cu_skip_list_new(CUCompareDataFunc compare,
+                             void *compare_data,
+                             CUDestroyNotifyFunc destroy_key,
+                             CUDestroyNotifyFunc destroy_value);
+
+/** @brief Remove all elements from a skip list.
+ *  @details No other thread may access the list at the same time.
+ *  @param[in] list The skip list.
+ */
+void cu_skip_list_clear(CUSkipList *list);
+
+/** @brief Destroy a skip list and free all resources.
+ *  @details No other thread may access the list at the same time.
+ *  @param[in] list The skip list to destroy.
+ */
+void cu_skip_list_destroy(CUSkipList *list);
+
+/** @brief Insert a new element into a skip list.
+ *  @details If an element with the given @a key is already in the list, the @a key and the old
+ *           value are destroyed. Ownership is passed to the list.
+ *  @param[in] list The skip list.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_skip_list_insert(CUSkipList *list,
+                         void *key,
+                         void *value);
+
+/** @brief Remove an element from a skip list.
+ *  @details Key and value are destroyed when no other thread can access them any more.
+ *  @param[in] list The skip list.
+ *  @param[in] key The key of the element to be removed.
+ *  @retval true The element was removed.
+ *  @retval false The element was not in the list.
+ */
+bool cu_skip_list_remove(CUSkipList *list, void *key);
+
+/** @brief Find an element in a skip list.
+ *  @details If other threads may remove the element concurrently, the caller has to make sure
+ *           that the value stays valid, e.g. by not setting a function to destroy values.
+ *  @param[in] list The skip list.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with the value of the element, if found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the list.
+ */
+bool cu_skip_list_find(CUSkipList *list,
+                       void *key,
+                       void **data);
+
+/** @brief Call a function for all elements of a skip list in order.
+ *  @details Elements inserted or removed concurrently may or may not be visited. The elements
+ *           passed to @a traverse are not destroyed before it returns.
+ *  @param[in] list The skip list.
+ *  @param[in] traverse The function called for each element. If it returns @a false, stop.
+ *  @param[in] userdata Pointer passed as third argument to @a traverse.
+ */
+void cu_skip_list_foreach(CUSkipList *list,
+                          CUTraverseFunc traverse,
+                          void *userdata);
+
+/** @} */
@@ -0,0 +1,506 @@
+#include "cu-sorted-vector.h"
+#include "cu-memory.h"
+#include "cu.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Initial number of elements the arrays can hold. */
+#define MIN_CAPACITY 8
+
+struct _CUSortedVector {
+    void **keys; /**< The keys, sorted. */
+    void **values; /**< The values, in the order of the keys. */
+    size_t length;
+    size_t capacity;
+
+    /* A copy of the keys in Eytzinger layout, starting at index 1, and the index of each in @a keys. */
+    void **eytzinger_keys;
+    size_t *eytzinger_index;
+    size_t eytzinger_capacity;
+    bool eytzinger_layout;
+
+    CUCompareDataFunc compare; /**< @a NULL if the pointer values are compared. */
+    void *compare_data;
+
+    CUDestroyNotifyFunc destroy_key;
+    CUDestroyNotifyFunc destroy_value;
+};
+
+/** @internal
+ *  @brief An element of a batch to insert or remove.
+ */
+typedef struct {
+    void *key;
+    void *value;
+} CUSortedVectorBatchItem;
+
+/** @internal
+ *  @brief Check whether a key is smaller than another key.
+ */
+static inline
+bool _cu_sorted_vector_less(CUSortedVector *vector, void *a, void *b)
+{
+    if (vector->compare)
+        return vector->compare(a, b, vector->compare_data) > 0;
+    return (uintptr_t)a < (uintptr_t)b;
+}
+
+/** @internal
+ *  @brief Find the first element that is not smaller than a key.
+ *  @details Each step halves the range with a conditional move instead of a branch, so
+ *           there are no mispredictions for random keys.
+ *  @return The index of the element, or the length of the vector.
+ */
+static inline
+size_t _cu_sorted_vector_lower_bound(CUSortedVector *vector, void *key)
+{
+    if (!vector->length)
+        return 0;
+
+    void **base = vector->keys;
+    size_t count = vector->length;
+    size_t half;
+
+    if (vector->compare) {
+        while (count > 1) {
+            half = count / 2;
+            base = vector->compare(base[half], key, vector->compare_data) > 0 ? base + half : base;
+            count -= half;
+        }
+    }
+    else {
+        while (count > 1) {
+            half = count / 2;
+            base = (uintptr_t)base[half] < (uintptr_t)key ? base + half : base;
+            count -= half;
+        }
+    }
+    return (size_t)(base - vector->keys) + _cu_sorted_vector_less(vector, base[0], key);
+}
+
+/** @internal
+ *  @brief Find the first element that is not smaller than a key in the Eytzinger layout.
+ *  @return The index of the element in the Eytzinger layout, or 0 if there is none.
+ */
+static inline
+size_t _cu_sorted_vector_lower_bound_eytzinger(CUSortedVector *vector, void *key)
+{
+    void **keys = vector->eytzinger_keys;
+    size_t j = 1;
+
+    /* The descendants four levels down fit into two cache lines. */
+    if (vector->compare) {
+        while (j <= vector->length) {
+            __builtin_prefetch(keys + 16 * j);
+            j = 2 * j + (vector->compare(keys[j], key, vector->compare_data) > 0);
+        }
+    }
+    else {
+        while (j <= vector->length) {
+            __builtin_prefetch(keys + 16 * j);
+            j = 2 * j + ((uintptr_t)keys[j] < (uintptr_t)key);
+        }
+    }
+    /* Go back up to the last node where we went left. */
+    return j >> __builtin_ffsll(~(unsigned long long)j);
+}
+
+/** @internal
+ *  @brief Find an element in the sorted arrays.
+ *  @param[out] equal Receives whether the element found has the same key.
+ *  @return The index of the first element not smaller than @a key.
+ */
+static inline
+size_t _cu_sorted_vector_search(CUSortedVector *vector, void *key, bool *equal)
+{
+    size_t j = _cu_sorted_vector_lower_bound(vector, key);
+    *equal = j < vector->length && !_cu_sorted_vector_less(vector, key, vector->keys[j]);
+    return j;
+}
+
+/** @internal
+ *  @brief Fill the Eytzinger layout of a subtree by an in-order walk.
+ *  @param[in] vector The vector.
+ *  @param[in] next The index of the next key in the sorted array.
+ *  @param[in] node The index of the root of the subtree in the Eytzinger layout.
+ *  @return The index of the key following the subtree.
+ */
+static
+size_t _cu_sorted_vector_build_eytzinger(CUSortedVector *vector, size_t next, size_t node)
+{
+    if (node > vector->length)
+        return next;
+    next = _cu_sorted_vector_build_eytzinger(vector, next, 2 * node);
+    vector->eytzinger_keys[node] = vector->keys[next];
+    vector->eytzinger_index[node] = next++;
+    return _cu_sorted_vector_build_eytzinger(vector, next, 2 * node + 1);
+}
+
+/** @internal
+ *  @brief Update the Eytzinger layout after the set of keys changed.
+ */
+static
+void _cu_sorted_vector_changed(CUSortedVector *vector)
+{
+    if (!vector->eytzinger_layout)
+        return;
+    if (vector->eytzinger_capacity < vector->capacity + 1) {
+        vector->eytzinger_capacity = vector->capacity + 1;
+        vector->eytzinger_keys = cu_realloc(vector->eytzinger_keys,
+                                            vector->eytzinger_capacity * sizeof(void *));
+        vector->eytzinger_index = cu_realloc(vector->eytzinger_index,
+                                             vector->eytzinger_capacity * sizeof(size_t));
+    }
+    _cu_sorted_vector_build_eytzinger(vector, 0, 1);
+}
+
+/** @internal
+ *  @brief Grow the arrays, if necessary, to hold at least @a count elements.
+ */
+static
+void _cu_sorted_vector_grow(CUSortedVector *vector, size_t count)
+{
+    if (count <= vector->capacity)
+        return;
+
+    size_t capacity = vector->capacity ? vector->capacity : MIN_CAPACITY;
+    while (capacity < count)
+        capacity *= 2;
+    vector->keys = cu_realloc(vector->keys, capacity * sizeof(void *));
+    vector->values = cu_realloc(vector->values, capacity * sizeof(void *));
+    vector->capacity = capacity;
+}
+
+/** @internal
+ *  @brief Insert a new element at a position.
+ */
+static
+void _cu_sorted_vector_insert_at(CUSortedVector *vector, size_t pos, void *key, void *value)
+{
+    _cu_sorted_vector_grow(vector, vector->length + 1);
+    memmove(vector->keys + pos + 1, vector->keys + pos, (vector->length - pos) * sizeof(void *));
+    memmove(vector->values + pos + 1, vector->values + pos, (vector->length - pos) * sizeof(void *));
+    vector->keys[pos] = key;
+    vector->values[pos] = value;
+    ++vector->length;
+    _cu_sorted_vector_changed(vector);
+}
+
+/** @internal
+ *  @brief Sort a batch, keeping the order of equal keys (merge sort).
+ *  @param[in] vector The vector providing the compare function.
+ *  @param[in,out] items The batch.
+ *  @param[in] tmp Memory for @a length elements.
+ *  @param[in] length The number of elements in @a items.
+ */
+static
+void _cu_sorted_vector_batch_sort(CUSortedVector *vector, CUSortedVectorBatchItem *items,
+                                  CUSortedVectorBatchItem *tmp, size_t length)
+{
+    if (length < 2)
+        return;
+
+    size_t middle = length / 2;
+    size_t a = 0, b = middle, j = 0;
+    _cu_sorted_vector_batch_sort(vector, items, tmp, middle);
+    _cu_sorted_vector_batch_sort(vector, items + middle, tmp, length - middle);
+
+    /* Nothing to do for already sorted batches. */
+    if (!_cu_sorted_vector_less(vector, items[middle].key, items[middle - 1].key))
+        return;
+
+    while (a < middle && b < length) {
+        if (!_cu_sorted_vector_less(vector, items[b].key, items[a].key))
+            tmp[j++] = items[a++];
+        else
+            tmp[j++] = items[b++];
+    }
+    while (a < middle)
+        tmp[j++] = items[a++];
+    /* The rest of the second half is already in place. */
+    memcpy(items, tmp, j * sizeof(CUSortedVectorBatchItem));
+}
+
+CUSortedVector *cu_sorted_vector_new_full(CUCompareDataFunc compare,
+                                          void *compare_data,
+                                          CUDestroyNotifyFunc destroy_key,
+                                          CUDestroyNotifyFunc destroy_value,
+                                          bool eytzinger_layout)
+{
+    CUSortedVector *vector = cu_alloc0(sizeof(CUSortedVector));
+
+    vector->compare = compare;
+    vector->compare_data = compare_data;
+    vector->destroy_key = destroy_key;
+    vector->destroy_value = destroy_value;
+    vector->eytzinger_layout = eytzinger_layout;
+
+    return vector;
+}
+
+CUSortedVector *cu_sorted_vector_new(CUCompareDataFunc compare,
+                                     void *compare_data,
+                                     CUDestroyNotifyFunc destroy_key,
+                                     CUDestroyNotifyFunc destroy_value)
+{
+    return cu_sorted_vector_new_full(compare, compare_data, destroy_key, destroy_value, false);
+}
+
+void cu_sorted_vector_clear(CUSortedVector *vector)
+{
+    if (cu_unlikely(!vector))
+        return;
+
+    size_t j;
+    for (j = 0; j < vector->length; ++j) {
+        if (vector->destroy_key)
+            vector->destroy_key(vector->keys[j]);
+        if (vector->destroy_value)
+            vector->destroy_value(vector->values[j]);
+    }
+    vector->length = 0;
+}
+
+void cu_sorted_vector_destroy(CUSortedVector *vector)
+{
+    if (cu_unlikely(!vector))
+        return;
+
+    cu_sorted_vector_clear(vector);
+    cu_free(vector->keys);
+    cu_free(vector->values);
+    cu_free(vector->eytzinger_keys);
+    cu_free(vector->eytzinger_index);
+    cu_free(vector);
+}
+
+void cu_sorted_vector_insert(CUSortedVector *vector,
+                             void *key,
+                             void *value)
+{
+    if (cu_unlikely(!vector))
+        return;
+
+    bool equal;
+    size_t pos = _cu_sorted_vector_search(vector, key, &equal);
+
+    if (equal) {
+        if (vector->destroy_key && vector->keys[pos] != key)
+            vector->destroy_key(key);
+        if (vector->destroy_value && vector->values[pos] != value)
+            vector->destroy_value(vector->values[pos]);
+        vector->values[pos] = value;
+        return;
+    }
+
+    _cu_sorted_vector_insert_at(vector, pos, key, value);
+}
+
+bool cu_sorted_vector_remove(CUSortedVector *vector, void *key)
+{
+    if (cu_unlikely(!vector))
+        return false;
+
+    bool equal;
+    size_t pos = _cu_sorted_vector_search(vector, key, &equal);
+
+    if (!equal)
+        return false;
+
+    if (vector->destroy_key)
+        vector->destroy_key(vector->keys[pos]);
+    if (vector->destroy_value)
+        vector->destroy_value(vector->values[pos]);
+
+    --vector->length;
+    memmove(vector->keys + pos, vector->keys + pos + 1, (vector->length - pos) * sizeof(void *));
+    memmove(vector->values + pos, vector->values + pos + 1, (vector->length - pos) * sizeof(void *));
+    _cu_sorted_vector_changed(vector);
+
+    return true;
+}
+
+bool cu_sorted_vector_find(CUSortedVector *vector,
+                           void *key,
+                           void **data)
+{
+    if (cu_unlikely(!vector))
+        return false;
+
+    bool equal;
+    size_t pos;
+
+    if (vector->eytzinger_layout) {
+        /* The key found is still in the cache, so compare it before looking up its index. */
+        pos = _cu_sorted_vector_lower_bound_eytzinger(vector, key);
+        equal = pos && !_cu_sorted_vector_less(vector, key, vector->eytzinger_keys[pos]);
+        if (equal && data)
+            *data = vector->values[vector->eytzinger_index[pos]];
+        return equal;
+    }
+
+    pos = _cu_sorted_vector_search(vector, key, &equal);
+    if (equal && data)
+        *data = vector->values[pos];
+    return equal;
+}
+
+size_t cu_sorted_vector_length(CUSortedVector *vector)
+{
+    return vector ? vector->length : 0;
+}
+
+void cu_sorted_vector_foreach(CUSortedVector *vector,
+                              CUTraverseFunc traverse,
+                              void *userdata)
+{
+    if (cu_unlikely(!vector || !traverse))
+        return;
+
+    size_t j;
+    for (j = 0; j < vector->length; ++j) {
+        if (!traverse(vector->keys[j], vector->values[j], userdata))
+            return;
+    }
+}
+
+void **cu_sorted_vector_lookup_or_insert(CUSortedVector *vector,
+                                         void *key,
+                                         bool *inserted)
+{
+    if (cu_unlikely(!vector))
+        return NULL;
+
+    bool equal;
+    size_t pos = _cu_sorted_vector_search(vector, key, &equal);
+
+    if (inserted)
+        *inserted = !equal;
+    if (!equal)
+        _cu_sorted_vector_insert_at(vector, pos, key, NULL);
+    return &vector->values[pos];
+}
+
+void cu_sorted_vector_reserve(CUSortedVector *vector, size_t count)
+{
+    if (cu_unlikely(!vector))
+        return;
+    _cu_sorted_vector_grow(vector, count);
+}
+
+void cu_sorted_vector_insert_batch(CUSortedVector *vector,
+                                   void **keys,
+                                   void **values,
+                                   size_t length)
+{
+    if (cu_unlikely(!vector || !keys || !length))
+        return;
+
+    size_t j, unique, merged, pos, duplicates = 0;
+    CUSortedVectorBatchItem *items = cu_alloc(2 * length * sizeof(CUSortedVectorBatchItem));
+    for (j = 0; j < length; ++j) {
+        items[j].key = keys[j];
+        items[j].value = values ? values[j] : NULL;
+    }
+    _cu_sorted_vector_batch_sort(vector, items, items + length, length);
+
+    /* Equal keys within the batch behave as if inserted one after another. */
+    for (j = 1, unique = 1; j < length; ++j) {
+        if (!_cu_sorted_vector_less(vector, items[unique - 1].key, items[j].key)) {
+            if (vector->destroy_key && items[unique - 1].key != items[j].key)
+                vector->destroy_key(items[j].key);
+            if (vector->destroy_value && items[unique - 1].value != items[j].value)
+                vector->destroy_value(items[unique - 1].value);
+            items[unique - 1].value = items[j].value;
+        }
+        else {
+            items[unique++] = items[j];
+        }
+    }
+
+    /* Merge from the back, so that every element of the vector is moved only once. Keys
+     * already in the vector leave a gap, which is closed at the end. */
+    _cu_sorted_vector_grow(vector, vector->length + unique);
+    pos = vector->length + unique;
+    merged = vector->length;
+    j = unique;
+    while (j > 0 && merged > 0) {
+        if (_cu_sorted_vector_less(vector, vector->keys[merged - 1], items[j - 1].key)) {
+            --pos;
+            --j;
+            vector->keys[pos] = items[j].key;
+            vector->values[pos] = items[j].value;
+        }
+        else if (_cu_sorted_vector_less(vector, items[j - 1].key, vector->keys[merged - 1])) {
+            --pos;
+            --merged;
+            vector->keys[pos] = vector->keys[merged];
+            vector->values[pos] = vector->values[merged];
+        }
+        else {
+            --pos;
+            --merged;
+            --j;
+            if (vector->destroy_key && vector->keys[merged] != items[j].key)
+                vector->destroy_key(items[j].key);
+            if (vector->destroy_value && vector->values[merged] != items[j].value)
+                vector->destroy_value(vector->values[merged]);
+            vector->keys[pos] = vector->keys[merged];
+            vector->values[pos] = items[j].value;
+            ++duplicates;
+        }
+    }
+    while (j > 0) {
+        --pos;
+        --j;
+        vector->keys[pos] = items[j].key;
+        vector->values[pos] = items[j].value;
+    }
+    if (duplicates) {
+        /* The untouched front of the vector is followed by a gap of one element per duplicate. */
+        memmove(vector->keys + merged, vector->keys + pos, (vector->length + unique - pos) * sizeof(void *));
+        memmove(vector->values + merged, vector->values + pos, (vector->length + unique - pos) * sizeof(void *));
+    }
+    vector->length += unique - duplicates;
+    _cu_sorted_vector_changed(vector);
+
+    cu_free(items);
+}
+
+size_t cu_sorted_vector_remove_batch(CUSortedVector *vector,
+                                     void **keys,
+                                     size_t length)
+{
+    if (cu_unlikely(!vector || !keys || !length || !vector->length))
+        return 0;
+
+    size_t j, batch = 0, kept = 0;
+    CUSortedVectorBatchItem *items = cu_alloc(2 * length * sizeof(CUSortedVectorBatchItem));
+    for (j = 0; j < length; ++j) {
+        items[j].key = keys[j];
+        items[j].value = NULL;
+    }
+    _cu_sorted_vector_batch_sort(vector, items, items + length, length);
+
+    for (j = 0; j < vector->length; ++j) {
+        while (batch < length && _cu_sorted_vector_less(vector, items[batch].key, vector->keys[j]))
+            ++batch;
+        if (batch < length && !_cu_sorted_vector_less(vector, vector->keys[j], items[batch].key)) {
+            if (vector->destroy_key)
+                vector->destroy_key(vector->keys[j]);
+            if (vector->destroy_value)
+                vector->destroy_value(vector->values[j]);
+            continue;
+        }
+        vector->keys[kept] = vector->keys[j];
+        vector->values[kept++] = vector->values[j];
+    }
+
+    cu_free(items);
+
+    j = vector->length - kept;
+    vector->length = kept;
+    if (j)
+        _cu_sorted_vector_changed(vector);
+    return j;
+}
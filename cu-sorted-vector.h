@@ -0,0 +1,157 @@
+/** @file cu-sorted-vector.h
+ *  Provide an ordered map stored in sorted arrays.
+ *  @defgroup CUSortedVector Sorted vector
+ *  @{
+ */
+#pragma once
+
+#include <cu-types.h>
+
+/** @brief Handle to a sorted vector.
+ *  @details Keys and values are kept in two contiguous arrays, sorted by key. A lookup is a
+ *           binary search without unpredictable branches, and a traversal is a linear scan.
+ *           Inserting or removing a single element moves the elements behind it, so this map
+ *           suits small maps that are read much more often than they are changed. Larger
+ *           changes should be done with cu_sorted_vector_insert_batch() and
+ *           cu_sorted_vector_remove_batch(), which merge a whole batch in one pass.
+ *           The functions mirror those of @a CUAVLTree.
+ */
+typedef struct _CUSortedVector CUSortedVector;
+
+/** @brief Create a new sorted vector, with full control.
+ *  @details In the Eytzinger layout, the keys are additionally stored in the order of a breadth
+ *           first traversal of a balanced binary tree. The first steps of all searches then touch
+ *           the same few cache lines, and the next steps can be prefetched. This can speed up
+ *           finding elements in vectors that do not fit into the cache, but every change rebuilds
+ *           the copy.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @param[in] eytzinger_layout Whether to search a copy of the keys in Eytzinger layout.
+ *  @return Pointer to a newly created sorted vector.
+ */
+CUSortedVector *cu_sorted_vector_new_full(CUCompareDataFunc compare,
+                                          void *compare_data,
+                                          CUDestroyNotifyFunc destroy_key,
+                                          CUDestroyNotifyFunc destroy_value,
+                                          bool eytzinger_layout);
+
+/** @brief Create a new sorted vector.
+ *  @param[in] compare Pointer to a function that compares two keys. If not specified,
+ *                     the pointer values are compared.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_key Function to free resources used by the key.
+ *  @param[in] destroy_value Function to free resources used by the value.
+ *  @return Pointer to a newly created sorted vector.
+ */
+CUSortedVector *cu_sorted_vector_new(CUCompareDataFunc compare,
+                                     void *compare_data,
+                                     CUDestroyNotifyFunc destroy_key,
+                                     CUDestroyNotifyFunc destroy_value);
+
+/** @brief Clear a sorted vector and free resources of keys/values.
+ *  @details The memory of the arrays is kept for further use.
+ *  @param[in] vector The vector to clear.
+ */
+void cu_sorted_vector_clear(CUSortedVector *vector);
+
+/** @brief Destroy a sorted vector and free all resources.
+ *  @param[in] vector The vector to destroy.
+ */
+void cu_sorted_vector_destroy(CUSortedVector *vector);
+
+/** @brief Insert a new element into a vector.
+ *  @details If an element with the given @a key is already in the vector, the @a key and the old
+ *           value are destroyed. Ownership is passed to the vector.
+ *  @param[in] vector The vector.
+ *  @param[in] key The key of the element.
+ *  @param[in] value The value to be inserted for @a key.
+ */
+void cu_sorted_vector_insert(CUSortedVector *vector,
+                             void *key,
+                             void *value);
+
+/** @brief Remove an element from the vector and free its resources.
+ *  @param[in] vector The vector.
+ *  @param[in] key The key of the element to destroy.
+ *  @retval true The element was present in the vector and was destroyed.
+ *  @retval false The element was not found in the vector.
+ */
+bool cu_sorted_vector_remove(CUSortedVector *vector, void *key);
+
+/** @brief Find an element in the vector.
+ *  @param[in] vector The vector.
+ *  @param[in] key The key of the element we search.
+ *  @param[out] data Gets filled with a pointer to the value, if @a key was found.
+ *  @retval true The element specified by @a key was found.
+ *  @retval false The element is not in the vector.
+ */
+bool cu_sorted_vector_find(CUSortedVector *vector,
+                           void *key,
+                           void **data);
+
+/** @brief Return the number of elements in the vector.
+ *  @param[in] vector The vector.
+ *  @return The number of elements.
+ */
+size_t cu_sorted_vector_length(CUSortedVector *vector);
+
+/** @brief Call a function for each element in the vector.
+ *  @details The vector is processed in order.
+ *  @param[in] vector The vector.
+ *  @param[in] traverse Function to call for each element.
+ *  @param[in] userdata Pointer passed as third argument to \a traverse.
+ */
+void cu_sorted_vector_foreach(CUSortedVector *vector,
+                              CUTraverseFunc traverse,
+                              void *userdata);
+
+/** @brief Find an element, or insert it if it is not in the vector yet.
+ *  @details If the element is inserted, its value is @a NULL and ownership of @a key is passed to
+ *           the vector. Otherwise, @a key is not used and remains owned by the caller. The returned
+ *           pointer is valid until the vector is modified next.
+ *  @param[in] vector The vector.
+ *  @param[in] key The key of the element.
+ *  @param[out] inserted If not @a NULL, receives whether a new element has been inserted.
+ *  @return Pointer to the value of the element, which may be set by the caller.
+ */
+void **cu_sorted_vector_lookup_or_insert(CUSortedVector *vector,
+                                         void *key,
+                                         bool *inserted);
+
+/** @brief Make room for a number of elements.
+ *  @param[in] vector The vector.
+ *  @param[in] count The number of elements the vector should hold without growing.
+ */
+void cu_sorted_vector_reserve(CUSortedVector *vector, size_t count);
+
+/** @brief Insert many elements at once.
+ *  @details The batch is sorted and merged with the vector from the back, so each element is
+ *           moved at most once. Batches that are already sorted need no extra comparisons for
+ *           sorting, which makes this the fastest way to build a vector from sorted data. The
+ *           result is the same as calling cu_sorted_vector_insert() for each element in the order
+ *           given.
+ *  @param[in] vector The vector.
+ *  @param[in] keys The keys of the elements.
+ *  @param[in] values The values of the elements, or @a NULL to insert @a NULL values.
+ *  @param[in] length The number of elements.
+ */
+void cu_sorted_vector_insert_batch(CUSortedVector *vector,
+                                   void **keys,
+                                   void **values,
+                                   size_t length);
+
+/** @brief Remove many elements at once and free their resources.
+ *  @details The remaining elements are compacted in a single pass.
+ *  @param[in] vector The vector.
+ *  @param[in] keys The keys of the elements to remove. Keys not in the vector are ignored.
+ *  @param[in] length The number of keys.
+ *  @return The number of elements removed.
+ */
+size_t cu_sorted_vector_remove_batch(CUSortedVector *vector,
+                                     void **keys,
+                                     size_t length);
+
+/** @} */
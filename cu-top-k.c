@@ -0,0 +1,278 @@
+#include "cu-top-k.h"
+#include "cu-heap.h"
+#include "cu-priority-heap.h"
+#include "cu-memory.h"
+#include "cu.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of keys compared against the threshold at once. */
+#define GROUP_WIDTH 4
+
+/* Arity of the heaps, see cu_heap_init_full(). */
+#define HEAP_ARITY 4
+
+struct _CUTopK {
+    uint32_t k;
+    bool numeric; /**< Whether @a priority_heap is used instead of @a heap. */
+
+    CUHeap heap; /**< The elements kept, if compared by a function. */
+    CUPriorityHeap priority_heap; /**< The elements kept, if compared by numeric keys. */
+    double threshold; /**< The smallest numeric key kept, once @a k elements are kept. */
+
+    CUDestroyNotifyFunc destroy_data;
+};
+
+/** @internal
+ *  @brief Return a bit mask of the keys in the group starting at @a keys that are above @a threshold.
+ */
+static inline
+uint32_t _cu_top_k_group_above(const double *keys, double threshold)
+{
+#ifdef __SSE2__
+    __m128d limit = _mm_set1_pd(threshold);
+    return (uint32_t)_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(keys), limit)) |
+           ((uint32_t)_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(keys + 2), limit)) << 2);
+#else
+    uint32_t mask = 0;
+    uint32_t j;
+    for (j = 0; j < GROUP_WIDTH; ++j)
+        mask |= (uint32_t)(keys[j] > threshold) << j;
+    return mask;
+#endif
+}
+
+/** @internal
+ *  @brief Create a selection with the common settings.
+ */
+static
+CUTopK *_cu_top_k_new(uint32_t k, bool numeric, CUDestroyNotifyFunc destroy_data)
+{
+    CUTopK *topk = cu_alloc0(sizeof(CUTopK));
+
+    topk->k = k;
+    topk->numeric = numeric;
+    topk->destroy_data = destroy_data;
+
+    return topk;
+}
+
+CUTopK *cu_top_k_new(uint32_t k,
+                     CUCompareDataFunc compare,
+                     void *compare_data,
+                     CUDestroyNotifyFunc destroy_data)
+{
+    CUTopK *topk = _cu_top_k_new(k, false, destroy_data);
+
+    cu_heap_init_full(&topk->heap, compare, compare_data, NULL, NULL, HEAP_ARITY);
+    if (k)
+        cu_heap_reserve(&topk->heap, k);
+
+    return topk;
+}
+
+CUTopK *cu_top_k_new_numeric(uint32_t k, CUDestroyNotifyFunc destroy_data)
+{
+    CUTopK *topk = _cu_top_k_new(k, true, destroy_data);
+
+    cu_priority_heap_init_full(&topk->priority_heap, false, NULL, NULL, HEAP_ARITY);
+    if (k)
+        cu_priority_heap_reserve(&topk->priority_heap, k);
+
+    return topk;
+}
+
+void cu_top_k_clear(CUTopK *topk)
+{
+    if (cu_unlikely(!topk))
+        return;
+
+    uint32_t j;
+
+    /* Keys-only selections keep NULL elements, which are not passed to destroy_data. */
+    if (topk->destroy_data) {
+        if (topk->numeric) {
+            for (j = 0; j < topk->priority_heap.length; ++j) {
+                if (topk->priority_heap.entries[j].data)
+                    topk->destroy_data(topk->priority_heap.entries[j].data);
+            }
+        }
+        else {
+            for (j = 0; j < topk->heap.length; ++j) {
+                if (topk->heap.data[j])
+                    topk->destroy_data(topk->heap.data[j]);
+            }
+        }
+    }
+    if (topk->numeric)
+        cu_priority_heap_clear(&topk->priority_heap, NULL);
+    else
+        cu_heap_clear(&topk->heap, NULL);
+}
+
+void cu_top_k_destroy(CUTopK *topk)
+{
+    if (cu_unlikely(!topk))
+        return;
+    cu_top_k_clear(topk);
+    cu_free(topk);
+}
+
+/** @internal
+ *  @brief Offer an element to a function compared selection.
+ */
+static inline
+bool _cu_top_k_offer(CUTopK *topk, void *element)
+{
+    CUHeap *heap = &topk->heap;
+    void *dropped = element;
+    bool accepted = false;
+
+    if (heap->length < topk->k) {
+        cu_heap_insert(heap, element);
+        return true;
+    }
+    if (topk->k && heap->compare(heap->data[0], element, heap->compare_data) > 0) {
+        /* Replace the smallest element kept. */
+        dropped = heap->data[0];
+        heap->data[0] = element;
+        cu_heap_update(heap, 0);
+        accepted = true;
+    }
+    if (topk->destroy_data && dropped)
+        topk->destroy_data(dropped);
+    return accepted;
+}
+
+bool cu_top_k_offer(CUTopK *topk, void *element)
+{
+    if (cu_unlikely(!topk || topk->numeric))
+        return false;
+    return _cu_top_k_offer(topk, element);
+}
+
+size_t cu_top_k_offer_batch(CUTopK *topk, void **elements, size_t count)
+{
+    if (cu_unlikely(!topk || topk->numeric || !elements))
+        return 0;
+
+    size_t kept = 0, j;
+
+    for (j = 0; j < count; ++j)
+        kept += _cu_top_k_offer(topk, elements[j]);
+    return kept;
+}
+
+/** @internal
+ *  @brief Offer an element to a numeric selection.
+ */
+static inline
+bool _cu_top_k_offer_numeric(CUTopK *topk, void *element, double key)
+{
+    CUPriorityHeap *heap = &topk->priority_heap;
+    void *dropped = element;
+    bool accepted = false;
+
+    if (cu_unlikely(key != key)) {
+        /* NaN has no place in the order. */
+    }
+    else if (heap->length < topk->k) {
+        cu_priority_heap_insert(heap, element, cu_priority_heap_key_from_double(key));
+        if (heap->length == topk->k)
+            topk->threshold = cu_priority_heap_key_to_double(heap->entries[0].key);
+        return true;
+    }
+    else if (topk->k && key > topk->threshold) {
+        /* Replace the element with the smallest key. */
+        dropped = heap->entries[0].data;
+        heap->entries[0].data = element;
+        cu_priority_heap_update(heap, 0, cu_priority_heap_key_from_double(key));
+        topk->threshold = cu_priority_heap_key_to_double(heap->entries[0].key);
+        accepted = true;
+    }
+    if (topk->destroy_data && dropped)
+        topk->destroy_data(dropped);
+    return accepted;
+}
+
+bool cu_top_k_offer_numeric(CUTopK *topk, void *element, double key)
+{
+    if (cu_unlikely(!topk || !topk->numeric))
+        return false;
+    return _cu_top_k_offer_numeric(topk, element, key);
+}
+
+size_t cu_top_k_offer_numeric_batch(CUTopK *topk, void **elements, const double *keys, size_t count)
+{
+    if (cu_unlikely(!topk || !topk->numeric || !keys))
+        return 0;
+
+    size_t kept = 0, j = 0;
+    uint32_t mask, b;
+
+    /* Without a threshold, every key has to be looked at. */
+    for (; j < count && topk->priority_heap.length < topk->k; ++j)
+        kept += _cu_top_k_offer_numeric(topk, elements ? elements[j] : NULL, keys[j]);
+
+    if (topk->k) {
+        for (; j + GROUP_WIDTH <= count; j += GROUP_WIDTH) {
+            mask = _cu_top_k_group_above(keys + j, topk->threshold);
+            if (cu_likely(!mask)) {
+                if (topk->destroy_data && elements) {
+                    for (b = 0; b < GROUP_WIDTH; ++b) {
+                        if (elements[j + b])
+                            topk->destroy_data(elements[j + b]);
+                    }
+                }
+                continue;
+            }
+            for (b = 0; b < GROUP_WIDTH; ++b) {
+                /* The threshold may have risen since the group was compared. */
+                if (mask & (1u << b))
+                    kept += _cu_top_k_offer_numeric(topk, elements ? elements[j + b] : NULL, keys[j + b]);
+                else if (topk->destroy_data && elements && elements[j + b])
+                    topk->destroy_data(elements[j + b]);
+            }
+        }
+    }
+    for (; j < count; ++j)
+        kept += _cu_top_k_offer_numeric(topk, elements ? elements[j] : NULL, keys[j]);
+
+    return kept;
+}
+
+size_t cu_top_k_length(CUTopK *topk)
+{
+    if (cu_unlikely(!topk))
+        return 0;
+    return topk->numeric ? topk->priority_heap.length : topk->heap.length;
+}
+
+size_t cu_top_k_take(CUTopK *topk, void **elements, double *keys)
+{
+    if (cu_unlikely(!topk))
+        return 0;
+
+    size_t length = cu_top_k_length(topk), j;
+    uint64_t key;
+    void *element;
+
+    /* The heap yields the smallest element first. */
+    for (j = length; j-- > 0; ) {
+        if (topk->numeric) {
+            element = cu_priority_heap_pop_root(&topk->priority_heap, &key);
+            if (keys)
+                keys[j] = cu_priority_heap_key_to_double(key);
+        }
+        else {
+            element = cu_heap_pop_root(&topk->heap);
+        }
+        if (elements)
+            elements[j] = element;
+        else if (topk->destroy_data && element)
+            topk->destroy_data(element);
+    }
+
+    return length;
+}
@@ -0,0 +1,115 @@
+/** @file cu-top-k.h
+ *  Select the largest elements of a stream.
+ *  @defgroup CUTopK Top-k selection
+ *  @{
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cu-types.h>
+
+/** @brief Handle to a top-k selection.
+ *  @details Keeps the @a k largest elements offered so far in a heap whose root is the smallest
+ *           of them. Once @a k elements are kept, a candidate is rejected with a single comparison
+ *           against the root, and an accepted candidate replaces the root. Selecting from @a n
+ *           elements thereby takes O(n + m log(k)) for @a m accepted candidates.
+ *
+ *           Elements are either compared by a function, which orders them as for @a CUHeap
+ *           (compare(a, b) > 0 if @a a is smaller than @a b), or by numeric keys of type
+ *           @a double. Batches with numeric keys are compared against the root several keys at
+ *           once with SSE2, if available.
+ */
+typedef struct _CUTopK CUTopK;
+
+/** @brief Create a new top-k selection of elements compared by a function.
+ *  @param[in] k The maximal number of elements to keep.
+ *  @param[in] compare Function to compare two elements.
+ *  @param[in] compare_data User defined data passed as third argument to @a compare.
+ *  @param[in] destroy_data Function to free the resources of elements that are rejected, dropped
+ *                          or left when the selection is cleared. It is not called for @a NULL
+ *                          elements. May be @a NULL.
+ *  @return Pointer to a newly created selection.
+ */
+CUTopK *cu_top_k_new(uint32_t k,
+                     CUCompareDataFunc compare,
+                     void *compare_data,
+                     CUDestroyNotifyFunc destroy_data);
+
+/** @brief Create a new top-k selection of elements with numeric keys.
+ *  @details Elements have to be offered with cu_top_k_offer_numeric() or
+ *           cu_top_k_offer_numeric_batch().
+ *  @param[in] k The maximal number of elements to keep.
+ *  @param[in] destroy_data Function to free the resources of elements that are rejected, dropped
+ *                          or left when the selection is cleared. It is not called for @a NULL
+ *                          elements. May be @a NULL.
+ *  @return Pointer to a newly created selection.
+ */
+CUTopK *cu_top_k_new_numeric(uint32_t k, CUDestroyNotifyFunc destroy_data);
+
+/** @brief Remove all elements from a selection and free their resources.
+ *  @param[in] topk The selection.
+ */
+void cu_top_k_clear(CUTopK *topk);
+
+/** @brief Destroy a selection and free all resources.
+ *  @param[in] topk The selection.
+ */
+void cu_top_k_destroy(CUTopK *topk);
+
+/** @brief Offer an element to a selection using a compare function.
+ *  @details Ownership is passed to the selection.
+ *  @param[in] topk The selection.
+ *  @param[in] element Pointer to the element.
+ *  @retval true The element is kept, possibly dropping the smallest element kept so far.
+ *  @retval false The element is not larger than the @a k elements kept.
+ */
+bool cu_top_k_offer(CUTopK *topk, void *element);
+
+/** @brief Offer many elements to a selection using a compare function.
+ *  @param[in] topk The selection.
+ *  @param[in] elements Pointers to the elements.
+ *  @param[in] count The number of elements.
+ *  @return The number of elements that were kept when they were offered.
+ */
+size_t cu_top_k_offer_batch(CUTopK *topk, void **elements, size_t count);
+
+/** @brief Offer an element with a numeric key to a selection.
+ *  @details Ownership is passed to the selection. Elements with a key that is NaN are rejected.
+ *  @param[in] topk The selection.
+ *  @param[in] element Pointer to the element.
+ *  @param[in] key The key of the element.
+ *  @retval true The element is kept, possibly dropping the element with the smallest key.
+ *  @retval false The key is not larger than the @a k keys kept.
+ */
+bool cu_top_k_offer_numeric(CUTopK *topk, void *element, double key);
+
+/** @brief Offer many elements with numeric keys to a selection.
+ *  @details Once @a k elements are kept, the keys are compared against the smallest key kept a
+ *           group at a time, and only the few keys above it are looked at one by one.
+ *  @param[in] topk The selection.
+ *  @param[in] elements Pointers to the elements. If @a NULL, only the keys are selected.
+ *  @param[in] keys The keys of the elements.
+ *  @param[in] count The number of elements.
+ *  @return The number of elements that were kept when they were offered.
+ */
+size_t cu_top_k_offer_numeric_batch(CUTopK *topk, void **elements, const double *keys, size_t count);
+
+/** @brief Return the number of elements kept.
+ *  @param[in] topk The selection.
+ *  @return The number of elements, at most @a k.
+ */
+size_t cu_top_k_length(CUTopK *topk);
+
+/** @brief Move the elements kept out of a selection, largest first.
+ *  @details The selection is empty afterwards and can be used for another stream.
+ *  @param[in] topk The selection.
+ *  @param[out] elements If not @a NULL, receives the elements and ownership of them. Must have room
+ *                       for cu_top_k_length() elements. If @a NULL, the elements are destroyed.
+ *  @param[out] keys If not @a NULL, receives the keys of a numeric selection. Must have room for
+ *                   cu_top_k_length() keys.
+ *  @return The number of elements.
+ */
+size_t cu_top_k_take(CUTopK *topk, void **elements, double *keys);
+
+/** @} */
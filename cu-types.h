@@ -29,6 +29,20 @@ typedef int (*CUCompareDataFunc)(void *, void *, void *);
  */
 typedef int (*CUCompareFunc)(void *, void *);
 
+/** @brief Compute the hash value of an element.
+ *  @param[in] 1 The element.
+ *  @return The hash value. Equal elements must have the same hash value.
+ */
+typedef uint64_t (*CUHashFunc)(void *);
+
+/** @brief Determine whether two elements are equal.
+ *  @param[in] 1 The first element.
+ *  @param[in] 2 The second element.
+ *  @retval true Both elements are equal.
+ *  @retval false The elements differ.
+ */
+typedef bool (*CUEqualFunc)(void *, void *);
+
 /** @brief Callback for key/value pairs.
  *  @param[in] 1 The key.
  *  @param[in] 2 The value.
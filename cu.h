@@ -13,10 +13,23 @@
 #include <cu-queue-locked.h>
 #include <cu-stack.h>
 #include <cu-timer.h>
+#include <cu-ar-tree.h>
 #include <cu-avl-tree.h>
+#include <cu-avl-tree-image.h>
+#include <cu-concurrent-hash-map.h>
+#include <cu-btree.h>
+#include <cu-skip-list.h>
+#include <cu-sorted-vector.h>
 #include <cu-fixed-stack.h>
+#include <cu-hash-table.h>
 #include <cu-heap.h>
+#include <cu-priority-heap.h>
+#include <cu-indexed-heap.h>
+#include <cu-radix-heap.h>
+#include <cu-meldable-heap.h>
+#include <cu-top-k.h>
 #include <cu-mixed-heap-list.h>
+#include <cu-multi-queue.h>
 #include <cu-types.h>
 
 #if __WORDSIZE == 32
@@ -1,10 +1,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "cu.h"
 #include "cu-heap.h"
+#include "cu-priority-heap.h"
+#include "cu-radix-heap.h"
+#include "cu-indexed-heap.h"
 #include "cu-avl-tree.h"
+#include "cu-avl-tree-image.h"
+#include "cu-top-k.h"
+#include "cu-meldable-heap.h"
+#include "cu-skip-list.h"
+#include "cu-epoch.h"
+#include "cu-multi-queue.h"
+#include "cu-btree.h"
+#include "cu-hash-table.h"
+#include "cu-concurrent-hash-map.h"
+#include "cu-ar-tree.h"
+#include "cu-sorted-vector.h"
+
+static uint32_t check_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++check_failures; \
+        } \
+    } while (0)
 
 int cmp_uint(void *a, void *b, void *data)
 {
@@ -16,6 +43,970 @@ int cmp_uint(void *a, void *b, void *data)
     return 0;
 }
 
+int cmp_uint_quiet(void *a, void *b, void *data)
+{
+    if (CU_POINTER_TO_UINT(a) < CU_POINTER_TO_UINT(b))
+        return 1;
+    if (CU_POINTER_TO_UINT(a) > CU_POINTER_TO_UINT(b))
+        return -1;
+    return 0;
+}
+
+int cmp_deref(uint32_t *a, uint32_t *b, void *data)
+{
+    return cmp_uint_quiet(CU_UINT_TO_POINTER(*a), CU_UINT_TO_POINTER(*b), data);
+}
+
+static uint32_t test_random_state = 1;
+
+static
+uint32_t test_random(void)
+{
+    /* xorshift32, the tests need reproducible values only. */
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+    return test_random_state;
+}
+
+/* Check that popping a heap of pointers to uint32_t yields non-decreasing values. */
+static
+uint32_t check_heap_sorted(CUHeap *heap)
+{
+    uint32_t count = 0, last = 0, *value;
+
+    while ((value = cu_heap_pop_root(heap))) {
+        CHECK(*value >= last);
+        last = *value;
+        ++count;
+    }
+    return count;
+}
+
+static uint32_t destroyed_count = 0;
+
+static
+void count_destroyed(void *data)
+{
+    CHECK(data != NULL);
+    ++destroyed_count;
+}
+
+static
+void test_top_k(void)
+{
+    CUTopK *topk;
+    double keys[8], top[2];
+    void *elements[8], *kept[2];
+    uint32_t j;
+
+    for (j = 0; j < 8; ++j) {
+        keys[j] = j + 1;
+        elements[j] = CU_UINT_TO_POINTER(j + 1);
+    }
+
+    /* Keys only: every key is larger than the ones kept before, so all are accepted. */
+    destroyed_count = 0;
+    topk = cu_top_k_new_numeric(2, count_destroyed);
+    CHECK(cu_top_k_offer_numeric_batch(topk, NULL, keys, 8) == 8);
+    CHECK(cu_top_k_take(topk, NULL, top) == 2);
+    CHECK(top[0] == 8 && top[1] == 7);
+    CHECK(cu_top_k_offer_numeric(topk, NULL, 5));
+    CHECK(cu_top_k_offer_numeric(topk, NULL, 6));
+    CHECK(!cu_top_k_offer_numeric(topk, NULL, 1));
+    cu_top_k_destroy(topk);
+    CHECK(destroyed_count == 0);
+
+    /* With elements, the rejected and dropped ones are destroyed. */
+    topk = cu_top_k_new_numeric(2, count_destroyed);
+    CHECK(cu_top_k_offer_numeric_batch(topk, elements, keys, 8) == 8);
+    CHECK(destroyed_count == 6);
+    CHECK(!cu_top_k_offer_numeric(topk, elements[0], 0.5));
+    CHECK(destroyed_count == 7);
+    CHECK(cu_top_k_take(topk, kept, top) == 2);
+    CHECK(kept[0] == elements[7] && kept[1] == elements[6]);
+    cu_top_k_destroy(topk);
+
+    /* The same pointer offered repeatedly is still accepted while it is larger. */
+    topk = cu_top_k_new(2, (CUCompareDataFunc)cmp_uint_quiet, NULL, NULL);
+    CHECK(cu_top_k_offer(topk, elements[2]));
+    CHECK(cu_top_k_offer(topk, elements[2]));
+    CHECK(cu_top_k_offer(topk, elements[5]));
+    CHECK(!cu_top_k_offer(topk, elements[0]));
+    CHECK(cu_top_k_take(topk, kept, NULL) == 2);
+    CHECK(kept[0] == elements[5] && kept[1] == elements[2]);
+    cu_top_k_destroy(topk);
+}
+
+static
+void test_meldable_heap(void)
+{
+    CUMeldableHeap *a = cu_meldable_heap_new((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL);
+    CUMeldableHeap *b = cu_meldable_heap_new((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL);
+    CUMeldableHeap *c = cu_meldable_heap_new_full((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL, false);
+    CUMeldableHeapNode *node = NULL;
+    uint32_t j;
+
+    for (j = 0; j < 100; ++j) {
+        cu_meldable_heap_insert(j % 2 ? a : b, CU_UINT_TO_POINTER(2 * j + 1));
+        if (j == 42)
+            node = cu_meldable_heap_insert(c, CU_UINT_TO_POINTER(1000));
+        else
+            cu_meldable_heap_insert(c, CU_UINT_TO_POINTER(2 * j));
+    }
+
+    /* Heaps with their own pools and without a pool can be melded. */
+    CHECK(cu_meldable_heap_meld(a, b));
+    CHECK(cu_meldable_heap_meld(a, c));
+    CHECK(cu_meldable_heap_size(a) == 200);
+    CHECK(cu_meldable_heap_size(b) == 0 && cu_meldable_heap_size(c) == 0);
+    cu_meldable_heap_destroy(b);
+    cu_meldable_heap_destroy(c);
+
+    /* Handles stay valid. */
+    CHECK(cu_meldable_heap_remove(a, node) == CU_UINT_TO_POINTER(1000));
+    for (j = 0; j < 20; ++j)
+        CHECK(cu_meldable_heap_pop_root(a) == CU_UINT_TO_POINTER(j));
+    CHECK(cu_meldable_heap_size(a) == 179);
+    cu_meldable_heap_destroy(a);
+}
+
+static
+bool sum_keys(void *key, void *value, uint32_t *sum)
+{
+    *sum += CU_POINTER_TO_UINT(key);
+    return true;
+}
+
+static
+void test_avl_tree_split_join(void)
+{
+    CUAVLTree *a = cu_avl_tree_new((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL, NULL);
+    CUAVLTree *b = cu_avl_tree_new((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL, NULL);
+    CUAVLTree *c = cu_avl_tree_new_full((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL, NULL, false);
+    CUAVLTree *left, *right;
+    uint32_t j, sum;
+
+    for (j = 0; j < 100; ++j) {
+        cu_avl_tree_insert(a, CU_UINT_TO_POINTER(j), NULL);
+        cu_avl_tree_insert(b, CU_UINT_TO_POINTER(100 + j), NULL);
+        cu_avl_tree_insert(c, CU_UINT_TO_POINTER(2 * j), NULL);
+    }
+
+    /* Trees with different pools are joined without copying. */
+    CHECK(!cu_avl_tree_join(b, a));
+    CHECK(cu_avl_tree_join(a, b));
+    CHECK(cu_avl_tree_find(a, CU_UINT_TO_POINTER(150), NULL));
+    CHECK(!cu_avl_tree_find(b, CU_UINT_TO_POINTER(150), NULL));
+    cu_avl_tree_destroy(b);
+    CHECK(cu_avl_tree_remove(a, CU_UINT_TO_POINTER(150)));
+
+    cu_avl_tree_split(a, CU_UINT_TO_POINTER(50), &left, &right);
+    CHECK(cu_avl_tree_find(left, CU_UINT_TO_POINTER(49), NULL));
+    CHECK(!cu_avl_tree_find(left, CU_UINT_TO_POINTER(50), NULL));
+    CHECK(cu_avl_tree_find(right, CU_UINT_TO_POINTER(50), NULL));
+    CHECK(cu_avl_tree_find(right, CU_UINT_TO_POINTER(199), NULL));
+    cu_avl_tree_destroy(a);
+
+    /* Merging a tree without a pool, duplicates are kept once. */
+    cu_avl_tree_merge(right, c);
+    cu_avl_tree_destroy(c);
+    CHECK(cu_avl_tree_remove(right, CU_UINT_TO_POINTER(198)));
+    CHECK(cu_avl_tree_remove(right, CU_UINT_TO_POINTER(2)));
+    CHECK(cu_avl_tree_join(left, right) == false);
+    sum = 0;
+    cu_avl_tree_foreach(right, (CUTraverseFunc)sum_keys, &sum);
+    /* 50..199 without 198 (150 is back from c), plus the even numbers below 50 without 2. */
+    CHECK(sum == (50 + 199) * 150 / 2 - 198 + 24 * 25 - 2);
+
+    cu_avl_tree_destroy(left);
+    cu_avl_tree_destroy(right);
+}
+
+static
+bool sum_keys_atomic(void *key, void *value, uint32_t *sum)
+{
+    __atomic_fetch_add(sum, CU_POINTER_TO_UINT(key), __ATOMIC_RELAXED);
+    return true;
+}
+
+static
+bool count_below(void *key, void *value, uint32_t *count)
+{
+    if (CU_POINTER_TO_UINT(key) >= 100)
+        return false;
+    ++*count;
+    return true;
+}
+
+static
+void *new_sum(void *userdata)
+{
+    return cu_alloc0(sizeof(uint32_t));
+}
+
+static
+void *reduce_sum(uint32_t *a, uint32_t *b, void *userdata)
+{
+    *a += *b;
+    cu_free(b);
+    return a;
+}
+
+static
+void test_avl_tree_parallel(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new((CUCompareDataFunc)cmp_uint_quiet, NULL, NULL, NULL);
+    uint32_t j, sum = 0, count = 0;
+    uint32_t *result;
+
+    for (j = 1; j <= 1000; ++j)
+        cu_avl_tree_insert(tree, CU_UINT_TO_POINTER(j), NULL);
+
+    cu_avl_tree_parallel_foreach(tree, 4, (CUTraverseFunc)sum_keys_atomic, &sum);
+    CHECK(sum == 1000 * 1001 / 2);
+
+    result = cu_avl_tree_parallel_reduce(tree, 4, new_sum, (CUTraverseFunc)sum_keys,
+                                         (CUAVLTreeReduceFunc)reduce_sum, NULL);
+    CHECK(result && *result == 1000 * 1001 / 2);
+    cu_free(result);
+
+    /* A single thread visits the chunks in order, so cancelling stops right at the key. */
+    cu_avl_tree_parallel_foreach(tree, 1, (CUTraverseFunc)count_below, &count);
+    CHECK(count == 99);
+
+    cu_avl_tree_destroy(tree);
+}
+
+static
+void test_avl_tree_persistent(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new_persistent(NULL, NULL, NULL, count_destroyed);
+    CUAVLTreeSnapshot *snapshot;
+    void *value = NULL;
+    uint32_t j, sum = 0;
+
+    destroyed_count = 0;
+    for (j = 1; j <= 100; ++j)
+        cu_avl_tree_insert(tree, CU_UINT_TO_POINTER(j), CU_UINT_TO_POINTER(j));
+    snapshot = cu_avl_tree_snapshot_acquire(tree);
+    CHECK(snapshot != NULL);
+
+    for (j = 1; j <= 50; ++j)
+        CHECK(cu_avl_tree_remove(tree, CU_UINT_TO_POINTER(j)));
+    cu_avl_tree_insert(tree, CU_UINT_TO_POINTER(100), CU_UINT_TO_POINTER(1000));
+
+    /* The snapshot still sees the old version, and nothing it refers to is freed. */
+    CHECK(destroyed_count == 0);
+    CHECK(cu_avl_tree_snapshot_find(snapshot, CU_UINT_TO_POINTER(1), &value) && value == CU_UINT_TO_POINTER(1));
+    CHECK(cu_avl_tree_snapshot_find(snapshot, CU_UINT_TO_POINTER(100), &value) && value == CU_UINT_TO_POINTER(100));
+    cu_avl_tree_snapshot_foreach(snapshot, (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 100 * 101 / 2);
+
+    CHECK(!cu_avl_tree_find(tree, CU_UINT_TO_POINTER(1), NULL));
+    CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(100), &value) && value == CU_UINT_TO_POINTER(1000));
+
+    cu_avl_tree_snapshot_release(snapshot);
+    cu_avl_tree_reclaim(tree);
+    CHECK(destroyed_count == 51);
+
+    cu_avl_tree_destroy(tree);
+    CHECK(destroyed_count == 101);
+}
+
+static
+void test_avl_tree_lookup_or_insert(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new(NULL, NULL, NULL, NULL);
+    void **slot;
+    void *value = NULL;
+    bool inserted = false;
+    uint32_t j, key;
+
+    /* Count occurrences, with finger search for the clustered keys. */
+    cu_avl_tree_set_finger_search(tree, true);
+    for (j = 0; j < 1000; ++j) {
+        key = j % 100 + 1;
+        slot = cu_avl_tree_lookup_or_insert(tree, CU_UINT_TO_POINTER(key), &inserted);
+        CHECK(slot != NULL && inserted == (j < 100));
+        *slot = CU_UINT_TO_POINTER(CU_POINTER_TO_UINT(*slot) + 1);
+    }
+    for (j = 1; j <= 100; ++j)
+        CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(j), &value) && value == CU_UINT_TO_POINTER(10));
+
+    cu_avl_tree_set_finger_search(tree, false);
+    CHECK(cu_avl_tree_remove(tree, CU_UINT_TO_POINTER(50)));
+    slot = cu_avl_tree_lookup_or_insert(tree, CU_UINT_TO_POINTER(50), &inserted);
+    CHECK(inserted && slot && *slot == NULL);
+
+    cu_avl_tree_destroy(tree);
+}
+
+static
+bool check_ascending(void *key, void *value, uint32_t *last)
+{
+    CHECK(CU_POINTER_TO_UINT(key) > *last);
+    *last = CU_POINTER_TO_UINT(key);
+    return true;
+}
+
+static
+void test_avl_tree_set(void)
+{
+    CUAVLTree *set = cu_avl_tree_new_set(NULL, NULL, count_destroyed);
+    void *value = CU_UINT_TO_POINTER(1);
+    uint32_t j, sum = 0;
+
+    destroyed_count = 0;
+    for (j = 1; j <= 100; ++j)
+        cu_avl_tree_insert(set, CU_UINT_TO_POINTER(j), CU_UINT_TO_POINTER(j));
+    /* Values are ignored. */
+    CHECK(cu_avl_tree_find(set, CU_UINT_TO_POINTER(42), &value) && value == NULL);
+    CHECK(cu_avl_tree_lookup_or_insert(set, CU_UINT_TO_POINTER(42), NULL) == NULL);
+    CHECK(!cu_avl_tree_find(set, CU_UINT_TO_POINTER(101), NULL));
+
+    CHECK(cu_avl_tree_remove(set, CU_UINT_TO_POINTER(100)));
+    CHECK(destroyed_count == 1);
+    cu_avl_tree_foreach(set, (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 99 * 100 / 2);
+
+    cu_avl_tree_destroy(set);
+    CHECK(destroyed_count == 100);
+}
+
+static
+void test_avl_tree_batch(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new(NULL, NULL, NULL, NULL);
+    void *keys[300], *values[300];
+    void *value = NULL;
+    uint32_t j, last = 0;
+
+    for (j = 0; j < 100; ++j)
+        cu_avl_tree_insert(tree, CU_UINT_TO_POINTER(3 * j + 1), NULL);
+
+    /* Unsorted, overlapping the tree, and with a duplicate of which the last one wins. */
+    for (j = 0; j < 299; ++j) {
+        keys[j] = CU_UINT_TO_POINTER((j * 7919) % 299 + 1);
+        values[j] = keys[j];
+    }
+    keys[299] = CU_UINT_TO_POINTER(1);
+    values[299] = CU_UINT_TO_POINTER(1000);
+    cu_avl_tree_insert_batch(tree, keys, values, 300);
+
+    for (j = 2; j <= 299; ++j)
+        CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(j), &value) && value == CU_UINT_TO_POINTER(j));
+    CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(1), &value) && value == CU_UINT_TO_POINTER(1000));
+    CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(298), NULL));
+    cu_avl_tree_foreach(tree, (CUTraverseFunc)check_ascending, &last);
+    CHECK(last == 299);
+
+    /* Remove the even keys, and some that are not in the tree. */
+    for (j = 0; j < 150; ++j)
+        keys[j] = CU_UINT_TO_POINTER(2 * j + 2);
+    for (j = 150; j < 160; ++j)
+        keys[j] = CU_UINT_TO_POINTER(1000 + j);
+    CHECK(cu_avl_tree_remove_batch(tree, keys, 160) == 149);
+    CHECK(!cu_avl_tree_find(tree, CU_UINT_TO_POINTER(298), NULL));
+    CHECK(cu_avl_tree_find(tree, CU_UINT_TO_POINTER(299), NULL));
+
+    cu_avl_tree_destroy(tree);
+}
+
+static
+void test_avl_tree_interval(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new_interval(NULL, NULL, NULL, NULL);
+    void *start = NULL, *end = NULL, *value = NULL;
+    uint32_t sum;
+
+    cu_avl_tree_insert_interval(tree, CU_UINT_TO_POINTER(10), CU_UINT_TO_POINTER(20), CU_UINT_TO_POINTER(1));
+    cu_avl_tree_insert_interval(tree, CU_UINT_TO_POINTER(15), CU_UINT_TO_POINTER(30), CU_UINT_TO_POINTER(2));
+    cu_avl_tree_insert_interval(tree, CU_UINT_TO_POINTER(40), CU_UINT_TO_POINTER(50), CU_UINT_TO_POINTER(3));
+
+    CHECK(cu_avl_tree_find_interval(tree, CU_UINT_TO_POINTER(15), &end, &value) &&
+          end == CU_UINT_TO_POINTER(30) && value == CU_UINT_TO_POINTER(2));
+    CHECK(cu_avl_tree_find_stabbing(tree, CU_UINT_TO_POINTER(17), &start, &value) &&
+          start == CU_UINT_TO_POINTER(10) && value == CU_UINT_TO_POINTER(1));
+    /* Ends are not part of the intervals. */
+    CHECK(!cu_avl_tree_find_stabbing(tree, CU_UINT_TO_POINTER(30), NULL, NULL));
+    CHECK(cu_avl_tree_find_stabbing(tree, CU_UINT_TO_POINTER(20), &start, NULL) && start == CU_UINT_TO_POINTER(15));
+
+    sum = 0;
+    cu_avl_tree_foreach_stabbing(tree, CU_UINT_TO_POINTER(17), (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 10 + 15);
+    sum = 0;
+    cu_avl_tree_foreach_overlapping(tree, CU_UINT_TO_POINTER(25), CU_UINT_TO_POINTER(45), (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 15 + 40);
+
+    CHECK(cu_avl_tree_remove(tree, CU_UINT_TO_POINTER(15)));
+    CHECK(!cu_avl_tree_find_stabbing(tree, CU_UINT_TO_POINTER(25), NULL, NULL));
+
+    cu_avl_tree_destroy(tree);
+}
+
+static
+void test_avl_tree_image(void)
+{
+    CUAVLTree *tree = cu_avl_tree_new(NULL, NULL, NULL, NULL);
+    CUAVLTreeImage *image;
+    char filename[64];
+    const void *value = NULL;
+    size_t value_length = 0;
+    uint64_t j, key;
+
+    for (j = 1; j <= 100; ++j)
+        cu_avl_tree_insert(tree, CU_UINT_TO_POINTER(2 * j), CU_UINT_TO_POINTER(10 * j));
+
+    snprintf(filename, sizeof(filename), "/tmp/cu-test-%d.img", (int)getpid());
+    CHECK(cu_avl_tree_image_write(tree, filename, CU_TYPE_UINT64, NULL, CU_TYPE_UINT64, NULL, NULL));
+    cu_avl_tree_destroy(tree);
+
+    image = cu_avl_tree_image_open(filename);
+    CHECK(image != NULL);
+    if (image) {
+        CHECK(cu_avl_tree_image_length(image) == 100);
+        for (j = 1; j <= 100; ++j) {
+            key = 2 * j;
+            CHECK(cu_avl_tree_image_find(image, &key, sizeof(key), &value, &value_length) &&
+                  value_length == sizeof(uint64_t) && *(const uint64_t *)value == 10 * j);
+            key = 2 * j + 1;
+            CHECK(!cu_avl_tree_image_find(image, &key, sizeof(key), NULL, NULL));
+        }
+        cu_avl_tree_image_close(image);
+    }
+    unlink(filename);
+
+    CHECK(cu_avl_tree_image_open(filename) == NULL);
+}
+
+static
+void test_skip_list(void)
+{
+    CUSkipList *list = cu_skip_list_new(NULL, NULL, NULL, count_destroyed);
+    void *value = NULL;
+    uint32_t j, last = 0;
+
+    destroyed_count = 0;
+    for (j = 1; j <= 1000; ++j)
+        cu_skip_list_insert(list, CU_UINT_TO_POINTER(j), CU_UINT_TO_POINTER(j));
+    for (j = 2; j <= 1000; j += 2)
+        CHECK(cu_skip_list_remove(list, CU_UINT_TO_POINTER(j)));
+    CHECK(!cu_skip_list_remove(list, CU_UINT_TO_POINTER(2)));
+
+    CHECK(cu_skip_list_find(list, CU_UINT_TO_POINTER(999), &value) && value == CU_UINT_TO_POINTER(999));
+    CHECK(!cu_skip_list_find(list, CU_UINT_TO_POINTER(998), NULL));
+    cu_skip_list_insert(list, CU_UINT_TO_POINTER(999), CU_UINT_TO_POINTER(1));
+    CHECK(cu_skip_list_find(list, CU_UINT_TO_POINTER(999), &value) && value == CU_UINT_TO_POINTER(1));
+
+    cu_skip_list_foreach(list, (CUTraverseFunc)check_ascending, &last);
+    CHECK(last == 999);
+
+    /* Removed and replaced values are destroyed once reclaimed, the others by destroy. */
+    cu_skip_list_destroy(list);
+    CHECK(destroyed_count == 1001);
+}
+
+typedef struct {
+    CUEpoch *epoch;
+    uint32_t state; /* 1 while the reader is inside, 2 to let it leave, 3 once it left. */
+} TestEpochReader;
+
+static
+void test_epoch_free(CUEpochEntry *entry, uint32_t *freed)
+{
+    ++*freed;
+    cu_free(entry);
+}
+
+static
+void *test_epoch_reader(TestEpochReader *reader)
+{
+    uint32_t guard = cu_epoch_enter(reader->epoch);
+
+    __atomic_store_n(&reader->state, 1, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&reader->state, __ATOMIC_ACQUIRE) != 2)
+        sched_yield();
+    cu_epoch_leave(reader->epoch, guard);
+    __atomic_store_n(&reader->state, 3, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static
+void test_epoch_retire(CUEpoch *epoch, uint32_t count)
+{
+    uint32_t j, guard;
+
+    for (j = 0; j < count; ++j) {
+        guard = cu_epoch_enter(epoch);
+        cu_epoch_retire(epoch, cu_alloc(sizeof(CUEpochEntry)));
+        cu_epoch_leave(epoch, guard);
+    }
+}
+
+static
+void test_epoch(void)
+{
+    uint32_t freed = 0;
+    CUEpoch *epoch = cu_epoch_new((CUEpochFreeFunc)test_epoch_free, &freed);
+    TestEpochReader reader = { epoch, 0 };
+    pthread_t thread;
+
+    test_epoch_retire(epoch, 100);
+    cu_epoch_reclaim(epoch);
+    CHECK(freed == 100);
+
+    /* Nothing retired while a reader is inside may be freed. */
+    pthread_create(&thread, NULL, (void *(*)(void *))test_epoch_reader, &reader);
+    while (__atomic_load_n(&reader.state, __ATOMIC_ACQUIRE) != 1)
+        sched_yield();
+    freed = 0;
+    test_epoch_retire(epoch, 1000);
+    CHECK(freed == 0);
+
+    __atomic_store_n(&reader.state, 2, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    /* Later retirements advance the epoch past the reader. */
+    test_epoch_retire(epoch, 1000);
+    CHECK(freed > 0);
+
+    cu_epoch_destroy(epoch);
+    CHECK(freed == 2000);
+}
+
+static
+void test_btree(void)
+{
+    CUBTree *tree = cu_btree_new(NULL, NULL, NULL, count_destroyed);
+    void *value = NULL;
+    uint32_t j, key, sum = 0, last = 0;
+
+    /* Enough elements for several levels, inserted out of order. */
+    destroyed_count = 0;
+    for (j = 0; j < 2000; ++j) {
+        key = (j * 7919) % 2000 + 1;
+        cu_btree_insert(tree, CU_UINT_TO_POINTER(key), CU_UINT_TO_POINTER(key));
+    }
+    CHECK(cu_btree_length(tree) == 2000);
+
+    cu_btree_insert(tree, CU_UINT_TO_POINTER(1000), CU_UINT_TO_POINTER(1));
+    CHECK(destroyed_count == 1);
+    CHECK(cu_btree_length(tree) == 2000);
+    CHECK(cu_btree_find(tree, CU_UINT_TO_POINTER(1000), &value) && value == CU_UINT_TO_POINTER(1));
+
+    for (j = 2; j <= 2000; j += 2)
+        CHECK(cu_btree_remove(tree, CU_UINT_TO_POINTER(j)));
+    CHECK(!cu_btree_remove(tree, CU_UINT_TO_POINTER(2)));
+    CHECK(!cu_btree_find(tree, CU_UINT_TO_POINTER(2000), NULL));
+    CHECK(cu_btree_find(tree, CU_UINT_TO_POINTER(1999), NULL));
+    CHECK(cu_btree_length(tree) == 1000);
+
+    cu_btree_foreach(tree, (CUTraverseFunc)check_ascending, &last);
+    CHECK(last == 1999);
+
+    /* The odd keys from 101 to 199. */
+    cu_btree_foreach_range(tree, CU_UINT_TO_POINTER(100), CU_UINT_TO_POINTER(200),
+                           (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 50 * 150);
+
+    cu_btree_destroy(tree);
+    CHECK(destroyed_count == 2001);
+}
+
+static
+void test_hash_table(void)
+{
+    CUHashTable *table = cu_hash_table_new(NULL, NULL, NULL, count_destroyed);
+    CUHashTable *strings;
+    void *value = NULL;
+    char name[16];
+    uint32_t j, sum = 0;
+
+    /* Grow through several sizes, then leave many removed markers behind. */
+    destroyed_count = 0;
+    for (j = 1; j <= 10000; ++j)
+        cu_hash_table_insert(table, CU_UINT_TO_POINTER(j), CU_UINT_TO_POINTER(j));
+    CHECK(cu_hash_table_length(table) == 10000);
+    for (j = 1; j <= 10000; j += 2)
+        CHECK(cu_hash_table_remove(table, CU_UINT_TO_POINTER(j)));
+    CHECK(!cu_hash_table_remove(table, CU_UINT_TO_POINTER(1)));
+    CHECK(destroyed_count == 5000);
+    cu_hash_table_insert(table, CU_UINT_TO_POINTER(2), CU_UINT_TO_POINTER(3));
+    CHECK(destroyed_count == 5001);
+    CHECK(cu_hash_table_length(table) == 5000);
+
+    cu_hash_table_rehash(table, 0);
+    for (j = 1; j <= 10000; ++j)
+        CHECK(cu_hash_table_find(table, CU_UINT_TO_POINTER(j), &value) == !(j & 1));
+    CHECK(cu_hash_table_find(table, CU_UINT_TO_POINTER(2), &value) && value == CU_UINT_TO_POINTER(3));
+    cu_hash_table_foreach(table, (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 5001 * 5000);
+
+    cu_hash_table_destroy(table);
+    CHECK(destroyed_count == 10001);
+
+    /* Equal strings at different addresses are the same key. */
+    strings = cu_hash_table_new(cu_hash_table_hash_string, cu_hash_table_equal_string, cu_free, NULL);
+    cu_hash_table_reserve(strings, 100);
+    for (j = 0; j < 100; ++j) {
+        snprintf(name, sizeof(name), "key-%u", j);
+        cu_hash_table_insert(strings, strcpy(cu_alloc(strlen(name) + 1), name), CU_UINT_TO_POINTER(j + 1));
+    }
+    CHECK(cu_hash_table_find(strings, "key-42", &value) && value == CU_UINT_TO_POINTER(43));
+    CHECK(!cu_hash_table_find(strings, "key-100", NULL));
+    CHECK(cu_hash_table_remove(strings, "key-42"));
+    CHECK(cu_hash_table_length(strings) == 99);
+    cu_hash_table_destroy(strings);
+}
+
+typedef struct {
+    CUConcurrentHashMap *map;
+    uint32_t first;
+} TestMapThread;
+
+static
+void *test_concurrent_hash_map_thread(TestMapThread *thread)
+{
+    uint32_t j;
+
+    for (j = thread->first; j < thread->first + 2500; ++j)
+        cu_concurrent_hash_map_insert(thread->map, CU_UINT_TO_POINTER(j), CU_UINT_TO_POINTER(j));
+    for (j = thread->first; j < thread->first + 2500; j += 2)
+        CHECK(cu_concurrent_hash_map_remove(thread->map, CU_UINT_TO_POINTER(j)));
+    return NULL;
+}
+
+static
+void test_concurrent_hash_map(void)
+{
+    CUConcurrentHashMap *map = cu_concurrent_hash_map_new(NULL, NULL, NULL, count_destroyed);
+    TestMapThread threads[4];
+    pthread_t thread_ids[4];
+    void *value = NULL;
+    uint32_t j, sum = 0;
+
+    destroyed_count = 0;
+    for (j = 0; j < 4; ++j) {
+        threads[j] = (TestMapThread){ map, 1 + 2500 * j };
+        pthread_create(&thread_ids[j], NULL, (void *(*)(void *))test_concurrent_hash_map_thread, &threads[j]);
+    }
+    for (j = 0; j < 4; ++j)
+        pthread_join(thread_ids[j], NULL);
+
+    /* Each thread started at an odd key, so the even keys are left. */
+    CHECK(cu_concurrent_hash_map_length(map) == 5000);
+    for (j = 1; j <= 10000; ++j)
+        CHECK(cu_concurrent_hash_map_find(map, CU_UINT_TO_POINTER(j), &value) == !(j & 1));
+    CHECK(cu_concurrent_hash_map_find(map, CU_UINT_TO_POINTER(9998), &value) && value == CU_UINT_TO_POINTER(9998));
+    cu_concurrent_hash_map_foreach(map, (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == 5000 * 5001);
+
+    cu_concurrent_hash_map_insert(map, CU_UINT_TO_POINTER(2), CU_UINT_TO_POINTER(3));
+    CHECK(cu_concurrent_hash_map_find(map, CU_UINT_TO_POINTER(2), &value) && value == CU_UINT_TO_POINTER(3));
+
+    /* Removed values may be destroyed late, but all are destroyed by now. */
+    cu_concurrent_hash_map_destroy(map);
+    CHECK(destroyed_count == 10001);
+}
+
+static
+void test_ar_tree(void)
+{
+    CUARTree *tree = cu_ar_tree_new(NULL, count_destroyed);
+    void *value = NULL;
+    uint32_t j, key, sum = 0, last = 0;
+
+    /* Inner nodes grow through all sizes, out of order. */
+    destroyed_count = 0;
+    for (j = 0; j < 1000; ++j) {
+        key = (j * 7919) % 1000 + 1;
+        cu_ar_tree_insert(tree, CU_UINT_TO_POINTER(key), CU_UINT_TO_POINTER(key));
+    }
+    /* A key sharing no prefix with the others. */
+    cu_ar_tree_insert(tree, (void *)UINTPTR_MAX, CU_UINT_TO_POINTER(1));
+    CHECK(cu_ar_tree_length(tree) == 1001);
+    CHECK(cu_ar_tree_find(tree, CU_UINT_TO_POINTER(1000), &value) && value == CU_UINT_TO_POINTER(1000));
+    CHECK(cu_ar_tree_find(tree, (void *)UINTPTR_MAX, &value) && value == CU_UINT_TO_POINTER(1));
+    CHECK(!cu_ar_tree_find(tree, CU_UINT_TO_POINTER(1001), NULL));
+    CHECK(!cu_ar_tree_find(tree, NULL, NULL));
+
+    CHECK(cu_ar_tree_remove(tree, (void *)UINTPTR_MAX));
+    cu_ar_tree_foreach(tree, (CUTraverseFunc)check_ascending, &last);
+    CHECK(last == 1000);
+
+    cu_ar_tree_foreach_range(tree, CU_UINT_TO_POINTER(100), CU_UINT_TO_POINTER(199), (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == (100 + 199) * 100 / 2);
+
+    /* All keys from 0x300 to 0x3ff, of which 768 to 1000 exist. */
+    sum = 0;
+    cu_ar_tree_foreach_prefix(tree, CU_UINT_TO_POINTER(0x300), sizeof(void *) * 8 - 8, (CUTraverseFunc)sum_keys, &sum);
+    CHECK(sum == (768 + 1000) * 233 / 2);
+
+    /* Nodes shrink again. */
+    for (j = 4; j <= 1000; ++j)
+        CHECK(cu_ar_tree_remove(tree, CU_UINT_TO_POINTER(j)));
+    CHECK(!cu_ar_tree_remove(tree, CU_UINT_TO_POINTER(4)));
+    CHECK(cu_ar_tree_length(tree) == 3);
+    for (j = 1; j <= 3; ++j)
+        CHECK(cu_ar_tree_find(tree, CU_UINT_TO_POINTER(j), &value) && value == CU_UINT_TO_POINTER(j));
+
+    cu_ar_tree_destroy(tree);
+    CHECK(destroyed_count == 1001);
+}
+
+static
+void test_sorted_vector(void)
+{
+    CUSortedVector *vector;
+    void *keys[200], *values[200], *value = NULL;
+    void **slot;
+    bool inserted = false;
+    uint32_t j, layout, last;
+
+    /* Both layouts have to give the same results. */
+    for (layout = 0; layout < 2; ++layout) {
+        vector = cu_sorted_vector_new_full(NULL, NULL, NULL, count_destroyed, layout);
+        destroyed_count = 0;
+        last = 0;
+
+        for (j = 0; j < 100; ++j)
+            cu_sorted_vector_insert(vector, CU_UINT_TO_POINTER((j * 37) % 100 * 2 + 2), CU_UINT_TO_POINTER(j + 1));
+        for (j = 0; j < 200; ++j) {
+            keys[j] = CU_UINT_TO_POINTER(j + 1);
+            values[j] = CU_UINT_TO_POINTER(j + 1001);
+        }
+        /* Replaces the values of the even keys. */
+        cu_sorted_vector_insert_batch(vector, keys, values, 200);
+        CHECK(destroyed_count == 100);
+        CHECK(cu_sorted_vector_length(vector) == 200);
+
+        for (j = 1; j <= 200; ++j)
+            CHECK(cu_sorted_vector_find(vector, CU_UINT_TO_POINTER(j), &value) && value == CU_UINT_TO_POINTER(j + 1000));
+        CHECK(!cu_sorted_vector_find(vector, CU_UINT_TO_POINTER(201), NULL));
+        CHECK(!cu_sorted_vector_find(vector, NULL, NULL));
+        cu_sorted_vector_foreach(vector, (CUTraverseFunc)check_ascending, &last);
+        CHECK(last == 200);
+
+        slot = cu_sorted_vector_lookup_or_insert(vector, CU_UINT_TO_POINTER(300), &inserted);
+        CHECK(inserted && slot && *slot == NULL);
+        *slot = CU_UINT_TO_POINTER(300);
+        slot = cu_sorted_vector_lookup_or_insert(vector, CU_UINT_TO_POINTER(300), &inserted);
+        CHECK(!inserted && slot && *slot == CU_UINT_TO_POINTER(300));
+
+        CHECK(cu_sorted_vector_remove(vector, CU_UINT_TO_POINTER(300)));
+        CHECK(!cu_sorted_vector_remove(vector, CU_UINT_TO_POINTER(300)));
+        CHECK(cu_sorted_vector_remove_batch(vector, keys, 100) == 100);
+        CHECK(cu_sorted_vector_length(vector) == 100);
+        CHECK(!cu_sorted_vector_find(vector, CU_UINT_TO_POINTER(100), NULL));
+        CHECK(cu_sorted_vector_find(vector, CU_UINT_TO_POINTER(101), NULL));
+
+        cu_sorted_vector_destroy(vector);
+        CHECK(destroyed_count == 301);
+    }
+}
+
+static
+void test_heap(void)
+{
+    static uint32_t values[1000];
+    void *elements[1000];
+    uint32_t positions[100];
+    CUHeap heap;
+    uint32_t j;
+
+    for (j = 0; j < 1000; ++j) {
+        values[j] = test_random() % 500;
+        elements[j] = &values[j];
+    }
+
+    cu_heap_init_from_array(&heap, (CUCompareDataFunc)cmp_deref, NULL, elements, 1000);
+    CHECK(heap.length == 1000);
+    CHECK(check_heap_sorted(&heap) == 1000);
+    cu_heap_clear(&heap, NULL);
+
+    /* Bulk insert into a non-empty 8-ary heap, then change some priorities at once. */
+    cu_heap_init_full(&heap, (CUCompareDataFunc)cmp_deref, NULL, NULL, NULL, 8);
+    for (j = 0; j < 10; ++j)
+        cu_heap_insert(&heap, elements[j]);
+    cu_heap_insert_bulk(&heap, elements + 10, 990);
+    CHECK(heap.length == 1000);
+    for (j = 0; j < 100; ++j) {
+        positions[j] = test_random() % heap.length;
+        *(uint32_t *)heap.data[positions[j]] = test_random() % 500;
+    }
+    cu_heap_update_batch(&heap, positions, 100);
+    CHECK(check_heap_sorted(&heap) == 1000);
+
+    /* Shrinking keeps the reserved capacity. */
+    cu_heap_reserve(&heap, 100);
+    cu_heap_set_shrink(&heap, true);
+    cu_heap_insert_bulk(&heap, elements, 1000);
+    CHECK(check_heap_sorted(&heap) == 1000);
+    CHECK(heap.max_length >= 100 && heap.max_length < 1000);
+    cu_heap_clear(&heap, NULL);
+}
+
+static
+void set_position(void *element, uint32_t pos, uint32_t *positions)
+{
+    positions[CU_POINTER_TO_UINT(element)] = pos;
+}
+
+static
+void test_priority_heap(void)
+{
+    static uint32_t positions[1001];
+    CUPriorityHeap heap;
+    uint64_t priority, last = 0;
+    uint32_t j, count = 0;
+    void *element;
+
+    /* Elements are their ids from 1 to 1000, the priority is drawn at random. */
+    cu_priority_heap_init_full(&heap, false, (CUHeapSetPositionCallback)set_position, positions, 0);
+    for (j = 1; j <= 1000; ++j)
+        cu_priority_heap_insert(&heap, CU_UINT_TO_POINTER(j), test_random() % 10000 + 10);
+
+    /* Move some elements to the top, and drop some others. */
+    for (j = 1; j <= 5; ++j)
+        cu_priority_heap_update(&heap, positions[j], j);
+    for (j = 6; j <= 10; ++j)
+        cu_priority_heap_remove(&heap, positions[j]);
+
+    CHECK(CU_POINTER_TO_UINT(cu_priority_heap_peek_root(&heap, &priority)) == 1 && priority == 1);
+    while ((element = cu_priority_heap_pop_root(&heap, &priority))) {
+        CHECK(priority >= last);
+        CHECK(CU_POINTER_TO_UINT(element) < 6 || CU_POINTER_TO_UINT(element) > 10);
+        last = priority;
+        ++count;
+    }
+    CHECK(count == 995);
+    cu_priority_heap_clear(&heap, NULL);
+
+    /* Doubles keep their order, including negative numbers. */
+    cu_priority_heap_init_full(&heap, true, NULL, NULL, 2);
+    cu_priority_heap_insert(&heap, CU_UINT_TO_POINTER(1), cu_priority_heap_key_from_double(-2.5));
+    cu_priority_heap_insert(&heap, CU_UINT_TO_POINTER(2), cu_priority_heap_key_from_double(0.5));
+    cu_priority_heap_insert(&heap, CU_UINT_TO_POINTER(3), cu_priority_heap_key_from_double(-0.5));
+    CHECK(cu_priority_heap_pop_root(&heap, &priority) == CU_UINT_TO_POINTER(2));
+    CHECK(cu_priority_heap_key_to_double(priority) == 0.5);
+    CHECK(cu_priority_heap_pop_root(&heap, NULL) == CU_UINT_TO_POINTER(3));
+    CHECK(cu_priority_heap_pop_root(&heap, &priority) == CU_UINT_TO_POINTER(1));
+    CHECK(cu_priority_heap_key_to_double(priority) == -2.5);
+    CHECK(cu_priority_heap_pop_root(&heap, NULL) == NULL);
+    cu_priority_heap_clear(&heap, NULL);
+}
+
+static
+void test_radix_heap(void)
+{
+    CURadixHeap heap;
+    uint64_t key, last = 0;
+    uint32_t j, count = 0;
+
+    /* Like a timer loop, every popped key schedules a later one. */
+    cu_radix_heap_init(&heap);
+    for (j = 1; j <= 1000; ++j)
+        CHECK(cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(j), test_random() % 100000));
+    for (j = 0; j < 1000; ++j) {
+        CHECK(cu_radix_heap_pop_min(&heap, &key) != NULL && key >= last);
+        last = key;
+        CHECK(cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(j + 1), key + test_random() % 100000));
+    }
+    CHECK(!cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(1), last - 1));
+    CHECK(cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(1), last));
+    CHECK(cu_radix_heap_size(&heap) == 1001);
+
+    while (cu_radix_heap_pop_min(&heap, &key)) {
+        CHECK(key >= last);
+        last = key;
+        ++count;
+    }
+    CHECK(count == 1001);
+
+    /* Clearing allows smaller keys again. */
+    cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(1), last + 10);
+    cu_radix_heap_clear(&heap, NULL);
+    CHECK(cu_radix_heap_size(&heap) == 0);
+    CHECK(cu_radix_heap_insert(&heap, CU_UINT_TO_POINTER(1), 0));
+    cu_radix_heap_clear(&heap, NULL);
+}
+
+static
+void test_indexed_heap(void)
+{
+    CUIndexedHeap heap;
+    uint64_t priority, last = 0;
+    uint32_t j, id, count = 0;
+
+    cu_indexed_heap_init(&heap);
+    for (j = 0; j < 1000; ++j)
+        cu_indexed_heap_insert(&heap, j, test_random() % 10000 + 10);
+
+    /* Inserting an id again changes its priority. */
+    cu_indexed_heap_insert(&heap, 500, 1);
+    CHECK(cu_indexed_heap_update(&heap, 600, 2));
+    CHECK(cu_indexed_heap_update(&heap, 500, 3));
+    CHECK(cu_indexed_heap_remove(&heap, 700));
+    CHECK(!cu_indexed_heap_remove(&heap, 700));
+    CHECK(!cu_indexed_heap_update(&heap, 700, 1));
+    CHECK(!cu_indexed_heap_contains(&heap, 700, NULL));
+    CHECK(!cu_indexed_heap_contains(&heap, 5000, NULL));
+    CHECK(cu_indexed_heap_contains(&heap, 500, &priority) && priority == 3);
+
+    CHECK(cu_indexed_heap_peek_root(&heap, &id, &priority) && id == 600 && priority == 2);
+    while (cu_indexed_heap_pop_root(&heap, &id, &priority)) {
+        CHECK(priority >= last && id != 700);
+        CHECK(!cu_indexed_heap_contains(&heap, id, NULL));
+        last = priority;
+        ++count;
+    }
+    CHECK(count == 999);
+    cu_indexed_heap_clear(&heap);
+
+    /* Ids beyond the reserved ones grow the heap. */
+    cu_indexed_heap_init_full(&heap, true, 2);
+    cu_indexed_heap_reserve(&heap, 10);
+    cu_indexed_heap_insert(&heap, 5, 50);
+    cu_indexed_heap_insert(&heap, 100000, 60);
+    CHECK(cu_indexed_heap_pop_root(&heap, &id, NULL) && id == 100000);
+    CHECK(cu_indexed_heap_pop_root(&heap, &id, NULL) && id == 5);
+    CHECK(!cu_indexed_heap_pop_root(&heap, NULL, NULL));
+    cu_indexed_heap_clear(&heap);
+}
+
+static
+void test_multi_queue(void)
+{
+    CUMultiQueue *queue = cu_multi_queue_new((CUCompareDataFunc)cmp_uint_quiet, NULL, 4);
+    bool seen[1001] = { false };
+    uint32_t j, value, last = 0;
+
+    for (j = 1; j <= 1000; ++j)
+        cu_multi_queue_insert(queue, CU_UINT_TO_POINTER(j));
+    CHECK(cu_multi_queue_size(queue) == 1000);
+
+    /* The order is relaxed, but every element comes out exactly once. */
+    for (j = 0; j < 1000; ++j) {
+        value = CU_POINTER_TO_UINT(cu_multi_queue_pop(queue));
+        CHECK(value >= 1 && value <= 1000 && !seen[value]);
+        if (value <= 1000)
+            seen[value] = true;
+    }
+    CHECK(cu_multi_queue_pop(queue) == NULL);
+    cu_multi_queue_destroy(queue, NULL);
+
+    /* A strict queue has a single heap and pops in order. */
+    queue = cu_multi_queue_new_full((CUCompareDataFunc)cmp_uint_quiet, NULL, 4, 0, true);
+    for (j = 1000; j > 0; --j)
+        cu_multi_queue_insert(queue, CU_UINT_TO_POINTER(j));
+    for (j = 0; j < 1000; ++j) {
+        value = CU_POINTER_TO_UINT(cu_multi_queue_pop(queue));
+        CHECK(value == last + 1);
+        last = value;
+    }
+    cu_multi_queue_destroy(queue, NULL);
+}
+
 static
 bool visit_node(void *key, void *value, void *nil)
 {
@@ -103,5 +1094,32 @@ int main(int argc, char **argv)
 
     cu_avl_tree_destroy(btree);
 
+    test_heap();
+    test_priority_heap();
+    test_radix_heap();
+    test_indexed_heap();
+    test_multi_queue();
+    test_top_k();
+    test_meldable_heap();
+    test_avl_tree_split_join();
+    test_avl_tree_parallel();
+    test_avl_tree_persistent();
+    test_avl_tree_lookup_or_insert();
+    test_avl_tree_set();
+    test_avl_tree_batch();
+    test_avl_tree_interval();
+    test_avl_tree_image();
+    test_skip_list();
+    test_epoch();
+    test_btree();
+    test_hash_table();
+    test_concurrent_hash_map();
+    test_ar_tree();
+    test_sorted_vector();
+
+    if (check_failures) {
+        fprintf(stderr, "%u checks failed\n", check_failures);
+        return 1;
+    }
     return 0;
 }